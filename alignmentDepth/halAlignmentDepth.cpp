@@ -9,6 +9,7 @@
 #include <fstream>
 #include <algorithm>
 #include "hal.h"
+#include "halBigWig.h"
 
 using namespace std;
 using namespace hal;
@@ -36,15 +37,16 @@ using namespace hal;
  */
 
 /** Print the alignment depth wiggle for a subrange of a given sequence to
- * the output stream. */
-static void printSequence(ostream& outStream, const Sequence* sequence, 
+ * the output stream (or add it to the bigWig writer if not NULL). */
+static void printSequence(ostream& outStream, BigWigWriter* bigWigWriter,
+                          const Sequence* sequence, 
                           const set<const Genome*>& targetSet,
                           hal_size_t start, hal_size_t length, hal_size_t step,
                           bool countDupes, bool noAncestors);
 
 /** If given genome-relative coordinates, map them to a series of 
  * sequence subranges */
-static void printGenome(ostream& outStream,
+static void printGenome(ostream& outStream, BigWigWriter* bigWigWriter,
                         const Genome* genome, const Sequence* sequence,
                         const set<const Genome*>& targetSet,
                         hal_size_t start, hal_size_t length, hal_size_t step,
@@ -62,6 +64,8 @@ static CLParserPtr initParser()
   optionsParser->addArgument("refGenome", "reference genome to scan");
   optionsParser->addOption("outWiggle", "output wig file (stdout if none)",
                            "stdout");
+  optionsParser->addOptionFlag("outBigWig", "write the output as a bigWig "
+                               "file instead of a text wig", false);
   optionsParser->addOption("refSequence", "sequence name to export ("
                            "all sequences by default)", 
                            "\"\"");
@@ -113,6 +117,7 @@ int main(int argc, char** argv)
   hal_size_t step;
   bool countDupes;
   bool noAncestors;
+  bool outBigWig;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -127,6 +132,7 @@ int main(int argc, char** argv)
     step = optionsParser->getOption<hal_size_t>("step");
     countDupes = optionsParser->getFlag("countDupes");
     noAncestors = optionsParser->getFlag("noAncestors");
+    outBigWig = optionsParser->getFlag("outBigWig");
 
     if (rootGenomeName != "\"\"" && targetGenomes != "\"\"")
     {
@@ -231,7 +237,7 @@ int main(int argc, char** argv)
     ostream& outStream = wigPath == "stdout" ? cout : ofile;
     if (wigPath != "stdout")
     {
-      ofile.open(wigPath.c_str());
+      ofile.open(wigPath.c_str(), ios::out | ios::binary);
       if (!ofile)
       {
         throw hal_exception(string("Error opening output file ") + 
@@ -239,8 +245,21 @@ int main(int argc, char** argv)
       }
     }
     
-    printGenome(outStream, refGenome, refSequence, targetSet, start, length, 
-                step, countDupes, noAncestors);
+    BigWigWriter bigWigWriter;
+    BigWigWriter* bigWigWriterPtr = NULL;
+    if (outBigWig == true)
+    {
+      bigWigWriter.open(&outStream, refGenome);
+      bigWigWriterPtr = &bigWigWriter;
+    }
+    
+    printGenome(outStream, bigWigWriterPtr, refGenome, refSequence, targetSet,
+                start, length, step, countDupes, noAncestors);
+
+    if (outBigWig == true)
+    {
+      bigWigWriter.close();
+    }
     
   }
   catch(hal_exception& e)
@@ -260,7 +279,8 @@ int main(int argc, char** argv)
 /** Given a Sequence (chromosome) and a (sequence-relative) coordinate
  * range, print the alignmability wiggle with respect to the genomes
  * in the target set */
-void printSequence(ostream& outStream, const Sequence* sequence, 
+void printSequence(ostream& outStream, BigWigWriter* bigWigWriter,
+                   const Sequence* sequence, 
                    const set<const Genome*>& targetSet,
                    hal_size_t start, hal_size_t length, hal_size_t step,
                    bool countDupes, bool noAncestors)
@@ -304,8 +324,11 @@ void printSequence(ostream& outStream, const Sequence* sequence,
                                                              false,
                                                              noAncestors);
   // note wig coordinates are 1-based for some reason so we shift to right
-  outStream << "fixedStep chrom=" << sequenceName << " start=" << start + 1
-            << " step=" << step << "\n";
+  if (bigWigWriter == NULL)
+  {
+    outStream << "fixedStep chrom=" << sequenceName << " start=" << start + 1
+              << " step=" << step << "\n";
+  }
   
   /** Since the column iterator stores coordinates in Genome coordinates
    * internally, we have to switch back to genome coordinates.  */
@@ -345,7 +368,15 @@ void printSequence(ostream& outStream, const Sequence* sequence,
     // don't want to include reference base in output
     --count;
 
-    outStream << count << '\n';
+    if (bigWigWriter == NULL)
+    {
+      outStream << count << '\n';
+    }
+    else
+    {
+      hal_size_t seqPos = pos - sequence->getStartPosition();
+      bigWigWriter->addInterval(sequenceName, seqPos, seqPos + 1, count);
+    }
     
     /** lastColumn checks if we are at the last column (inclusive)
      * in range.  So we need to check at end of iteration instead
@@ -388,7 +419,7 @@ void printSequence(ostream& outStream, const Sequence* sequence,
  * for the hal::Sequence interface.  We can convert between the two by 
  * adding or subtracting the sequence start position (in the example it woudl
  * be 0 for ChrA and 500 for ChrB) */
-void printGenome(ostream& outStream,
+void printGenome(ostream& outStream, BigWigWriter* bigWigWriter,
                  const Genome* genome, const Sequence* sequence,
                  const set<const Genome*>& targetSet,
                  hal_size_t start, hal_size_t length, hal_size_t step,
@@ -396,8 +427,8 @@ void printGenome(ostream& outStream,
 {
   if (sequence != NULL)
   {
-    printSequence(outStream, sequence, targetSet, start, length, step, countDupes,
-                  noAncestors);
+    printSequence(outStream, bigWigWriter, sequence, targetSet, start, length,
+                  step, countDupes, noAncestors);
   }
   else
   {
@@ -430,8 +461,8 @@ void printGenome(ostream& outStream,
         hal_size_t readStart = seqStart >= start ? 0 : start - seqStart;
         hal_size_t readLen = min(seqLen - readStart, length);
         readLen = min(readLen, length - runningLength);
-        printSequence(outStream, sequence, targetSet, readStart, readLen, step,
-                      countDupes, noAncestors);
+        printSequence(outStream, bigWigWriter, sequence, targetSet, readStart,
+                      readLen, step, countDupes, noAncestors);
         runningLength += readLen;
       }
     }
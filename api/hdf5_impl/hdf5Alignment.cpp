@@ -36,14 +36,19 @@ const H5std_string HDF5Alignment::MetaGroupName = "Meta";
 const H5std_string HDF5Alignment::TreeGroupName = "Phylogeny";
 const H5std_string HDF5Alignment::GenomesGroupName = "Genomes";
 const H5std_string HDF5Alignment::VersionGroupName = "Verison";
+const H5std_string HDF5Alignment::StatsGroupName = "Stats";
+const H5std_string HDF5Alignment::ChangeLogGroupName = "ChangeLog";
 
 HDF5Alignment::HDF5Alignment() :
   _file(NULL),
   _flags(H5F_ACC_RDONLY),
   _metaData(NULL),
+  _statsCache(NULL),
+  _changeLog(NULL),
   _tree(NULL),
   _dirty(false),
-  _inMemory(false)
+  _inMemory(false),
+  _writeThread(false)
 {
   // set defaults from the command-line parser
   HDF5CLParser defaultOptions(true);  
@@ -58,9 +63,12 @@ HDF5Alignment::HDF5Alignment(const H5::FileCreatPropList& fileCreateProps,
   _file(NULL),
   _flags(H5F_ACC_RDONLY),
   _metaData(NULL),
+  _statsCache(NULL),
+  _changeLog(NULL),
   _tree(NULL),
   _dirty(false),
-  _inMemory(inMemory)
+  _inMemory(inMemory),
+  _writeThread(false)
 {
   _cprops.copy(fileCreateProps);
   _aprops.copy(fileAccessProps);
@@ -97,9 +105,16 @@ void HDF5Alignment::createNew(const string& alignmentPath)
   _file->createGroup(VersionGroupName);
   delete _metaData;
   _metaData = new HDF5MetaData(_file, MetaGroupName);
+  delete _statsCache;
+  _statsCache = NULL;
+  openChangeLog();
   _tree = NULL;
   _dirty = true;
   writeVersion();
+  if (_writeThread == true)
+  {
+    _arrayWriter.start();
+  }
 }
 
 // todo: properly handle readonly
@@ -129,7 +144,25 @@ void HDF5Alignment::open(const string& alignmentPath, bool readOnly)
   }
   delete _metaData;
   _metaData = new HDF5MetaData(_file, MetaGroupName);
+  delete _statsCache;
+  _statsCache = NULL;
+  // cached stats can't be trusted once the file's been open for writing
+  if (readOnly == false &&
+      H5Lexists(_file->getId(), StatsGroupName.c_str(), H5P_DEFAULT) > 0)
+  {
+    _file->unlink(StatsGroupName);
+  }
+  delete _changeLog;
+  _changeLog = NULL;
+  if (readOnly == false)
+  {
+    openChangeLog();
+  }
   loadTree();
+  if (_writeThread == true && readOnly == false)
+  {
+    _arrayWriter.start();
+  }
 }
 
 // todo: properly handle readonly
@@ -156,6 +189,18 @@ void HDF5Alignment::close()
       delete _metaData;
       _metaData = NULL;
     }
+    if (_statsCache != NULL)
+    {
+      _statsCache->write();
+      delete _statsCache;
+      _statsCache = NULL;
+    }
+    if (_changeLog != NULL)
+    {
+      _changeLog->write();
+      delete _changeLog;
+      _changeLog = NULL;
+    }
     writeVersion();
     map<string, HDF5Genome*>::iterator mapIt;
     for (mapIt = _openGenomes.begin(); mapIt != _openGenomes.end(); ++mapIt)
@@ -165,6 +210,7 @@ void HDF5Alignment::close()
       delete genome;
     }
     _openGenomes.clear();
+    _arrayWriter.stop();
     _file->flush(H5F_SCOPE_LOCAL);
     _file->close();
     delete _file;
@@ -194,6 +240,10 @@ void HDF5Alignment::close() const
       delete  const_cast<HDF5Alignment*>(this)->_metaData;
        const_cast<HDF5Alignment*>(this)->_metaData = NULL;
     }
+    delete _statsCache;
+    _statsCache = NULL;
+    delete _changeLog;
+    _changeLog = NULL;
 
     map<string, HDF5Genome*>::iterator mapIt;
     for (mapIt = _openGenomes.begin(); mapIt != _openGenomes.end(); ++mapIt)
@@ -202,6 +252,7 @@ void HDF5Alignment::close() const
       delete genome;
     }
     _openGenomes.clear();
+    _arrayWriter.stop();
      const_cast<HDF5Alignment*>(this)->_file->close();
      delete const_cast<HDF5Alignment*>(this)->_file;
      const_cast<HDF5Alignment*>(this)->_file = NULL;
@@ -225,6 +276,7 @@ void HDF5Alignment::setOptionsFromParser(CLParserConstPtr parser) const
   hdf5Parser->applyToDCProps(_dcprops);
   hdf5Parser->applyToAProps(_aprops);
   _inMemory = hdf5Parser->getInMemory();
+  _writeThread = hdf5Parser->getWriteThread();
   if (_inMemory == true)
   {
     int mdc;
@@ -650,6 +702,56 @@ const MetaData* HDF5Alignment::getMetaData() const
   return _metaData;
 }
 
+const MetaData* HDF5Alignment::getStatsCache() const
+{
+  if (_statsCache == NULL && _file != NULL &&
+      H5Lexists(_file->getId(), StatsGroupName.c_str(), H5P_DEFAULT) > 0)
+  {
+    _statsCache = new HDF5MetaData(_file, StatsGroupName);
+  }
+  return _statsCache;
+}
+
+MetaData* HDF5Alignment::createStatsCache()
+{
+  assert(_file != NULL);
+  delete _statsCache;
+  _statsCache = NULL;
+  if (H5Lexists(_file->getId(), StatsGroupName.c_str(), H5P_DEFAULT) > 0)
+  {
+    _file->unlink(StatsGroupName);
+  }
+  _statsCache = new HDF5MetaData(_file, StatsGroupName);
+  return _statsCache;
+}
+
+const MetaData* HDF5Alignment::getChangeLog() const
+{
+  if (_changeLog == NULL && _file != NULL &&
+      H5Lexists(_file->getId(), ChangeLogGroupName.c_str(), H5P_DEFAULT) > 0)
+  {
+    _changeLog = new HDF5MetaData(_file, ChangeLogGroupName);
+  }
+  return _changeLog;
+}
+
+MetaData* HDF5Alignment::getChangeLog()
+{
+  return _changeLog;
+}
+
+// whoever opens the file for writing can change anything, so log it
+// straight away: files derived from the alignment are then never taken
+// to be up to date with it, even if the writer doesn't log what it
+// changed or doesn't get as far as closing the file
+void HDF5Alignment::openChangeLog()
+{
+  delete _changeLog;
+  _changeLog = new HDF5MetaData(_file, ChangeLogGroupName);
+  logWriteOpen(_changeLog);
+  _changeLog->write();
+}
+
 string HDF5Alignment::getNewickTree() const
 {
   if (_tree == NULL)
@@ -761,3 +863,15 @@ void HDF5Alignment::replaceNewickTree(const string &newNewickString)
   treeMeta.write();
   loadTree();
 }
+
+bool HDF5Alignment::isThreadSafe() const
+{
+  // the library that is loaded, not the headers compiled against
+  hbool_t threadSafe = 0;
+  return H5is_library_threadsafe(&threadSafe) >= 0 && threadSafe > 0;
+}
+
+HDF5ArrayWriter* HDF5Alignment::getArrayWriter() const
+{
+  return _arrayWriter.isRunning() ? &_arrayWriter : NULL;
+}
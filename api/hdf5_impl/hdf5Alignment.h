@@ -13,6 +13,7 @@
 #include "halAlignmentInstance.h"
 #include "hdf5Genome.h"
 #include "hdf5MetaData.h"
+#include "hdf5ArrayWriter.h"
 
 typedef struct _stTree stTree;
 
@@ -79,12 +80,26 @@ public:
 
    const MetaData* getMetaData() const;
 
+   const MetaData* getStatsCache() const;
+
+   MetaData* createStatsCache();
+
+   const MetaData* getChangeLog() const;
+
+   MetaData* getChangeLog();
+
    std::string getNewickTree() const;
 
    std::string getVersion() const;
 
    void replaceNewickTree(const std::string &newNewickString);
 
+   bool isThreadSafe() const;
+
+   /** Writer thread for the genomes' arrays (NULL unless the
+    * writeThread option was given and the file is writable) */
+   HDF5ArrayWriter* getArrayWriter() const;
+
 protected:
    // Nobody creates this class except through the interface. 
    friend AlignmentPtr hdf5AlignmentInstance();
@@ -109,6 +124,7 @@ protected:
    void loadTree();
    void writeTree();
    void writeVersion();
+   void openChangeLog();
    void addGenomeToTree(const std::string& name,
                         const std::pair<std::string, double>& parentName,
                         const std::vector<std::pair<std::string, double> >&
@@ -123,15 +139,21 @@ protected:
    mutable H5::DSetCreatPropList _dcprops;
    int _flags;
    HDF5MetaData* _metaData;
+   mutable HDF5MetaData* _statsCache;
+   mutable HDF5MetaData* _changeLog;
    static const H5std_string MetaGroupName;
    static const H5std_string TreeGroupName;
    static const H5std_string GenomesGroupName;
    static const H5std_string VersionGroupName;
+   static const H5std_string StatsGroupName;
+   static const H5std_string ChangeLogGroupName;
    stTree* _tree;
    mutable std::map<std::string, stTree*> _nodeMap;
    bool _dirty;
    mutable std::map<std::string, HDF5Genome*> _openGenomes;
    mutable bool _inMemory;
+   mutable bool _writeThread;
+   mutable HDF5ArrayWriter _arrayWriter;
 };
 
 }
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <iostream>
+#include "hdf5ArrayWriter.h"
+
+using namespace hal;
+using namespace H5;
+using namespace std;
+
+HDF5ArrayWriter::HDF5ArrayWriter() : _running(false), _stopping(false)
+{
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_jobCond, NULL);
+  pthread_cond_init(&_doneCond, NULL);
+}
+
+HDF5ArrayWriter::~HDF5ArrayWriter()
+{
+  try
+  {
+    stop();
+  }
+  catch(...)
+  {
+  }
+  pthread_cond_destroy(&_doneCond);
+  pthread_cond_destroy(&_jobCond);
+  pthread_mutex_destroy(&_mutex);
+}
+
+bool HDF5ArrayWriter::isAvailable()
+{
+  hbool_t threadSafe = 0;
+  return H5is_library_threadsafe(&threadSafe) >= 0 && threadSafe > 0;
+}
+
+void HDF5ArrayWriter::start()
+{
+  if (_running == true)
+  {
+    return;
+  }
+  if (isAvailable() == false)
+  {
+    throw hal_exception("HDF5 library was not built threadsafe: can't "
+                        "write arrays in the background");
+  }
+  _stopping = false;
+  _error.clear();
+  if (pthread_create(&_thread, NULL, writeThread, this) != 0)
+  {
+    throw hal_exception("Error creating HDF5 writer thread");
+  }
+  _running = true;
+}
+
+void HDF5ArrayWriter::stop()
+{
+  if (_running == false)
+  {
+    return;
+  }
+  pthread_mutex_lock(&_mutex);
+  _stopping = true;
+  pthread_cond_signal(&_jobCond);
+  pthread_mutex_unlock(&_mutex);
+  pthread_join(_thread, NULL);
+  _running = false;
+  assert(_jobs.empty() && _pending.empty());
+  checkError();
+}
+
+void HDF5ArrayWriter::push(const void* owner, const DataSet& dataSet,
+                           const DataType& dataType, const char* buf,
+                           hsize_t start, hsize_t numElements)
+{
+  assert(_running == true);
+  Job job;
+  job._owner = owner;
+  job._dataSet = dataSet;
+  job._dataType = dataType;
+  job._buf = buf;
+  job._start = start;
+  job._numElements = numElements;
+  pthread_mutex_lock(&_mutex);
+  _jobs.push_back(job);
+  ++_pending[owner];
+  pthread_cond_signal(&_jobCond);
+  pthread_mutex_unlock(&_mutex);
+}
+
+void HDF5ArrayWriter::wait(const void* owner)
+{
+  if (_running == false)
+  {
+    return;
+  }
+  pthread_mutex_lock(&_mutex);
+  while (_pending.find(owner) != _pending.end())
+  {
+    pthread_cond_wait(&_doneCond, &_mutex);
+  }
+  pthread_mutex_unlock(&_mutex);
+  checkError();
+}
+
+void* HDF5ArrayWriter::writeThread(void* data)
+{
+  HDF5ArrayWriter* writer = (HDF5ArrayWriter*)data;
+  writer->writeJobs();
+  return NULL;
+}
+
+void HDF5ArrayWriter::writeJobs()
+{
+  pthread_mutex_lock(&_mutex);
+  while (true)
+  {
+    while (_jobs.empty() && _stopping == false)
+    {
+      pthread_cond_wait(&_jobCond, &_mutex);
+    }
+    if (_jobs.empty())
+    {
+      break;
+    }
+    Job job = _jobs.front();
+    _jobs.pop_front();
+    pthread_mutex_unlock(&_mutex);
+
+    string error;
+    try
+    {
+      DataSpace memSpace(1, &job._numElements);
+      DataSpace fileSpace = job._dataSet.getSpace();
+      fileSpace.selectHyperslab(H5S_SELECT_SET, &job._numElements,
+                                &job._start);
+      job._dataSet.write(job._buf, job._dataType, memSpace, fileSpace);
+    }
+    catch(Exception& e)
+    {
+      error = "HDF5 background write failed: " + e.getDetailMsg();
+    }
+    // release our references to the dataset before the owner can
+    // move on (and possibly unlink it)
+    job._dataSet = DataSet();
+    job._dataType = DataType();
+
+    pthread_mutex_lock(&_mutex);
+    if (_error.empty())
+    {
+      _error = error;
+    }
+    map<const void*, size_t>::iterator i = _pending.find(job._owner);
+    assert(i != _pending.end());
+    if (--i->second == 0)
+    {
+      _pending.erase(i);
+    }
+    pthread_cond_broadcast(&_doneCond);
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+void HDF5ArrayWriter::checkError()
+{
+  pthread_mutex_lock(&_mutex);
+  string error = _error;
+  _error.clear();
+  pthread_mutex_unlock(&_mutex);
+  if (error.empty() == false)
+  {
+    throw hal_exception(error);
+  }
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HDF5ARRAYWRITER_H
+#define _HDF5ARRAYWRITER_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <pthread.h>
+#include <H5Cpp.h>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * Background thread that writes buffers paged out of HDF5ExternalArrays
+ * back to their datasets, so that the caller can keep filling in the
+ * next chunk (of the same or any other array) while the last one is
+ * compressed and written.  Requires a threadsafe HDF5 library (all
+ * HDF5 calls are still serialized by its global lock, so only the
+ * work done between them overlaps).
+ */
+class HDF5ArrayWriter
+{
+public:
+
+   HDF5ArrayWriter();
+   ~HDF5ArrayWriter();
+
+   /** True if the HDF5 library can be called from another thread */
+   static bool isAvailable();
+
+   /** Launch the writer thread */
+   void start();
+
+   /** Finish all queued writes and join the writer thread */
+   void stop();
+
+   bool isRunning() const;
+
+   /** Queue a write of numElements elements from buf to the dataset
+    * starting at index start.  buf must not be touched again until
+    * wait(owner) returns */
+   void push(const void* owner, const H5::DataSet& dataSet,
+             const H5::DataType& dataType, const char* buf,
+             hsize_t start, hsize_t numElements);
+
+   /** Block until all writes queued by owner are done.  Throws if
+    * any write failed */
+   void wait(const void* owner);
+
+protected:
+
+   struct Job
+   {
+      const void* _owner;
+      H5::DataSet _dataSet;
+      H5::DataType _dataType;
+      const char* _buf;
+      hsize_t _start;
+      hsize_t _numElements;
+   };
+
+   static void* writeThread(void* data);
+   void writeJobs();
+   void checkError();
+
+   pthread_t _thread;
+   pthread_mutex_t _mutex;
+   pthread_cond_t _jobCond;
+   pthread_cond_t _doneCond;
+   std::deque<Job> _jobs;
+   std::map<const void*, size_t> _pending;
+   std::string _error;
+   bool _running;
+   bool _stopping;
+
+private:
+   HDF5ArrayWriter(const HDF5ArrayWriter&);
+   HDF5ArrayWriter& operator=(const HDF5ArrayWriter&);
+};
+
+inline bool HDF5ArrayWriter::isRunning() const
+{
+  return _running;
+}
+
+}
+
+#endif
@@ -24,6 +24,7 @@ public:
 
    friend class HDF5TopSegmentIterator;
    friend class HDF5BottomSegmentIterator;
+   friend class HDF5Genome;
 
     /** Constructor 
     * @param genome Smart pointer to genome to which segment belongs
@@ -21,6 +21,7 @@ const hsize_t HDF5CLParser::DefaultCacheRDCElems = 599999;
 const hsize_t HDF5CLParser::DefaultCacheRDCBytes = 15728640;
 const double HDF5CLParser::DefaultCacheW0 = 0.75;
 const bool HDF5CLParser::DefaultInMemory = false;
+const bool HDF5CLParser::DefaultWriteThread = false;
 
 HDF5CLParser::HDF5CLParser(bool createOptions) :
   CLParser()
@@ -30,6 +31,9 @@ HDF5CLParser::HDF5CLParser(bool createOptions) :
     addOption("chunk", "hdf5 chunk size", DefaultChunkSize);
     addOption("deflate", "hdf5 compression factor [0:none - 9:max]", 
               DefaultDeflate);
+    addOptionFlag("writeThread", "compress and write array chunks to the "
+                  "hdf5 file in a background thread (requires a threadsafe "
+                  "hdf5 library)", DefaultWriteThread);
   }
   addOption("cacheMDC", "number of metadata slots in hdf5 cache",
             DefaultCacheMDCElems);
@@ -75,3 +79,8 @@ bool HDF5CLParser::getInMemory() const
 {
   return getFlag("inMemory");
 }
+
+bool HDF5CLParser::getWriteThread() const
+{
+  return hasOption("writeThread") && getFlag("writeThread");
+}
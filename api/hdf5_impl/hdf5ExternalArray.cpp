@@ -6,6 +6,8 @@
 
 #include <cassert>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 #include "hdf5ExternalArray.h"
 
 using namespace hal;
@@ -21,13 +23,26 @@ HDF5ExternalArray::HDF5ExternalArray() :
   _bufEnd(0),
   _bufSize(0),
   _buf(NULL),
-  _dirty(false)
+  _dirty(false),
+  _writer(NULL),
+  _writeBuf(NULL)
 {}
 
 /** Destructor */
 HDF5ExternalArray::~HDF5ExternalArray()
 {
+  if (_writer != NULL)
+  {
+    try
+    {
+      _writer->wait(this);
+    }
+    catch(...)
+    {
+    }
+  }
   delete [] _buf;
+  delete [] _writeBuf;
 }
 
 // Create a new dataset in specifed location
@@ -38,6 +53,8 @@ void HDF5ExternalArray::create(CommonFG* file,
                                const DSetCreatPropList* inCparms,
                                hsize_t chunksInBuffer)
 {
+  setWriter(_writer);
+
   // copy in parameters
   _file = file;
   _path = path;
@@ -93,6 +110,8 @@ void HDF5ExternalArray::create(CommonFG* file,
 void HDF5ExternalArray::load(CommonFG* file, const H5std_string& path,
                              hsize_t chunksInBuffer)
 {
+  setWriter(_writer);
+
   // load up the parameters
   _file = file;
   _path = path;
@@ -140,6 +159,10 @@ void HDF5ExternalArray::load(CommonFG* file, const H5std_string& path,
 // Write the memory buffer back to the file 
 void HDF5ExternalArray::write()
 {
+  if (_writer != NULL)
+  {
+    _writer->wait(this);
+  }
   if (_dirty == true)
   {
     _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
@@ -150,7 +173,18 @@ void HDF5ExternalArray::write()
 // Page chunk containing index i into memory 
 void HDF5ExternalArray::page(hsize_t i)
 {
-  if (_dirty == true)
+  if (_dirty == true && _writer != NULL && _writer->isRunning())
+  {
+    // the chunk handed off last time has to be out of _writeBuf first
+    _writer->wait(this);
+    if (_writeBuf == NULL)
+    {
+      _writeBuf = new char[(_chunkSize > 1 ? _chunkSize : _size) * _dataSize];
+    }
+    swap(_buf, _writeBuf);
+    _writer->push(this, _dataSet, _dataType, _writeBuf, _bufStart, _bufSize);
+  }
+  else if (_dirty == true)
   {
     write();
   }
@@ -170,3 +204,50 @@ void HDF5ExternalArray::page(hsize_t i)
   _dirty = false;
   assert(_bufSize > 0 || _size == 0);
 }
+
+void HDF5ExternalArray::read(hsize_t start, hsize_t count, char* dest)
+{
+  if (start + count > _size)
+  {
+    throw hal_exception("error: attempt to read hdf5 array out of bounds");
+  }
+  if (count == 0)
+  {
+    return;
+  }
+  // ranges within a chunk go through the buffer, like get(), so that
+  // lookups of nearby elements are cheap
+  hsize_t pageSize = _chunkSize > 1 ? _chunkSize : _size;
+  if (start / pageSize == (start + count - 1) / pageSize)
+  {
+    if (start < _bufStart || start > _bufEnd)
+    {
+      page(start);
+    }
+    memcpy(dest, _buf + (start - _bufStart) * _dataSize, count * _dataSize);
+    return;
+  }
+  // the file has to be up to date first
+  if (_dirty == true)
+  {
+    write();
+  }
+  else if (_writer != NULL)
+  {
+    _writer->wait(this);
+  }
+  DataSpace destSpace(1, &count);
+  _dataSpace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+  _dataSet.read(dest, _dataType, destSpace, _dataSpace);
+}
+
+void HDF5ExternalArray::setWriter(HDF5ArrayWriter* writer)
+{
+  if (_writer != NULL)
+  {
+    _writer->wait(this);
+  }
+  _writer = writer;
+  delete [] _writeBuf;
+  _writeBuf = NULL;
+}
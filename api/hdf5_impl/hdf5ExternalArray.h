@@ -10,6 +10,7 @@
 #include <cassert>
 #include <H5Cpp.h>
 #include "halDefs.h"
+#include "hdf5ArrayWriter.h"
 
 namespace hal {
 
@@ -63,6 +64,10 @@ public:
    /** Write the memory buffer back to the file */
    void write();
 
+   /** Hand dirty chunks that get paged out to a background writer
+    * (NULL to write them in place) */
+   void setWriter(HDF5ArrayWriter* writer);
+
    /** Access the raw data at given index
     * @param i index of element to retrieve for reading
     */
@@ -86,6 +91,14 @@ public:
    template <typename T>
    void setValue(hsize_t index, hsize_t offset, T value);
 
+   /** Copy count elements starting at start into dest.  Ranges within
+    * a chunk are paged into the memory buffer as by get(), and larger
+    * ones are read from the dataset in one go
+    * @param start index of first element
+    * @param count number of elements
+    * @param dest buffer of at least count * element size bytes */
+   void read(hsize_t start, hsize_t count, char* dest);
+
    /** Write typed element in the the raw data index
     * @param offset OFfset of element in struct (number of bytes) */
    
@@ -129,6 +142,11 @@ protected:
    /** Flag saying we should write to disk on write
     * or page-out calls (set by getUpdate()) */
    bool _dirty;
+   /** Background writer for paged-out chunks (optional) */
+   HDF5ArrayWriter* _writer;
+   /** Second buffer, which holds the chunk being written in the
+    * background while _buf is filled in */
+   char* _writeBuf;
 
 private:
 
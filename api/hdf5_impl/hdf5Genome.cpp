@@ -59,6 +59,12 @@ HDF5Genome::HDF5Genome(const string& name,
   {
     _group = h5Parent->createGroup(name);
   }
+  // the big arrays are paged out through the alignment's writer thread
+  // (if it has one)
+  HDF5ArrayWriter* writer = _alignment->getArrayWriter();
+  _dnaArray.setWriter(writer);
+  _topArray.setWriter(writer);
+  _bottomArray.setWriter(writer);
   read();
   _metaData = new HDF5MetaData(&_group, metaGroupName);
   _rup = new HDF5MetaData(&_group, rupGroupName);
@@ -1020,3 +1026,87 @@ void HDF5Genome::rename(const string &newName)
   _alignment->replaceNewickTree(stTree_getNewickTreeString(tree));
   stTree_destruct(tree);
 }
+
+// the arrays have one more element than there are segments, which holds
+// the end of the last one.  one read gets count + 1 elements as they are
+// stored, and the fields are picked out of those
+void HDF5Genome::readTopSegments(hal_index_t start, hal_size_t count,
+                                 vector<TopSegmentRecord>& records) const
+{
+  if (start < 0 || start + count > getNumTopSegments())
+  {
+    throw hal_exception("Top segment range out of bounds in genome " +
+                        _name);
+  }
+  records.resize(count);
+  if (count == 0)
+  {
+    return;
+  }
+  HDF5ExternalArray& array = const_cast<HDF5ExternalArray&>(_topArray);
+  size_t size = array.getDataType().getSize();
+  vector<char> buffer((count + 1) * size);
+  array.read(start, count + 1, &buffer[0]);
+  const char* element = &buffer[0];
+  for (hal_size_t i = 0; i < count; ++i, element += size)
+  {
+    TopSegmentRecord& record = records[i];
+    record._startPosition = *(const hal_index_t*)(
+      element + HDF5TopSegment::genomeIndexOffset);
+    record._length = *(const hal_index_t*)(
+      element + size + HDF5TopSegment::genomeIndexOffset) - 
+       record._startPosition;
+    record._bottomParseIndex = *(const hal_index_t*)(
+      element + HDF5TopSegment::bottomIndexOffset);
+    record._parentIndex = *(const hal_index_t*)(
+      element + HDF5TopSegment::parentIndexOffset);
+    record._nextParalogyIndex = *(const hal_index_t*)(
+      element + HDF5TopSegment::parIndexOffset);
+    record._parentReversed = *(const bool*)(
+      element + HDF5TopSegment::parentReversedOffset);
+  }
+}
+
+void HDF5Genome::readBottomSegments(hal_index_t start, hal_size_t count,
+                                    vector<BottomSegmentRecord>& records,
+                                    vector<hal_index_t>& childIndexes,
+                                    vector<bool>& childReversed) const
+{
+  if (start < 0 || start + count > getNumBottomSegments())
+  {
+    throw hal_exception("Bottom segment range out of bounds in genome " +
+                        _name);
+  }
+  hal_size_t numChildren = _numChildrenInBottomArray;
+  records.resize(count);
+  childIndexes.resize(count * numChildren);
+  childReversed.resize(count * numChildren);
+  if (count == 0)
+  {
+    return;
+  }
+  HDF5ExternalArray& array = const_cast<HDF5ExternalArray&>(_bottomArray);
+  size_t size = array.getDataType().getSize();
+  vector<char> buffer((count + 1) * size);
+  array.read(start, count + 1, &buffer[0]);
+  const char* element = &buffer[0];
+  for (hal_size_t i = 0; i < count; ++i, element += size)
+  {
+    BottomSegmentRecord& record = records[i];
+    record._startPosition = *(const hal_index_t*)(
+      element + HDF5BottomSegment::genomeIndexOffset);
+    record._length = *(const hal_index_t*)(
+      element + size + HDF5BottomSegment::genomeIndexOffset) - 
+       record._startPosition;
+    record._topParseIndex = *(const hal_index_t*)(
+      element + HDF5BottomSegment::topIndexOffset);
+    const char* child = element + HDF5BottomSegment::firstChildOffset;
+    for (hal_size_t j = 0; j < numChildren; ++j)
+    {
+      childIndexes[i * numChildren + j] = *(const hal_index_t*)child;
+      childReversed[i * numChildren + j] = 
+         *(const bool*)(child + sizeof(hal_index_t));
+      child += sizeof(hal_index_t) + sizeof(bool);
+    }
+  }
+}
@@ -99,6 +99,14 @@ public:
 
    void rename(const std::string &newName);
 
+   void readTopSegments(hal_index_t start, hal_size_t count,
+                        std::vector<TopSegmentRecord>& records) const;
+
+   void readBottomSegments(hal_index_t start, hal_size_t count,
+                           std::vector<BottomSegmentRecord>& records,
+                           std::vector<hal_index_t>& childIndexes,
+                           std::vector<bool>& childReversed) const;
+
    // SEGMENTED SEQUENCE INTERFACE
 
    hal_size_t getSequenceLength() const;
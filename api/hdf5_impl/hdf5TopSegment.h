@@ -21,6 +21,7 @@ class HDF5TopSegment : public TopSegment
 {
    friend class HDF5TopSegmentIterator;
    friend class HDF5BottomSegmentIterator;
+   friend class HDF5Genome;
 
 public:
 
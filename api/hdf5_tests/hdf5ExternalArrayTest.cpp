@@ -13,6 +13,7 @@
 #include <H5Cpp.h>
 #include "allTests.h"
 #include "hdf5ExternalArray.h"
+#include "hdf5ArrayWriter.h"
 #include "hdf5Test.h"
 extern "C" {
 #include "commonC.h"
@@ -159,11 +160,64 @@ void hdf5ExternalArrayTestCompression(CuTest *testCase)
   }
 }
 
+void hdf5ExternalArrayTestWriter(CuTest *testCase)
+{
+  if (HDF5ArrayWriter::isAvailable() == false)
+  {
+    return;
+  }
+  for (hsize_t chunkIdx = 0; chunkIdx < numSizes; ++chunkIdx)
+  {
+    hsize_t chunkSize = chunkSizes[chunkIdx];
+    setup();
+    try 
+    {
+      IntType datatype(PredType::NATIVE_HSIZE);
+      H5File file(H5std_string(fileName), H5F_ACC_TRUNC);
+      HDF5ArrayWriter writer;
+      writer.start();
+      HDF5ExternalArray myArray;
+      myArray.setWriter(&writer);
+      DSetCreatPropList cparms;
+      if (chunkSize > 0)
+      {
+        cparms.setDeflate(2);
+        cparms.setChunk(1, &chunkSize);
+      }
+      myArray.create(&file, datasetName, datatype, N, &cparms);
+      // go over everything twice so that chunks being written in the
+      // background get paged back in
+      for (hsize_t i = 0; i < 2 * N; ++i)
+      {
+        hsize_t j = i < N ? i : 2 * N - 1 - i;
+        hsize_t* block = reinterpret_cast<hsize_t*>(myArray.getUpdate(j));
+        *block = i < N ? 0 : j;
+      }
+      myArray.write();
+      writer.stop();
+      file.flush(H5F_SCOPE_LOCAL);
+      file.close();
+      checkNumbers(testCase);
+    }
+    catch(Exception& exception)
+    {
+      cerr << exception.getCDetailMsg() << endl;
+      CuAssertTrue(testCase, 0);
+    }
+    catch(...)
+    {
+      CuAssertTrue(testCase, 0);
+    }
+    teardown();
+  }
+}
+
 CuSuite* hdf5ExternalArrayTestSuite(void) 
 {
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCreate);
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestLoad);
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCompression);
+  SUITE_ADD_TEST(suite, hdf5ExternalArrayTestWriter);
   return suite;
 }
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cassert>
 #include <deque>
+#include <limits>
 #include "defaultColumnIterator.h"
 #include "hal.h"
 
@@ -32,7 +33,9 @@ DefaultColumnIterator::DefaultColumnIterator(const Genome* reference,
   _reversed(reverseStrand),
   _tree(NULL),
   _unique(unique),
-  _onlyOrthologs(onlyOrthologs)
+  _onlyOrthologs(onlyOrthologs),
+  _runLength(0),
+  _runIndex(NULL_INDEX)
 {
   assert (columnIndex >= 0 && lastColumnIndex >= columnIndex && 
           lastColumnIndex < (hal_index_t)reference->getSequenceLength());
@@ -104,6 +107,11 @@ void DefaultColumnIterator::toRight() const
     return;
   }
   assert(_indelStack.size() == 0);
+
+  if (toRightInRun() == true)
+  {
+    return;
+  }
   
   do
   {
@@ -129,25 +137,22 @@ void DefaultColumnIterator::toRight() const
       _stack.top()->_top._it.get() == NULL);
 
     recursiveUpdate(init);
+    _runIndex = _stack.top()->_index;
     
     // move the index right
     ++_stack.top()->_index;
 
     // jump to next sequence in genome if necessary
-    const Sequence* seq = _stack.top()->_sequence;
-    if (_stack.size() == 1 && 
-        _stack.top()->_index >= (hal_index_t)(seq->getStartPosition() + 
-                                              seq->getSequenceLength()) &&
-        _stack.top()->_index < (hal_index_t)(seq->getGenome()->getSequenceLength()))
-    {
-      _stack.top()->_sequence = 
-         seq->getGenome()->getSequenceBySite(_stack.top()->_index);
-      assert(_stack.top()->_sequence != NULL);
-      _ref = _stack.top()->_sequence;    
-    }
+    updateRefSequence();
   }
   while (_break == true);
 
+  // can only shift columns along the reference
+  if (_stack.size() > 1 || _indelStack.size() > 0)
+  {
+    _runLength = 0;
+  }
+
   // push the indel stack.  
   _stack.pushStack(_indelStack);
 
@@ -190,6 +195,7 @@ void DefaultColumnIterator::toSite(hal_index_t columnIndex,
   _ref =sequence;    
   _stack.clear();
   _indelStack.clear();
+  _runLength = 0;
   if (clearCache == true)
   {
       clearVisitCache();
@@ -316,6 +322,8 @@ void DefaultColumnIterator::recursiveUpdate(bool init) const
   clearTree();
   _break = false;
   _leftmostRefPos = _stack[0]->_index;
+  _runDNA.clear();
+  _runLength = numeric_limits<hal_size_t>::max();
 
   const Sequence* refSequence = _stack.top()->_sequence;
   const Genome* refGenome = refSequence->getGenome();
@@ -365,6 +373,7 @@ void DefaultColumnIterator::recursiveUpdate(bool init) const
     }
     assert(topIt->_it->getReversed() == _reversed &&
            topIt->_dna->getReversed() == _reversed);
+    updateRunLength(topIt->_it.get());
     assert(topIt->_it->getStartPosition() == topIt->_dna->getArrayIndex());
     assert(topIt->_dna->getArrayIndex() == _stack.top()->_index);    
     assert(_stack.top()->_index <= _stack.top()->_lastIndex);
@@ -428,6 +437,7 @@ void DefaultColumnIterator::recursiveUpdate(bool init) const
 
     assert(bottomIt->_it->getReversed() == _reversed &&
            bottomIt->_dna->getReversed() == _reversed);
+    updateRunLength(bottomIt->_it.get());
     assert(bottomIt->_it->getStartPosition() == bottomIt->_dna->getArrayIndex());
     assert(bottomIt->_dna->getArrayIndex() == _stack.top()->_index);
 
@@ -731,6 +741,7 @@ void DefaultColumnIterator::updateParent(LinkedTopIterator* topIt) const
     // advance the parent's iterator to match topIt's (which should 
     // already have been updated. 
     topIt->_parent->_it->toParent(topIt->_it);
+    updateRunLength(topIt->_parent->_it.get());
     topIt->_parent->_dna->jumpTo( topIt->_parent->_it->getStartPosition());
     topIt->_parent->_dna->setReversed(topIt->_parent->_it->getReversed());
     if (colMapInsert(topIt->_parent->_dna) == false)
@@ -784,6 +795,7 @@ void DefaultColumnIterator::updateChild(LinkedBottomIterator* bottomIt,
     // advance the child's iterator to match bottomIt's (which should
     // have already been updated)
     bottomIt->_children[index]->_it->toChild(bottomIt->_it, index);
+    updateRunLength(bottomIt->_children[index]->_it.get());
     bottomIt->_children[index]->_dna->jumpTo(
       bottomIt->_children[index]->_it->getStartPosition());
     bottomIt->_children[index]->_dna->setReversed(
@@ -841,6 +853,7 @@ void DefaultColumnIterator::updateNextTopDup(LinkedTopIterator* topIt) const
     // have already been updated)
     currentTopIt->_nextDup->_it = currentTopIt->_it->copy();
     currentTopIt->_nextDup->_it->toNextParalogy();
+    updateRunLength(currentTopIt->_nextDup->_it.get());
     currentTopIt->_nextDup->_dna->jumpTo(
       currentTopIt->_nextDup->_it->getStartPosition());
     currentTopIt->_nextDup->_dna->setReversed(
@@ -882,6 +895,7 @@ void DefaultColumnIterator::updateParseUp(LinkedBottomIterator* bottomIt)
     
     // advance the parse link's iterator to match bottomIt
     bottomIt->_topParse->_it->toParseUp(bottomIt->_it);
+    updateRunLength(bottomIt->_topParse->_it.get());
     bottomIt->_topParse->_dna->jumpTo(
       bottomIt->_topParse->_it->getStartPosition());
     bottomIt->_topParse->_dna->setReversed(
@@ -928,6 +942,7 @@ void DefaultColumnIterator::updateParseDown(LinkedTopIterator* topIt) const
     
     // advance the parse link's iterator to match topIt
     topIt->_bottomParse->_it->toParseDown(topIt->_it);
+    updateRunLength(topIt->_bottomParse->_it.get());
     
     topIt->_bottomParse->_dna->jumpTo(
       topIt->_bottomParse->_it->getStartPosition());
@@ -980,6 +995,7 @@ bool DefaultColumnIterator::colMapInsert(DNAIteratorConstPtr dnaIt) const
   const Sequence* sequence = dnaIt->getSequence();
   const Genome* genome = dnaIt->getGenome();
   assert(sequence != NULL);
+  _runDNA.push_back(dnaIt);
   
   // All reference bases need to get added to the cache
   bool updateCache = genome == _stack[0]->_sequence->getGenome();
@@ -1048,6 +1064,83 @@ bool DefaultColumnIterator::colMapInsert(DNAIteratorConstPtr dnaIt) const
   return !found;
 }
 
+void DefaultColumnIterator::updateRefSequence() const
+{
+  const Sequence* seq = _stack.top()->_sequence;
+  if (_stack.size() == 1 && 
+      _stack.top()->_index >= (hal_index_t)(seq->getStartPosition() + 
+                                            seq->getSequenceLength()) &&
+      _stack.top()->_index <
+      (hal_index_t)(seq->getGenome()->getSequenceLength()))
+  {
+    _stack.top()->_sequence = 
+       seq->getGenome()->getSequenceBySite(_stack.top()->_index);
+    assert(_stack.top()->_sequence != NULL);
+    _ref = _stack.top()->_sequence;    
+  }
+}
+
+// the segment iterators in the column are all sliced down to one base,
+// so the end offset is the number of bases left after it.  indels are
+// only found from the last base of a segment, so when they're followed
+// that base is left to recursiveUpdate()
+void DefaultColumnIterator::updateRunLength(const SegmentIterator* segIt) const
+{
+  hal_size_t left = segIt->getLength() == 1 ? segIt->getEndOffset() : 0;
+  if (_maxInsertionLength > 0 && left > 0)
+  {
+    --left;
+  }
+  _runLength = min(_runLength, left);
+}
+
+// shift every base of the last column one to the right instead of
+// recomputing the column from the segments.  only done when all the
+// segments have bases left and none of the new positions were visited
+// (otherwise the column wouldn't be the same, and we fall back on
+// recursiveUpdate()).
+bool DefaultColumnIterator::toRightInRun() const
+{
+  StackEntry* entry = _stack.top();
+  if (_runLength == 0 || _reversed == true || _stack.size() > 1 ||
+      entry->_index != _runIndex + 1 || entry->_index > entry->_lastIndex ||
+      entry->_index >= (hal_index_t)(entry->_sequence->getStartPosition() +
+                                     entry->_sequence->getSequenceLength()))
+  {
+    return false;
+  }
+  for (size_t i = 0; i < _runDNA.size(); ++i)
+  {
+    VisitCache::iterator cacheIt = _visitCache.find(_runDNA[i]->getGenome());
+    if (cacheIt != _visitCache.end())
+    {
+      hal_index_t pos = _runDNA[i]->getArrayIndex() + 
+         (_runDNA[i]->getReversed() ? -1 : 1);
+      if (cacheIt->second->find(pos) == true)
+      {
+        return false;
+      }
+    }
+  }
+
+  resetColMap();
+  _leftmostRefPos = entry->_index;
+  vector<DNAIteratorConstPtr> runDNA;
+  runDNA.swap(_runDNA);
+  for (size_t i = 0; i < runDNA.size(); ++i)
+  {
+    runDNA[i]->toRight();
+    bool inserted = colMapInsert(runDNA[i]);
+    assert(inserted == true);
+  }
+  --_runLength;
+  _runIndex = entry->_index;
+  ++entry->_index;
+  updateRefSequence();
+  nextFreeIndex();
+  return true;
+}
+
 void DefaultColumnIterator::resetColMap() const
 {
   for (ColumnMap::iterator i = _colMap.begin(); i != _colMap.end(); ++i)
@@ -73,6 +73,9 @@ protected:
    bool childInScope(const Genome*, hal_size_t child) const;
    void nextFreeIndex() const;
    bool colMapInsert(DNAIteratorConstPtr dnaIt) const;
+   void updateRefSequence() const;
+   void updateRunLength(const SegmentIterator* segIt) const;
+   bool toRightInRun() const;
 
    void resetColMap() const;
    void eraseColMap() const;
@@ -109,6 +112,14 @@ protected:
    mutable stTree *_tree;
    mutable bool _unique;
    mutable bool _onlyOrthologs;
+
+   // while every segment touched by the last column computed by
+   // recursiveUpdate() has bases left, the next column is just the same
+   // one shifted over by a base.  _runLength is the number of such
+   // shifts left, and _runDNA all the bases passed to colMapInsert().
+   mutable std::vector<DNAIteratorConstPtr> _runDNA;
+   mutable hal_size_t _runLength;
+   mutable hal_index_t _runIndex;
 };
 
 inline bool DefaultColumnIterator::parentInScope(const Genome* genome) const
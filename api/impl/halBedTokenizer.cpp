@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include "halBedTokenizer.h"
+
+using namespace std;
+using namespace hal;
+
+const size_t BedTokenizer::BlockSize = 1 << 20;
+
+BedTokenizer::BedTokenizer() : _stream(NULL), _begin(0), _end(0),
+                               _bufferPosition(0), _linePosition(0),
+                               _eof(true)
+{
+  setSeparators(locale::classic());
+}
+
+BedTokenizer::~BedTokenizer()
+{
+
+}
+
+void BedTokenizer::open(istream* stream)
+{
+  _stream = stream;
+  _begin = 0;
+  _end = 0;
+  _bufferPosition = 0;
+  _linePosition = 0;
+  _eof = false;
+  // one extra byte so that the last line can always be terminated
+  _buffer.resize(BlockSize + 1);
+  setSeparators(_stream->getloc());
+}
+
+void BedTokenizer::setSeparators(const locale& inLocale)
+{
+  const ctype<char>& cType = use_facet<ctype<char> >(inLocale);
+  for (int i = 0; i < 256; ++i)
+  {
+    _separator[i] = cType.is(ctype_base::space, (char)i);
+  }
+  _separator[(unsigned char)'\0'] = true;
+}
+
+bool BedTokenizer::nextLine()
+{
+  _fields.clear();
+  _lengths.clear();
+  while (_fields.empty())
+  {
+    char* first = &_buffer[0] + _begin;
+    char* newLine = (char*)memchr(first, '\n', _end - _begin);
+    _linePosition = _bufferPosition + _begin;
+    if (newLine != NULL)
+    {
+      size_t length = newLine - first;
+      _begin += length + 1;
+      tokenize(first, length);
+    }
+    else if (_eof == false)
+    {
+      readBlock();
+    }
+    else if (_begin < _end)
+    {
+      // last line, without a newline
+      size_t length = _end - _begin;
+      _begin = _end;
+      tokenize(first, length);
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// move the partial line at the end of the buffer to the front (growing
+// the buffer if it's a really long line) and fill in the rest
+void BedTokenizer::readBlock()
+{
+  assert(_stream != NULL && _eof == false);
+  if (_begin > 0)
+  {
+    memmove(&_buffer[0], &_buffer[0] + _begin, _end - _begin);
+    _bufferPosition += _begin;
+    _end -= _begin;
+    _begin = 0;
+  }
+  if (_end + 1 >= _buffer.size())
+  {
+    _buffer.resize(_buffer.size() * 2);
+  }
+  _stream->read(&_buffer[0] + _end, _buffer.size() - 1 - _end);
+  _end += _stream->gcount();
+  if (_stream->bad())
+  {
+    throw hal_exception("Error reading bed input stream");
+  }
+  if (!*_stream)
+  {
+    _eof = true;
+  }
+}
+
+void BedTokenizer::tokenize(char* line, size_t length)
+{
+  _fields.clear();
+  _lengths.clear();
+  char* last = line + length;
+  // we always have room for this (it overwrites the newline)
+  *last = '\0';
+  char* pos = line;
+  while (true)
+  {
+    while (pos < last && _separator[(unsigned char)*pos])
+    {
+      ++pos;
+    }
+    if (pos == last)
+    {
+      break;
+    }
+    char* field = pos;
+    while (pos < last && !_separator[(unsigned char)*pos])
+    {
+      ++pos;
+    }
+    *pos = '\0';
+    _fields.push_back(field);
+    _lengths.push_back(pos - field);
+    if (pos < last)
+    {
+      ++pos;
+    }
+  }
+}
+
+bool BedTokenizer::parseInt(const char* field, size_t length,
+                            hal_index_t& val)
+{
+  const char* pos = field;
+  const char* last = field + length;
+  bool negative = false;
+  if (pos < last && (*pos == '-' || *pos == '+'))
+  {
+    negative = *pos == '-';
+    ++pos;
+  }
+  if (pos == last)
+  {
+    return false;
+  }
+  const hal_index_t maxVal = numeric_limits<hal_index_t>::max();
+  hal_index_t result = 0;
+  for (; pos < last; ++pos)
+  {
+    hal_index_t digit = *pos - '0';
+    if (digit < 0 || digit > 9 || result > (maxVal - digit) / 10)
+    {
+      return false;
+    }
+    result = result * 10 + digit;
+  }
+  val = negative ? -result : result;
+  return true;
+}
@@ -5,6 +5,9 @@
  */
 #include <sstream>
 #include <map>
+#include <algorithm>
+#include <ctime>
+#include <unistd.h>
 #include "halDefs.h"
 #include "hal.h"
 
@@ -214,3 +217,91 @@ void hal::getGenomesInSubTree(const Genome* root,
     getGenomesInSubTree(root->getChild(i), outputSet);
   }
 }
+
+static hal_size_t getChangeNumber(const MetaData* changeLog,
+                                  const string& key)
+{
+  hal_size_t number = 0;
+  if (changeLog != NULL && changeLog->has(key) == true)
+  {
+    stringstream ss(changeLog->get(key));
+    ss >> number;
+    if (!ss)
+    {
+      throw hal_exception("Invalid change log entry " + key + "=" +
+                          changeLog->get(key));
+    }
+  }
+  return number;
+}
+
+void hal::logGenomeChanges(AlignmentPtr alignment,
+                           const vector<string>& sequenceChanged,
+                           const vector<string>& bottomChanged)
+{
+  MetaData* changeLog = alignment->getChangeLog();
+  if (changeLog == NULL)
+  {
+    throw hal_exception("Can't log changes to a read-only alignment");
+  }
+  hal_size_t number = getChangeNumber(changeLog, "last");
+  if (getChangeNumber(changeLog, "any") == number &&
+      changeLog->has("anyBefore") == true)
+  {
+    // the entry logWriteOpen() added: we know what it changed now
+    changeLog->set("any", changeLog->get("anyBefore"));
+  }
+  else
+  {
+    ++number;
+  }
+  stringstream ss;
+  ss << number;
+  changeLog->set("last", ss.str());
+  for (size_t i = 0; i < sequenceChanged.size(); ++i)
+  {
+    changeLog->set("sequence:" + sequenceChanged[i], ss.str());
+  }
+  for (size_t i = 0; i < bottomChanged.size(); ++i)
+  {
+    changeLog->set("bottom:" + bottomChanged[i], ss.str());
+  }
+}
+
+void hal::logWriteOpen(MetaData* changeLog)
+{
+  if (changeLog->has("id") == false)
+  {
+    stringstream id;
+    id << time(NULL) << "." << getpid() << "." << clock();
+    changeLog->set("id", id.str());
+  }
+  stringstream ss;
+  ss << getChangeNumber(changeLog, "any");
+  changeLog->set("anyBefore", ss.str());
+  ss.str("");
+  ss << getChangeNumber(changeLog, "last") + 1;
+  changeLog->set("last", ss.str());
+  changeLog->set("any", ss.str());
+}
+
+string hal::getChangeLogId(AlignmentConstPtr alignment)
+{
+  const MetaData* changeLog = alignment->getChangeLog();
+  return changeLog != NULL && changeLog->has("id") == true ?
+     changeLog->get("id") : string();
+}
+
+hal_size_t hal::getLastGenomeChange(AlignmentConstPtr alignment)
+{
+  return getChangeNumber(alignment->getChangeLog(), "last");
+}
+
+hal_size_t hal::getGenomeChange(AlignmentConstPtr alignment,
+                                const string& genomeName, bool bottom)
+{
+  const MetaData* changeLog = alignment->getChangeLog();
+  return max(getChangeNumber(changeLog, "any"),
+             getChangeNumber(changeLog, (bottom ? "bottom:" : "sequence:") +
+                             genomeName));
+}
@@ -312,4 +312,66 @@ void Genome::fixParseInfo()
     }
   }
 }
+
+void Genome::readTopSegments(hal_index_t start, hal_size_t count,
+                             vector<TopSegmentRecord>& records) const
+{
+  if (start < 0 || start + count > getNumTopSegments())
+  {
+    throw hal_exception("Top segment range out of bounds in genome " +
+                        getName());
+  }
+  records.resize(count);
+  if (count == 0)
+  {
+    return;
+  }
+  TopSegmentIteratorConstPtr topIt = getTopSegmentIterator(start);
+  for (hal_size_t i = 0; i < count; ++i, topIt->toRight())
+  {
+    const TopSegment* topSegment = topIt->getTopSegment();
+    TopSegmentRecord& record = records[i];
+    record._startPosition = topSegment->getStartPosition();
+    record._length = topSegment->getLength();
+    record._bottomParseIndex = topSegment->getBottomParseIndex();
+    record._parentIndex = topSegment->getParentIndex();
+    record._nextParalogyIndex = topSegment->getNextParalogyIndex();
+    record._parentReversed = topSegment->getParentReversed();
+  }
+}
+
+void Genome::readBottomSegments(hal_index_t start, hal_size_t count,
+                                vector<BottomSegmentRecord>& records,
+                                vector<hal_index_t>& childIndexes,
+                                vector<bool>& childReversed) const
+{
+  if (start < 0 || start + count > getNumBottomSegments())
+  {
+    throw hal_exception("Bottom segment range out of bounds in genome " +
+                        getName());
+  }
+  hal_size_t numChildren = getNumChildren();
+  records.resize(count);
+  childIndexes.resize(count * numChildren);
+  childReversed.resize(count * numChildren);
+  if (count == 0)
+  {
+    return;
+  }
+  BottomSegmentIteratorConstPtr bottomIt = getBottomSegmentIterator(start);
+  for (hal_size_t i = 0; i < count; ++i, bottomIt->toRight())
+  {
+    const BottomSegment* bottomSegment = bottomIt->getBottomSegment();
+    BottomSegmentRecord& record = records[i];
+    record._startPosition = bottomSegment->getStartPosition();
+    record._length = bottomSegment->getLength();
+    record._topParseIndex = bottomSegment->getTopParseIndex();
+    for (hal_size_t j = 0; j < numChildren; ++j)
+    {
+      childIndexes[i * numChildren + j] = bottomSegment->getChildIndex(j);
+      childReversed[i * numChildren + j] = 
+         bottomSegment->getChildReversed(j);
+    }
+  }
+}
 } // namespace hal
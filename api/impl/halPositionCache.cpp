@@ -4,15 +4,47 @@
  * Released under the MIT license, see LICENSE.txt
  */
 #include <sstream>
+#include <algorithm>
 #include "halPositionCache.h"
 #include "hal.h"
 
 using namespace std;
 using namespace hal;
 
+// rough size of a map node: the entry, three pointers and the colour
+const hal_size_t PositionCache::IntervalBytes = 
+  sizeof(IntervalSet::value_type) + 4 * sizeof(void*);
+
+PositionCache::PositionCache(const PositionCache &positionCache) :
+  _set(positionCache._set),
+  _size(positionCache._size),
+  _prev(_set.begin()),
+  _bitmap(positionCache._bitmap),
+  _bitmapLength(positionCache._bitmapLength),
+  _isBitmap(positionCache._isBitmap)
+{
+}
 
 bool PositionCache::insert(hal_index_t pos)
 {
+  if (_isBitmap == true)
+  {
+    if (pos < 0 || pos >= (hal_index_t)_bitmapLength)
+    {
+      stringstream ss;
+      ss << "PositionCache: position " << pos << " out of bitmap range [0, "
+         << _bitmapLength << ")";
+      throw hal_exception(ss.str());
+    }
+    if (_bitmap[pos] == true)
+    {
+      return false;
+    }
+    _bitmap[pos] = true;
+    ++_size;
+    return true;
+  }
+
   IntervalSet::iterator i;
   if (_prev != _set.end() && _prev->first == pos - 1)
   {
@@ -80,11 +112,20 @@ bool PositionCache::insert(hal_index_t pos)
 
   ++_size;
   assert(find(pos) == true);
+  if (_bitmapLength > 0 && 
+      _set.size() * IntervalBytes > (_bitmapLength + 7) / 8)
+  {
+    toBitmap();
+  }
   return true;
 }
 
 bool PositionCache::find(hal_index_t pos) const
 {
+  if (_isBitmap == true)
+  {
+    return pos >= 0 && pos < (hal_index_t)_bitmapLength && _bitmap[pos];
+  }
   IntervalSet::const_iterator i = _set.lower_bound(pos);
   if (i != _set.end() && i->second <= pos)
   {
@@ -98,11 +139,85 @@ void PositionCache::clear()
   _set.clear();
   _size = 0;
   _prev = _set.begin();
+  vector<bool>().swap(_bitmap);
+  _isBitmap = false;
+}
+
+void PositionCache::allowBitmap(hal_size_t length)
+{
+  assert(_isBitmap == false);
+  _bitmapLength = length;
+}
+
+void PositionCache::compact()
+{
+  if (_isBitmap == false)
+  {
+    return;
+  }
+  hal_size_t numIntervals = 0;
+  for (hal_size_t i = 0; i < _bitmapLength; ++i)
+  {
+    if (_bitmap[i] == true && (i == 0 || _bitmap[i - 1] == false))
+    {
+      ++numIntervals;
+    }
+  }
+  if (numIntervals * IntervalBytes > (_bitmapLength + 7) / 8)
+  {
+    return;
+  }
+  for (hal_size_t i = 0; i < _bitmapLength; ++i)
+  {
+    if (_bitmap[i] == true)
+    {
+      hal_size_t j = i;
+      while (j + 1 < _bitmapLength && _bitmap[j + 1] == true)
+      {
+        ++j;
+      }
+      _set.insert(_set.end(), IntervalSet::value_type(j, i));
+      i = j;
+    }
+  }
+  _prev = _set.begin();
+  vector<bool>().swap(_bitmap);
+  _isBitmap = false;
+  assert(check() == true);
+}
+
+hal_size_t PositionCache::getMemoryUsage() const
+{
+  if (_isBitmap == true)
+  {
+    return (_bitmapLength + 7) / 8;
+  }
+  return _set.size() * IntervalBytes;
+}
+
+void PositionCache::toBitmap()
+{
+  _bitmap.assign(_bitmapLength, false);
+  for (IntervalSet::const_iterator i = _set.begin(); i != _set.end(); ++i)
+  {
+    assert(i->first < (hal_index_t)_bitmapLength);
+    for (hal_index_t j = i->second; j <= i->first; ++j)
+    {
+      _bitmap[j] = true;
+    }
+  }
+  _set.clear();
+  _prev = _set.begin();
+  _isBitmap = true;
 }
 
 // for debugging
 bool PositionCache::check() const
 {
+  if (_isBitmap == true)
+  {
+    return (hal_size_t)count(_bitmap.begin(), _bitmap.end(), true) == _size;
+  }
   hal_size_t size = 0;
   for (IntervalSet::const_iterator i = _set.begin(); i != _set.end(); ++i)
   {
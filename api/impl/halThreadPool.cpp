@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "halThreadPool.h"
+#include "hal.h"
+
+using namespace std;
+using namespace hal;
+
+ThreadPool::ThreadPool() : _nextThread(0), _nextItem(0), _error(false)
+{
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+}
+
+ThreadPool::~ThreadPool()
+{
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+}
+
+void ThreadPool::checkThreadSafe(AlignmentConstPtr alignment,
+                                 hal_size_t numThreads)
+{
+  if (numThreads > 1 && alignment->isThreadSafe() == false)
+  {
+    throw hal_exception("Multiple threads require an HDF5 library built "
+                        "with --enable-threadsafe");
+  }
+}
+
+void ThreadPool::run(hal_size_t numThreads, AlignmentConstPtr alignment,
+                     const string& halPath, CLParserConstPtr options)
+{
+  if (numThreads <= 1)
+  {
+    _error = false;
+    _nextItem = 0;
+    runWork(alignment);
+    if (_error == true)
+    {
+      throw hal_exception(_errorMessage);
+    }
+  }
+  else
+  {
+    start(numThreads, halPath, options);
+    join();
+  }
+}
+
+void ThreadPool::start(hal_size_t numThreads, const string& halPath,
+                       CLParserConstPtr options)
+{
+  if (_threads.empty() == false)
+  {
+    throw hal_exception("Thread pool already running");
+  }
+  _error = false;
+  _nextItem = 0;
+  _nextThread = 0;
+
+  // they are opened here because the options parser isn't thread-safe
+  // either
+  _alignments.clear();
+  for (size_t i = 0; i < numThreads; ++i)
+  {
+    _alignments.push_back(openHalAlignmentReadOnly(halPath, options));
+    if (i == 0)
+    {
+      checkThreadSafe(_alignments[0], numThreads);
+    }
+  }
+
+  _threads.resize(numThreads);
+  size_t numStarted = 0;
+  for (; numStarted < numThreads; ++numStarted)
+  {
+    if (pthread_create(&_threads[numStarted], NULL, threadFunc, this) != 0)
+    {
+      setError("Error creating thread");
+      break;
+    }
+  }
+  _threads.resize(numStarted);
+}
+
+void ThreadPool::join()
+{
+  for (size_t i = 0; i < _threads.size(); ++i)
+  {
+    pthread_join(_threads[i], NULL);
+  }
+  _threads.clear();
+  _alignments.clear();
+  if (_error == true)
+  {
+    throw hal_exception(_errorMessage);
+  }
+}
+
+bool ThreadPool::nextItem(size_t numItems, size_t& item)
+{
+  pthread_mutex_lock(&_mutex);
+  bool found = _error == false && _nextItem < numItems;
+  if (found == true)
+  {
+    item = _nextItem++;
+  }
+  pthread_mutex_unlock(&_mutex);
+  return found;
+}
+
+void ThreadPool::lock()
+{
+  pthread_mutex_lock(&_mutex);
+}
+
+void ThreadPool::unlock()
+{
+  pthread_mutex_unlock(&_mutex);
+}
+
+void ThreadPool::wait()
+{
+  pthread_cond_wait(&_cond, &_mutex);
+}
+
+void ThreadPool::broadcast()
+{
+  pthread_cond_broadcast(&_cond);
+}
+
+bool ThreadPool::hasError() const
+{
+  return _error;
+}
+
+void ThreadPool::setError(const string& message)
+{
+  pthread_mutex_lock(&_mutex);
+  if (_error == false)
+  {
+    _error = true;
+    _errorMessage = message;
+  }
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+}
+
+void ThreadPool::runWork(AlignmentConstPtr alignment)
+{
+  try
+  {
+    work(alignment);
+  }
+  catch(exception& e)
+  {
+    setError(e.what());
+  }
+  catch(string& s)
+  {
+    setError(s);
+  }
+  catch(...)
+  {
+    setError("Unknown error in worker thread");
+  }
+}
+
+void* ThreadPool::threadFunc(void* data)
+{
+  ThreadPool* pool = (ThreadPool*)data;
+  pthread_mutex_lock(&pool->_mutex);
+  AlignmentConstPtr alignment = pool->_alignments[pool->_nextThread++];
+  pthread_mutex_unlock(&pool->_mutex);
+  pool->runWork(alignment);
+  return NULL;
+}
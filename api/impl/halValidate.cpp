@@ -7,12 +7,26 @@
 #include <deque>
 #include <vector>
 #include <iostream>
+#include <algorithm>
 #include "halValidate.h"
 #include "hal.h"
 
 using namespace std;
 using namespace hal;
 
+// work items of the threaded validateAlignment() check at most this many
+// segments or bases
+static const hal_size_t ValidateChunkSegments = 100000;
+static const hal_size_t ValidateChunkBases = 10000000;
+
+// with sampling, DNA is checked in windows of this many bases
+static const hal_size_t ValidateSampleBases = 1000;
+
+// segments read at a time by the checks that don't use iterators, in
+// order and (around the ones asked for) out of order
+static const hal_size_t ValidateBatchSegments = 65536;
+static const hal_size_t ValidateWindowSegments = 16;
+
 // current implementation is poor and hacky.  should fix up to 
 // use iterators to properly scan the segments. 
 
@@ -255,28 +269,537 @@ void hal::validateTopSegment(const TopSegment* topSegment)
   }
 }
 
-void hal::validateSequence(const Sequence* sequence)
+// deterministic, evenly spread choice of a fraction of the units
+// (segments or windows of DNA) 0, 1, 2, ...
+static inline bool isSampled(hal_size_t i, double fraction)
 {
-  // Verify that the DNA sequence doesn't contain funny characters
-  DNAIteratorConstPtr dnaIt = sequence->getDNAIterator();
-  hal_size_t length = sequence->getSequenceLength();
-  if (sequence->getGenome()->containsDNAArray() == true)
+  return fraction >= 1. || 
+     (hal_size_t)((i + 1) * fraction) > (hal_size_t)(i * fraction);
+}
+
+// Verify that the DNA of genome positions [start, end) doesn't contain
+// funny characters, looking only at a sample of windows if fraction < 1
+static void validateDNA(const Genome* genome, hal_size_t start,
+                        hal_size_t end, double fraction)
+{
+  if (genome->containsDNAArray() == false)
+  {
+    return;
+  }
+  string dna;
+  for (hal_size_t pos = start; pos < end; )
+  {
+    hal_size_t window = pos / ValidateSampleBases;
+    hal_size_t windowEnd = min(end, (window + 1) * ValidateSampleBases);
+    if (isSampled(window, fraction) == true)
+    {
+      genome->getSubString(dna, pos, windowEnd - pos);
+      for (size_t i = 0; i < dna.length(); ++i)
+      {
+        if (isNucleotide(dna[i]) == false)
+        {
+          const Sequence* sequence = genome->getSequenceBySite(pos + i);
+          stringstream ss;
+          ss << "Non-nucleotide character discoverd at position " 
+             << pos + i - sequence->getStartPosition() << " of sequence " 
+             << sequence->getName() << ": " << dna[i];
+          throw hal_exception(ss.str());
+        }
+      }
+    }
+    pos = windowEnd;
+  }
+}
+
+static void validateTopSegments(const Genome* genome, hal_index_t start,
+                                hal_index_t end, double fraction)
+{
+  TopSegmentIteratorConstPtr topIt = genome->getTopSegmentIterator(start);
+  for (hal_index_t i = start; i < end; ++i, topIt->toRight())
+  {
+    if (isSampled(i, fraction) == true)
+    {
+      validateTopSegment(topIt->getTopSegment());
+    }
+  }
+}
+
+static void validateBottomSegments(const Genome* genome, hal_index_t start,
+                                   hal_index_t end, double fraction)
+{
+  BottomSegmentIteratorConstPtr bottomIt = 
+     genome->getBottomSegmentIterator(start);
+  for (hal_index_t i = start; i < end; ++i, bottomIt->toRight())
+  {
+    if (isSampled(i, fraction) == true)
+    {
+      validateBottomSegment(bottomIt->getBottomSegment());
+    }
+  }
+}
+
+// the records of a genome's top segments, read ValidateWindowSegments at
+// a time around the ones asked for.  the checks mostly look at nearby
+// segments, so this reads each window about once.
+class TopRecordWindow
+{
+public:
+   TopRecordWindow(const Genome* genome) : _genome(genome), _start(0) {}
+   const TopSegmentRecord& get(hal_index_t i)
+   {
+     if (i < _start || i >= _start + (hal_index_t)_records.size())
+     {
+       _start = i - i % ValidateWindowSegments;
+       _genome->readTopSegments(
+         _start, min(ValidateWindowSegments, 
+                     _genome->getNumTopSegments() - _start), _records);
+     }
+     return _records[i - _start];
+   }
+protected:
+   const Genome* _genome;
+   hal_index_t _start;
+   vector<TopSegmentRecord> _records;
+};
+
+class BottomRecordWindow
+{
+public:
+   BottomRecordWindow(const Genome* genome) : _genome(genome), _start(0),
+     _numChildren(genome != NULL ? genome->getNumChildren() : 0) {}
+   const BottomSegmentRecord& get(hal_index_t i)
+   {
+     if (i < _start || i >= _start + (hal_index_t)_records.size())
+     {
+       _start = i - i % ValidateWindowSegments;
+       _genome->readBottomSegments(
+         _start, min(ValidateWindowSegments, 
+                     _genome->getNumBottomSegments() - _start), _records,
+         _childIndexes, _childReversed);
+     }
+     return _records[i - _start];
+   }
+   // of the last segment returned by get()
+   hal_index_t getChildIndex(hal_index_t i, hal_size_t child) const
+   {
+     return _childIndexes[(i - _start) * _numChildren + child];
+   }
+   bool getChildReversed(hal_index_t i, hal_size_t child) const
+   {
+     return _childReversed[(i - _start) * _numChildren + child];
+   }
+protected:
+   const Genome* _genome;
+   hal_index_t _start;
+   hal_size_t _numChildren;
+   vector<BottomSegmentRecord> _records;
+   vector<hal_index_t> _childIndexes;
+   vector<bool> _childReversed;
+};
+
+// the checks of validateTopSegment() (and that the segments are
+// contiguous), done on records read in batches instead of through
+// iterators
+static void validateTopRecords(const Genome* genome, hal_index_t start,
+                               hal_index_t end, double fraction)
+{
+  const Genome* parent = genome->getParent();
+  hal_index_t numTop = (hal_index_t)genome->getNumTopSegments();
+  hal_index_t numBottom = (hal_index_t)genome->getNumBottomSegments();
+  hal_index_t numParentBottom = 
+     parent != NULL ? (hal_index_t)parent->getNumBottomSegments() : 0;
+  BottomRecordWindow parseRecords(genome);
+  BottomRecordWindow parentRecords(parent);
+  TopRecordWindow paralogRecords(genome);
+  vector<TopSegmentRecord> records;
+  hal_index_t prevEnd = 0;
+  if (start > 0 && start < end)
   {
-    for (hal_size_t i = 0; i < length; ++i)
+    const TopSegmentRecord& prev = paralogRecords.get(start - 1);
+    prevEnd = prev._startPosition + prev._length;
+  }
+
+  for (hal_index_t batch = start; batch < end; 
+       batch += ValidateBatchSegments)
+  {
+    hal_size_t count = min(ValidateBatchSegments, (hal_size_t)(end - batch));
+    genome->readTopSegments(batch, count, records);
+    for (hal_size_t j = 0; j < count; ++j)
     {
-      char c = dnaIt->getChar();
-      if (isNucleotide(c) == false)
+      const TopSegmentRecord& record = records[j];
+      hal_index_t index = batch + j;
+      if (record._length < 1 || record._length > genome->getSequenceLength())
+      {
+        stringstream ss;
+        ss << "Top segment " << index  << " in genome " << genome->getName()
+           << " has length " << (hal_index_t)record._length 
+           << " which is not currently supported";
+        throw hal_exception(ss.str());
+      }
+      if (record._startPosition != prevEnd)
       {
         stringstream ss;
-        ss << "Non-nucleotide character discoverd at position " 
-           << i << " of sequence " << sequence->getName() << ": " << c;
+        ss << "Top segment " << index << " in genome " << genome->getName()
+           << " starts at " << record._startPosition 
+           << " but the previous segment ends at " << prevEnd;
         throw hal_exception(ss.str());
       }
+      prevEnd = record._startPosition + record._length;
+      if (isSampled(index, fraction) == false)
+      {
+        continue;
+      }
+
+      hal_index_t parentIndex = record._parentIndex;
+      if (parent != NULL && parentIndex != NULL_INDEX)
+      {
+        if (parentIndex < 0 || parentIndex >= numParentBottom)
+        {
+          stringstream ss;
+          ss << "Parent index " << parentIndex << " of segment "
+             << index << " out of range in genome " << parent->getName();
+          throw hal_exception(ss.str());
+        }
+        const BottomSegmentRecord& parentRecord = 
+           parentRecords.get(parentIndex);
+        if (record._length != parentRecord._length)
+        {
+          stringstream ss;
+          ss << "Parent length of segment " << index 
+             << " in genome " << genome->getName() << " has length "
+             << parentRecord._length << " which does not match "
+             << record._length;
+          throw hal_exception(ss.str());
+        }
+      }
+
+      hal_index_t parseIndex = record._bottomParseIndex;
+      if (parseIndex == NULL_INDEX)
+      {
+        if (genome->getNumChildren() != 0)
+        {
+          stringstream ss;
+          ss << "Top Segment " << index << " in genome "
+             << genome->getName() << " has null parse index";
+          throw hal_exception(ss.str());
+        }
+      }
+      else
+      {
+        if (parseIndex < 0 || parseIndex >= numBottom)
+        {
+          stringstream ss;
+          ss << "Top Segment " << index << " in genome "
+             << genome->getName() << " has parse index " << parseIndex 
+             << " which is out of range since genome has " 
+             << numBottom << " bottom segments";
+          throw hal_exception(ss.str());
+        }
+        const BottomSegmentRecord& parseRecord = parseRecords.get(parseIndex);
+        if (record._startPosition < parseRecord._startPosition ||
+            record._startPosition >= parseRecord._startPosition + 
+            (hal_index_t)parseRecord._length)
+        {
+          throw hal_exception("parse index broken in top segment in genome "
+                              + genome->getName());
+        }
+      }
+
+      hal_index_t paralogyIndex = record._nextParalogyIndex;
+      if (paralogyIndex != NULL_INDEX)
+      {
+        if (paralogyIndex == index || paralogyIndex < 0 || 
+            paralogyIndex >= numTop)
+        {
+          stringstream ss;
+          ss << "Top segment " << index << " has paralogy index " 
+             << paralogyIndex << " which isn't allowed";
+          throw hal_exception(ss.str());
+        }
+        if (paralogRecords.get(paralogyIndex)._parentIndex != parentIndex)
+        {
+          stringstream ss;
+          ss << "Top segment " << index << " has parent index "
+             << parentIndex << ", but next paraglog " << paralogyIndex
+             << " has parent Index " 
+             << paralogRecords.get(paralogyIndex)._parentIndex
+             << ". Paralogous top segments must share same parent.";
+          throw hal_exception(ss.str());
+        }
+      }
+    }
+  }
+}
+
+// the checks of validateBottomSegment() (and that the segments are
+// contiguous) on records read in batches
+static void validateBottomRecords(const Genome* genome, hal_index_t start,
+                                  hal_index_t end, double fraction)
+{
+  hal_index_t numTop = (hal_index_t)genome->getNumTopSegments();
+  hal_size_t numChildren = genome->getNumChildren();
+  vector<const Genome*> children(numChildren);
+  vector<hal_index_t> numChildTop(numChildren, 0);
+  vector<TopRecordWindow> childRecords;
+  for (hal_size_t i = 0; i < numChildren; ++i)
+  {
+    children[i] = genome->getChild(i);
+    if (children[i] != NULL)
+    {
+      numChildTop[i] = (hal_index_t)children[i]->getNumTopSegments();
     }
+    childRecords.push_back(TopRecordWindow(children[i]));
+  }
+  TopRecordWindow parseRecords(genome);
+  vector<BottomSegmentRecord> records;
+  vector<hal_index_t> childIndexes;
+  vector<bool> childReversed;
+  hal_index_t prevEnd = 0;
+  if (start > 0 && start < end)
+  {
+    genome->readBottomSegments(start - 1, 1, records, childIndexes,
+                               childReversed);
+    prevEnd = records[0]._startPosition + records[0]._length;
   }
 
-  // Check the top segments
-  if (sequence->getGenome()->getParent() != NULL)
+  for (hal_index_t batch = start; batch < end; 
+       batch += ValidateBatchSegments)
+  {
+    hal_size_t count = min(ValidateBatchSegments, (hal_size_t)(end - batch));
+    genome->readBottomSegments(batch, count, records, childIndexes,
+                               childReversed);
+    for (hal_size_t j = 0; j < count; ++j)
+    {
+      const BottomSegmentRecord& record = records[j];
+      hal_index_t index = batch + j;
+      if (record._length < 1 || record._length > genome->getSequenceLength())
+      {
+        stringstream ss;
+        ss << "Bottom segment " << index  << " in genome " 
+           << genome->getName() << " has length " 
+           << (hal_index_t)record._length 
+           << " which is not currently supported";
+        throw hal_exception(ss.str());
+      }
+      if (record._startPosition != prevEnd)
+      {
+        stringstream ss;
+        ss << "Bottom segment " << index << " in genome " 
+           << genome->getName() << " starts at " << record._startPosition
+           << " but the previous segment ends at " << prevEnd;
+        throw hal_exception(ss.str());
+      }
+      prevEnd = record._startPosition + record._length;
+      if (isSampled(index, fraction) == false)
+      {
+        continue;
+      }
+
+      for (hal_size_t child = 0; child < numChildren; ++child)
+      {
+        hal_index_t childIndex = childIndexes[j * numChildren + child];
+        if (children[child] == NULL || childIndex == NULL_INDEX)
+        {
+          continue;
+        }
+        const Genome* childGenome = children[child];
+        if (childIndex < 0 || childIndex >= numChildTop[child])
+        {
+          stringstream ss;
+          ss << "Child " << child << " index " << childIndex 
+             << " of segment " << index << " out of range in genome "
+             << childGenome->getName();
+          throw hal_exception(ss.str());
+        }
+        const TopSegmentRecord& childRecord = 
+           childRecords[child].get(childIndex);
+        if (childRecord._length != record._length)
+        {
+          stringstream ss;
+          ss << "Child " << child << " with index " << childIndex
+             << " and start position " << childRecord._startPosition
+             << " has length " << childRecord._length
+             << " but parent with index " << index
+             << " and start position " << record._startPosition
+             << " in genome " << genome->getName()
+             << " has length " << record._length;
+          throw hal_exception(ss.str());
+        }
+        if (childRecord._nextParalogyIndex == NULL_INDEX &&
+            childRecord._parentIndex != index)
+        {
+          stringstream ss;
+          ss << "Parent / child index mismatch:\n" 
+             << genome->getName() << "[" << index << "]"
+             << " links to " << childGenome->getName() << "[" << childIndex 
+             << "] but \n"
+             << childGenome->getName() << "[" << childIndex
+             << "] links to " << genome->getName() << "[" 
+             << childRecord._parentIndex << "]";
+          throw hal_exception(ss.str());
+        }
+        if (childRecord._parentReversed != 
+            childReversed[j * numChildren + child])
+        {
+          stringstream ss;
+          ss << "parent / child reversal mismatch (parent=" 
+             << genome->getName() << " parentSegNum=" << index 
+             << " child=" << childGenome->getName() << " childSegNum=" 
+             << childIndex << ")";
+          throw hal_exception(ss.str());
+        }
+      }
+
+      hal_index_t parseIndex = record._topParseIndex;
+      if (parseIndex == NULL_INDEX)
+      {
+        if (genome->getParent() != NULL)
+        {
+          stringstream ss;
+          ss << "Bottom segment " << index << " in genome "
+             << genome->getName() << " has null parse index";
+          throw hal_exception(ss.str());
+        }
+      }
+      else
+      {
+        if (parseIndex < 0 || parseIndex >= numTop)
+        {
+          stringstream ss;
+          ss << "BottomSegment " << index << " in genome "
+             << genome->getName() << " has parse index " << parseIndex 
+             << " greater than the number of top segments, " << numTop;
+          throw hal_exception(ss.str());
+        }
+        const TopSegmentRecord& parseRecord = parseRecords.get(parseIndex);
+        if (record._startPosition < parseRecord._startPosition ||
+            record._startPosition >= parseRecord._startPosition + 
+            (hal_index_t)parseRecord._length)
+        {
+          throw hal_exception("parse index broken in bottom segment in "
+                              "genome " + genome->getName());
+        }
+      }
+    }
+  }
+}
+
+// validateDuplications() on records, which also checks that the next
+// paralogy indexes link the paralogous segments into cycles: every
+// segment with a next paralog has to be the next paralog of exactly one
+// other segment, and segments without one of none.
+static void validateParalogyRecords(const Genome* genome)
+{
+  const Genome* parent = genome->getParent();
+  if (parent == NULL)
+  {
+    return;
+  }
+  hal_size_t numTop = genome->getNumTopSegments();
+  vector<unsigned char> pcount(parent->getNumBottomSegments(), 0);
+  vector<unsigned char> incount(numTop, 0);
+  vector<TopSegmentRecord> records;
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    for (hal_size_t batch = 0; batch < numTop; 
+         batch += ValidateBatchSegments)
+    {
+      hal_size_t count = min(ValidateBatchSegments, numTop - batch);
+      genome->readTopSegments(batch, count, records);
+      for (hal_size_t j = 0; j < count; ++j)
+      {
+        const TopSegmentRecord& record = records[j];
+        hal_index_t index = batch + j;
+        if (pass == 0)
+        {
+          if (record._parentIndex != NULL_INDEX &&
+              pcount[record._parentIndex] < 250)
+          {
+            ++pcount[record._parentIndex];
+          }
+          if (record._nextParalogyIndex != NULL_INDEX &&
+              incount[record._nextParalogyIndex] < 250)
+          {
+            ++incount[record._nextParalogyIndex];
+          }
+          continue;
+        }
+        if (record._parentIndex != NULL_INDEX &&
+            record._nextParalogyIndex == NULL_INDEX &&
+            pcount[record._parentIndex] > 1)
+        {
+          stringstream ss;
+          ss << "Top Segment " << index
+             << " in genome " << genome->getName() << " is not marked as a"
+             << " duplication but it shares its parent " 
+             << record._parentIndex << " with at least " 
+             << pcount[record._parentIndex] - 1 
+             << " other segments in the same genome";
+          throw hal_exception(ss.str());
+        }
+        if ((record._nextParalogyIndex != NULL_INDEX && incount[index] != 1)
+            || (record._nextParalogyIndex == NULL_INDEX && incount[index] > 0))
+        {
+          stringstream ss;
+          ss << "Top Segment " << index << " in genome " 
+             << genome->getName() << " is the next paralog of " 
+             << (int)incount[index] << " segments but has next paralog "
+             << record._nextParalogyIndex 
+             << ", so the paralogy indexes don't form cycles";
+          throw hal_exception(ss.str());
+        }
+      }
+    }
+  }
+}
+
+// the DNA and the segments themselves are only checked if segments is
+// true.  otherwise they are left to validateDNA() and validateTopSegments()
+// or validateTopRecords() etc.  if the record windows are given, they are
+// used to add up the lengths of the segments instead of iterators.
+static void checkSequence(const Sequence* sequence, bool segments,
+                          TopRecordWindow* topRecords,
+                          BottomRecordWindow* bottomRecords)
+{
+  hal_size_t length = sequence->getSequenceLength();
+  if (segments == true)
+  {
+    validateDNA(sequence->getGenome(), sequence->getStartPosition(),
+                sequence->getStartPosition() + length, 1.);
+  }
+
+  // Check the top segments (the records have already been checked to be
+  // contiguous)
+  if (sequence->getGenome()->getParent() != NULL && topRecords != NULL)
+  {
+    hal_size_t numTopSegments = sequence->getNumTopSegments();
+    if (numTopSegments > 0)
+    {
+      hal_index_t first = sequence->getTopSegmentArrayIndex();
+      hal_index_t start = topRecords->get(first)._startPosition;
+      const TopSegmentRecord& last = 
+         topRecords->get(first + numTopSegments - 1);
+      if (start != sequence->getStartPosition() ||
+          last._startPosition + last._length != start + length)
+      {
+        stringstream ss;
+        ss << "Sequence " << sequence->getName() << " spans [" 
+           << sequence->getStartPosition() << ", " 
+           << sequence->getStartPosition() + length
+           << ") but its top segments span [" << start << ", " 
+           << last._startPosition + last._length << ")";
+        throw hal_exception(ss.str());
+      }
+    }
+    else if (length != 0)
+    {
+      stringstream ss;
+      ss << "Sequence " << sequence->getName() << " has length " << length 
+         << " but no top segments";
+      throw hal_exception(ss.str());
+    }
+  }
+  else if (sequence->getGenome()->getParent() != NULL)
   {
     hal_size_t totalTopLength = 0;
     TopSegmentIteratorConstPtr topIt = sequence->getTopSegmentIterator();
@@ -284,7 +807,10 @@ void hal::validateSequence(const Sequence* sequence)
     for (hal_size_t i = 0; i < numTopSegments; ++i)
     {
       const TopSegment* topSegment = topIt->getTopSegment();
-      validateTopSegment(topSegment);
+      if (segments == true)
+      {
+        validateTopSegment(topSegment);
+      }
       totalTopLength += topSegment->getLength();
       topIt->toRight();
     }
@@ -298,7 +824,36 @@ void hal::validateSequence(const Sequence* sequence)
   }
 
   // Check the bottom segments
-  if (sequence->getGenome()->getNumChildren() > 0)
+  if (sequence->getGenome()->getNumChildren() > 0 && bottomRecords != NULL)
+  {
+    hal_size_t numBottomSegments = sequence->getNumBottomSegments();
+    if (numBottomSegments > 0)
+    {
+      hal_index_t first = sequence->getBottomSegmentArrayIndex();
+      hal_index_t start = bottomRecords->get(first)._startPosition;
+      const BottomSegmentRecord& last = 
+         bottomRecords->get(first + numBottomSegments - 1);
+      if (start != sequence->getStartPosition() ||
+          last._startPosition + last._length != start + length)
+      {
+        stringstream ss;
+        ss << "Sequence " << sequence->getName() << " spans [" 
+           << sequence->getStartPosition() << ", " 
+           << sequence->getStartPosition() + length
+           << ") but its bottom segments span [" << start << ", " 
+           << last._startPosition + last._length << ")";
+        throw hal_exception(ss.str());
+      }
+    }
+    else if (length != 0)
+    {
+      stringstream ss;
+      ss << "Sequence " << sequence->getName() << " has length " << length 
+         << " but no bottom segments";
+      throw hal_exception(ss.str());
+    }
+  }
+  else if (sequence->getGenome()->getNumChildren() > 0)
   {
     hal_size_t totalBottomLength = 0;
     BottomSegmentIteratorConstPtr bottomIt = 
@@ -307,7 +862,10 @@ void hal::validateSequence(const Sequence* sequence)
     for (hal_size_t i = 0; i < numBottomSegments; ++i)
     {
       const BottomSegment* bottomSegment = bottomIt->getBottomSegment();
-      validateBottomSegment(bottomSegment);
+      if (segments == true)
+      {
+        validateBottomSegment(bottomSegment);
+      }
       totalBottomLength += bottomSegment->getLength();
       bottomIt->toRight();
     }
@@ -321,6 +879,11 @@ void hal::validateSequence(const Sequence* sequence)
   }
 }
 
+void hal::validateSequence(const Sequence* sequence)
+{
+  checkSequence(sequence, true, NULL, NULL);
+}
+
 void hal::validateDuplications(const Genome* genome)
 {
   const Genome* parent = genome->getParent();
@@ -363,8 +926,13 @@ void hal::validateDuplications(const Genome* genome)
   }
 }
 
-void hal::validateGenome(const Genome* genome)
+// see checkSequence().  with raw, the lengths of the sequences and the
+// duplications are checked on segment records instead of with iterators
+static void checkGenome(const Genome* genome, bool segments, bool raw)
 {
+  TopRecordWindow topRecords(genome);
+  BottomRecordWindow bottomRecords(genome);
+
   // first we check the sequence coverage
   hal_size_t totalTop = 0;
   hal_size_t totalBottom = 0;
@@ -375,7 +943,8 @@ void hal::validateGenome(const Genome* genome)
   for (; seqIt != seqEnd; seqIt->toNext())
   {
     const Sequence* sequence = seqIt->getSequence();
-    validateSequence(sequence);
+    checkSequence(sequence, segments, raw ? &topRecords : NULL,
+                  raw ? &bottomRecords : NULL);
 
     totalTop += sequence->getNumTopSegments();
     totalBottom += sequence->getNumBottomSegments();
@@ -441,7 +1010,19 @@ void hal::validateGenome(const Genome* genome)
     throw hal_exception(ss.str());
   }
   
-  validateDuplications(genome);
+  if (raw == true)
+  {
+    validateParalogyRecords(genome);
+  }
+  else
+  {
+    validateDuplications(genome);
+  }
+}
+
+void hal::validateGenome(const Genome* genome)
+{
+  checkGenome(genome, true, false);
 }
 
 void hal::validateAlignment(AlignmentConstPtr alignment)
@@ -468,3 +1049,166 @@ void hal::validateAlignment(AlignmentConstPtr alignment)
     }
   }
 }
+
+// one unit of work of the threaded validateAlignment(): the genome-wide
+// checks of a genome (without the DNA and segments themselves), or a
+// range of its DNA, top segments or bottom segments
+struct ValidateItem
+{
+   enum Type { GenomeItem, DNAItem, TopItem, BottomItem };
+   string _genomeName;
+   Type _type;
+   hal_size_t _start;
+   hal_size_t _end;
+};
+
+// work shared by the threads of validateAlignment().  items are handed
+// out in order, and the first error stops everything.
+struct ValidateThreads : public ThreadPool
+{
+   virtual void work(AlignmentConstPtr alignment);
+
+   vector<ValidateItem> _items;
+   double _sampleFraction;
+   bool _progress;
+   bool _deep;
+   size_t _numDone;
+   size_t _lastPercent;
+};
+
+static void addValidateItems(vector<ValidateItem>& items,
+                             const string& genomeName,
+                             ValidateItem::Type type, hal_size_t total,
+                             hal_size_t chunkLength)
+{
+  ValidateItem item;
+  item._genomeName = genomeName;
+  item._type = type;
+  for (hal_size_t start = 0; start < total; start += chunkLength)
+  {
+    item._start = start;
+    item._end = min(total, start + chunkLength);
+    items.push_back(item);
+  }
+}
+
+void ValidateThreads::work(AlignmentConstPtr alignment)
+{
+  size_t next;
+  while (nextItem(_items.size(), next) == true)
+  {
+    const ValidateItem& item = _items[next];
+    const Genome* genome = alignment->openGenome(item._genomeName);
+    if (genome == NULL)
+    {
+      throw hal_exception("Failure to open genome " + item._genomeName);
+    }
+    switch (item._type)
+    {
+    case ValidateItem::GenomeItem:
+      checkGenome(genome, false, !_deep);
+      break;
+    case ValidateItem::DNAItem:
+      validateDNA(genome, item._start, item._end, _sampleFraction);
+      break;
+    case ValidateItem::TopItem:
+      if (_deep == true)
+      {
+        validateTopSegments(genome, item._start, item._end,
+                            _sampleFraction);
+      }
+      else
+      {
+        validateTopRecords(genome, item._start, item._end,
+                           _sampleFraction);
+      }
+      break;
+    case ValidateItem::BottomItem:
+      if (_deep == true)
+      {
+        validateBottomSegments(genome, item._start, item._end,
+                               _sampleFraction);
+      }
+      else
+      {
+        validateBottomRecords(genome, item._start, item._end,
+                              _sampleFraction);
+      }
+      break;
+    }
+
+    lock();
+    ++_numDone;
+    size_t percent = 100 * _numDone / _items.size();
+    if (_progress == true && percent > _lastPercent)
+    {
+      _lastPercent = percent;
+      cerr << "validated " << _numDone << " of " 
+           << _items.size() << " chunks (" << percent << "%), "
+           << "last in " << item._genomeName << endl;
+    }
+    unlock();
+  }
+}
+
+void hal::validateAlignment(AlignmentConstPtr alignment, 
+                            hal_size_t numThreads, const string& halPath,
+                            CLParserConstPtr options, double sampleFraction,
+                            bool progress, bool deep)
+{
+  ThreadPool::checkThreadSafe(alignment, numThreads);
+  if (sampleFraction <= 0. || sampleFraction > 1.)
+  {
+    throw hal_exception("Sample fraction must be in (0, 1]");
+  }
+
+  // same genome order as validateAlignment() above
+  ValidateThreads state;
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    string name = bfQueue.back();
+    bfQueue.pop_back();
+    if (name.empty() == false)
+    {
+      const Genome* genome = alignment->openGenome(name);
+      if (genome == NULL)
+      {
+        throw hal_exception("Failure to open genome " + name);
+      }
+      ValidateItem item;
+      item._genomeName = name;
+      item._type = ValidateItem::GenomeItem;
+      item._start = item._end = 0;
+      state._items.push_back(item);
+      addValidateItems(state._items, name, ValidateItem::DNAItem,
+                       genome->getSequenceLength(), ValidateChunkBases);
+      if (genome->getParent() != NULL)
+      {
+        addValidateItems(state._items, name, ValidateItem::TopItem,
+                         genome->getNumTopSegments(), ValidateChunkSegments);
+      }
+      if (genome->getNumChildren() > 0)
+      {
+        addValidateItems(state._items, name, ValidateItem::BottomItem,
+                         genome->getNumBottomSegments(), 
+                         ValidateChunkSegments);
+      }
+      vector<string> childNames = alignment->getChildNames(name);
+      for (size_t i = 0; i < childNames.size(); ++i)
+      {
+        bfQueue.push_front(childNames[i]);
+      }
+    }
+  }
+
+  numThreads = max((hal_size_t)1, min(numThreads, 
+                                      (hal_size_t)state._items.size()));
+  state._sampleFraction = sampleFraction;
+  state._progress = progress;
+  state._deep = deep;
+  state._numDone = 0;
+  state._lastPercent = 0;
+  state.run(numThreads, alignment, halPath, options);
+}
@@ -81,6 +81,7 @@
 #include "halTopSegmentIterator.h"
 #include "halDNAIterator.h"
 #include "halValidate.h"
+#include "halThreadPool.h"
 #include "halColumnIterator.h"
 #include "halGappedTopSegmentIterator.h"
 #include "halGappedBottomSegmentIterator.h"
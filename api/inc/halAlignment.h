@@ -130,6 +130,24 @@ public:
    /** Get read-only instance of Alignment's metadata */
    virtual const MetaData* getMetaData() const = 0;
 
+   /** Get the cached summary statistics written by halStats --writeCache
+    * (NULL if there are none).  Opening the alignment for writing
+    * discards them, since any modification can make them stale */
+   virtual const MetaData* getStatsCache() const = 0;
+
+   /** Create an empty statistics cache, replacing any existing one.
+    * It is written when the alignment is closed */
+   virtual MetaData* createStatsCache() = 0;
+
+   /** Get the alignment's change log (see logGenomeChanges()), or NULL if
+    * it has never been opened for writing */
+   virtual const MetaData* getChangeLog() const = 0;
+
+   /** Get the change log of an alignment open for writing (NULL if it is
+    * read-only).  Opening it added an entry for edits that may change any
+    * genome */
+   virtual MetaData* getChangeLog() = 0;
+
    /** Get a newick-formatted phylogeny to the alignment */
    virtual std::string getNewickTree() const = 0;
 
@@ -139,6 +157,10 @@ public:
    /** Replace the newick tree with a new string */
    virtual void replaceNewickTree(const std::string& newick) = 0;
 
+   /** Can several threads each open their own (read-only) instance of
+    * the alignment and read from them at once */
+   virtual bool isThreadSafe() const = 0;
+
 protected:
    friend class counted_ptr<Alignment>;
    friend class counted_ptr<const Alignment>;
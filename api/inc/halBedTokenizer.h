@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALBEDTOKENIZER_H
+#define _HALBEDTOKENIZER_H
+
+#include <vector>
+#include <string>
+#include <istream>
+#include <locale>
+#include "hal.h"
+
+namespace hal {
+
+/** Split BED (or MAF) lines into fields without going through the stream
+ * operators.  The input is read in large blocks, and each line's fields
+ * are null-terminated in place and returned as pointers into the block.
+ * Fields are separated by the space characters of a locale, as they
+ * would be with >> (so the TabSepFacet works just the same). */
+class BedTokenizer
+{
+public:
+
+   BedTokenizer();
+   virtual ~BedTokenizer();
+
+   /** Start reading a stream, using its locale for the separators */
+   void open(std::istream* stream);
+
+   /** Use the space characters of the given locale as separators */
+   void setSeparators(const std::locale& inLocale);
+
+   /** Move to the next line with at least one field.  Returns false at
+    * the end of the stream */
+   bool nextLine();
+
+   /** Offset in the stream of the current line (or of the end of the
+    * stream, once nextLine() has returned false) */
+   uint64_t getLinePosition() const;
+
+   /** Split a line (not necessarily from the stream) in place.  There
+    * must be room for a terminator at line[length] */
+   void tokenize(char* line, size_t length);
+
+   size_t getNumFields() const;
+   const char* getField(size_t i) const;
+   size_t getFieldLength(size_t i) const;
+
+   /** Parse a whole field as a (decimal) integer.  Returns false if it
+    * isn't one */
+   static bool parseInt(const char* field, size_t length, hal_index_t& val);
+
+   static const size_t BlockSize;
+
+protected:
+
+   void readBlock();
+
+   std::istream* _stream;
+   std::vector<char> _buffer;
+   size_t _begin;
+   size_t _end;
+   uint64_t _bufferPosition;
+   uint64_t _linePosition;
+   bool _eof;
+   bool _separator[256];
+   std::vector<const char*> _fields;
+   std::vector<size_t> _lengths;
+};
+
+inline uint64_t BedTokenizer::getLinePosition() const
+{
+  return _linePosition;
+}
+
+inline size_t BedTokenizer::getNumFields() const
+{
+  return _fields.size();
+}
+
+inline const char* BedTokenizer::getField(size_t i) const
+{
+  assert(i < _fields.size());
+  return _fields[i];
+}
+
+inline size_t BedTokenizer::getFieldLength(size_t i) const
+{
+  assert(i < _lengths.size());
+  return _lengths[i];
+}
+
+}
+
+#endif
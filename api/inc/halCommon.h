@@ -164,6 +164,35 @@ void getGenomesInSpanningTree(const std::set<const Genome*>& inputSet,
 void getGenomesInSubTree(const Genome* root, 
                          std::set<const Genome*>& outputSet);
 
+/** Record in the alignment's change log that the sequences of the
+ * genomes in sequenceChanged, and the bottom segments of those in
+ * bottomChanged (along with the top segments of their children), were
+ * edited.  Each call is one entry of the log, numbered from 1, that tools
+ * deriving files from the alignment (such as halLodExtract) use to tell
+ * which genomes changed since they last ran.  The first call after the
+ * alignment is opened for writing replaces the entry for any genome that
+ * logWriteOpen() added, so it must cover all the edits made until then */
+void logGenomeChanges(AlignmentPtr alignment,
+                      const std::vector<std::string>& sequenceChanged,
+                      const std::vector<std::string>& bottomChanged);
+
+/** Add an entry for edits that may change any genome to a change log,
+ * giving it a new identifier if it hasn't got one.  Called by the storage
+ * layer whenever an alignment is created or opened for writing */
+void logWriteOpen(MetaData* changeLog);
+
+/** Identifier of the alignment's change log (empty if there is none).
+ * Change numbers of logs with different identifiers can't be compared */
+std::string getChangeLogId(AlignmentConstPtr alignment);
+
+/** Number of the last entry of the change log (0 if there is none) */
+hal_size_t getLastGenomeChange(AlignmentConstPtr alignment);
+
+/** Number of the last entry of the change log that edited the sequence
+ * (or if bottom is true, the bottom segments) of a genome.  0 if none */
+hal_size_t getGenomeChange(AlignmentConstPtr alignment,
+                           const std::string& genomeName, bool bottom);
+
 }
 
 #endif
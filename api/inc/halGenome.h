@@ -15,6 +15,27 @@
 
 namespace hal {
 
+/** Plain copy of the fields of a top segment, as read in bulk by 
+ * Genome::readTopSegments() */
+struct TopSegmentRecord
+{
+   hal_index_t _startPosition;
+   hal_size_t _length;
+   hal_index_t _bottomParseIndex;
+   hal_index_t _parentIndex;
+   hal_index_t _nextParalogyIndex;
+   bool _parentReversed;
+};
+
+/** Plain copy of the fields of a bottom segment, except for its children,
+ * as read in bulk by Genome::readBottomSegments() */
+struct BottomSegmentRecord
+{
+   hal_index_t _startPosition;
+   hal_size_t _length;
+   hal_index_t _topParseIndex;
+};
+
 /** 
  * Interface for a genome within a hal alignment.  The genome
  * is comprised of a dna sequence, and two segment arrays (top and bottom)
@@ -175,6 +196,20 @@ public:
    /** Rename this genome. */
    virtual void rename(const std::string &name) = 0;
 
+   /** Copy the fields of the top segments [start, start + count) in one
+    * go, for code that needs to look at every segment.  The default
+    * implementation uses a segment iterator. */
+   virtual void readTopSegments(hal_index_t start, hal_size_t count,
+                                std::vector<TopSegmentRecord>& records) const;
+
+   /** Copy the fields of the bottom segments [start, start + count) in
+    * one go.  The child indexes and reversal flags of segment i are at
+    * i * getNumChildren() + child in childIndexes and childReversed. */
+   virtual void readBottomSegments(hal_index_t start, hal_size_t count,
+                                   std::vector<BottomSegmentRecord>& records,
+                                   std::vector<hal_index_t>& childIndexes,
+                                   std::vector<bool>& childReversed) const;
+
 protected:
 
    /** Destructor */
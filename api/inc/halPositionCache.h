@@ -18,12 +18,15 @@ namespace hal {
 /** keep track of bases by storing 2d intervals 
  * For example, if we want to flag positions in a genome
  * that we have visited, this structure will be fairly 
- * efficient provided positions are clustered into intervals */
+ * efficient provided positions are clustered into intervals.
+ * If they aren't, allowBitmap() lets it fall back on one bit per
+ * position */
 class PositionCache
 {
 public:
-   PositionCache() : _size(0), _prev(_set.begin()) {}
-   PositionCache(const PositionCache &positionCache) : _set(*positionCache.getIntervalSet()), _size(positionCache.size()), _prev(_set.begin()) {}
+   PositionCache() : _size(0), _prev(_set.begin()), _bitmapLength(0),
+                     _isBitmap(false) {}
+   PositionCache(const PositionCache &positionCache);
   // sorted by last index, so each interval is (last, first)
    typedef std::map<hal_index_t, hal_index_t> IntervalSet;
  
@@ -34,13 +37,31 @@ public:
    hal_size_t size() const { return _size; }
    hal_size_t numIntervals() const { return _set.size(); }
 
-   const IntervalSet* getIntervalSet() const { return &_set; }
+   /** Switch to a bitmap of positions [0, length) as soon as the
+    * intervals would take more memory than it */
+   void allowBitmap(hal_size_t length);
+   /** Switch back from a bitmap to intervals if they are smaller */
+   void compact();
+   bool isBitmap() const { return _isBitmap; }
+   /** Approximate number of bytes used by the intervals or bitmap */
+   hal_size_t getMemoryUsage() const;
+
+   /** Not available once the cache has switched to a bitmap */
+   const IntervalSet* getIntervalSet() const { 
+     assert(_isBitmap == false); return &_set; }
 
 protected:
 
+   void toBitmap();
+
+   static const hal_size_t IntervalBytes;
+
    IntervalSet _set;
    hal_size_t _size;
    IntervalSet::iterator _prev;
+   std::vector<bool> _bitmap;
+   hal_size_t _bitmapLength;
+   bool _isBitmap;
 };
 
 }
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALTHREADPOOL_H
+#define _HALTHREADPOOL_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "halAlignment.h"
+
+namespace hal {
+
+/** Run work() on several threads, each with its own read-only copy of
+ * an alignment (the alignment objects aren't thread-safe).  The first
+ * exception thrown by work() is kept and rethrown as a hal_exception
+ * by run() or join(); the other threads should give up as soon as
+ * hasError() is true (nextItem() checks it).  Anything else shared
+ * between the threads goes in the subclass, under lock() */
+class ThreadPool
+{
+public:
+   ThreadPool();
+   virtual ~ThreadPool();
+
+   /** Throw if numThreads > 1 and the alignment can't be read by
+    * several threads at once (see Alignment::isThreadSafe()) */
+   static void checkThreadSafe(AlignmentConstPtr alignment,
+                               hal_size_t numThreads);
+
+   /** Call work() on numThreads threads, each opening halPath, and
+    * wait for them all to finish.  With one thread, work() is just
+    * called on this one with the given alignment */
+   void run(hal_size_t numThreads, AlignmentConstPtr alignment,
+            const std::string& halPath, CLParserConstPtr options);
+
+   /** Start work() on numThreads threads, each opening halPath, and
+    * return so the caller can do its share (the ordered writing of
+    * their results, say) before join(), which must be called even if
+    * that fails (after setError()) */
+   void start(hal_size_t numThreads, const std::string& halPath,
+              CLParserConstPtr options);
+   void join();
+
+   /** Hand out the items [0, numItems) in order.  False once they're
+    * all taken or there has been an error */
+   bool nextItem(size_t numItems, size_t& item);
+
+   void lock();
+   void unlock();
+   /** Wait for broadcast(), with the lock held */
+   void wait();
+   void broadcast();
+   /** With the lock held */
+   bool hasError() const;
+   /** Keep the message if it's the first error and wake up everyone
+    * waiting.  Takes the lock itself */
+   void setError(const std::string& message);
+
+protected:
+
+   virtual void work(AlignmentConstPtr alignment) = 0;
+
+private:
+
+   ThreadPool(const ThreadPool&);
+   ThreadPool& operator=(const ThreadPool&);
+
+   void runWork(AlignmentConstPtr alignment);
+   static void* threadFunc(void* data);
+
+   std::vector<AlignmentConstPtr> _alignments;
+   std::vector<pthread_t> _threads;
+   size_t _nextThread;
+   size_t _nextItem;
+   bool _error;
+   std::string _errorMessage;
+   pthread_mutex_t _mutex;
+   pthread_cond_t _cond;
+};
+
+}
+
+#endif
@@ -38,6 +38,21 @@ void validateDuplications(const Genome* genome);
  * appears out of whack. */
 void validateAlignment(AlignmentConstPtr alignment);
 
+/** Validate an alignment as above, but with numThreads threads that each
+ * open their own copy of the alignment at halPath (with the given
+ * options).  Genomes are checked concurrently, and the segments and DNA
+ * of large genomes in chunks.  If sampleFraction is less than 1, only
+ * that fraction of the segments and DNA (evenly spread) is checked.  If
+ * progress is true, the number of chunks done is written to stderr.
+ * Unless deep is true, the segments are checked on records read in
+ * batches with Genome::readTopSegments() etc. instead of through
+ * iterators, which is much faster and also checks that segments are
+ * contiguous and that paralogy indexes form cycles. */
+void validateAlignment(AlignmentConstPtr alignment, hal_size_t numThreads,
+                       const std::string& halPath, CLParserConstPtr options,
+                       double sampleFraction = 1., bool progress = false,
+                       bool deep = false);
+
 }
 #endif
 
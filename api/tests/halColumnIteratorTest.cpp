@@ -1008,6 +1008,108 @@ void ColumnIteratorMultiGapInvTest::checkCallBack(AlignmentConstPtr alignment)
   }
 }
 
+void ColumnIteratorInsertionTest::createCallBack(AlignmentPtr alignment)
+{
+  double branchLength = 1e-10;
+
+  alignment->addRootGenome("grandpa");
+  alignment->addLeafGenome("dad", "grandpa", branchLength);
+
+  vector<Sequence::Info> dims(1);
+
+  Genome* grandpa = alignment->openGenome("grandpa");
+  dims[0] = Sequence::Info("gseq", 8, 0, 2);
+  grandpa->setDimensions(dims);
+
+  Genome* dad = alignment->openGenome("dad");
+  dims[0] = Sequence::Info("dseq", 10, 3, 0);
+  dad->setDimensions(dims);
+
+  BottomSegmentIteratorPtr bi;
+  BottomSegmentStruct bs;
+  TopSegmentIteratorPtr ti;
+  TopSegmentStruct ts;
+
+  // seg - --- - seg
+  // seg - INS - seg
+  bi = grandpa->getBottomSegmentIterator(0);
+  bs.set(0, 4);
+  bs.applyTo(bi);
+  bi->getBottomSegment()->setChildIndex(0, 0);
+  bi->getBottomSegment()->setChildReversed(0, false);
+
+  bi = grandpa->getBottomSegmentIterator(1);
+  bs.set(4, 4);
+  bs.applyTo(bi);
+  bi->getBottomSegment()->setChildIndex(0, 2);
+  bi->getBottomSegment()->setChildReversed(0, false);
+
+  ti = dad->getTopSegmentIterator(0);
+  ts.set(0, 4, 0);
+  ts.applyTo(ti);
+
+  ti = dad->getTopSegmentIterator(1);
+  ts.set(4, 2, NULL_INDEX);
+  ts.applyTo(ti);
+
+  ti = dad->getTopSegmentIterator(2);
+  ts.set(6, 4, 1);
+  ts.applyTo(ti);
+
+  grandpa->setString("ACGTGGGG");
+  dad->setString("ACGTCCGGGG");
+}
+
+// the columns of the reference are computed in runs, which mustn't step
+// over the base an insertion is found from
+void ColumnIteratorInsertionTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  validateAlignment(alignment);
+  const Genome* dad = alignment->openGenome("dad");
+  const Sequence* dadSeq = dad->getSequence("dseq");
+  const Genome* grandpa = alignment->openGenome("grandpa");
+  const Sequence* grandpaSeq = grandpa->getSequence("gseq");
+
+  vector<size_t> dadCount(10, 0);
+  vector<size_t> grandpaCount(8, 0);
+  ColumnIteratorConstPtr colIterator = 
+     grandpaSeq->getColumnIterator(NULL, 10);
+  while (true)
+  {
+    const ColumnIterator::ColumnMap* colMap = colIterator->getColumnMap();
+    for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin();
+         i != colMap->end(); ++i)
+    {
+      for (size_t j = 0; j < i->second->size(); ++j)
+      {
+        DNAIteratorConstPtr dna = i->second->at(j);
+        if (dna->getSequence() == dadSeq)
+        {
+          ++dadCount[dna->getArrayIndex()];
+        }
+        else
+        {
+          CuAssertTrue(_testCase, dna->getSequence() == grandpaSeq);
+          ++grandpaCount[dna->getArrayIndex()];
+        }
+      }
+    }
+    if (colIterator->lastColumn() == true)
+    {
+      break;
+    }
+    colIterator->toRight();
+  }
+  for (size_t i = 0; i < dadCount.size(); ++i)
+  {
+    CuAssertTrue(_testCase, dadCount[i] == 1);
+  }
+  for (size_t i = 0; i < grandpaCount.size(); ++i)
+  {
+    CuAssertTrue(_testCase, grandpaCount[i] == 1);
+  }
+}
+
 void ColumnIteratorPositionCacheTest::createCallBack(AlignmentPtr alignment)
 {
 }
@@ -1019,28 +1121,52 @@ void ColumnIteratorPositionCacheTest::checkCallBack(AlignmentConstPtr alignment)
   size_t entries = 10000;
   set<hal_index_t> truth;
   PositionCache cache;
+  PositionCache bitmapCache;
   srand(time(NULL));
 
   for (size_t i = 0; i < trials; ++i)
   {
+    bitmapCache.allowBitmap(sizes[i]);
     for (size_t j = 0; j < entries; ++j)
     {
       hal_index_t val = (hal_index_t)rand() % sizes[i];
       bool r = truth.insert(val).second;
       bool r2 = cache.insert(val);
+      bool r3 = bitmapCache.insert(val);
       CuAssertTrue(_testCase, r == r2);
+      CuAssertTrue(_testCase, r == r3);
       CuAssertTrue(_testCase, truth.size() == cache.size());
+      CuAssertTrue(_testCase, truth.size() == bitmapCache.size());
     }
     CuAssertTrue(_testCase, cache.check());
+    CuAssertTrue(_testCase, bitmapCache.check());
+    CuAssertTrue(_testCase, bitmapCache.getMemoryUsage() <= 
+                 (sizes[i] + 7) / 8);
     for (size_t j = 0; j < entries * 2; ++j)
     {
       hal_index_t val = (hal_index_t)rand() % sizes[i];
       bool r = truth.find(val) != truth.end();
       bool r2 = cache.find(val);
+      bool r3 = bitmapCache.find(val);
       CuAssertTrue(_testCase, r == r2);
+      CuAssertTrue(_testCase, r == r3);
     }
+    // once everything is visited, the bitmap compacts back into 
+    // one interval (unless the bitmap is tiny anyway)
+    for (hal_size_t j = 0; j < sizes[i]; ++j)
+    {
+      bitmapCache.insert(j);
+    }
+    bitmapCache.compact();
+    CuAssertTrue(_testCase, bitmapCache.isBitmap() == false || 
+                 sizes[i] < 1000);
+    CuAssertTrue(_testCase, bitmapCache.isBitmap() == true || 
+                 bitmapCache.numIntervals() == 1);
+    CuAssertTrue(_testCase, bitmapCache.size() == sizes[i]);
+    CuAssertTrue(_testCase, bitmapCache.check());
     truth.clear();
     cache.clear();
+    bitmapCache.clear();
   }
 }
 
@@ -1135,6 +1261,19 @@ void halColumnIteratorMultiGapInvTest(CuTest *testCase)
   } 
 }
 
+void halColumnIteratorInsertionTest(CuTest *testCase)
+{
+  try 
+  {
+    ColumnIteratorInsertionTest tester;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  } 
+}
+
 void halColumnIteratorPositionCacheTest(CuTest *testCase)
 {
   try 
@@ -1158,6 +1297,7 @@ CuSuite* halColumnIteratorTestSuite(void)
   SUITE_ADD_TEST(suite, halColumnIteratorGapTest);
   SUITE_ADD_TEST(suite, halColumnIteratorMultiGapTest);
   SUITE_ADD_TEST(suite, halColumnIteratorMultiGapInvTest);
+  SUITE_ADD_TEST(suite, halColumnIteratorInsertionTest);
   SUITE_ADD_TEST(suite, halColumnIteratorPositionCacheTest);
   return suite;
 }
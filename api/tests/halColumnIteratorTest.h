@@ -57,6 +57,12 @@ struct ColumnIteratorMultiGapInvTest : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
+struct ColumnIteratorInsertionTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
 struct ColumnIteratorPositionCacheTest : public AlignmentTest
 {
    void createCallBack(hal::AlignmentPtr alignment);
@@ -12,6 +12,7 @@
 #include "halAlignment.h"
 #include "halGenome.h"
 #include "halMetaData.h"
+#include "halCommon.h"
 extern "C" {
 #include "commonC.h"
 }
@@ -55,16 +56,106 @@ void MetaDataTest::checkCallBack(hal::AlignmentConstPtr alignment)
   CuAssertTrue(_testCase, meta->getMap().size() == 3);
 }
 
+void MetaDataStatsCacheTest::createCallBack(hal::AlignmentPtr alignment)
+{
+  CuAssertTrue(_testCase, alignment->getStatsCache() == NULL);
+  MetaData* stats = alignment->createStatsCache();
+  stats->set("Version", "1");
+  stats->set("Genome:Root", "0 10 1 0 0");
+  CuAssertTrue(_testCase, alignment->getStatsCache() == stats);
+}
+
+void MetaDataStatsCacheTest::checkCallBack(hal::AlignmentConstPtr alignment)
+{
+  const MetaData* stats = alignment->getStatsCache();
+  CuAssertTrue(_testCase, stats != NULL);
+  CuAssertTrue(_testCase, stats->getMap().size() == 2);
+  CuAssertTrue(_testCase, stats->get("Genome:Root") == "0 10 1 0 0");
+  CuAssertTrue(_testCase, alignment->getMetaData()->getMap().empty());
+
+  // opening the file for writing discards the cache
+  Alignment* writable = const_cast<Alignment*>(alignment.get());
+  writable->close();
+  writable->open(_checkPath, false);
+  CuAssertTrue(_testCase, writable->getStatsCache() == NULL);
+  writable->close();
+  writable->open(_checkPath, true);
+  CuAssertTrue(_testCase, alignment->getStatsCache() == NULL);
+}
+
+void MetaDataChangeLogTest::createCallBack(hal::AlignmentPtr alignment)
+{
+  // creating the file counts as changing anything, until it's logged
+  CuAssertTrue(_testCase, getLastGenomeChange(alignment) == 1);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Other", true) == 1);
+  CuAssertTrue(_testCase, getChangeLogId(alignment).empty() == false);
+  vector<string> sequences;
+  vector<string> bottoms;
+  sequences.push_back("Leaf");
+  bottoms.push_back("Root");
+  logGenomeChanges(alignment, sequences, bottoms);
+  sequences.push_back("Root");
+  logGenomeChanges(alignment, sequences, vector<string>());
+  CuAssertTrue(_testCase, getLastGenomeChange(alignment) == 2);
+}
+
+void MetaDataChangeLogTest::checkCallBack(hal::AlignmentConstPtr alignment)
+{
+  CuAssertTrue(_testCase, getLastGenomeChange(alignment) == 2);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Leaf", false) == 2);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Leaf", true) == 0);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Root", false) == 2);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Root", true) == 1);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Other", true) == 0);
+  CuAssertTrue(_testCase, alignment->getMetaData()->getMap().empty());
+
+  // so does opening it for writing, whoever does it
+  string id = getChangeLogId(alignment);
+  Alignment* writable = const_cast<Alignment*>(alignment.get());
+  writable->close();
+  writable->open(_checkPath, false);
+  writable->close();
+  writable->open(_checkPath, true);
+  CuAssertTrue(_testCase, getChangeLogId(alignment) == id);
+  CuAssertTrue(_testCase, getLastGenomeChange(alignment) == 3);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Leaf", true) == 3);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Root", true) == 3);
+
+  // unless it logs that it changed nothing (halStats --writeCache)
+  writable->close();
+  AlignmentPtr cacheWriter = openHalAlignment(_checkPath, CLParserPtr());
+  logGenomeChanges(cacheWriter, vector<string>(), vector<string>());
+  cacheWriter->close();
+  writable->open(_checkPath, true);
+  CuAssertTrue(_testCase, getLastGenomeChange(alignment) == 4);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Leaf", true) == 3);
+  CuAssertTrue(_testCase, getGenomeChange(alignment, "Other", false) == 3);
+}
+
 void halMetaDataTest(CuTest *testCase)
 {
   MetaDataTest tester;
   tester.check(testCase);
 }
 
+void halMetaDataStatsCacheTest(CuTest *testCase)
+{
+  MetaDataStatsCacheTest tester;
+  tester.check(testCase);
+}
+
+void halMetaDataChangeLogTest(CuTest *testCase)
+{
+  MetaDataChangeLogTest tester;
+  tester.check(testCase);
+}
+
 CuSuite* halMetaDataTestSuite(void) 
 {
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, halMetaDataTest);
+  SUITE_ADD_TEST(suite, halMetaDataStatsCacheTest);
+  SUITE_ADD_TEST(suite, halMetaDataChangeLogTest);
   return suite;
 }
 
@@ -6,6 +6,7 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <deque>
 #include "halAlignmentTest.h"
 #include "halValidateTest.h"
 #include "halRandomData.h"
@@ -52,6 +53,103 @@ void ValidateMediumTest::createCallBack(AlignmentPtr alignment)
 void ValidateMediumTest::checkCallBack(AlignmentConstPtr alignment)
 {
   validateAlignment(alignment);
+  validateAlignment(alignment, 1, _checkPath, CLParserPtr(), 0.1);
+  validateAlignment(alignment, 1, _checkPath, CLParserPtr(), 1., false, 
+                    true);
+  if (alignment->isThreadSafe() == true)
+  {
+    validateAlignment(alignment, 3, _checkPath, CLParserPtr());
+  }
+
+  // the records read in bulk must match those read through iterators
+  deque<string> queue(1, alignment->getRootName());
+  while (queue.empty() == false)
+  {
+    const Genome* genome = alignment->openGenome(queue.front());
+    vector<string> childNames = alignment->getChildNames(queue.front());
+    queue.insert(queue.end(), childNames.begin(), childNames.end());
+    queue.pop_front();
+
+    hal_size_t numTop = genome->getNumTopSegments();
+    vector<TopSegmentRecord> top1, top2;
+    genome->readTopSegments(0, numTop, top1);
+    genome->Genome::readTopSegments(0, numTop, top2);
+    CuAssertTrue(_testCase, top1.size() == numTop);
+    for (hal_size_t i = 0; i < numTop; ++i)
+    {
+      CuAssertTrue(_testCase, 
+                   top1[i]._startPosition == top2[i]._startPosition &&
+                   top1[i]._length == top2[i]._length &&
+                   top1[i]._bottomParseIndex == top2[i]._bottomParseIndex &&
+                   top1[i]._parentIndex == top2[i]._parentIndex &&
+                   top1[i]._nextParalogyIndex == 
+                   top2[i]._nextParalogyIndex &&
+                   top1[i]._parentReversed == top2[i]._parentReversed);
+    }
+
+    hal_size_t numBottom = genome->getNumBottomSegments();
+    hal_index_t start = numBottom / 3;
+    hal_size_t count = numBottom - start;
+    vector<BottomSegmentRecord> bottom1, bottom2;
+    vector<hal_index_t> children1, children2;
+    vector<bool> reversed1, reversed2;
+    genome->readBottomSegments(start, count, bottom1, children1, reversed1);
+    genome->Genome::readBottomSegments(start, count, bottom2, children2,
+                                       reversed2);
+    CuAssertTrue(_testCase, bottom1.size() == count);
+    for (hal_size_t i = 0; i < count; ++i)
+    {
+      CuAssertTrue(_testCase, 
+                   bottom1[i]._startPosition == bottom2[i]._startPosition &&
+                   bottom1[i]._length == bottom2[i]._length &&
+                   bottom1[i]._topParseIndex == bottom2[i]._topParseIndex);
+    }
+    CuAssertTrue(_testCase, children1 == children2);
+    CuAssertTrue(_testCase, reversed1 == reversed2);
+  }
+}
+
+void ValidateBrokenTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment, 
+                        2, 
+                        0.1,
+                        5,
+                        10,
+                        1000,
+                        5,
+                        10,
+                        1104);
+
+  // point a segment at the wrong parent
+  Genome* genome = alignment->openGenome(
+    alignment->getChildNames(alignment->getRootName()).at(0));
+  TopSegmentIteratorPtr topIt = genome->getTopSegmentIterator();
+  while (topIt->getTopSegment()->hasParent() == false)
+  {
+    topIt->toRight();
+  }
+  hal_size_t numParentBottom = genome->getParent()->getNumBottomSegments();
+  topIt->getTopSegment()->setParentIndex(
+    (topIt->getTopSegment()->getParentIndex() + 1) % numParentBottom);
+}
+
+void ValidateBrokenTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  for (int deep = 0; deep < 2; ++deep)
+  {
+    bool caught = false;
+    try
+    {
+      validateAlignment(alignment, 1, _checkPath, CLParserPtr(), 1., false,
+                        deep == 1);
+    }
+    catch (hal_exception& e)
+    {
+      caught = true;
+    }
+    CuAssertTrue(_testCase, caught);
+  }
 }
 
 void ValidateLargeTest::createCallBack(AlignmentPtr alignment)
@@ -108,6 +206,24 @@ void halValidateMediumTest(CuTest *testCase)
   }
 }
 
+void halValidateBrokenTest(CuTest *testCase)
+{
+  try
+  {
+    ValidateBrokenTest tester;
+    tester.check(testCase);
+  }
+  catch (hal_exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
 void halValidateLargeTest(CuTest *testCase)
 {
   try
@@ -131,6 +247,7 @@ CuSuite* halValidateTestSuite(void)
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, halValidateSmallTest);
   SUITE_ADD_TEST(suite, halValidateMediumTest);
+  SUITE_ADD_TEST(suite, halValidateBrokenTest);
 //  SUITE_ADD_TEST(suite, halValidateLargeTest);
   return suite;
 }
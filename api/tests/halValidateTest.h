@@ -24,6 +24,12 @@ struct ValidateMediumTest : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
+struct ValidateBrokenTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
 struct ValidateLargeTest : public AlignmentTest
 {
    void createCallBack(hal::AlignmentPtr alignment);
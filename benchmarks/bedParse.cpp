@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include "halBedScanner.h"
+
+using namespace std;
+using namespace hal;
+
+// time the BedScanner against plain getline / >> parsing of the same
+// columns (which is what BedLine::read used to do).  if no bed file is
+// given, random BED12 lines are generated.
+
+class CountScanner : public BedScanner
+{
+public:
+   CountScanner() : _count(0), _sum(0) {}
+   size_t _count;
+   hal_index_t _sum;
+protected:
+   void visitLine() { ++_count; _sum += _bedLine._end - _bedLine._start; }
+};
+
+static void makeBed(ostream& os, size_t numLines)
+{
+  for (size_t i = 0; i < numLines; ++i)
+  {
+    hal_index_t start = rand() % 100000000;
+    size_t numBlocks = 1 + rand() % 10;
+    os << "chr" << rand() % 20 << '\t' << start << '\t'
+       << start + numBlocks * 100 << "\tname" << i << '\t' << rand() % 1000
+       << '\t' << (rand() % 2 ? '+' : '-') << '\t' << start << '\t'
+       << start + numBlocks * 100 << "\t255,0,0\t" << numBlocks << '\t';
+    for (size_t j = 0; j < numBlocks; ++j)
+    {
+      os << 50 << ',';
+    }
+    os << '\t';
+    for (size_t j = 0; j < numBlocks; ++j)
+    {
+      os << j * 100 << ',';
+    }
+    os << '\n';
+  }
+}
+
+static size_t streamParse(istream& is, hal_index_t& sum)
+{
+  string lineBuffer, chrom, name, strand, rgb, sizes, starts;
+  hal_index_t start, end, score, thickStart, thickEnd, numBlocks;
+  size_t count = 0;
+  while (getline(is, lineBuffer))
+  {
+    stringstream ss(lineBuffer);
+    ss >> chrom >> start >> end >> name >> score >> strand >> thickStart
+       >> thickEnd >> rgb >> numBlocks >> sizes >> starts;
+    vector<string> sizeBuf = chopString(sizes, ",");
+    vector<string> startBuf = chopString(starts, ",");
+    for (size_t i = 0; i < sizeBuf.size(); ++i)
+    {
+      stringstream ss1(sizeBuf[i]);
+      ss1 >> score;
+      stringstream ss2(startBuf[i]);
+      ss2 >> score;
+    }
+    sum += end - start;
+    ++count;
+  }
+  return count;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 2)
+  {
+    cerr << "usage : bedParse [bedFile]" << endl;
+    return 1;
+  }
+
+  string bedText;
+  if (argc == 2)
+  {
+    ifstream bedFile(argv[1]);
+    if (!bedFile)
+    {
+      cerr << "problem reading " << argv[1] << endl;
+      return 1;
+    }
+    stringstream ss;
+    ss << bedFile.rdbuf();
+    bedText = ss.str();
+  }
+  else
+  {
+    stringstream ss;
+    makeBed(ss, 1000000);
+    bedText = ss.str();
+  }
+
+  try
+  {
+    stringstream in1(bedText);
+    hal_index_t sum1 = 0;
+    clock_t t = clock();
+    size_t count1 = streamParse(in1, sum1);
+    double streamTime = double(clock() - t) / CLOCKS_PER_SEC;
+
+    stringstream in2(bedText);
+    CountScanner scanner;
+    t = clock();
+    scanner.scan(&in2, 12);
+    double scanTime = double(clock() - t) / CLOCKS_PER_SEC;
+
+    if (count1 != scanner._count || sum1 != scanner._sum)
+    {
+      cerr << "parsers disagree" << endl;
+      return 1;
+    }
+    cout << count1 << " lines\n"
+         << "istream: " << streamTime << "s\n"
+         << "BedScanner: " << scanTime << "s" << endl;
+  }
+  catch(hal_exception& e)
+  {
+    cerr << "hal exception caught: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
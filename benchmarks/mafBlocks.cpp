@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <ctime>
+#include "hal.h"
+#include "halMafBlock.h"
+
+using namespace std;
+using namespace hal;
+
+// time how fast MafBlock turns columns into (discarded) MAF blocks, on
+// top of the column iteration itself, for a reference genome of an
+// alignment such as those made by halRandGen:
+//   halRandGen --preset big --seed 1 big.hal
+//   mafBlocks big.hal [refGenome]
+
+// count the bytes written without keeping them
+class NullBuf : public streambuf
+{
+public:
+   NullBuf() : _count(0) {}
+   size_t _count;
+protected:
+   int overflow(int c) { ++_count; return c; }
+   streamsize xsputn(const char*, streamsize n) { _count += n; return n; }
+};
+
+static ColumnIteratorConstPtr getColumns(const Genome* genome)
+{
+  return genome->getColumnIterator(NULL, 0, 0, NULL_INDEX, false, false,
+                                   false, true);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc > 3)
+  {
+    cerr << "usage : mafBlocks <halFile> [refGenome]" << endl;
+    return 1;
+  }
+  try
+  {
+    AlignmentConstPtr alignment = openHalAlignmentReadOnly(argv[1], 
+                                                           CLParserPtr());
+    string refName = argc == 3 ? argv[2] : alignment->getRootName();
+    const Genome* genome = alignment->openGenome(refName);
+    if (genome == NULL || genome->getSequenceLength() == 0)
+    {
+      cerr << "reference genome " << refName << " not found or empty"
+           << endl;
+      return 1;
+    }
+
+    // columns alone
+    clock_t t = clock();
+    size_t numColumns = 0;
+    ColumnIteratorConstPtr colIt = getColumns(genome);
+    while (true)
+    {
+      ++numColumns;
+      if (colIt->lastColumn())
+      {
+        break;
+      }
+      colIt->toRight();
+    }
+    double columnTime = double(clock() - t) / CLOCKS_PER_SEC;
+
+    // columns into blocks, as MafExport does
+    NullBuf nullBuf;
+    ostream os(&nullBuf);
+    MafBlock mafBlock;
+    size_t numBlocks = 0;
+    t = clock();
+    colIt = getColumns(genome);
+    mafBlock.initBlock(colIt, true, false);
+    while (true)
+    {
+      if (mafBlock.canAppendColumn(colIt) == false)
+      {
+        os << mafBlock << '\n';
+        ++numBlocks;
+        mafBlock.initBlock(colIt, true, false);
+      }
+      mafBlock.appendColumn(colIt);
+      if (colIt->lastColumn())
+      {
+        break;
+      }
+      colIt->toRight();
+    }
+    os << mafBlock << '\n';
+    ++numBlocks;
+    double blockTime = double(clock() - t) / CLOCKS_PER_SEC;
+    double mafTime = max(blockTime - columnTime, 1e-9);
+
+    cout << "reference " << refName << ": " << numColumns << " columns, "
+         << numBlocks << " blocks, " << nullBuf._count << " bytes of MAF\n"
+         << "columns only:  " << columnTime << "s\n"
+         << "with blocks:   " << blockTime << "s ("
+         << numBlocks / max(blockTime, 1e-9) << " blocks/s)\n"
+         << "MafBlock time: " << mafTime << "s ("
+         << numBlocks / mafTime << " blocks/s)" << endl;
+  }
+  catch(exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -12,7 +12,7 @@ include  ${sonLibRootPath}/include.mk
 dataSetsPath=/Users/hickey/Documents/Devel/genomes/datasets
 
 cflags += -I${sonLibPath} -fPIC
-cppflags += -I${sonLibPath} -fPIC
+cppflags += -I${sonLibPath} -fPIC -pthread
 
 basicLibs = ${sonLibPath}/sonLib.a ${sonLibPath}/cuTest.a
 basicLibsDependencies = ${basicLibs}
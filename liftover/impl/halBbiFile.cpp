@@ -0,0 +1,973 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <zlib.h>
+#include "halBbiFile.h"
+
+using namespace std;
+using namespace hal;
+
+const uint32_t BbiFile::BigWigMagic = 0x888FFC26;
+const uint32_t BbiFile::BigBedMagic = 0x8789F2EB;
+const uint32_t BbiFile::ChromTreeMagic = 0x78CA8C91;
+const uint32_t BbiFile::IndexMagic = 0x2468ACE0;
+const uint16_t BbiFile::Version = 4;
+const uint32_t BbiFile::IndexBlockSize = 256;
+const uint32_t BbiFile::ChromBlockSize = 256;
+const hal_size_t BbiFile::MaxZoomLevels = 10;
+const hal_size_t BbiFile::ZoomIncrement = 4;
+
+static const hal_size_t HeaderSize = 64;
+static const hal_size_t ZoomHeaderSize = 24;
+static const hal_size_t SummarySize = 40;
+static const hal_size_t ChromTreeHeaderSize = 32;
+static const hal_size_t IndexHeaderSize = 48;
+static const hal_size_t NodeHeaderSize = 4;
+static const hal_size_t IndexLeafItemSize = 32;
+static const hal_size_t IndexNodeItemSize = 24;
+static const hal_size_t ZoomRecordSize = 32;
+
+template <class T>
+static inline void append(string& buffer, T val)
+{
+  buffer.append((const char*)&val, sizeof(T));
+}
+
+static inline void appendZeros(string& buffer, hal_size_t count)
+{
+  buffer.append(count, '\0');
+}
+
+static inline bool lessPos(uint32_t chrom1, uint32_t pos1,
+                           uint32_t chrom2, uint32_t pos2)
+{
+  return chrom1 < chrom2 || (chrom1 == chrom2 && pos1 < pos2);
+}
+
+bool BbiFile::hasMagic(istream* stream, uint32_t magic)
+{
+  if (stream == &cin || !stream->good())
+  {
+    return false;
+  }
+  streampos pos = stream->tellg();
+  uint32_t fileMagic = 0;
+  stream->read((char*)&fileMagic, sizeof(fileMagic));
+  bool found = stream->gcount() == sizeof(fileMagic) && fileMagic == magic;
+  stream->clear();
+  stream->seekg(pos);
+  return found;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// WRITER
+//////////////////////////////////////////////////////////////////////////
+
+BbiWriter::BbiWriter(uint32_t magic, hal_size_t itemsPerSlot) :
+  _outStream(NULL),
+  _magic(magic),
+  _itemsPerSlot(itemsPerSlot),
+  _spillFile(NULL)
+{
+  clear();
+}
+
+BbiWriter::~BbiWriter()
+{
+  clear();
+}
+
+void BbiWriter::clear()
+{
+  _chromNames.clear();
+  _chromSizes.clear();
+  _chromIds.clear();
+  _chromBlocks.clear();
+  if (_spillFile != NULL)
+  {
+    fclose(_spillFile);
+    _spillFile = NULL;
+  }
+  _spillEnd = 0;
+  _maxBlockSize = 0;
+  _itemCount = 0;
+  _itemBases = 0;
+  _zooms.clear();
+  _totalBases = 0;
+  _totalMin = numeric_limits<double>::max();
+  _totalMax = -numeric_limits<double>::max();
+  _totalSum = 0;
+  _totalSumSquares = 0;
+}
+
+void BbiWriter::open(ostream* outStream,
+                     const vector<pair<string, hal_size_t> >& chroms)
+{
+  clear();
+  _outStream = outStream;
+  // chromosome ids are given by the order of the names in the B+ tree
+  vector<pair<string, hal_size_t> > sorted(chroms);
+  sort(sorted.begin(), sorted.end());
+  for (size_t i = 0; i < sorted.size(); ++i)
+  {
+    if (sorted[i].second > numeric_limits<uint32_t>::max())
+    {
+      throw hal_exception("Sequence " + sorted[i].first +
+                          " too long for bigWig/bigBed");
+    }
+    if (i > 0 && sorted[i].first == sorted[i-1].first)
+    {
+      throw hal_exception("Duplicate sequence name " + sorted[i].first);
+    }
+    _chromIds[sorted[i].first] = (uint32_t)i;
+    _chromNames.push_back(sorted[i].first);
+    _chromSizes.push_back(sorted[i].second);
+  }
+  _chromBlocks.resize(_chromNames.size());
+  _spillFile = tmpfile();
+  if (_spillFile == NULL)
+  {
+    throw hal_exception("Error creating temporary file");
+  }
+}
+
+void BbiWriter::open(ostream* outStream, const Genome* genome)
+{
+  vector<pair<string, hal_size_t> > chroms;
+  SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEndIt = genome->getSequenceEndIterator();
+  for (; seqIt != seqEndIt; seqIt->toNext())
+  {
+    const Sequence* sequence = seqIt->getSequence();
+    chroms.push_back(pair<string, hal_size_t>(
+                       sequence->getName(), sequence->getSequenceLength()));
+  }
+  open(outStream, chroms);
+}
+
+uint32_t BbiWriter::getChromId(const string& chrom) const
+{
+  map<string, uint32_t>::const_iterator i = _chromIds.find(chrom);
+  if (i == _chromIds.end())
+  {
+    throw hal_exception("Sequence " + chrom + " not found in bigWig/bigBed "
+                        "chromosome list");
+  }
+  return i->second;
+}
+
+string BbiWriter::getAutoSql() const
+{
+  return string();
+}
+
+uint16_t BbiWriter::getFieldCount() const
+{
+  return 0;
+}
+
+uint16_t BbiWriter::getDefinedFieldCount() const
+{
+  return 0;
+}
+
+void BbiWriter::addBlock(uint32_t chromId, uint32_t start, uint32_t end,
+                         const string& data, hal_size_t numItems,
+                         hal_size_t numBases)
+{
+  assert(chromId < _chromBlocks.size());
+  vector<Block>& blocks = _chromBlocks[chromId];
+  if (!blocks.empty() && start < blocks.back()._startBase)
+  {
+    throw hal_exception("bigWig/bigBed items must be sorted by position");
+  }
+  Block block = {chromId, start, chromId, end, 0, 0};
+  spillBlock(block, data);
+  blocks.push_back(block);
+  _itemCount += numItems;
+  _itemBases += numBases;
+}
+
+// compress a block and append it to the temporary file
+void BbiWriter::spillBlock(Block& block, const string& data)
+{
+  uLongf size = compressBound(data.size());
+  vector<Bytef> buffer(size);
+  if (compress(&buffer[0], &size, (const Bytef*)data.data(),
+               data.size()) != Z_OK)
+  {
+    throw hal_exception("Error compressing bigWig/bigBed block");
+  }
+  if (fseeko(_spillFile, _spillEnd, SEEK_SET) != 0 ||
+      fwrite(&buffer[0], 1, size, _spillFile) != size)
+  {
+    throw hal_exception("Error writing temporary file");
+  }
+  block._offset = _spillEnd;
+  block._size = size;
+  _spillEnd += size;
+  _maxBlockSize = max(_maxBlockSize, (uint64_t)data.size());
+}
+
+void BbiWriter::readSpilled(const Block& block, string& data) const
+{
+  data.resize(block._size);
+  if (block._size > 0 &&
+      (fseeko(_spillFile, block._offset, SEEK_SET) != 0 ||
+       fread(&data[0], 1, block._size, _spillFile) != block._size))
+  {
+    throw hal_exception("Error reading temporary file");
+  }
+}
+
+// add an item to the total summary and to every zoom level
+void BbiWriter::summarize(const Item& item)
+{
+  hal_size_t length = item._end - item._start;
+  _totalBases += length;
+  _totalMin = min(_totalMin, item._value);
+  _totalMax = max(_totalMax, item._value);
+  _totalSum += item._value * length;
+  _totalSumSquares += item._value * item._value * length;
+
+  for (size_t i = 0; i < _zooms.size(); ++i)
+  {
+    ZoomLevel& zoom = _zooms[i];
+    // split the item across the zoom level's windows
+    uint32_t start = item._start;
+    while (start < item._end)
+    {
+      uint32_t windowStart = start - start % zoom._reduction;
+      uint32_t end = (uint32_t)min((uint64_t)item._end,
+                                   (uint64_t)windowStart + zoom._reduction);
+      Summary& cur = zoom._current;
+      if (zoom._open == true && (cur._chromId != item._chromId ||
+                                 zoom._window < windowStart))
+      {
+        flushZoom(zoom, true);
+      }
+      float val = (float)item._value;
+      if (zoom._open == false)
+      {
+        zoom._window = windowStart;
+        cur._chromId = item._chromId;
+        cur._start = start;
+        cur._end = end;
+        cur._validCount = 0;
+        cur._minVal = val;
+        cur._maxVal = val;
+        cur._sumData = 0;
+        cur._sumSquares = 0;
+        zoom._open = true;
+      }
+      // overlapping (bigBed) items can reach back into earlier windows,
+      // in which case we just stretch the current record
+      uint32_t length = end - start;
+      cur._start = min(cur._start, start);
+      cur._end = max(cur._end, end);
+      cur._validCount += length;
+      cur._minVal = min(cur._minVal, val);
+      cur._maxVal = max(cur._maxVal, val);
+      cur._sumData += val * length;
+      cur._sumSquares += val * val * length;
+      start = end;
+    }
+  }
+}
+
+// close the current record of a zoom level and, if there are enough
+// (or closeRecord is false, meaning we're done), write them as a block
+void BbiWriter::flushZoom(ZoomLevel& zoom, bool closeRecord)
+{
+  if (zoom._open == true)
+  {
+    zoom._pending.push_back(zoom._current);
+    ++zoom._count;
+    zoom._open = false;
+  }
+  if (!zoom._pending.empty() &&
+      (zoom._pending.size() >= _itemsPerSlot || closeRecord == false))
+  {
+    string data;
+    data.reserve(zoom._pending.size() * ZoomRecordSize);
+    Block block = {zoom._pending[0]._chromId, zoom._pending[0]._start,
+                   zoom._pending[0]._chromId, zoom._pending[0]._end, 0, 0};
+    for (size_t i = 0; i < zoom._pending.size(); ++i)
+    {
+      const Summary& s = zoom._pending[i];
+      append(data, s._chromId);
+      append(data, s._start);
+      append(data, s._end);
+      append(data, s._validCount);
+      append(data, s._minVal);
+      append(data, s._maxVal);
+      append(data, s._sumData);
+      append(data, s._sumSquares);
+      if (lessPos(s._chromId, s._start, block._startChrom, block._startBase))
+      {
+        block._startChrom = s._chromId;
+        block._startBase = s._start;
+      }
+      if (lessPos(block._endChrom, block._endBase, s._chromId, s._end))
+      {
+        block._endChrom = s._chromId;
+        block._endBase = s._end;
+      }
+    }
+    spillBlock(block, data);
+    zoom._blocks.push_back(block);
+    zoom._pending.clear();
+  }
+}
+
+void BbiWriter::close()
+{
+  assert(_outStream != NULL);
+
+  // zoom levels start at 10 times the average item size, and go up by
+  // a factor of 4 (as in the UCSC tools)
+  hal_size_t reduction = 10;
+  if (_itemCount > 0)
+  {
+    reduction = max(reduction, 10 * (_itemBases / _itemCount));
+  }
+  hal_size_t maxChromSize = 0;
+  for (size_t i = 0; i < _chromSizes.size(); ++i)
+  {
+    maxChromSize = max(maxChromSize, _chromSizes[i]);
+  }
+  for (size_t i = 0; i < MaxZoomLevels && reduction < maxChromSize &&
+          reduction <= numeric_limits<uint32_t>::max(); ++i)
+  {
+    ZoomLevel zoom;
+    zoom._reduction = (uint32_t)reduction;
+    zoom._count = 0;
+    zoom._open = false;
+    zoom._window = 0;
+    memset(&zoom._current, 0, sizeof(Summary));
+    _zooms.push_back(zoom);
+    reduction *= ZoomIncrement;
+  }
+
+  // compute the summaries by reading back all the blocks
+  vector<Block> dataBlocks;
+  string compressed;
+  string data;
+  vector<Item> items;
+  for (size_t i = 0; i < _chromBlocks.size(); ++i)
+  {
+    for (size_t j = 0; j < _chromBlocks[i].size(); ++j)
+    {
+      const Block& block = _chromBlocks[i][j];
+      readSpilled(block, compressed);
+      uLongf size = _maxBlockSize;
+      data.resize(size);
+      if (uncompress((Bytef*)&data[0], &size, (const Bytef*)compressed.data(),
+                     compressed.size()) != Z_OK)
+      {
+        throw hal_exception("Error uncompressing bigWig/bigBed block");
+      }
+      data.resize(size);
+      items.clear();
+      decodeBlock(data, items);
+      for (size_t k = 0; k < items.size(); ++k)
+      {
+        summarize(items[k]);
+      }
+      dataBlocks.push_back(block);
+    }
+  }
+
+  // only keep zoom levels that are at least half the size of the
+  // previous level
+  hal_size_t prevCount = _itemCount;
+  size_t numZooms = 0;
+  for (; numZooms < _zooms.size(); ++numZooms)
+  {
+    flushZoom(_zooms[numZooms], false);
+    if (_zooms[numZooms]._count == 0 || 
+        _zooms[numZooms]._count * 2 > prevCount)
+    {
+      break;
+    }
+    prevCount = _zooms[numZooms]._count;
+  }
+  _zooms.resize(numZooms);
+
+  // figure out where everything goes
+  string autoSql = getAutoSql();
+  uint64_t offset = HeaderSize + _zooms.size() * ZoomHeaderSize;
+  uint64_t autoSqlOffset = 0;
+  if (!autoSql.empty())
+  {
+    autoSqlOffset = offset;
+    offset += autoSql.length() + 1;
+  }
+  uint64_t totalSummaryOffset = offset;
+  offset += SummarySize;
+  uint64_t chromTreeOffset = offset;
+  string chromTree;
+  writeChromTree(chromTree, chromTreeOffset);
+  offset += chromTree.length();
+  uint64_t fullDataOffset = offset;
+  offset += sizeof(uint64_t);
+  // (the blocks keep their offsets in the spill file until written)
+  vector<Block> fileBlocks = dataBlocks;
+  for (size_t i = 0; i < fileBlocks.size(); ++i)
+  {
+    fileBlocks[i]._offset = offset;
+    offset += fileBlocks[i]._size;
+  }
+  uint64_t fullIndexOffset = offset;
+  string index;
+  writeIndex(index, fullIndexOffset, fileBlocks, fullIndexOffset);
+  offset += index.length();
+
+  vector<uint64_t> zoomDataOffsets(_zooms.size());
+  vector<uint64_t> zoomIndexOffsets(_zooms.size());
+  vector<string> zoomIndices(_zooms.size());
+  vector<vector<Block> > zoomBlocks(_zooms.size());
+  for (size_t i = 0; i < _zooms.size(); ++i)
+  {
+    zoomDataOffsets[i] = offset;
+    offset += sizeof(uint32_t);
+    zoomBlocks[i] = _zooms[i]._blocks;
+    for (size_t j = 0; j < zoomBlocks[i].size(); ++j)
+    {
+      zoomBlocks[i][j]._offset = offset;
+      offset += zoomBlocks[i][j]._size;
+    }
+    zoomIndexOffsets[i] = offset;
+    writeIndex(zoomIndices[i], offset, zoomBlocks[i], offset);
+    offset += zoomIndices[i].length();
+  }
+
+  // header
+  string buffer;
+  append(buffer, _magic);
+  append(buffer, Version);
+  append(buffer, (uint16_t)_zooms.size());
+  append(buffer, chromTreeOffset);
+  append(buffer, fullDataOffset);
+  append(buffer, fullIndexOffset);
+  append(buffer, getFieldCount());
+  append(buffer, getDefinedFieldCount());
+  append(buffer, autoSqlOffset);
+  append(buffer, totalSummaryOffset);
+  append(buffer, (uint32_t)_maxBlockSize);
+  append(buffer, (uint64_t)0);
+  assert(buffer.length() == HeaderSize);
+  for (size_t i = 0; i < _zooms.size(); ++i)
+  {
+    append(buffer, _zooms[i]._reduction);
+    append(buffer, (uint32_t)0);
+    append(buffer, zoomDataOffsets[i]);
+    append(buffer, zoomIndexOffsets[i]);
+  }
+  if (!autoSql.empty())
+  {
+    buffer.append(autoSql.c_str(), autoSql.length() + 1);
+  }
+  append(buffer, (uint64_t)_totalBases);
+  append(buffer, _totalBases > 0 ? _totalMin : 0.);
+  append(buffer, _totalBases > 0 ? _totalMax : 0.);
+  append(buffer, _totalSum);
+  append(buffer, _totalSumSquares);
+  buffer.append(chromTree);
+  // bigWig counts the blocks and bigBed the items
+  append(buffer, (uint64_t)(_magic == BigBedMagic ? _itemCount :
+                            dataBlocks.size()));
+  _outStream->write(buffer.data(), buffer.length());
+
+  writeSpilled(dataBlocks);
+  _outStream->write(index.data(), index.length());
+  for (size_t i = 0; i < _zooms.size(); ++i)
+  {
+    buffer.clear();
+    append(buffer, (uint32_t)_zooms[i]._count);
+    _outStream->write(buffer.data(), buffer.length());
+    writeSpilled(_zooms[i]._blocks);
+    _outStream->write(zoomIndices[i].data(), zoomIndices[i].length());
+  }
+  buffer.clear();
+  append(buffer, _magic);
+  _outStream->write(buffer.data(), buffer.length());
+  _outStream->flush();
+  if (!*_outStream)
+  {
+    throw hal_exception("Error writing bigWig/bigBed file");
+  }
+  clear();
+  _outStream = NULL;
+}
+
+void BbiWriter::writeSpilled(const vector<Block>& blocks)
+{
+  string data;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    readSpilled(blocks[i], data);
+    _outStream->write(data.data(), data.length());
+  }
+}
+
+// B+ tree with all the chromosome names, laid out as in the UCSC tools:
+// every node is padded to the full block size, and the levels are written
+// from the root down.
+void BbiWriter::writeChromTree(string& buffer, uint64_t treeOffset) const
+{
+  // keys are sorted by name (the ids needn't follow the same order)
+  vector<string> names;
+  for (map<string, uint32_t>::const_iterator i = _chromIds.begin();
+       i != _chromIds.end(); ++i)
+  {
+    names.push_back(i->first);
+  }
+  hal_size_t itemCount = names.size();
+  uint32_t blockSize = (uint32_t)max((hal_size_t)1,
+                                     min((hal_size_t)ChromBlockSize,
+                                         itemCount));
+  uint32_t keySize = 1;
+  for (size_t i = 0; i < _chromNames.size(); ++i)
+  {
+    keySize = max(keySize, (uint32_t)_chromNames[i].length());
+  }
+  uint32_t valSize = 2 * sizeof(uint32_t);
+  append(buffer, ChromTreeMagic);
+  append(buffer, blockSize);
+  append(buffer, keySize);
+  append(buffer, valSize);
+  append(buffer, (uint64_t)itemCount);
+  append(buffer, (uint64_t)0);
+
+  hal_size_t levels = 1;
+  for (hal_size_t count = itemCount; count > blockSize; ++levels)
+  {
+    count = (count + blockSize - 1) / blockSize;
+  }
+  hal_size_t nodeSize = NodeHeaderSize + blockSize * (keySize + valSize);
+  assert(valSize == sizeof(uint64_t));
+
+  // non-leaf levels: a node at level i covers blockSize^(i+1) items
+  uint64_t offset = treeOffset + ChromTreeHeaderSize;
+  for (hal_size_t level = levels - 1; level > 0; --level)
+  {
+    hal_size_t slotSize = 1;
+    for (hal_size_t i = 0; i < level; ++i)
+    {
+      slotSize *= blockSize;
+    }
+    hal_size_t nodeItems = slotSize * blockSize;
+    hal_size_t nodeCount = (itemCount + nodeItems - 1) / nodeItems;
+    uint64_t nextChild = offset + nodeCount * nodeSize;
+    for (hal_size_t i = 0; i < itemCount; i += nodeItems)
+    {
+      hal_size_t endIdx = min(itemCount, i + nodeItems);
+      uint16_t count = (uint16_t)((endIdx - i + slotSize - 1) / slotSize);
+      append(buffer, (uint8_t)0);
+      append(buffer, (uint8_t)0);
+      append(buffer, count);
+      for (hal_size_t j = i; j < endIdx; j += slotSize)
+      {
+        const string& name = names[j];
+        buffer.append(name);
+        appendZeros(buffer, keySize - name.length());
+        append(buffer, nextChild);
+        nextChild += nodeSize;
+      }
+      appendZeros(buffer, (blockSize - count) * (keySize + sizeof(uint64_t)));
+    }
+    offset += nodeCount * nodeSize;
+  }
+
+  // leaves
+  hal_size_t i = 0;
+  do
+  {
+    uint16_t count = (uint16_t)min((hal_size_t)blockSize, itemCount - i);
+    append(buffer, (uint8_t)1);
+    append(buffer, (uint8_t)0);
+    append(buffer, count);
+    for (hal_size_t j = i; j < i + count; ++j)
+    {
+      const string& name = names[j];
+      uint32_t chromId = _chromIds.find(name)->second;
+      buffer.append(name);
+      appendZeros(buffer, keySize - name.length());
+      append(buffer, chromId);
+      append(buffer, (uint32_t)_chromSizes[chromId]);
+    }
+    appendZeros(buffer, (blockSize - count) * (keySize + valSize));
+    i += count;
+  }
+  while (i < itemCount);
+}
+
+// R tree over the blocks (which must be sorted), one block per leaf item.
+// As with the B+ tree, nodes are padded and written from the root down.
+void BbiWriter::writeIndex(string& buffer, uint64_t indexOffset,
+                           const vector<Block>& blocks,
+                           uint64_t dataEnd) const
+{
+  uint32_t blockSize = IndexBlockSize;
+  // levels[0] are the bounds of the leaves, levels[1] their parents etc.
+  vector<vector<Block> > levels;
+  const vector<Block>* children = &blocks;
+  do
+  {
+    vector<Block> level;
+    for (size_t i = 0; i < children->size() || i == 0; i += blockSize)
+    {
+      Block bounds = {0, 0, 0, 0, 0, 0};
+      size_t endIdx = min(children->size(), i + blockSize);
+      for (size_t j = i; j < endIdx; ++j)
+      {
+        const Block& child = children->at(j);
+        if (j == i || lessPos(child._startChrom, child._startBase,
+                              bounds._startChrom, bounds._startBase))
+        {
+          bounds._startChrom = child._startChrom;
+          bounds._startBase = child._startBase;
+        }
+        if (j == i || lessPos(bounds._endChrom, bounds._endBase,
+                              child._endChrom, child._endBase))
+        {
+          bounds._endChrom = child._endChrom;
+          bounds._endBase = child._endBase;
+        }
+      }
+      level.push_back(bounds);
+    }
+    levels.push_back(level);
+    children = &levels.back();
+  }
+  while (children->size() > 1);
+
+  const Block& root = levels.back()[0];
+  append(buffer, IndexMagic);
+  append(buffer, blockSize);
+  append(buffer, (uint64_t)blocks.size());
+  append(buffer, root._startChrom);
+  append(buffer, root._startBase);
+  append(buffer, root._endChrom);
+  append(buffer, root._endBase);
+  append(buffer, dataEnd);
+  append(buffer, (uint32_t)1);
+  append(buffer, (uint32_t)0);
+
+  hal_size_t leafSize = NodeHeaderSize + blockSize * IndexLeafItemSize;
+  hal_size_t nodeSize = NodeHeaderSize + blockSize * IndexNodeItemSize;
+  vector<uint64_t> levelOffsets(levels.size());
+  uint64_t offset = indexOffset + IndexHeaderSize;
+  for (size_t i = levels.size(); i > 0; --i)
+  {
+    levelOffsets[i - 1] = offset;
+    offset += levels[i - 1].size() * (i == 1 ? leafSize : nodeSize);
+  }
+
+  for (size_t i = levels.size() - 1; i > 0; --i)
+  {
+    const vector<Block>& level = levels[i - 1];
+    hal_size_t childSize = i == 1 ? leafSize : nodeSize;
+    for (size_t j = 0; j < level.size(); j += blockSize)
+    {
+      uint16_t count = (uint16_t)min((size_t)blockSize, level.size() - j);
+      append(buffer, (uint8_t)0);
+      append(buffer, (uint8_t)0);
+      append(buffer, count);
+      for (size_t k = j; k < j + count; ++k)
+      {
+        append(buffer, level[k]._startChrom);
+        append(buffer, level[k]._startBase);
+        append(buffer, level[k]._endChrom);
+        append(buffer, level[k]._endBase);
+        append(buffer, (uint64_t)(levelOffsets[i - 1] + k * childSize));
+      }
+      appendZeros(buffer, (blockSize - count) * IndexNodeItemSize);
+    }
+  }
+
+  for (size_t i = 0; i < blocks.size() || i == 0; i += blockSize)
+  {
+    uint16_t count = (uint16_t)min((size_t)blockSize, blocks.size() - i);
+    append(buffer, (uint8_t)1);
+    append(buffer, (uint8_t)0);
+    append(buffer, count);
+    for (size_t k = i; k < i + count; ++k)
+    {
+      append(buffer, blocks[k]._startChrom);
+      append(buffer, blocks[k]._startBase);
+      append(buffer, blocks[k]._endChrom);
+      append(buffer, blocks[k]._endBase);
+      append(buffer, blocks[k]._offset);
+      append(buffer, blocks[k]._size);
+    }
+    appendZeros(buffer, (blockSize - count) * IndexLeafItemSize);
+  }
+  assert(indexOffset + buffer.length() == offset);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// READER
+//////////////////////////////////////////////////////////////////////////
+
+BbiReader::BbiReader(uint32_t magic) : _inStream(NULL), _inFile(NULL),
+                                       _magic(magic)
+{
+
+}
+
+BbiReader::~BbiReader()
+{
+  close();
+}
+
+void BbiReader::close()
+{
+  delete _inFile;
+  _inFile = NULL;
+  _inStream = NULL;
+  _chromNames.clear();
+  _chromSizes.clear();
+  _chromIds.clear();
+}
+
+void BbiReader::open(const string& path)
+{
+  close();
+  ifstream* inFile = new ifstream(path.c_str(), ios::in | ios::binary);
+  try
+  {
+    if (!*inFile)
+    {
+      throw hal_exception("Error opening " + path);
+    }
+    open(inFile);
+  }
+  catch(...)
+  {
+    delete inFile;
+    throw;
+  }
+  _inFile = inFile;
+}
+
+void BbiReader::open(istream* inStream)
+{
+  close();
+  _inStream = inStream;
+  _inStream->clear();
+  _inStream->seekg(0);
+  uint32_t magic = read<uint32_t>();
+  if (magic != _magic)
+  {
+    throw hal_exception("Input is not a bigWig/bigBed file of the expected "
+                        "type (or has a different byte order)");
+  }
+  uint16_t version = read<uint16_t>();
+  if (version < 3)
+  {
+    throw hal_exception("Unsupported bigWig/bigBed version");
+  }
+  read<uint16_t>();
+  uint64_t chromTreeOffset = read<uint64_t>();
+  read<uint64_t>();
+  _fullIndexOffset = read<uint64_t>();
+  _fieldCount = read<uint16_t>();
+  _definedFieldCount = read<uint16_t>();
+  read<uint64_t>();
+  read<uint64_t>();
+  _uncompressBufSize = read<uint32_t>();
+
+  _inStream->seekg(chromTreeOffset);
+  if (read<uint32_t>() != ChromTreeMagic)
+  {
+    throw hal_exception("Corrupt bigWig/bigBed chromosome tree");
+  }
+  read<uint32_t>();
+  uint32_t keySize = read<uint32_t>();
+  if (read<uint32_t>() != 2 * sizeof(uint32_t))
+  {
+    throw hal_exception("Unsupported bigWig/bigBed chromosome tree");
+  }
+  uint64_t itemCount = read<uint64_t>();
+  _chromNames.resize(itemCount);
+  _chromSizes.resize(itemCount);
+  readChromTree(chromTreeOffset + ChromTreeHeaderSize, keySize);
+}
+
+void BbiReader::readChromTree(uint64_t offset, uint32_t keySize)
+{
+  _inStream->seekg(offset);
+  uint8_t isLeaf = read<uint8_t>();
+  read<uint8_t>();
+  uint16_t count = read<uint16_t>();
+  vector<char> key(keySize + 1, '\0');
+  vector<uint64_t> children;
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    readBytes(&key[0], keySize);
+    if (isLeaf)
+    {
+      uint32_t chromId = read<uint32_t>();
+      uint32_t chromSize = read<uint32_t>();
+      if (chromId >= _chromNames.size())
+      {
+        throw hal_exception("Corrupt bigWig/bigBed chromosome tree");
+      }
+      _chromNames[chromId] = string(&key[0]);
+      _chromSizes[chromId] = chromSize;
+      _chromIds[_chromNames[chromId]] = chromId;
+    }
+    else
+    {
+      children.push_back(read<uint64_t>());
+    }
+  }
+  for (size_t i = 0; i < children.size(); ++i)
+  {
+    readChromTree(children[i], keySize);
+  }
+}
+
+hal_size_t BbiReader::getNumChroms() const
+{
+  return _chromNames.size();
+}
+
+const string& BbiReader::getChromName(hal_size_t chromId) const
+{
+  assert(chromId < _chromNames.size());
+  return _chromNames[chromId];
+}
+
+hal_size_t BbiReader::getChromSize(hal_size_t chromId) const
+{
+  assert(chromId < _chromSizes.size());
+  return _chromSizes[chromId];
+}
+
+bool BbiReader::getChromId(const string& chrom, hal_size_t& chromId) const
+{
+  map<string, hal_size_t>::const_iterator i = _chromIds.find(chrom);
+  if (i == _chromIds.end())
+  {
+    return false;
+  }
+  chromId = i->second;
+  return true;
+}
+
+uint16_t BbiReader::getFieldCount() const
+{
+  return _fieldCount;
+}
+
+uint16_t BbiReader::getDefinedFieldCount() const
+{
+  return _definedFieldCount;
+}
+
+void BbiReader::getBlocks(hal_size_t chromId, hal_size_t start,
+                          hal_size_t end, vector<string>& blocks)
+{
+  blocks.clear();
+  vector<Block> found;
+  _inStream->seekg(_fullIndexOffset);
+  if (read<uint32_t>() != IndexMagic)
+  {
+    throw hal_exception("Corrupt bigWig/bigBed index");
+  }
+  findBlocks(_fullIndexOffset + IndexHeaderSize, (uint32_t)chromId,
+             (uint32_t)start, (uint32_t)min(end, (hal_size_t)
+                                            numeric_limits<uint32_t>::max()),
+             found);
+
+  string compressed;
+  for (size_t i = 0; i < found.size(); ++i)
+  {
+    compressed.resize(found[i]._size);
+    _inStream->seekg(found[i]._offset);
+    readBytes(&compressed[0], compressed.size());
+    if (_uncompressBufSize == 0)
+    {
+      blocks.push_back(compressed);
+    }
+    else
+    {
+      blocks.push_back(string());
+      string& data = blocks.back();
+      uLongf size = _uncompressBufSize;
+      data.resize(size);
+      if (uncompress((Bytef*)&data[0], &size,
+                     (const Bytef*)compressed.data(),
+                     compressed.size()) != Z_OK)
+      {
+        throw hal_exception("Error uncompressing bigWig/bigBed block");
+      }
+      data.resize(size);
+    }
+  }
+}
+
+void BbiReader::findBlocks(uint64_t offset, uint32_t chromId, uint32_t start,
+                           uint32_t end, vector<Block>& blocks)
+{
+  _inStream->seekg(offset);
+  uint8_t isLeaf = read<uint8_t>();
+  read<uint8_t>();
+  uint16_t count = read<uint16_t>();
+  vector<uint64_t> children;
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    Block block;
+    block._startChrom = read<uint32_t>();
+    block._startBase = read<uint32_t>();
+    block._endChrom = read<uint32_t>();
+    block._endBase = read<uint32_t>();
+    block._offset = read<uint64_t>();
+    if (isLeaf)
+    {
+      block._size = read<uint64_t>();
+    }
+    bool overlaps =
+       lessPos(chromId, start, block._endChrom, block._endBase) &&
+       lessPos(block._startChrom, block._startBase, chromId, end);
+    if (overlaps && isLeaf)
+    {
+      blocks.push_back(block);
+    }
+    else if (overlaps)
+    {
+      children.push_back(block._offset);
+    }
+  }
+  for (size_t i = 0; i < children.size(); ++i)
+  {
+    findBlocks(children[i], chromId, start, end, blocks);
+  }
+}
+
+template <class T>
+T BbiReader::read()
+{
+  T val;
+  readBytes((char*)&val, sizeof(T));
+  return val;
+}
+
+void BbiReader::readBytes(char* buffer, size_t size)
+{
+  _inStream->read(buffer, size);
+  if ((size_t)_inStream->gcount() != size)
+  {
+    throw hal_exception("Error reading bigWig/bigBed file (truncated?)");
+  }
+}
@@ -8,6 +8,7 @@
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
 
 #include "halBedLine.h"
 
@@ -27,175 +28,210 @@ BedLine::~BedLine()
 
 istream& BedLine::read(istream& is, int version, string& lineBuffer)
 {
-  _version = version;
   std::getline(is, lineBuffer);
-  stringstream ss(lineBuffer);
-  ss.imbue(is.getloc());
-  ss >> _chrName;
-  if (ss.bad() || ss.fail()) 
+  lineBuffer.push_back('\0');
+  BedTokenizer tokenizer;
+  tokenizer.setSeparators(is.getloc());
+  tokenizer.tokenize(&lineBuffer[0], lineBuffer.length() - 1);
+  read(tokenizer, version);
+  return is;
+}
+
+// same checks (and messages) as we used to get from >>, but the numbers
+// have to take up their whole field
+void BedLine::read(const BedTokenizer& tokens, int version)
+{
+  _version = version;
+  size_t numFields = tokens.getNumFields();
+  size_t field = 0;
+  if (field >= numFields)
   {
     throw hal_exception("Error scanning BED chrom");
   }
-  ss >> _start;
-  if (ss.bad() || ss.fail()) 
+  _chrName.assign(tokens.getField(field), tokens.getFieldLength(field));
+  ++field;
+  if (field >= numFields || !readInt(tokens, field, _start))
   {
     throw hal_exception("Error scanning BED chromStart");
   }
-  ss >> _end;
-  if (ss.bad() || ss.fail())
+  ++field;
+  if (field >= numFields || !readInt(tokens, field, _end))
   {
     throw hal_exception("Error scanning BED chromEnd");
   }
+  ++field;
   if (_version > 3)
   {
-    ss >> _name;
-    if (ss.bad() || ss.fail())
+    if (field >= numFields)
     {
       throw hal_exception("Error scanning BED name");
     }
+    _name.assign(tokens.getField(field), tokens.getFieldLength(field));
+    ++field;
   }
   if (_version > 4)
   {
-    ss >> _score;
-    if (ss.bad() || ss.fail())
+    if (field >= numFields || !readInt(tokens, field, _score))
     {
       throw hal_exception("Error scanning BED score");
     }
+    ++field;
   }
   if (_version > 5)
   {
-    ss >> _strand;
-    if (ss.bad() || ss.fail())
+    if (field >= numFields)
     {
       throw hal_exception("Error scanning BED strand");
     }
-    if (_strand != '.' && _strand != '+' && _strand != '-')
+    _strand = tokens.getField(field)[0];
+    if (tokens.getFieldLength(field) != 1 ||
+        (_strand != '.' && _strand != '+' && _strand != '-'))
     {
       throw hal_exception("Strand character must be + or - or .");
     }
+    ++field;
   }
   if (_version > 6)
   {
-    ss >> _thickStart;
-    if (ss.bad() || ss.fail())
+    if (field >= numFields || !readInt(tokens, field, _thickStart))
     {
       throw hal_exception("Error scanning BED thickStart");
     }
+    ++field;
   }
   if (_version > 7)
   {
-    ss >> _thickEnd;
-    if (ss.bad() || ss.fail()) 
+    if (field >= numFields || !readInt(tokens, field, _thickEnd))
     {
       throw hal_exception("Error scanning BED thickEnd");
     }
+    ++field;
   }
   if (_version > 8)
   {
-    string rgb;
-    ss >> rgb;    
-    if (ss.bad() || ss.fail())
+    if (field >= numFields)
     {
       throw hal_exception("Error scanning BED itemRGB");
     }
-    vector<string> rgbTokens = chopString(rgb, ",");
-    if (rgbTokens.size() > 3 || rgbTokens.size() == 0)
+    hal_index_t rgb[3];
+    size_t numRgb = readList(tokens.getField(field),
+                             tokens.getFieldLength(field), rgb, 3);
+    if (numRgb == 0)
     {
       throw hal_exception("Error parsing BED itemRGB");
     }
-    stringstream rgbssr(rgbTokens[0]);
-    rgbssr >> _itemR;
-    if (rgbssr.bad())
-    {
-      throw hal_exception("Error parsing BED itemRGB");
-    }
-    _itemG = _itemR;
-    _itemB = _itemR;
-    if (rgbTokens.size() > 1)
-    {
-      stringstream rgbssg(rgbTokens[1]);
-      rgbssg >> _itemG;
-      if (rgbssg.bad())
-      {
-        throw hal_exception("Error parsing BED itemRGB");
-      }
-    }
-    if (rgbTokens.size() == 3)
-    {
-      stringstream rgbssb(rgbTokens[2]);
-      rgbssb >> _itemB;
-      if (rgbssb.bad())
-      {
-        throw hal_exception("Error parsing BED itemRGB");
-      }    
-    }
+    _itemR = rgb[0];
+    _itemG = numRgb > 1 ? rgb[1] : _itemR;
+    _itemB = numRgb > 2 ? rgb[2] : _itemR;
+    ++field;
   }
+  _blocks.clear();
   if (_version > 9)
   {
-    size_t numBlocks;
-    ss >> numBlocks;
-    if (ss.bad() || ss.fail()) 
+    hal_index_t numBlocks;
+    if (field >= numFields || !readInt(tokens, field, numBlocks) ||
+        numBlocks < 0)
     {
       throw hal_exception("Error scanning BED blockCount");
     }
+    ++field;
     if (numBlocks > 0)
     {
-      string blockSizes;
-      ss >> blockSizes;
-      if (ss.bad() || ss.fail())
+      if (field + 1 >= numFields)
       {
-        throw hal_exception("Error scanning BED blockSizes");
-      }
-      string blockStarts;
-      ss >> blockStarts;
-      if (ss.bad() || ss.fail())
-      {
-        throw hal_exception("Error scanning BED blockStarts");
+        throw hal_exception(field >= numFields ? 
+                            "Error scanning BED blockSizes" :
+                            "Error scanning BED blockStarts");
       }
       _blocks.resize(numBlocks);
-      vector<string> sizeBuf = chopString(blockSizes, ",");
-      if (sizeBuf.size() != numBlocks)
+      if (readBlockList(tokens, field, false) == false)
       {
         throw hal_exception("Error scanning BED blockSizes");
       }
-      vector<string> startBuf = chopString(blockStarts, ",");
-      if (startBuf.size() != numBlocks)
+      ++field;
+      if (readBlockList(tokens, field, true) == false)
       {
         throw hal_exception("Error scanning BED blockStarts");
       }
-      for (size_t i = 0; i < numBlocks; ++i)
+      for (hal_index_t i = 0; i < numBlocks; ++i)
       {
         BedBlock& block = _blocks[i];
-        stringstream ss1(sizeBuf[i]);
-        ss1 >> block._length;
-        if (ss1.bad())
-        {
-          throw hal_exception("Error scanning BED blockSizes");
-        }
-        stringstream ss2(startBuf[i]);
-        ss2 >> block._start;
-        if (ss2.bad())
-        {
-          throw hal_exception("Error scanning BED blockStarts");
-        }
         if (_start + block._start + block._length > _end)
         {
           throw hal_exception("Error BED block out of range");
         }
       }
+      ++field;
     }
   }
-  _extra.clear();
-  while (ss.good())
+  _extra.resize(numFields - min(field, numFields));
+  for (size_t i = 0; field < numFields; ++field, ++i)
+  {
+    _extra[i].assign(tokens.getField(field), tokens.getFieldLength(field));
+  }
+}
+
+bool BedLine::readInt(const BedTokenizer& tokens, size_t field,
+                      hal_index_t& val)
+{
+  return BedTokenizer::parseInt(tokens.getField(field),
+                                tokens.getFieldLength(field), val);
+}
+
+// parse a comma-separated list of integers (with an optional trailing
+// comma, as written by the UCSC tools).  returns the number of values
+// read, which is 0 on error or if there are more than maxVals
+size_t BedLine::readList(const char* field, size_t length, hal_index_t* vals,
+                         size_t maxVals)
+{
+  const char* last = field + length;
+  size_t numVals = 0;
+  while (field < last)
   {
-    string extraBuf;
-    ss >> extraBuf;
-    if (extraBuf.length() > 0)
+    const char* comma = (const char*)memchr(field, ',', last - field);
+    if (comma == NULL)
     {
-      _extra.push_back(extraBuf);
+      comma = last;
     }
+    if (numVals == maxVals ||
+        !BedTokenizer::parseInt(field, comma - field, vals[numVals]))
+    {
+      return 0;
+    }
+    ++numVals;
+    field = comma + 1;
   }
-  return is;
+  return numVals;
+}
+
+// same as above, but straight into the (already sized) block list
+bool BedLine::readBlockList(const BedTokenizer& tokens, size_t field,
+                            bool starts)
+{
+  const char* pos = tokens.getField(field);
+  const char* last = pos + tokens.getFieldLength(field);
+  size_t numVals = 0;
+  while (pos < last)
+  {
+    const char* comma = (const char*)memchr(pos, ',', last - pos);
+    if (comma == NULL)
+    {
+      comma = last;
+    }
+    if (numVals == _blocks.size())
+    {
+      return false;
+    }
+    BedBlock& block = _blocks[numVals];
+    if (!BedTokenizer::parseInt(pos, comma - pos,
+                                starts ? block._start : block._length))
+    {
+      return false;
+    }
+    ++numVals;
+    pos = comma + 1;
+  }
+  return numVals == _blocks.size();
 }
 
 ostream& BedLine::write(ostream& os, int version)
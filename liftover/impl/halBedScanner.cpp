@@ -11,10 +11,13 @@
 #include <cctype>
 
 #include "halBedScanner.h"
+#include "halTabFacet.h"
 
 using namespace std;
 using namespace hal;
 
+const hal_size_t BedScanner::BigBedWindow = 1000000;
+
 BedScanner::BedScanner() : _bedStream(NULL)
 {
 
@@ -70,17 +73,15 @@ void BedScanner::scan(istream* is, int bedVersion, const locale* inLocale)
   {
     throw hal_exception("Error reading bed input stream");
   }
-  string lineBuffer;
   _lineNumber = 0;
   try
   {
-    skipWhiteSpaces(_bedStream, inLocale);
-    while (_bedStream->good())
+    _tokenizer.open(_bedStream);
+    while (_tokenizer.nextLine())
     {
       ++_lineNumber;
-      _bedLine.read(*_bedStream, _bedVersion, lineBuffer);
+      _bedLine.read(_tokenizer, _bedVersion);
       visitLine();
-      skipWhiteSpaces(_bedStream, inLocale);
     }
   }
   catch(hal_exception e)
@@ -93,6 +94,62 @@ void BedScanner::scan(istream* is, int bedVersion, const locale* inLocale)
   _bedStream = NULL;
 }
 
+// the entries are turned back into (tab-separated) text lines so that
+// they are parsed exactly like BED input
+void BedScanner::scanBigBed(BigBedReader& reader, int bedVersion)
+{
+  visitBegin();
+  _bedStream = NULL;
+  _bedVersion = bedVersion;
+  if (_bedVersion <= 0)
+  {
+    _bedVersion = reader.getDefinedFieldCount();
+  }
+  _tokenizer.setSeparators(locale(locale(), new TabSepFacet(locale())));
+  _lineNumber = 0;
+  vector<BigBedReader::Entry> entries;
+  stringstream line;
+  string lineBuffer;
+  try
+  {
+    for (hal_size_t chromId = 0; chromId < reader.getNumChroms(); ++chromId)
+    {
+      const string& chrom = reader.getChromName(chromId);
+      hal_size_t chromSize = reader.getChromSize(chromId);
+      for (hal_size_t start = 0; start < chromSize; start += BigBedWindow)
+      {
+        hal_size_t end = min(start + BigBedWindow, chromSize);
+        reader.getEntries(chromId, start, end, entries);
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+          // already scanned in the previous window
+          if (entries[i]._start < start)
+          {
+            continue;
+          }
+          line.str(string());
+          line << chrom << '\t' << entries[i]._start << '\t'
+               << entries[i]._end << '\t' << entries[i]._rest << '\0';
+          lineBuffer = line.str();
+          ++_lineNumber;
+          _tokenizer.tokenize(&lineBuffer[0], lineBuffer.length() - 1);
+          _bedLine.read(_tokenizer, _bedVersion);
+          visitLine();
+        }
+      }
+    }
+  }
+  catch(hal_exception e)
+  {
+    stringstream ss;
+    ss << e.what() << " -- input bigBed entry " << _lineNumber;
+    throw hal_exception(ss.str());
+  }
+  visitEOF();
+}
+
+// the first line is only split up once, and then parsed for each
+// version from 12 down until it works
 int BedScanner::getBedVersion(istream* bedStream, const locale* inLocale)
 {
   assert(bedStream != &cin);
@@ -106,18 +163,24 @@ int BedScanner::getBedVersion(istream* bedStream, const locale* inLocale)
   }
 
   string lineBuffer;
+  streampos pos = bedStream->tellg();
+  skipWhiteSpaces(bedStream, inLocale);
+  std::getline(*bedStream, lineBuffer);
+  bedStream->clear();
+  bedStream->seekg(pos);
+  assert(!bedStream->bad());
+
+  lineBuffer.push_back('\0');
+  BedTokenizer tokenizer;
+  tokenizer.setSeparators(bedStream->getloc());
+  tokenizer.tokenize(&lineBuffer[0], lineBuffer.length() - 1);
   BedLine bedLine;
   int version = 12;
-  streampos pos = bedStream->tellg();
   for (; version > 3; --version)
   {
     try
     {
-      bedStream->clear();
-      bedStream->seekg(pos);
-      skipWhiteSpaces(bedStream, inLocale);
-      *bedStream >> std::skipws;
-      bedLine.read(*bedStream, version, lineBuffer);
+      bedLine.read(tokenizer, version);
       break;
     }
     catch(...)
@@ -128,33 +191,23 @@ int BedScanner::getBedVersion(istream* bedStream, const locale* inLocale)
       }
     }
   }
-  bedStream->clear();
-  bedStream->seekg(pos);
-  assert(!bedStream->bad());
   return version;
 }
 
 size_t BedScanner::getNumColumns(const string& bedLine,
                                  const locale* inLocale)
 {
-  stringstream ss(bedLine);
+  string lineBuffer(bedLine);
+  lineBuffer.push_back('\0');
+  BedTokenizer tokenizer;
   if (inLocale != NULL)
   {
-    ss.imbue(*inLocale);
+    tokenizer.setSeparators(*inLocale);
   }
-  size_t c = 0;
-  string buffer;
-  while (ss.good())
-  {
-    buffer.clear();
-    ss >> buffer;
-    if (!buffer.empty())
-    {
-      ++c;
-    }
-  }
-  return c;
+  tokenizer.tokenize(&lineBuffer[0], lineBuffer.length() - 1);
+  return tokenizer.getNumFields();
 }
+
 void BedScanner::visitBegin()
 {
 }
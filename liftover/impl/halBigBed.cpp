@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+#include "halBigBed.h"
+
+using namespace std;
+using namespace hal;
+
+const hal_size_t BigBedWriter::ItemsPerSlot = 512;
+
+static const char* BedAutoSqlFields[] = {
+  "string chrom;       \"Reference sequence chromosome or scaffold\"",
+  "uint   chromStart;  \"Start position in chromosome\"",
+  "uint   chromEnd;    \"End position in chromosome\"",
+  "string name;        \"Name of item\"",
+  "uint   score;       \"Score from 0-1000\"",
+  "char[1] strand;     \"+ or -\"",
+  "uint   thickStart;  \"Start of where display should be thick\"",
+  "uint   thickEnd;    \"End of where display should be thick\"",
+  "uint   reserved;    \"Used as itemRgb\"",
+  "int    blockCount;  \"Number of blocks\"",
+  "int[blockCount] blockSizes; \"Comma separated list of block sizes\"",
+  "int[blockCount] chromStarts; \"Start positions relative to chromStart\""
+};
+
+template <class T>
+static inline void append(string& buffer, T val)
+{
+  buffer.append((const char*)&val, sizeof(T));
+}
+
+// each item is chromId, start, end and a zero-terminated string
+static void decodeItems(const string& data, vector<BbiFile::Item>& items,
+                        vector<string>* rests)
+{
+  size_t pos = 0;
+  while (pos < data.length())
+  {
+    if (pos + 3 * sizeof(uint32_t) > data.length())
+    {
+      throw hal_exception("Corrupt bigBed block");
+    }
+    BbiFile::Item item;
+    memcpy(&item._chromId, data.data() + pos, sizeof(uint32_t));
+    memcpy(&item._start, data.data() + pos + 4, sizeof(uint32_t));
+    memcpy(&item._end, data.data() + pos + 8, sizeof(uint32_t));
+    item._value = 1.;
+    pos += 3 * sizeof(uint32_t);
+    size_t restEnd = data.find('\0', pos);
+    if (restEnd == string::npos)
+    {
+      throw hal_exception("Corrupt bigBed block");
+    }
+    if (rests != NULL)
+    {
+      rests->push_back(data.substr(pos, restEnd - pos));
+    }
+    pos = restEnd + 1;
+    items.push_back(item);
+  }
+}
+
+bool BigBedWriter::Entry::operator<(const Entry& other) const
+{
+  return _start < other._start || (_start == other._start && 
+                                   _end < other._end);
+}
+
+BigBedWriter::BigBedWriter() : BbiWriter(BigBedMagic, ItemsPerSlot),
+                               _fieldCount(3), _definedFieldCount(0)
+{
+
+}
+
+BigBedWriter::~BigBedWriter()
+{
+
+}
+
+void BigBedWriter::open(ostream* outStream,
+                        const vector<pair<string, hal_size_t> >& chroms)
+{
+  BbiWriter::open(outStream, chroms);
+  _entries.clear();
+  _entries.resize(_chromNames.size());
+  _fieldCount = 3;
+}
+
+void BigBedWriter::setDefinedFieldCount(hal_size_t definedFieldCount)
+{
+  _definedFieldCount = definedFieldCount;
+}
+
+void BigBedWriter::addEntry(const string& chrom, hal_size_t start,
+                            hal_size_t end, const string& rest)
+{
+  uint32_t chromId = getChromId(chrom);
+  if (end < start || end > _chromSizes[chromId])
+  {
+    stringstream ss;
+    ss << "Invalid bigBed interval " << chrom << ":" << start << "-" << end;
+    throw hal_exception(ss.str());
+  }
+  Entry entry;
+  entry._start = (uint32_t)start;
+  entry._end = (uint32_t)end;
+  entry._rest = rest;
+  _entries[chromId].push_back(entry);
+  hal_size_t fieldCount = 3;
+  if (!rest.empty())
+  {
+    fieldCount += 1 + count(rest.begin(), rest.end(), '\t');
+  }
+  _fieldCount = max(_fieldCount, fieldCount);
+}
+
+void BigBedWriter::addLine(const string& line)
+{
+  size_t tab1 = line.find('\t');
+  size_t tab2 = tab1 == string::npos ? tab1 : line.find('\t', tab1 + 1);
+  if (tab2 == string::npos)
+  {
+    throw hal_exception("Error parsing BED line for bigBed: " + line);
+  }
+  size_t tab3 = line.find('\t', tab2 + 1);
+  size_t lineEnd = line.find_last_not_of("\n\r");
+  lineEnd = lineEnd == string::npos ? line.length() : lineEnd + 1;
+  string rest;
+  if (tab3 != string::npos && tab3 < lineEnd)
+  {
+    rest = line.substr(tab3 + 1, lineEnd - tab3 - 1);
+  }
+  else
+  {
+    tab3 = lineEnd;
+  }
+  hal_size_t start;
+  hal_size_t end;
+  stringstream ss(line.substr(tab1 + 1, tab3 - tab1 - 1));
+  ss >> start >> end;
+  if (!ss)
+  {
+    throw hal_exception("Error parsing BED line for bigBed: " + line);
+  }
+  addEntry(line.substr(0, tab1), start, end, rest);
+}
+
+void BigBedWriter::close()
+{
+  for (size_t i = 0; i < _entries.size(); ++i)
+  {
+    vector<Entry>& entries = _entries[i];
+    stable_sort(entries.begin(), entries.end());
+    for (size_t j = 0; j < entries.size(); j += _itemsPerSlot)
+    {
+      size_t endIdx = min(entries.size(), j + _itemsPerSlot);
+      string data;
+      uint32_t end = 0;
+      hal_size_t bases = 0;
+      for (size_t k = j; k < endIdx; ++k)
+      {
+        append(data, (uint32_t)i);
+        append(data, entries[k]._start);
+        append(data, entries[k]._end);
+        data.append(entries[k]._rest.c_str(), entries[k]._rest.length() + 1);
+        end = max(end, entries[k]._end);
+        bases += entries[k]._end - entries[k]._start;
+      }
+      addBlock(i, entries[j]._start, end, data, endIdx - j, bases);
+    }
+    vector<Entry>().swap(entries);
+  }
+  BbiWriter::close();
+}
+
+void BigBedWriter::decodeBlock(const string& data, vector<Item>& items) const
+{
+  decodeItems(data, items, NULL);
+}
+
+uint16_t BigBedWriter::getFieldCount() const
+{
+  return (uint16_t)_fieldCount;
+}
+
+uint16_t BigBedWriter::getDefinedFieldCount() const
+{
+  if (_definedFieldCount > 0)
+  {
+    return (uint16_t)min(_definedFieldCount, _fieldCount);
+  }
+  return (uint16_t)min(_fieldCount, (hal_size_t)12);
+}
+
+string BigBedWriter::getAutoSql() const
+{
+  stringstream ss;
+  ss << "table bed\n\"Browser Extensible Data\"\n    (\n";
+  hal_size_t defined = getDefinedFieldCount();
+  for (hal_size_t i = 0; i < _fieldCount; ++i)
+  {
+    if (i < defined)
+    {
+      ss << "    " << BedAutoSqlFields[i] << "\n";
+    }
+    else
+    {
+      ss << "    string field" << (i + 1) << ";     \"Extra column\"\n";
+    }
+  }
+  ss << "    )\n";
+  return ss.str();
+}
+
+BigBedReader::BigBedReader() : BbiReader(BigBedMagic)
+{
+
+}
+
+BigBedReader::~BigBedReader()
+{
+
+}
+
+bool BigBedReader::isBigBed(istream* stream)
+{
+  return hasMagic(stream, BigBedMagic);
+}
+
+void BigBedReader::getEntries(hal_size_t chromId, hal_size_t start,
+                              hal_size_t end, vector<Entry>& entries)
+{
+  entries.clear();
+  vector<string> blocks;
+  getBlocks(chromId, start, end, blocks);
+  vector<Item> items;
+  vector<string> rests;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    items.clear();
+    rests.clear();
+    decodeItems(blocks[i], items, &rests);
+    for (size_t j = 0; j < items.size(); ++j)
+    {
+      if (items[j]._chromId == chromId && items[j]._start < end &&
+          items[j]._end > start)
+      {
+        Entry entry = {items[j]._start, items[j]._end, rests[j]};
+        entries.push_back(entry);
+      }
+    }
+  }
+}
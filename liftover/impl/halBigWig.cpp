@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include "halBigWig.h"
+
+using namespace std;
+using namespace hal;
+
+const hal_size_t BigWigWriter::ItemsPerSlot = 1024;
+
+static const uint8_t BedGraphSection = 1;
+static const uint8_t VariableStepSection = 2;
+static const uint8_t FixedStepSection = 3;
+static const size_t SectionHeaderSize = 24;
+
+template <class T>
+static inline void append(string& buffer, T val)
+{
+  buffer.append((const char*)&val, sizeof(T));
+}
+
+template <class T>
+static inline T extract(const string& buffer, size_t& pos)
+{
+  if (pos + sizeof(T) > buffer.length())
+  {
+    throw hal_exception("Corrupt bigWig section");
+  }
+  T val;
+  memcpy(&val, buffer.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return val;
+}
+
+static void decodeSection(const string& data, vector<BbiFile::Item>& items)
+{
+  size_t pos = 0;
+  uint32_t chromId = extract<uint32_t>(data, pos);
+  uint32_t start = extract<uint32_t>(data, pos);
+  extract<uint32_t>(data, pos);
+  uint32_t step = extract<uint32_t>(data, pos);
+  uint32_t span = extract<uint32_t>(data, pos);
+  uint8_t type = extract<uint8_t>(data, pos);
+  extract<uint8_t>(data, pos);
+  uint16_t count = extract<uint16_t>(data, pos);
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    BbiFile::Item item;
+    item._chromId = chromId;
+    if (type == BedGraphSection)
+    {
+      item._start = extract<uint32_t>(data, pos);
+      item._end = extract<uint32_t>(data, pos);
+    }
+    else if (type == VariableStepSection)
+    {
+      item._start = extract<uint32_t>(data, pos);
+      item._end = item._start + span;
+    }
+    else if (type == FixedStepSection)
+    {
+      item._start = start + i * step;
+      item._end = item._start + span;
+    }
+    else
+    {
+      throw hal_exception("Unknown bigWig section type");
+    }
+    item._value = extract<float>(data, pos);
+    items.push_back(item);
+  }
+}
+
+BigWigWriter::BigWigWriter() : BbiWriter(BigWigMagic, ItemsPerSlot),
+                               _hasInterval(false)
+{
+
+}
+
+BigWigWriter::~BigWigWriter()
+{
+
+}
+
+void BigWigWriter::open(ostream* outStream,
+                        const vector<pair<string, hal_size_t> >& chroms)
+{
+  BbiWriter::open(outStream, chroms);
+  _hasInterval = false;
+  _section.clear();
+  _chromEnds.assign(_chromNames.size(), 0);
+}
+
+void BigWigWriter::close()
+{
+  flushInterval();
+  flushSection();
+  BbiWriter::close();
+}
+
+void BigWigWriter::addInterval(const string& chrom, hal_size_t start,
+                               hal_size_t end, double value)
+{
+  if (end <= start)
+  {
+    return;
+  }
+  uint32_t chromId = _hasInterval && _chromNames[_interval._chromId] == chrom ?
+     _interval._chromId : getChromId(chrom);
+  if (end > _chromSizes[chromId])
+  {
+    throw hal_exception("bigWig interval past end of sequence " + chrom);
+  }
+  if (_hasInterval && _interval._chromId == chromId &&
+      _interval._end == start && _interval._value == value)
+  {
+    _interval._end = end;
+    return;
+  }
+  flushInterval();
+  if (start < _chromEnds[chromId])
+  {
+    throw hal_exception("bigWig intervals must be added in order and not "
+                        "overlap, in sequence " + chrom);
+  }
+  _interval._chromId = chromId;
+  _interval._start = start;
+  _interval._end = end;
+  _interval._value = value;
+  _hasInterval = true;
+}
+
+void BigWigWriter::flushInterval()
+{
+  if (_hasInterval == true)
+  {
+    if (!_section.empty() && (_section.back()._chromId != _interval._chromId ||
+                              _section.size() >= _itemsPerSlot))
+    {
+      flushSection();
+    }
+    _section.push_back(_interval);
+    _chromEnds[_interval._chromId] = _interval._end;
+    _hasInterval = false;
+  }
+}
+
+// write the section as fixedStep if it's a run of single bases, and as
+// bedGraph otherwise
+void BigWigWriter::flushSection()
+{
+  if (_section.empty())
+  {
+    return;
+  }
+  bool fixedStep = true;
+  hal_size_t bases = 0;
+  for (size_t i = 0; i < _section.size(); ++i)
+  {
+    const Item& item = _section[i];
+    bases += item._end - item._start;
+    fixedStep = fixedStep && item._end == item._start + 1 &&
+       (i == 0 || item._start == _section[i - 1]._end);
+  }
+  string data;
+  append(data, _section[0]._chromId);
+  append(data, _section[0]._start);
+  append(data, _section.back()._end);
+  append(data, (uint32_t)(fixedStep ? 1 : 0));
+  append(data, (uint32_t)(fixedStep ? 1 : 0));
+  append(data, fixedStep ? FixedStepSection : BedGraphSection);
+  append(data, (uint8_t)0);
+  append(data, (uint16_t)_section.size());
+  for (size_t i = 0; i < _section.size(); ++i)
+  {
+    if (fixedStep == false)
+    {
+      append(data, _section[i]._start);
+      append(data, _section[i]._end);
+    }
+    append(data, (float)_section[i]._value);
+  }
+  addBlock(_section[0]._chromId, _section[0]._start, _section.back()._end,
+           data, _section.size(), bases);
+  _section.clear();
+}
+
+void BigWigWriter::decodeBlock(const string& data, vector<Item>& items) const
+{
+  decodeSection(data, items);
+}
+
+BigWigReader::BigWigReader() : BbiReader(BigWigMagic)
+{
+
+}
+
+BigWigReader::~BigWigReader()
+{
+
+}
+
+bool BigWigReader::isBigWig(istream* stream)
+{
+  return hasMagic(stream, BigWigMagic);
+}
+
+void BigWigReader::getIntervals(hal_size_t chromId, hal_size_t start,
+                                hal_size_t end, vector<Interval>& intervals)
+{
+  intervals.clear();
+  vector<string> blocks;
+  getBlocks(chromId, start, end, blocks);
+  vector<Item> items;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    items.clear();
+    decodeSection(blocks[i], items);
+    for (size_t j = 0; j < items.size(); ++j)
+    {
+      if (items[j]._chromId == chromId && items[j]._start < end &&
+          items[j]._end > start)
+      {
+        Interval interval = {items[j]._start, items[j]._end, items[j]._value};
+        intervals.push_back(interval);
+      }
+    }
+  }
+}
@@ -5,6 +5,7 @@
  */
 
 #include <deque>
+#include <algorithm>
 #include <cassert>
 #include "halBlockLiftover.h"
 #include "halBlockMapper.h"
@@ -12,7 +13,7 @@
 using namespace std;
 using namespace hal;
 
-BlockLiftover::BlockLiftover() : Liftover()
+BlockLiftover::BlockLiftover() : Liftover(), _prevGlobalStart(NULL_INDEX)
 {
 
 }
@@ -27,11 +28,13 @@ void BlockLiftover::visitBegin()
   if (_srcGenome->getNumTopSegments() > 0)
   {
     _refSeg = _srcGenome->getTopSegmentIterator();
+    _windowSeg = _srcGenome->getTopSegmentIterator();
     _lastIndex = (hal_index_t)_srcGenome->getNumTopSegments();
   }
   else
   {
     _refSeg = _srcGenome->getBottomSegmentIterator();
+    _windowSeg = _srcGenome->getBottomSegmentIterator();
     _lastIndex = (hal_index_t)_srcGenome->getNumBottomSegments();
   }
 
@@ -47,6 +50,9 @@ void BlockLiftover::visitBegin()
   inputSet.insert(_coalescenceLimit);
   inputSet.insert(_tgtGenome);
   getGenomesInSpanningTree(inputSet, _downwardPath);
+
+  _window.clear();
+  _prevGlobalStart = NULL_INDEX;
 }
 
 void BlockLiftover::liftInterval(BedList& mappedBedLines)
@@ -56,32 +62,11 @@ void BlockLiftover::liftInterval(BedList& mappedBedLines)
   hal_index_t globalEnd = _bedLine._end - 1 + _srcSequence->getStartPosition();
   bool flip = _bedLine._strand == '-';
 
-  _refSeg->toSite(globalStart, false);
-  hal_offset_t startOffset = globalStart - _refSeg->getStartPosition();
-  hal_offset_t endOffset = 0;
-  if (globalEnd <= _refSeg->getEndPosition())
+  updateWindow(globalStart, globalEnd);
+  if (sliceWindow(globalStart, globalEnd, flip) == false)
   {
-    endOffset = _refSeg->getEndPosition() - globalEnd;
-  }
-  _refSeg->slice(startOffset, endOffset);
-
-  assert(_refSeg->getStartPosition() ==  globalStart);
-  assert(_refSeg->getEndPosition() <= globalEnd);
-
-  while (_refSeg->getArrayIndex() < _lastIndex &&
-         _refSeg->getStartPosition() <= globalEnd)
-  {
-    if (flip == true)
-    {
-      _refSeg->toReverseInPlace();
-    }
-    _refSeg->getMappedSegments(_mappedSegments, _tgtGenome, &_downwardPath,
-                               _traverseDupes, 0, _coalescenceLimit, _mrca);
-    if (flip == true)
-    {
-      _refSeg->toReverseInPlace();
-    }
-    _refSeg->toRight(globalEnd);
+    _mappedSegments.clear();
+    mapInterval(globalStart, globalEnd, flip);
   }
 
   vector<MappedSegmentConstPtr> fragments;
@@ -136,6 +121,176 @@ void BlockLiftover::liftInterval(BedList& mappedBedLines)
   }
 }
 
+// Make sure the window contains the mappings of every source segment
+// overlapping [globalStart, globalEnd].  Segments that were already
+// mapped for a previous interval are kept as long as the input remains
+// sorted, so each source segment is only mapped once in a sweep.  If the
+// input is not sorted, the window is simply rebuilt from scratch.
+void BlockLiftover::updateWindow(hal_index_t globalStart, 
+                                 hal_index_t globalEnd)
+{
+  if (globalStart < _prevGlobalStart)
+  {
+    _window.clear();
+  }
+  _prevGlobalStart = globalStart;
+
+  while (!_window.empty() && _window.front()._end < globalStart)
+  {
+    _window.pop_front();
+  }
+
+  if (_window.empty())
+  {
+    _windowSeg->toSite(globalStart, false);
+  }
+
+  set<MappedSegmentConstPtr> segMappings;
+  TargetRanges tgtRanges;
+  while (_windowSeg->getArrayIndex() < _lastIndex &&
+         _windowSeg->getStartPosition() <= globalEnd)
+  {
+    assert(_windowSeg->getStartOffset() == 0 && 
+           _windowSeg->getEndOffset() == 0);
+    _window.push_back(WindowEntry());
+    WindowEntry& entry = _window.back();
+    entry._start = _windowSeg->getStartPosition();
+    entry._end = _windowSeg->getEndPosition();
+    segMappings.clear();
+    _windowSeg->getMappedSegments(segMappings, _tgtGenome, &_downwardPath,
+                                  _traverseDupes, 0, _coalescenceLimit, 
+                                  _mrca);
+    entry._mapped.assign(segMappings.begin(), segMappings.end());
+    tgtRanges.clear();
+    for (size_t i = 0; i < entry._mapped.size(); ++i)
+    {
+      addTargetRange(entry._mapped[i], tgtRanges);
+    }
+    entry._overlaps = hasOverlaps(tgtRanges, false);
+    _windowSeg->toRight();
+  }
+}
+
+// Fill _mappedSegments with copies of the window's mapped segments, sliced
+// down to the part whose source lies within [globalStart, globalEnd]. 
+// This gives the same segments as mapping the sliced source segments 
+// directly, as long as getMappedSegments had nothing to break up: neither
+// within a source segment's mappings nor between the sliced pieces.  If
+// that can't be guaranteed, false is returned and the interval must be
+// mapped directly.
+bool BlockLiftover::sliceWindow(hal_index_t globalStart, 
+                                hal_index_t globalEnd,
+                                bool flip)
+{
+  TargetRanges tgtRanges;
+  for (deque<WindowEntry>::const_iterator i = _window.begin();
+       i != _window.end() && i->_start <= globalEnd; ++i)
+  {
+    if (i->_overlaps == true)
+    {
+      return false;
+    }
+    vector<MappedSegmentConstPtr>::const_iterator j = i->_mapped.begin();
+    for (; j != i->_mapped.end(); ++j)
+    {
+      SlicedSegmentConstPtr source = (*j)->getSource();
+      hal_index_t srcFirst = min(source->getStartPosition(),
+                                 source->getEndPosition());
+      hal_index_t srcLast = max(source->getStartPosition(),
+                                source->getEndPosition());
+      hal_index_t first = max(srcFirst, globalStart);
+      hal_index_t last = min(srcLast, globalEnd);
+      if (first > last)
+      {
+        continue;
+      }
+      hal_offset_t startDelta = first - srcFirst;
+      hal_offset_t endDelta = srcLast - last;
+      if (source->getReversed() == true)
+      {
+        swap(startDelta, endDelta);
+      }
+      MappedSegmentConstPtr mapped = (*j)->copy();
+      mapped->slice(mapped->getStartOffset() + startDelta, 
+                    mapped->getEndOffset() + endDelta);
+      if (flip == true)
+      {
+        mapped->fullReverse();
+      }
+      addTargetRange(mapped, tgtRanges);
+      _mappedSegments.insert(mapped);
+    }
+  }
+
+  // identical target ranges are left alone by getMappedSegments, so only
+  // partial overlaps force us to remap
+  return hasOverlaps(tgtRanges, true) == false;
+}
+
+void BlockLiftover::addTargetRange(const MappedSegmentConstPtr& mapped,
+                                   TargetRanges& tgtRanges)
+{
+  tgtRanges.push_back(pair<hal_index_t, hal_index_t>(
+                        min(mapped->getStartPosition(),
+                            mapped->getEndPosition()),
+                        max(mapped->getStartPosition(),
+                            mapped->getEndPosition())));
+}
+
+bool BlockLiftover::hasOverlaps(TargetRanges& tgtRanges, bool allowSame)
+{
+  sort(tgtRanges.begin(), tgtRanges.end());
+  hal_index_t maxLast = NULL_INDEX;
+  for (size_t i = 0; i < tgtRanges.size(); ++i)
+  {
+    if (i > 0 && allowSame == true && tgtRanges[i] == tgtRanges[i - 1])
+    {
+      continue;
+    }
+    if (i > 0 && tgtRanges[i].first <= maxLast)
+    {
+      return true;
+    }
+    maxLast = max(maxLast, tgtRanges[i].second);
+  }
+  return false;
+}
+
+// Map the interval without going through the window, one sliced source
+// segment at a time.
+void BlockLiftover::mapInterval(hal_index_t globalStart, 
+                                hal_index_t globalEnd,
+                                bool flip)
+{
+  _refSeg->toSite(globalStart, false);
+  hal_offset_t startOffset = globalStart - _refSeg->getStartPosition();
+  hal_offset_t endOffset = 0;
+  if (globalEnd <= _refSeg->getEndPosition())
+  {
+    endOffset = _refSeg->getEndPosition() - globalEnd;
+  }
+  _refSeg->slice(startOffset, endOffset);
+
+  assert(_refSeg->getStartPosition() ==  globalStart);
+  assert(_refSeg->getEndPosition() <= globalEnd);
+
+  while (_refSeg->getArrayIndex() < _lastIndex &&
+         _refSeg->getStartPosition() <= globalEnd)
+  {
+    if (flip == true)
+    {
+      _refSeg->toReverseInPlace();
+    }
+    _refSeg->getMappedSegments(_mappedSegments, _tgtGenome, &_downwardPath,
+                               _traverseDupes, 0, _coalescenceLimit, _mrca);
+    if (flip == true)
+    {
+      _refSeg->toReverseInPlace();
+    }
+    _refSeg->toRight(globalEnd);
+  }
+}
+
 void BlockLiftover::readPSLInfo(vector<MappedSegmentConstPtr>& fragments, 
                                 BedLine& outBedLine)
 {
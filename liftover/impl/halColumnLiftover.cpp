@@ -4,7 +4,7 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
-#include <deque>
+#include <algorithm>
 #include <cassert>
 #include "halColumnLiftover.h"
 
@@ -21,98 +21,374 @@ ColumnLiftover::~ColumnLiftover()
 
 }
 
+void ColumnLiftover::visitBegin()
+{
+  if (_srcGenome->getNumTopSegments() > 0)
+  {
+    _refSeg = _srcGenome->getTopSegmentIterator();
+    _lastIndex = (hal_index_t)_srcGenome->getNumTopSegments();
+  }
+  else
+  {
+    _refSeg = _srcGenome->getBottomSegmentIterator();
+    _lastIndex = (hal_index_t)_srcGenome->getNumBottomSegments();
+  }
+
+  // same scope as a column iterator with the target as its only target
+  set<const Genome*> inputSet;
+  inputSet.insert(_srcGenome);
+  inputSet.insert(_tgtGenome);
+  _scope.clear();
+  getGenomesInSpanningTree(inputSet, _scope);
+}
 
 void ColumnLiftover::liftInterval(BedList& mappedBedLines)
-{  
-  PositionMap posCacheMap;
-  PositionMap revCacheMap;
-  _colIt = _srcSequence->getColumnIterator(&_tgtSet, 0, _bedLine._start, 
-                                           _bedLine._end - 1,
-                                           !_traverseDupes,
-                                           false,
-                                           _bedLine._strand == '-',
-                                           true);
-  while (true) 
-  {
-    const ColumnMap* cMap = _colIt->getColumnMap();
-    for (ColumnMap::const_iterator i = cMap->begin(); i != cMap->end(); ++i)
+{
+  hal_index_t globalStart = _bedLine._start + _srcSequence->getStartPosition();
+  hal_index_t globalEnd = _bedLine._end - 1 + _srcSequence->getStartPosition();
+  bool flip = _bedLine._strand == '-';
+
+  _fwdIntervals.clear();
+  _revIntervals.clear();
+
+  _visited.clear();
+
+  _refSeg->toSite(globalStart, false);
+  hal_offset_t startOffset = globalStart - _refSeg->getStartPosition();
+  hal_offset_t endOffset = 0;
+  if (globalEnd <= _refSeg->getEndPosition())
+  {
+    endOffset = _refSeg->getEndPosition() - globalEnd;
+  }
+  _refSeg->slice(startOffset, endOffset);
+
+  assert(_refSeg->getStartPosition() ==  globalStart);
+  assert(_refSeg->getEndPosition() <= globalEnd);
+
+  while (_refSeg->getArrayIndex() < _lastIndex &&
+         _refSeg->getStartPosition() <= globalEnd)
+  {
+    liftRange(_refSeg->getStartPosition(), _refSeg->getEndPosition(), flip);
+    _refSeg->toRight(globalEnd);
+  }
+
+  writeIntervals(mappedBedLines, false);
+  writeIntervals(mappedBedLines, true);
+}
+
+// The column iterator skips any reference position that already turned
+// up in an earlier column, so each column is reported relative to the
+// leftmost reference position it contains.  We do the same, over the
+// unvisited stretches of [first, last] (which must lie within the
+// current reference segment).
+void ColumnLiftover::liftRange(hal_index_t first, hal_index_t last, bool flip)
+{
+  hal_index_t pos = first;
+  while (pos <= last)
+  {
+    map<hal_index_t, hal_index_t>::const_iterator i = 
+       _visited.upper_bound(pos);
+    if (i != _visited.begin())
     {
-      if (i->first->getGenome() == _tgtGenome)
+      map<hal_index_t, hal_index_t>::const_iterator prev = i;
+      --prev;
+      if (prev->second >= pos)
       {
-        const DNASet* dSet = i->second;
-        const Sequence* seq = i->first;
-        // if we're not adding the column, don't bother keeping track
-        SeqIndex seqIdx(seq, 0);
-        for (DNASet::const_iterator j = dSet->begin(); j != dSet->end(); ++j)
-        {
-          pair<PositionMap::iterator, bool> res;
-          if ((*j)->getReversed() == false)
-          {
-            res =
-               posCacheMap.insert(pair<SeqIndex, PositionCache*>(seqIdx, NULL));
-          }
-          else
-          {
-            res =
-               revCacheMap.insert(pair<SeqIndex, PositionCache*>(seqIdx, NULL));
-          }
-          if (res.second == true)
-          {
-            res.first->second = new PositionCache();
-          }
-          res.first->second->insert((*j)->getArrayIndex());
-        }
+        pos = prev->second + 1;
+        continue;
       }
     }
-    if (_colIt->lastColumn() == true)
+    hal_index_t end = last;
+    if (i != _visited.end() && i->first <= last)
+    {
+      end = i->first - 1;
+    }
+    liftSlice(pos, end, flip);
+    pos = end + 1;
+  }
+}
+
+// every base of a sliced segment has the same column structure, so
+// we follow the column iterator's links for the whole slice at once.
+// the only exception is when the slice's column contains other bases
+// of the slice itself (ie a paralogy overlapping the slice), in which
+// case we split it up until that's no longer the case.
+void ColumnLiftover::liftSlice(hal_index_t first, hal_index_t last, bool flip)
+{
+  _pendingTargets.clear();
+  _pendingRefs.clear();
+  if (_refSeg->isTop() == true)
+  {
+    TopSegmentIteratorConstPtr top =
+       _refSeg.downCast<TopSegmentIteratorConstPtr>()->copy();
+    top->slice(top->getStartOffset() + first - top->getStartPosition(),
+               top->getEndOffset() + top->getEndPosition() - last);
+    if (flip == true)
+    {
+      top->toReverseInPlace();
+    }
+    updateRefTop(top);
+  }
+  else
+  {
+    BottomSegmentIteratorConstPtr bottom =
+       _refSeg.downCast<BottomSegmentIteratorConstPtr>()->copy();
+    bottom->slice(bottom->getStartOffset() + first - 
+                  bottom->getStartPosition(),
+                  bottom->getEndOffset() + bottom->getEndPosition() - last);
+    if (flip == true)
+    {
+      bottom->toReverseInPlace();
+    }
+    updateRefBottom(bottom);
+  }
+
+  // first entry is the slice itself
+  for (size_t i = 1; i < _pendingRefs.size() && first < last; ++i)
+  {
+    if (_pendingRefs[i].first <= last && _pendingRefs[i].second >= first)
+    {
+      hal_index_t mid = first + (last - first) / 2;
+      liftRange(first, mid, flip);
+      liftRange(mid + 1, last, flip);
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < _pendingTargets.size(); ++i)
+  {
+    const PendingTarget& target = _pendingTargets[i];
+    IntervalMap& intervalMap = target._reversed ?
+       _revIntervals : _fwdIntervals;
+    intervalMap[SeqIndex(target._sequence, 0)].push_back(
+      pair<hal_index_t, hal_index_t>(target._first, target._last));
+  }
+  for (size_t i = 0; i < _pendingRefs.size(); ++i)
+  {
+    markVisited(_pendingRefs[i].first, _pendingRefs[i].second);
+  }
+}
+
+void ColumnLiftover::markVisited(hal_index_t first, hal_index_t last)
+{
+  // merge with any overlapping or adjacent ranges
+  map<hal_index_t, hal_index_t>::iterator i = _visited.upper_bound(last + 1);
+  while (i != _visited.begin())
+  {
+    --i;
+    if (i->second + 1 < first)
     {
       break;
     }
-    _colIt->toRight();
-  } 
+    first = min(first, i->first);
+    last = max(last, i->second);
+    _visited.erase(i++);
+  }
+  _visited[first] = last;
+}
+
+void ColumnLiftover::updateRefTop(TopSegmentIteratorConstPtr top)
+{
+  insertTarget(top);
+  updateParent(top);
+  updateNextTopDup(top);
+  updateParseDown(top);
+}
+
+void ColumnLiftover::updateRefBottom(BottomSegmentIteratorConstPtr bottom)
+{
+  insertTarget(bottom);
+  const Genome* genome = bottom->getGenome();
+  for (hal_size_t i = 0; i < genome->getNumChildren(); ++i)
+  {
+    updateChild(bottom, i);
+  }
+}
 
-  PositionMap::iterator pcmIt;
-  for (pcmIt = posCacheMap.begin(); pcmIt != posCacheMap.end(); ++pcmIt)
+void ColumnLiftover::updateParent(TopSegmentIteratorConstPtr top)
+{
+  const Genome* genome = top->getGenome();
+  if (top->hasParent() && parentInScope(genome) &&
+      (_traverseDupes || top->isCanonicalParalog()))
   {
-    const Sequence* seq = pcmIt->first.first;
-    _outParalogy = pcmIt->first.second;
-    hal_size_t seqStart = seq->getStartPosition();
-    PositionCache* posCache = pcmIt->second;
-    const IntervalSet* iSet = posCache->getIntervalSet();
-    for (IntervalSet::const_iterator k = iSet->begin(); k != iSet->end(); ++k)
+    const Genome* parentGenome = genome->getParent();
+    BottomSegmentIteratorConstPtr bottom =
+       parentGenome->getBottomSegmentIterator();
+    bottom->toParent(top);
+    insertTarget(bottom);
+
+    // recurse on parent's parse edge
+    updateParseUp(bottom);
+
+    // recurse on parent's child edges (siblings to top)
+    for (hal_size_t i = 0; i < parentGenome->getNumChildren(); ++i)
     {
-      mappedBedLines.push_back(_bedLine);
-      BedLine& outBedLine = mappedBedLines.back();
-      outBedLine._blocks.clear();
-      outBedLine._chrName = seq->getName();
-      outBedLine._start = k->second - seqStart;
-      outBedLine._end = k->first + 1 - seqStart;
-      outBedLine._strand = _bedLine._strand == '.' ? '.' : '+';
-      outBedLine._srcStart = NULL_INDEX; // not available from posMap
+      if (parentGenome->getChild(i) != genome)
+      {
+        updateChild(bottom, i);
+      }
+    }
+  }
+}
+
+void ColumnLiftover::updateChild(BottomSegmentIteratorConstPtr bottom,
+                                 hal_size_t index)
+{
+  const Genome* genome = bottom->getGenome();
+  if (bottom->hasChild(index) && childInScope(genome, index))
+  {
+    const Genome* childGenome = genome->getChild(index);
+    TopSegmentIteratorConstPtr top = childGenome->getTopSegmentIterator();
+    top->toChild(bottom, index);
+    insertTarget(top);
+
+    //recurse on paralgous siblings
+    updateNextTopDup(top);
+
+    //recurse on child's parse edge
+    updateParseDown(top);
+  }
+}
+
+void ColumnLiftover::updateNextTopDup(TopSegmentIteratorConstPtr top)
+{
+  const Genome* genome = top->getGenome();
+  if (_traverseDupes == false ||
+      top->getTopSegment()->getNextParalogyIndex() == NULL_INDEX ||
+      genome->getParent() == NULL || parentInScope(genome) == false)
+  {
+    return;
+  }
+
+  hal_index_t firstIndex = top->getTopSegment()->getArrayIndex();
+  TopSegmentIteratorConstPtr dup = top->copy();
+  do
+  {
+    dup->toNextParalogy();
+    insertTarget(dup);
+
+    // recurse on duplicate's parse edge
+    updateParseDown(dup);
+  }
+  while (dup->getTopSegment()->getNextParalogyIndex() != NULL_INDEX &&
+         dup->getTopSegment()->getNextParalogyIndex() != firstIndex);
+}
+
+void ColumnLiftover::updateParseUp(BottomSegmentIteratorConstPtr bottom)
+{
+  if (bottom->hasParseUp())
+  {
+    // the slice can span several top segments, which each get their own
+    // (differently-linked) columns
+    hal_index_t rightCutoff = bottom->getEndPosition();
+    TopSegmentIteratorConstPtr top =
+       bottom->getGenome()->getTopSegmentIterator();
+    top->toParseUp(bottom);
+    while (true)
+    {
+      TopSegmentIteratorConstPtr topParse = top->copy();
+
+      // recurse on parse link's parent
+      updateParent(topParse);
+
+      //recurse on parse link's paralogous siblings
+      updateNextTopDup(topParse);
+
+      if (top->getEndPosition() != rightCutoff)
+      {
+        top->toRight(rightCutoff);
+      }
+      else
+      {
+        break;
+      }
+    }
+  }
+}
+
+void ColumnLiftover::updateParseDown(TopSegmentIteratorConstPtr top)
+{
+  if (top->hasParseDown())
+  {
+    const Genome* genome = top->getGenome();
+    hal_index_t rightCutoff = top->getEndPosition();
+    BottomSegmentIteratorConstPtr bottom =
+       genome->getBottomSegmentIterator();
+    bottom->toParseDown(top);
+    while (true)
+    {
+      BottomSegmentIteratorConstPtr bottomParse = bottom->copy();
+
+      // recurse on all the link's children
+      for (hal_size_t i = 0; i < genome->getNumChildren(); ++i)
+      {
+        updateChild(bottomParse, i);
+      }
+
+      if (bottom->getEndPosition() != rightCutoff)
+      {
+        bottom->toRight(rightCutoff);
+      }
+      else
+      {
+        break;
+      }
     }
-    delete posCache;
   }
+}
+
+void ColumnLiftover::insertTarget(SegmentIteratorConstPtr segment)
+{
+  hal_index_t first = min(segment->getStartPosition(),
+                          segment->getEndPosition());
+  hal_index_t last = max(segment->getStartPosition(),
+                         segment->getEndPosition());
+  if (segment->getGenome() == _tgtGenome)
+  {
+    PendingTarget target;
+    target._sequence = segment->getSequence();
+    target._reversed = segment->getReversed();
+    target._first = first;
+    target._last = last;
+    _pendingTargets.push_back(target);
+  }
+  if (segment->getGenome() == _srcGenome)
+  {
+    _pendingRefs.push_back(pair<hal_index_t, hal_index_t>(first, last));
+  }
+}
 
-  for (pcmIt = revCacheMap.begin(); pcmIt != revCacheMap.end(); ++pcmIt)
+// merge the overlapping and adjacent intervals found for each target
+// sequence and write them out
+void ColumnLiftover::writeIntervals(BedList& mappedBedLines, bool reversed)
+{
+  IntervalMap& intervalMap = reversed ? _revIntervals : _fwdIntervals;
+  char strand = reversed ? '-' : '+';
+  for (IntervalMap::iterator i = intervalMap.begin();
+       i != intervalMap.end(); ++i)
   {
-    const Sequence* seq = pcmIt->first.first;
-    _outParalogy = pcmIt->first.second;
+    const Sequence* seq = i->first.first;
+    _outParalogy = i->first.second;
     hal_size_t seqStart = seq->getStartPosition();
-    PositionCache* posCache = pcmIt->second;
-    const IntervalSet* iSet = posCache->getIntervalSet();
-    for (IntervalSet::const_iterator k = iSet->begin(); k != iSet->end(); ++k)
+    IntervalList& intervals = i->second;
+    sort(intervals.begin(), intervals.end());
+    IntervalList::const_iterator j = intervals.begin();
+    while (j != intervals.end())
     {
+      hal_index_t first = j->first;
+      hal_index_t last = j->second;
+      for (++j; j != intervals.end() && j->first <= last + 1; ++j)
+      {
+        last = max(last, j->second);
+      }
       mappedBedLines.push_back(_bedLine);
       BedLine& outBedLine = mappedBedLines.back();
       outBedLine._blocks.clear();
       outBedLine._chrName = seq->getName();
-      outBedLine._start = k->second - seqStart;
-      outBedLine._end = k->first + 1 - seqStart;
-      outBedLine._strand = _bedLine._strand == '.' ? '.' : '-';
-      outBedLine._srcStart = NULL_INDEX; // not available from posMap
+      outBedLine._start = first - seqStart;
+      outBedLine._end = last + 1 - seqStart;
+      outBedLine._strand = _bedLine._strand == '.' ? '.' : strand;
+      outBedLine._srcStart = NULL_INDEX; // not tracked by the column
     }
-    delete posCache;
   }
-
 }
-
@@ -14,7 +14,8 @@ using namespace hal;
 Liftover::Liftover() : _outBedStream(NULL),                       
                        _inBedVersion(-1), _outBedVersion(-1),
                        _outPSL(false), _outPSLWithName(false),
-                       _srcGenome(NULL), _tgtGenome(NULL)
+                       _srcGenome(NULL), _tgtGenome(NULL),
+                       _outBigBed(false)
 {
 
 }
@@ -54,6 +55,24 @@ void Liftover::convert(AlignmentConstPtr alignment,
   assert(_srcGenome && inBedStream && tgtGenome && outBedStream);
 
   _tgtSet.insert(tgtGenome);
+
+  if (BigBedReader::isBigBed(inBedStream) == true)
+  {
+    BigBedReader reader;
+    reader.open(inBedStream);
+    if (_inBedVersion <= 0)
+    {
+      _inBedVersion = reader.getDefinedFieldCount();
+    }
+    if (_outBedVersion <= 0)
+    {
+      _outBedVersion = _inBedVersion;
+    }
+    openOutput();
+    scanBigBed(reader, _inBedVersion);
+    closeOutput();
+    return;
+  }
   
   // we copy into a stringstream because we never want to
   // run getBedVersion (which does random access) on cin (which is a
@@ -78,6 +97,7 @@ void Liftover::convert(AlignmentConstPtr alignment,
   {
     _outBedVersion = _inBedVersion;
   }
+  openOutput();
 
   if (firstLineStream != NULL)
   {
@@ -85,6 +105,29 @@ void Liftover::convert(AlignmentConstPtr alignment,
     delete firstLineStream;
   }
   scan(inBedStream, _inBedVersion, inLocale);
+  closeOutput();
+}
+
+void Liftover::setOutBigBed(bool outBigBed)
+{
+  _outBigBed = outBigBed;
+}
+
+void Liftover::openOutput()
+{
+  if (_outBigBed == true)
+  {
+    _bigBedWriter.open(_outBedStream, _tgtGenome);
+    _bigBedWriter.setDefinedFieldCount(_outBedVersion);
+  }
+}
+
+void Liftover::closeOutput()
+{
+  if (_outBigBed == true)
+  {
+    _bigBedWriter.close();
+  }
 }
 
 void Liftover::visitBegin()
@@ -161,7 +204,13 @@ void Liftover::writeLineResults()
     {
       i->_extra.clear();
     }
-    if (_outPSL == false)
+    if (_outBigBed == true)
+    {
+      stringstream line;
+      i->write(line, _outBedVersion);
+      _bigBedWriter.addLine(line.str());
+    }
+    else if (_outPSL == false)
     {
       i->write(*_outBedStream, _outBedVersion);
     }
@@ -19,8 +19,8 @@ static CLParserPtr initParser()
   CLParserPtr optionsParser = hdf5CLParserInstance();
   optionsParser->addArgument("halFile", "input hal file");
   optionsParser->addArgument("srcGenome", "source genome name");
-  optionsParser->addArgument("srcBed", "path of input bed file.  set as stdin "
-                             "to stream from standard input");
+  optionsParser->addArgument("srcBed", "path of input bed (or bigBed) file. "
+                             " set as stdin to stream from standard input");
   optionsParser->addArgument("tgtGenome", "target genome name");
   optionsParser->addArgument("tgtBed", "path of output bed file.  set as stdout"
                              " to stream to standard output.");
@@ -48,6 +48,10 @@ static CLParserPtr initParser()
   optionsParser->addOptionFlag("outPSLWithName", "write output as input BED name followed by PSL line instead of "
                                "bed format. overrides --outBedVersion when "
                                "specified.", false);
+  optionsParser->addOptionFlag("outBigBed", "write output as a bigBed file "
+                               "over the target genome's sequences instead "
+                               "of text. incompatible with --outPSL and "
+                               "--append.", false);
   optionsParser->addOptionFlag("keepExtra", "keep extra columns. these are "
                                "columns in the input beyond the specified or "
                                "detected bed version, and which are cut by "
@@ -78,6 +82,7 @@ int main(int argc, char** argv)
   bool keepExtra;
   bool outPSL;
   bool outPSLWithName;
+  bool outBigBed;
   bool tab;
   try
   {
@@ -95,6 +100,7 @@ int main(int argc, char** argv)
     keepExtra = optionsParser->getFlag("keepExtra");
     outPSL = optionsParser->getFlag("outPSL");
     outPSLWithName = optionsParser->getFlag("outPSLWithName");
+    outBigBed = optionsParser->getFlag("outBigBed");
     tab = optionsParser->getFlag("tab");
   }
   catch(exception& e)
@@ -114,6 +120,11 @@ int main(int argc, char** argv)
     {
       outBedVersion = 12;
     }
+    if (outBigBed == true && (outPSL == true || append == true))
+    {
+      throw hal_exception("--outBigBed cannot be used with --outPSL, "
+                          "--outPSLWithName or --append");
+    }
 
     AlignmentConstPtr alignment = openHalAlignmentReadOnly(halPath, 
                                                            optionsParser);
@@ -153,7 +164,7 @@ int main(int argc, char** argv)
     }
     else
     {
-      srcBed.open(srcBedPath.c_str());
+      srcBed.open(srcBedPath.c_str(), ios::in | ios::binary);
       srcBedPtr = &srcBed;
       if (!srcBed)
       {
@@ -162,6 +173,7 @@ int main(int argc, char** argv)
     }
     
     ios_base::openmode mode = append ? ios::out | ios::app : ios_base::out;
+    mode |= ios::binary;
     ofstream tgtBed;
     ostream* tgtBedPtr;
     if (tgtBedPath == "stdout")
@@ -187,6 +199,7 @@ int main(int argc, char** argv)
     }
     
     BlockLiftover liftover;
+    liftover.setOutBigBed(outBigBed);
     liftover.convert(alignment, srcGenome, srcBedPtr, tgtGenome, tgtBedPtr,
                      inBedVersion, outBedVersion, keepExtra, !noDupes,
                      outPSL, outPSLWithName, inLocale, coalescenceLimit);
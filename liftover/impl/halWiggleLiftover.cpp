@@ -15,8 +15,17 @@ using namespace hal;
 
 const double WiggleLiftover::DefaultValue = 0.0;
 const hal_size_t WiggleLiftover::DefaultTileSize = 10000;
+const hal_size_t WiggleLiftover::DefaultMaxTiles = 1000;
+const hal_size_t WiggleLiftover::DefaultMaxRunBytes = 268435456;
 
-WiggleLiftover::WiggleLiftover()
+// a target sequence reached from more source sequences than this is
+// just written at the end
+static const size_t MaxSources = 1000;
+
+WiggleLiftover::WiggleLiftover() : _maxTiles(DefaultMaxTiles),
+                                   _maxRunBytes(DefaultMaxRunBytes),
+                                   _variableStep(false),
+                                   _bigWig(false)
 {
 
 }
@@ -26,12 +35,30 @@ WiggleLiftover::~WiggleLiftover()
 
 }
 
+void WiggleLiftover::setMaxMemory(hal_size_t maxTiles,
+                                  hal_size_t maxRunBytes)
+{
+  _maxTiles = maxTiles;
+  _maxRunBytes = maxRunBytes;
+}
+
+void WiggleLiftover::setVariableStep(bool variableStep)
+{
+  _variableStep = variableStep;
+}
+
+void WiggleLiftover::setBigWig(bool bigWig)
+{
+  _bigWig = bigWig;
+}
+
 void WiggleLiftover::preloadOutput(AlignmentConstPtr alignment,
                                    const Genome* tgtGenome,
                                    istream* inputFile)
 {
   WiggleLoader loader;
-  _outVals.init(tgtGenome->getSequenceLength(), DefaultValue, DefaultTileSize);
+  _outVals.init(tgtGenome->getSequenceLength(), DefaultValue, DefaultTileSize,
+                _maxTiles, _maxRunBytes);
   loader.load(alignment, tgtGenome, inputFile, &_outVals);
 }
 
@@ -70,7 +97,31 @@ void WiggleLiftover::convert(AlignmentConstPtr alignment,
   if (_outVals.getGenomeSize() == 0)
   {
     _outVals.init(tgtGenome->getSequenceLength(), DefaultValue, 
-                  DefaultTileSize);
+                  DefaultTileSize, _maxTiles, _maxRunBytes);
+  }
+
+  _outSequence = NULL;
+  _prevPos = NULL_INDEX;
+  if (_bigWig == true)
+  {
+    _bigWigWriter.open(_outStream, _tgtGenome);
+  }
+  findSources();
+  countSourceGroups(inputFile);
+  for (size_t i = 0; i < _srcGroups.size(); ++i)
+  {
+    if (_srcGroups[i] == 0)
+    {
+      finishSource(i);
+    }
+  }
+  // (only preloaded values, if anything)
+  for (size_t i = 0; i < _tgtSequences.size(); ++i)
+  {
+    if (_numSources[i] == 0)
+    {
+      writeSequence(_tgtSequences[i]);
+    }
   }
   scan(inputFile);
   write();
@@ -80,6 +131,7 @@ void WiggleLiftover::convert(AlignmentConstPtr alignment,
 void WiggleLiftover::visitHeader()
 {
   mapSegment();
+  const Sequence* prevSequence = _srcSequence;
   _srcSequence = _srcGenome->getSequence(_sequenceName);
   if (_srcSequence == NULL)
   {
@@ -88,6 +140,15 @@ void WiggleLiftover::visitHeader()
        << _srcGenome->getName();
     throw hal_exception(ss.str());
   }
+  if (prevSequence != NULL && _srcSequence != prevSequence)
+  {
+    // the values of its lines were all mapped by mapSegment() above
+    hal_index_t& groups = _srcGroups[prevSequence->getArrayIndex()];
+    if (groups != NULL_INDEX && --groups == 0)
+    {
+      finishSource(prevSequence->getArrayIndex());
+    }
+  }
 }
 
 void WiggleLiftover::visitLine()
@@ -219,46 +280,455 @@ void WiggleLiftover::mapFragments(vector<MappedSegmentConstPtr>& fragments)
   }
 }
 
+// source sequences that can map to each sequence of a genome, sorted.
+// {NULL_INDEX} stands for too many to keep track of
+typedef vector<vector<hal_index_t> > SourceSets;
+
+static bool isAnySource(const vector<hal_index_t>& sources)
+{
+  return sources.size() == 1 && sources[0] == NULL_INDEX;
+}
+
+static void compactSources(vector<hal_index_t>& sources)
+{
+  sort(sources.begin(), sources.end());
+  sources.erase(unique(sources.begin(), sources.end()), sources.end());
+  if (sources.size() > MaxSources ||
+      (sources.empty() == false && sources[0] == NULL_INDEX))
+  {
+    sources.assign(1, NULL_INDEX);
+  }
+}
+
+static void addSources(vector<hal_index_t>& sources,
+                       const vector<hal_index_t>& newSources)
+{
+  if (isAnySource(sources) == true)
+  {
+    return;
+  }
+  if (isAnySource(newSources) == true)
+  {
+    sources = newSources;
+    return;
+  }
+  sources.insert(sources.end(), newSources.begin(), newSources.end());
+  if (sources.size() > 2 * MaxSources)
+  {
+    compactSources(sources);
+  }
+}
+
+// index of the first top (or bottom) segment of each sequence, to find
+// the sequence of a segment
+static void getFirstSegments(const Genome* genome, bool top,
+                             vector<hal_index_t>& firsts)
+{
+  firsts.clear();
+  SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEndIt = genome->getSequenceEndIterator();
+  for (; seqIt != seqEndIt; seqIt->toNext())
+  {
+    const Sequence* sequence = seqIt->getSequence();
+    firsts.push_back(top == true ? sequence->getTopSegmentArrayIndex() :
+                     sequence->getBottomSegmentArrayIndex());
+  }
+}
+
+static hal_index_t getSequenceIndex(const vector<hal_index_t>& firsts,
+                                    hal_index_t segment)
+{
+  return (hal_index_t)(upper_bound(firsts.begin(), firsts.end(), segment) -
+                       firsts.begin()) - 1;
+}
+
+// carry the sources of the child's sequences up to the parent's (or the
+// other way round) over the child's top segments
+static void followSegments(const Genome* child, const Genome* parent,
+                           bool up, const SourceSets& from, SourceSets& to)
+{
+  vector<hal_index_t> childFirsts;
+  vector<hal_index_t> parentFirsts;
+  getFirstSegments(child, true, childFirsts);
+  getFirstSegments(parent, false, parentFirsts);
+  hal_index_t prevChildSeq = NULL_INDEX;
+  hal_index_t prevParentSeq = NULL_INDEX;
+  TopSegmentIteratorConstPtr top = child->getTopSegmentIterator();
+  TopSegmentIteratorConstPtr topEnd = child->getTopSegmentEndIterator();
+  for (; top != topEnd; top->toRight())
+  {
+    if (top->hasParent() == false)
+    {
+      continue;
+    }
+    hal_index_t childSeq = getSequenceIndex(childFirsts,
+                                            top->getArrayIndex());
+    hal_index_t parentSeq = getSequenceIndex(parentFirsts,
+                                             top->getParentIndex());
+    if (childSeq == prevChildSeq && parentSeq == prevParentSeq)
+    {
+      continue;
+    }
+    prevChildSeq = childSeq;
+    prevParentSeq = parentSeq;
+    if (up == true)
+    {
+      addSources(to[parentSeq], from[childSeq]);
+    }
+    else
+    {
+      addSources(to[childSeq], from[parentSeq]);
+    }
+  }
+  for (size_t i = 0; i < to.size(); ++i)
+  {
+    compactSources(to[i]);
+  }
+}
+
+static hal_index_t findRoot(vector<hal_index_t>& roots, hal_index_t i)
+{
+  while (roots[i] != i)
+  {
+    roots[i] = roots[roots[i]];
+    i = roots[i];
+  }
+  return i;
+}
+
+// sequences joined by paralogous segments share their sources
+static void addParalogs(const Genome* genome, SourceSets& sets)
+{
+  vector<hal_index_t> firsts;
+  getFirstSegments(genome, true, firsts);
+  vector<hal_index_t> roots(sets.size());
+  for (size_t i = 0; i < roots.size(); ++i)
+  {
+    roots[i] = i;
+  }
+  bool joined = false;
+  TopSegmentIteratorConstPtr top = genome->getTopSegmentIterator();
+  TopSegmentIteratorConstPtr topEnd = genome->getTopSegmentEndIterator();
+  for (; top != topEnd; top->toRight())
+  {
+    if (top->hasNextParalogy() == false)
+    {
+      continue;
+    }
+    hal_index_t root1 = findRoot(roots, getSequenceIndex(
+                                   firsts, top->getArrayIndex()));
+    hal_index_t root2 = findRoot(roots, getSequenceIndex(
+                                   firsts, top->getNextParalogyIndex()));
+    if (root1 != root2)
+    {
+      roots[max(root1, root2)] = min(root1, root2);
+      joined = true;
+    }
+  }
+  if (joined == false)
+  {
+    return;
+  }
+  // roots come before the rest of their groups
+  for (size_t i = 0; i < sets.size(); ++i)
+  {
+    hal_index_t root = findRoot(roots, i);
+    if (root != (hal_index_t)i)
+    {
+      addSources(sets[root], sets[i]);
+    }
+  }
+  for (size_t i = 0; i < sets.size(); ++i)
+  {
+    hal_index_t root = findRoot(roots, i);
+    if (root == (hal_index_t)i)
+    {
+      compactSources(sets[i]);
+    }
+    else
+    {
+      sets[i] = sets[root];
+    }
+  }
+}
+
+// follow whole sequences along the path from the source genome to the
+// target, through their common ancestor.  this finds every source
+// sequence that can map to a target sequence, and maybe a few more
+void WiggleLiftover::findSources()
+{
+  set<const Genome*> srcAncestors;
+  for (const Genome* genome = _srcGenome; genome != NULL;
+       genome = genome->getParent())
+  {
+    srcAncestors.insert(genome);
+  }
+  vector<const Genome*> down;
+  const Genome* ancestor = _tgtGenome;
+  for (; srcAncestors.find(ancestor) == srcAncestors.end();
+       ancestor = ancestor->getParent())
+  {
+    down.push_back(ancestor);
+  }
+  vector<const Genome*> path;
+  for (const Genome* genome = _srcGenome; genome != ancestor;
+       genome = genome->getParent())
+  {
+    path.push_back(genome);
+  }
+  path.push_back(ancestor);
+  path.insert(path.end(), down.rbegin(), down.rend());
+
+  SourceSets sources(_srcGenome->getNumSequences());
+  for (size_t i = 0; i < sources.size(); ++i)
+  {
+    sources[i].push_back(i);
+  }
+  for (size_t i = 0; i < path.size(); ++i)
+  {
+    if (i > 0)
+    {
+      SourceSets next(path[i]->getNumSequences());
+      if (path[i] == path[i - 1]->getParent())
+      {
+        followSegments(path[i - 1], path[i], true, sources, next);
+      }
+      else
+      {
+        followSegments(path[i], path[i - 1], false, sources, next);
+      }
+      sources.swap(next);
+    }
+    if (_traverseDupes == true && path[i]->getParent() != NULL)
+    {
+      addParalogs(path[i], sources);
+    }
+  }
+
+  _numSources.assign(sources.size(), 0);
+  _srcTargets.assign(_srcGenome->getNumSequences(), vector<hal_index_t>());
+  for (size_t i = 0; i < sources.size(); ++i)
+  {
+    if (isAnySource(sources[i]) == true)
+    {
+      _numSources[i] = NULL_INDEX;
+      continue;
+    }
+    _numSources[i] = sources[i].size();
+    for (size_t j = 0; j < sources[i].size(); ++j)
+    {
+      _srcTargets[sources[i][j]].push_back(i);
+    }
+  }
+  _tgtWritten.assign(_tgtGenome->getNumSequences(), false);
+  _tgtSequences.clear();
+  SequenceIteratorConstPtr seqIt = _tgtGenome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEndIt = _tgtGenome->getSequenceEndIterator();
+  for (; seqIt != seqEndIt; seqIt->toNext())
+  {
+    _tgtSequences.push_back(seqIt->getSequence());
+  }
+}
+
+// count the groups of consecutive lines of each source sequence in the
+// input, so that a sequence is only taken to be finished after the last
+// one.  this reads the input an extra time, and if it can't be read
+// again (from a pipe, say), nothing is written before the end
+void WiggleLiftover::countSourceGroups(istream* inputFile)
+{
+  _srcGroups.assign(_srcGenome->getNumSequences(), NULL_INDEX);
+  streampos start = inputFile->tellg();
+  if (start == streampos(-1))
+  {
+    return;
+  }
+  _srcGroups.assign(_srcGenome->getNumSequences(), 0);
+  if (BigWigReader::isBigWig(inputFile) == true)
+  {
+    // each sequence is visited once, in one go
+    BigWigReader reader;
+    reader.open(inputFile);
+    for (hal_size_t i = 0; i < reader.getNumChroms(); ++i)
+    {
+      const Sequence* sequence =
+         _srcGenome->getSequence(reader.getChromName(i));
+      if (sequence != NULL)
+      {
+        _srcGroups[sequence->getArrayIndex()] = 1;
+      }
+    }
+  }
+  else
+  {
+    string lineBuffer;
+    string word;
+    string prevName;
+    while (getline(*inputFile, lineBuffer))
+    {
+      size_t first = lineBuffer.find_first_not_of(" \t");
+      if (first == string::npos || (lineBuffer[first] != 'f' &&
+                                    lineBuffer[first] != 'v'))
+      {
+        continue;
+      }
+      stringstream ss(lineBuffer);
+      ss >> word;
+      if (word != "fixedStep" && word != "variableStep")
+      {
+        continue;
+      }
+      ss >> word;
+      if (!ss || word.length() <= 6 || word.substr(0, 6) != "chrom=" ||
+          word.substr(6) == prevName)
+      {
+        continue;
+      }
+      prevName = word.substr(6);
+      const Sequence* sequence = _srcGenome->getSequence(prevName);
+      if (sequence != NULL)
+      {
+        ++_srcGroups[sequence->getArrayIndex()];
+      }
+    }
+  }
+  inputFile->clear();
+  inputFile->seekg(start);
+  if (!*inputFile)
+  {
+    throw hal_exception("Error rewinding wiggle input");
+  }
+}
+
+// all the input of a source sequence has been read, so write the target
+// sequences that were only waiting for it
+void WiggleLiftover::finishSource(hal_index_t src)
+{
+  const vector<hal_index_t>& targets = _srcTargets[src];
+  for (size_t i = 0; i < targets.size(); ++i)
+  {
+    if (_numSources[targets[i]] != NULL_INDEX &&
+        --_numSources[targets[i]] == 0)
+    {
+      writeSequence(_tgtSequences[targets[i]]);
+    }
+  }
+}
+
+// write the values in a target sequence, and free them
+void WiggleLiftover::writeSequence(const Sequence* tgtSequence)
+{
+  _tgtWritten[tgtSequence->getArrayIndex()] = true;
+  hal_index_t first = tgtSequence->getStartPosition();
+  hal_index_t last = tgtSequence->getEndPosition();
+  if (last < first)
+  {
+    return;
+  }
+  hal_index_t tileSize = (hal_index_t)_outVals.getTileSize();
+  vector<WiggleTiles<double>::Run> runs;
+  for (hal_index_t i = first / tileSize; i <= last / tileSize; ++i)
+  {
+    if (_outVals.isTileEmpty(i) == true)
+    {
+      continue;
+    }
+    _outVals.getRuns(i, runs);
+    hal_index_t tileStart = i * tileSize;
+    for (size_t j = 0; j < runs.size(); ++j)
+    {
+      hal_index_t runFirst = max(first, tileStart + (hal_index_t)
+                                 runs[j]._offset);
+      hal_index_t runLast = min(last, tileStart + (hal_index_t)
+                                (runs[j]._offset + runs[j]._length) - 1);
+      if (runFirst > runLast)
+      {
+        continue;
+      }
+      if (_bigWig == true)
+      {
+        writeBigWigRun(runFirst, runLast - runFirst + 1, runs[j]._value);
+      }
+      else
+      {
+        writeRun(runFirst, runLast - runFirst + 1, runs[j]._value);
+      }
+    }
+  }
+  _outVals.erase(first, last);
+}
+
+// whatever is left, in order
 void WiggleLiftover::write()
 {
-  const Sequence* outSequence = NULL;
-  hal_size_t ogSize = _tgtGenome->getSequenceLength();
-  bool needHeader = true;
-  hal_index_t prevPos = NULL_INDEX;
-  for (hal_size_t i = 0; i < _outVals.getNumTiles(); ++i)
-  {
-    if (_outVals.isTileEmpty(i) == false)
-    { 
-      hal_index_t pos = i * _outVals.getTileSize();
-      for (hal_size_t j = 0; pos < ogSize && j < _outVals.getTileSize(); ++j, 
-              ++pos)
+  for (size_t i = 0; i < _tgtSequences.size(); ++i)
+  {
+    if (_tgtWritten[i] == false)
+    {
+      writeSequence(_tgtSequences[i]);
+    }
+  }
+  if (_bigWig == true)
+  {
+    _bigWigWriter.close();
+  }
+}
+
+// runs are in genome coordinates, and the sequences are written in any
+// order
+void WiggleLiftover::writeBigWigRun(hal_index_t pos, hal_size_t length, 
+                                    double val)
+{
+  hal_index_t last = pos + length - 1;
+  while (pos <= last)
+  {
+    if (_outSequence == NULL || pos < _outSequence->getStartPosition() ||
+        pos > _outSequence->getEndPosition())
+    {
+      _outSequence = _tgtGenome->getSequenceBySite(pos);
+      assert(_outSequence != NULL);
+    }
+    hal_index_t end = min(last, _outSequence->getEndPosition()) + 1;
+    hal_index_t seqStart = _outSequence->getStartPosition();
+    _bigWigWriter.addInterval(_outSequence->getName(), pos - seqStart,
+                              end - seqStart, val);
+    pos = end;
+  }
+}
+
+void WiggleLiftover::writeRun(hal_index_t pos, hal_size_t length, double val)
+{
+  for (hal_index_t last = pos + length - 1; pos <= last; ++pos)
+  {
+    bool needHeader = pos != _prevPos + 1;
+    if (_outSequence == NULL || pos < _outSequence->getStartPosition() ||
+        pos > _outSequence->getEndPosition())
+    {
+      _outSequence = _tgtGenome->getSequenceBySite(pos);
+      assert(_outSequence != NULL);
+      needHeader = true;
+      if (_variableStep == true)
       {
-        if (_outVals.exists(pos) == true)
-        {
-          if (outSequence == NULL || pos < outSequence->getStartPosition() ||
-                pos > outSequence->getEndPosition())
-          {
-            outSequence = _tgtGenome->getSequenceBySite(pos);
-            assert(outSequence != NULL);
-            needHeader = true;
-          }
-          else if (pos != prevPos + 1)
-          {
-            needHeader = true;
-          }
-          if (needHeader == true)
-          {
-            *_outStream << "fixedStep"
-                        << "\tchrom=" << outSequence->getName()
-                        << "\tstart=" 
-                        << (1 + pos - outSequence->getStartPosition())
-                        << "\tstep=1\n";
-            needHeader = false;
-          }
-          *_outStream << _outVals.get(pos) << '\n';
-          prevPos = pos;
-        }
+        *_outStream << "variableStep"
+                    << "\tchrom=" << _outSequence->getName() << '\n';
+      }
+    }
+    if (_variableStep == true)
+    {
+      *_outStream << (1 + pos - _outSequence->getStartPosition()) << '\t'
+                  << val << '\n';
+    }
+    else
+    {
+      if (needHeader == true)
+      {
+        *_outStream << "fixedStep"
+                    << "\tchrom=" << _outSequence->getName()
+                    << "\tstart=" 
+                    << (1 + pos - _outSequence->getStartPosition())
+                    << "\tstep=1\n";
       }
+      *_outStream << val << '\n';
     }
+    _prevPos = pos;
   }
 }
@@ -17,8 +17,9 @@ static CLParserPtr initParser()
   CLParserPtr optionsParser = hdf5CLParserInstance();
   optionsParser->addArgument("halFile", "input hal file");
   optionsParser->addArgument("srcGenome", "source genome name");
-  optionsParser->addArgument("srcWig", "path of input .wig file.  set as stdin "
-                             "to stream from standard input");
+  optionsParser->addArgument("srcWig", "path of input .wig or .bigWig file."
+                             "  set as stdin to stream (.wig only) from "
+                             "standard input");
   optionsParser->addArgument("tgtGenome", "target genome name");
   optionsParser->addArgument("tgtWig", "path of output .wig file.  set as stdout"
                              " to stream to standard output.");
@@ -28,6 +29,19 @@ static CLParserPtr initParser()
                                "Note that the entire tgtWig file will be loaded into"
                                " memory then overwritten, so this data can be lost "
                                "in event of a crash", false);
+  optionsParser->addOptionFlag("variableStep", "write variableStep wiggle "
+                               "output (one header per target sequence) "
+                               "instead of fixedStep", false);
+  optionsParser->addOptionFlag("outBigWig", "write tgtWig in bigWig "
+                               "format", false);
+  optionsParser->addOption("maxTiles", "maximum number of uncompressed "
+                           "tiles of lifted values (10000 bases each) to keep "
+                           "in memory.  0 for no limit", 
+                           WiggleLiftover::DefaultMaxTiles);
+  optionsParser->addOption("maxMemory", "maximum number of bytes of "
+                           "compressed tiles to keep in memory before "
+                           "spilling them to a temporary file.  0 for no "
+                           "limit", WiggleLiftover::DefaultMaxRunBytes);
 /*  optionsParser->addOptionFlag("unique",
                                "only map block if its left-most paralog is in"
                                "the input.  this "
@@ -53,6 +67,10 @@ int main(int argc, char** argv)
   bool noDupes;
   bool append;
   bool unique;
+  bool variableStep;
+  bool outBigWig;
+  hal_size_t maxTiles;
+  hal_size_t maxMemory;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -65,6 +83,10 @@ int main(int argc, char** argv)
     append = optionsParser->getFlag("append");
     //  unique = optionsParser->getFlag("unique");
     unique = false;
+    variableStep = optionsParser->getFlag("variableStep");
+    outBigWig = optionsParser->getFlag("outBigWig");
+    maxTiles = optionsParser->getOption<hal_size_t>("maxTiles");
+    maxMemory = optionsParser->getOption<hal_size_t>("maxMemory");
   }
   catch(exception& e)
   {
@@ -103,7 +125,7 @@ int main(int argc, char** argv)
     }
     else
     {
-      srcWig.open(srcWigPath.c_str());
+      srcWig.open(srcWigPath.c_str(), ios::in | ios::binary);
       srcWigPtr = &srcWig;
       if (!srcWig)
       {
@@ -112,11 +134,14 @@ int main(int argc, char** argv)
     }
 
     WiggleLiftover liftover;
+    liftover.setMaxMemory(maxTiles, maxMemory);
+    liftover.setVariableStep(variableStep);
+    liftover.setBigWig(outBigWig);
     if (append == true && tgtWigPath != "stdout")
     {
       // load the wig data into memory so that it can be properly merged
       // with the new data from the liftover.
-      ifstream tgtWig(tgtWigPath.c_str());
+      ifstream tgtWig(tgtWigPath.c_str(), ios::in | ios::binary);
       if (tgtWig)
       {
         liftover.preloadOutput(alignment, tgtGenome, &tgtWig);
@@ -131,7 +156,7 @@ int main(int argc, char** argv)
     }
     else
     {      
-      tgtWig.open(tgtWigPath.c_str());
+      tgtWig.open(tgtWigPath.c_str(), ios::out | ios::binary);
       tgtWigPtr = &tgtWig;
       if (!tgtWig)
       {
@@ -11,10 +11,13 @@
 #include <cctype>
 
 #include "halWiggleScanner.h"
+#include "halBigWig.h"
 
 using namespace std;
 using namespace hal;
 
+const hal_size_t WiggleScanner::BigWigWindow = 1000000;
+
 WiggleScanner::WiggleScanner() : _wiggleStream(NULL)
 {
 
@@ -48,6 +51,11 @@ void WiggleScanner::scan(const string& wigglePath)
 
 void WiggleScanner::scan(istream* is)
 {
+  if (BigWigReader::isBigWig(is) == true)
+  {
+    scanBigWig(is);
+    return;
+  }
   visitBegin();
   _wiggleStream = is;
 
@@ -86,6 +94,47 @@ void WiggleScanner::scan(istream* is)
   _wiggleStream = NULL;
 }
 
+// feed the intervals of a bigWig file to the visitors as if they were
+// text lines, reading the file a window at a time
+void WiggleScanner::scanBigWig(istream* is)
+{
+  visitBegin();
+  BigWigReader reader;
+  reader.open(is);
+  vector<BigWigReader::Interval> intervals;
+  _lineNumber = 0;
+  for (hal_size_t chromId = 0; chromId < reader.getNumChroms(); ++chromId)
+  {
+    bool needHeader = true;
+    hal_size_t chromSize = reader.getChromSize(chromId);
+    for (hal_size_t start = 0; start < chromSize; start += BigWigWindow)
+    {
+      hal_size_t end = min(start + BigWigWindow, chromSize);
+      reader.getIntervals(chromId, start, end, intervals);
+      for (size_t i = 0; i < intervals.size(); ++i)
+      {
+        // already visited in the previous window
+        if (intervals[i]._start < start)
+        {
+          continue;
+        }
+        if (needHeader == true)
+        {
+          _sequenceName = reader.getChromName(chromId);
+          visitHeader();
+          needHeader = false;
+        }
+        ++_lineNumber;
+        _first = intervals[i]._start;
+        _last = intervals[i]._end - 1;
+        _value = intervals[i]._value;
+        visitLine();
+      }
+    }
+  }
+  visitEOF();
+}
+
 bool WiggleScanner::scanHeader(const string& lineBuffer)
 {
   stringstream ss(lineBuffer);
@@ -199,7 +248,7 @@ void WiggleScanner::scanLine(const string& lineBuffer)
     }
     assert(_first > 0);
     // store internally in 0-based coordinates.
-    --_start;
+    --_first;
   }
 
   ss >> _value;
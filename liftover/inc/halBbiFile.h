@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALBBIFILE_H
+#define _HALBBIFILE_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "hal.h"
+
+namespace hal {
+
+/** Structure shared by the UCSC indexed binary track formats (bigWig and
+ * bigBed): a header, a B+ tree of chromosome names, zlib-compressed data
+ * blocks, an R tree indexing the blocks by position, and a set of zoom
+ * levels of summaries (each with their own R tree).  Files are written
+ * (and read) in native little-endian byte order, as version 4. */
+class BbiFile
+{
+public:
+
+   /** One item of a data block, as seen by the summaries */
+   struct Item
+   {
+      uint32_t _chromId;
+      uint32_t _start;
+      uint32_t _end;
+      double _value;
+   };
+
+   /** Location and span of a compressed block */
+   struct Block
+   {
+      uint32_t _startChrom;
+      uint32_t _startBase;
+      uint32_t _endChrom;
+      uint32_t _endBase;
+      uint64_t _offset;
+      uint64_t _size;
+   };
+
+   /** Zoom level summary record */
+   struct Summary
+   {
+      uint32_t _chromId;
+      uint32_t _start;
+      uint32_t _end;
+      uint32_t _validCount;
+      float _minVal;
+      float _maxVal;
+      float _sumData;
+      float _sumSquares;
+   };
+
+   static const uint32_t BigWigMagic;
+   static const uint32_t BigBedMagic;
+   static const uint32_t ChromTreeMagic;
+   static const uint32_t IndexMagic;
+   static const uint16_t Version;
+   static const uint32_t IndexBlockSize;
+   static const uint32_t ChromBlockSize;
+   static const hal_size_t MaxZoomLevels;
+   static const hal_size_t ZoomIncrement;
+
+   /** Check if the stream begins with the given magic number.  The stream
+    * is left where it was */
+   static bool hasMagic(std::istream* stream, uint32_t magic);
+};
+
+/** Writes a bbi file.  Subclasses encode their items into blocks (all on
+ * the same chromosome, in order) and pass them to addBlock().  These are
+ * compressed and spilled to a temporary file until close(), when the
+ * index and zoom levels are computed and the whole file is written out
+ * sequentially (so the output stream needn't be seekable). */
+class BbiWriter : public BbiFile
+{
+public:
+
+   BbiWriter(uint32_t magic, hal_size_t itemsPerSlot);
+   virtual ~BbiWriter();
+
+   /** Start a file over the given chromosomes (name, length) */
+   virtual void open(std::ostream* outStream,
+                     const std::vector<std::pair<std::string,
+                     hal_size_t> >& chroms);
+
+   /** Start a file over all the sequences in a genome */
+   void open(std::ostream* outStream, const Genome* genome);
+
+   /** Write the file.  Nothing is written to the stream before this is
+    * called */
+   virtual void close();
+
+protected:
+
+   uint32_t getChromId(const std::string& chrom) const;
+   void addBlock(uint32_t chromId, uint32_t start, uint32_t end,
+                 const std::string& data, hal_size_t numItems,
+                 hal_size_t numBases);
+   virtual void decodeBlock(const std::string& data,
+                            std::vector<Item>& items) const = 0;
+   virtual std::string getAutoSql() const;
+   virtual uint16_t getFieldCount() const;
+   virtual uint16_t getDefinedFieldCount() const;
+
+   struct ZoomLevel
+   {
+      uint32_t _reduction;
+      hal_size_t _count;
+      bool _open;
+      uint32_t _window;
+      Summary _current;
+      std::vector<Summary> _pending;
+      std::vector<Block> _blocks;
+   };
+
+   void summarize(const Item& item);
+   void flushZoom(ZoomLevel& zoom, bool closeRecord);
+   void spillBlock(Block& block, const std::string& data);
+   void readSpilled(const Block& block, std::string& data) const;
+   void writeChromTree(std::string& buffer, uint64_t treeOffset) const;
+   void writeIndex(std::string& buffer, uint64_t indexOffset,
+                   const std::vector<Block>& blocks,
+                   uint64_t dataEnd) const;
+   void writeSpilled(const std::vector<Block>& blocks);
+   void clear();
+
+   std::ostream* _outStream;
+   uint32_t _magic;
+   hal_size_t _itemsPerSlot;
+   std::vector<std::string> _chromNames;
+   std::vector<hal_size_t> _chromSizes;
+   std::map<std::string, uint32_t> _chromIds;
+   std::vector<std::vector<Block> > _chromBlocks;
+   FILE* _spillFile;
+   uint64_t _spillEnd;
+   uint64_t _maxBlockSize;
+   hal_size_t _itemCount;
+   hal_size_t _itemBases;
+   std::vector<ZoomLevel> _zooms;
+   uint64_t _totalBases;
+   double _totalMin;
+   double _totalMax;
+   double _totalSum;
+   double _totalSumSquares;
+
+private:
+   BbiWriter(const BbiWriter&);
+   BbiWriter& operator=(const BbiWriter&);
+};
+
+/** Reads a bbi file from a seekable stream.  Subclasses decode the
+ * blocks returned by getBlocks() */
+class BbiReader : public BbiFile
+{
+public:
+
+   BbiReader(uint32_t magic);
+   virtual ~BbiReader();
+
+   void open(const std::string& path);
+   void open(std::istream* inStream);
+   void close();
+
+   hal_size_t getNumChroms() const;
+   const std::string& getChromName(hal_size_t chromId) const;
+   hal_size_t getChromSize(hal_size_t chromId) const;
+
+   /** Returns false if the chromosome isn't in the file */
+   bool getChromId(const std::string& chrom, hal_size_t& chromId) const;
+
+   uint16_t getFieldCount() const;
+   uint16_t getDefinedFieldCount() const;
+
+protected:
+
+   /** Get the (uncompressed) data blocks overlapping [start, end) */
+   void getBlocks(hal_size_t chromId, hal_size_t start, hal_size_t end,
+                  std::vector<std::string>& blocks);
+
+   template <class T> T read();
+   void readBytes(char* buffer, size_t size);
+   void readChromTree(uint64_t offset, uint32_t keySize);
+   void findBlocks(uint64_t offset, uint32_t chromId, uint32_t start,
+                   uint32_t end, std::vector<Block>& blocks);
+
+   std::istream* _inStream;
+   std::ifstream* _inFile;
+   uint32_t _magic;
+   uint16_t _fieldCount;
+   uint16_t _definedFieldCount;
+   uint64_t _fullIndexOffset;
+   uint32_t _uncompressBufSize;
+   std::vector<std::string> _chromNames;
+   std::vector<hal_size_t> _chromSizes;
+   std::map<std::string, hal_size_t> _chromIds;
+
+private:
+   BbiReader(const BbiReader&);
+   BbiReader& operator=(const BbiReader&);
+};
+
+}
+#endif
@@ -11,6 +11,7 @@
 #include <string>
 #include <ostream>
 #include "hal.h"
+#include "halBedTokenizer.h"
 
 namespace hal {
 
@@ -53,6 +54,8 @@ struct BedLine
    BedLine();
    virtual ~BedLine();
    std::istream& read(std::istream& is, int version, std::string& lineBuffer);
+   /** Read the fields of the tokenizer's current line */
+   void read(const BedTokenizer& tokens, int version);
    std::ostream& write(std::ostream& os, int version=-1);
    std::ostream& writePSL(std::ostream& os, bool prefixWithName=false);
    bool validatePSL() const;
@@ -80,6 +83,14 @@ struct BedLine
    // to write psl output.  put in vector so they dont get stored or 
    // copied around if not in use.  vector should never have length  > 1
    std::vector<PSLInfo> _psl;
+
+protected:
+
+   static bool readInt(const BedTokenizer& tokens, size_t field,
+                       hal_index_t& val);
+   static size_t readList(const char* field, size_t length, 
+                          hal_index_t* vals, size_t maxVals);
+   bool readBlockList(const BedTokenizer& tokens, size_t field, bool starts);
 };
 
 struct BedLineLess
@@ -16,6 +16,8 @@
 #include <locale>
 #include "hal.h"
 #include "halBedLine.h"
+#include "halBedTokenizer.h"
+#include "halBigBed.h"
 
 namespace hal {
 
@@ -31,12 +33,18 @@ public:
                      const std::locale* inLocale = NULL);
    virtual void scan(std::istream* bedStream, int bedVersion = -1,
                      const std::locale* inLocale = NULL);
+
+   /** Scan all the entries of a bigBed file, a window at a time.  The
+    * version defaults to the file's number of standard columns */
+   virtual void scanBigBed(BigBedReader& reader, int bedVersion = -1);
    
    static int getBedVersion(std::istream* bedStream, 
                             const std::locale* inLocale = NULL);
    static size_t getNumColumns(const std::string& bedLine,
                                const std::locale* inLocale = NULL);
 
+   static const hal_size_t BigBedWindow;
+
 protected:
    
    virtual void visitBegin();
@@ -50,6 +58,7 @@ protected:
 
    std::istream* _bedStream;
    BedLine _bedLine;
+   BedTokenizer _tokenizer;
    hal_size_t _lineNumber;
    int _bedVersion;
 };
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALBIGBED_H
+#define _HALBIGBED_H
+
+#include <vector>
+#include <string>
+#include "halBbiFile.h"
+
+namespace hal {
+
+/** Write a bigBed file.  Since liftover output isn't sorted, the entries
+ * are kept in memory and sorted when the file is closed. */
+class BigBedWriter : public BbiWriter
+{
+public:
+
+   BigBedWriter();
+   virtual ~BigBedWriter();
+
+   void open(std::ostream* outStream,
+             const std::vector<std::pair<std::string, hal_size_t> >& chroms);
+   using BbiWriter::open;
+   void close();
+
+   /** Number of standard BED columns (the rest are extra).  By default,
+    * all columns up to 12 are considered standard */
+   void setDefinedFieldCount(hal_size_t definedFieldCount);
+
+   /** Add an entry.  rest contains the tab-separated columns after the
+    * end coordinate (without a trailing newline) */
+   void addEntry(const std::string& chrom, hal_size_t start, hal_size_t end,
+                 const std::string& rest);
+
+   /** Add a BED line as written in text (ex by BedLine::write()) */
+   void addLine(const std::string& line);
+
+   static const hal_size_t ItemsPerSlot;
+
+protected:
+
+   struct Entry
+   {
+      uint32_t _start;
+      uint32_t _end;
+      std::string _rest;
+      bool operator<(const Entry& other) const;
+   };
+
+   void decodeBlock(const std::string& data, std::vector<Item>& items) const;
+   std::string getAutoSql() const;
+   uint16_t getFieldCount() const;
+   uint16_t getDefinedFieldCount() const;
+
+   std::vector<std::vector<Entry> > _entries;
+   hal_size_t _fieldCount;
+   hal_size_t _definedFieldCount;
+};
+
+/** Read a bigBed file */
+class BigBedReader : public BbiReader
+{
+public:
+
+   BigBedReader();
+   virtual ~BigBedReader();
+
+   struct Entry
+   {
+      hal_size_t _start;
+      hal_size_t _end;
+      std::string _rest;
+   };
+
+   /** Get all the entries (sorted) overlapping [start, end) in the 
+    * given sequence */
+   void getEntries(hal_size_t chromId, hal_size_t start, hal_size_t end,
+                   std::vector<Entry>& entries);
+
+   static bool isBigBed(std::istream* stream);
+};
+
+}
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALBIGWIG_H
+#define _HALBIGWIG_H
+
+#include <vector>
+#include <string>
+#include "halBbiFile.h"
+
+namespace hal {
+
+/** Write a bigWig file.  Intervals must be added in increasing order
+ * within each sequence (though the sequences can come in any order).
+ * Adjacent intervals with the same value are merged. */
+class BigWigWriter : public BbiWriter
+{
+public:
+
+   BigWigWriter();
+   virtual ~BigWigWriter();
+
+   void open(std::ostream* outStream,
+             const std::vector<std::pair<std::string, hal_size_t> >& chroms);
+   using BbiWriter::open;
+   void close();
+
+   /** Add a value over the (0-based, half-open) interval [start, end) */
+   void addInterval(const std::string& chrom, hal_size_t start,
+                    hal_size_t end, double value);
+
+   static const hal_size_t ItemsPerSlot;
+
+protected:
+
+   void flushInterval();
+   void flushSection();
+   void decodeBlock(const std::string& data, std::vector<Item>& items) const;
+
+   Item _interval;
+   bool _hasInterval;
+   std::vector<Item> _section;
+   std::vector<uint32_t> _chromEnds;
+};
+
+/** Read a bigWig file */
+class BigWigReader : public BbiReader
+{
+public:
+
+   BigWigReader();
+   virtual ~BigWigReader();
+
+   struct Interval
+   {
+      hal_size_t _start;
+      hal_size_t _end;
+      double _value;
+   };
+
+   /** Get all the intervals (sorted) overlapping [start, end) in the 
+    * given sequence */
+   void getIntervals(hal_size_t chromId, hal_size_t start, hal_size_t end,
+                     std::vector<Interval>& intervals);
+
+   static bool isBigWig(std::istream* stream);
+};
+
+}
+#endif
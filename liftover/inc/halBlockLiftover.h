@@ -8,6 +8,7 @@
 #define _HALBLOCKLIFTOVER_H
 
 #include <vector>
+#include <deque>
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -27,15 +28,41 @@ protected:
    void liftInterval(BedList& mappedBedLines);
    void visitBegin();
 
+   void updateWindow(hal_index_t globalStart, hal_index_t globalEnd);
+   bool sliceWindow(hal_index_t globalStart, hal_index_t globalEnd, 
+                    bool flip);
+   void mapInterval(hal_index_t globalStart, hal_index_t globalEnd, 
+                    bool flip);
+
+   typedef std::vector<std::pair<hal_index_t, hal_index_t> > TargetRanges;
+   static void addTargetRange(const MappedSegmentConstPtr& mapped,
+                              TargetRanges& tgtRanges);
+   static bool hasOverlaps(TargetRanges& tgtRanges, bool allowSame);
+
    void cleanTargetParalogies();
    void readPSLInfo(std::vector<MappedSegmentConstPtr>& fragments, 
                     BedLine& outBedLine);
 
    
 protected: 
+
+   // all the segments that a single (unsliced) source segment maps to.  
+   // kept around so that consecutive intervals in sorted input can 
+   // reuse them instead of remapping the same source segments.  
+   // _overlaps is set if any of them overlap each other in the target
+   struct WindowEntry
+   {
+      hal_index_t _start;
+      hal_index_t _end;
+      std::vector<MappedSegmentConstPtr> _mapped;
+      bool _overlaps;
+   };
    
    std::set<MappedSegmentConstPtr> _mappedSegments;
+   std::deque<WindowEntry> _window;
+   hal_index_t _prevGlobalStart;
    SegmentIteratorConstPtr _refSeg;
+   SegmentIteratorConstPtr _windowSeg;
    hal_index_t _lastIndex;
    std::set<const Genome*> _downwardPath;
    const Genome *_mrca;
@@ -15,30 +15,73 @@
 
 namespace hal {
 
+/** Liftover that gives the same results as walking the interval with a
+ * column iterator (scoped to the source and target genomes), but that
+ * follows the column's edges a segment at a time instead of a base at a
+ * time. */
 class ColumnLiftover : public Liftover
 {
 public:
-   
+
    ColumnLiftover();
    virtual ~ColumnLiftover();
-                   
+
 protected:
 
+   void visitBegin();
    void liftInterval(BedList& mappedBedLines);
 
-   typedef ColumnIterator::DNASet DNASet;
-   typedef ColumnIterator::ColumnMap ColumnMap;
-   typedef PositionCache::IntervalSet IntervalSet;
-   
+   void liftRange(hal_index_t first, hal_index_t last, bool flip);
+   void liftSlice(hal_index_t first, hal_index_t last, bool flip);
+   void markVisited(hal_index_t first, hal_index_t last);
+   void updateRefTop(TopSegmentIteratorConstPtr top);
+   void updateRefBottom(BottomSegmentIteratorConstPtr bottom);
+   void updateParent(TopSegmentIteratorConstPtr top);
+   void updateChild(BottomSegmentIteratorConstPtr bottom, hal_size_t index);
+   void updateNextTopDup(TopSegmentIteratorConstPtr top);
+   void updateParseUp(BottomSegmentIteratorConstPtr bottom);
+   void updateParseDown(TopSegmentIteratorConstPtr top);
+   void insertTarget(SegmentIteratorConstPtr segment);
+   void writeIntervals(BedList& mappedBedLines, bool reversed);
+
+   bool parentInScope(const Genome* genome) const;
+   bool childInScope(const Genome* genome, hal_size_t child) const;
+
    typedef std::pair<const Sequence*, hal_size_t> SeqIndex;
-   typedef std::map<SeqIndex, PositionCache*> PositionMap;
-   
-protected: 
-   
-   ColumnIteratorConstPtr _colIt;
-   std::set<std::string> _missedSet;
+   typedef std::vector<std::pair<hal_index_t, hal_index_t> > IntervalList;
+   typedef std::map<SeqIndex, IntervalList> IntervalMap;
+
+   struct PendingTarget
+   {
+      const Sequence* _sequence;
+      bool _reversed;
+      hal_index_t _first;
+      hal_index_t _last;
+   };
+
+protected:
+
+   SegmentIteratorConstPtr _refSeg;
+   hal_index_t _lastIndex;
+   std::set<const Genome*> _scope;
+   IntervalMap _fwdIntervals;
+   IntervalMap _revIntervals;
+   std::vector<PendingTarget> _pendingTargets;
+   IntervalList _pendingRefs;
+   std::map<hal_index_t, hal_index_t> _visited;
    bool _outParalogy;
 };
 
+inline bool ColumnLiftover::parentInScope(const Genome* genome) const
+{
+  return _scope.find(genome->getParent()) != _scope.end();
+}
+
+inline bool ColumnLiftover::childInScope(const Genome* genome,
+                                         hal_size_t child) const
+{
+  return _scope.find(genome->getChild(child)) != _scope.end();
+}
+
 }
 #endif
@@ -36,6 +36,10 @@ public:
                 bool outPSLWithName = false,
                 const std::locale* inLocale = NULL,
                 const Genome *coalescenceLimit = NULL);
+
+   /** Write the output stream as a bigBed file (over the target genome's
+    * sequences) instead of text.  bigBed input is always detected. */
+   void setOutBigBed(bool outBigBed);
                    
 protected:
 
@@ -53,6 +57,8 @@ protected:
    virtual void cleanResults();
    virtual void liftBlockIntervals();
    virtual void liftInterval(BedList& mappedBedLines) = 0;
+   void openOutput();
+   void closeOutput();
    
 protected: 
 
@@ -77,6 +83,9 @@ protected:
 
    ColumnIteratorConstPtr _colIt;
    std::set<std::string> _missedSet;
+
+   bool _outBigBed;
+   BigBedWriter _bigBedWriter;
 };
 
 }
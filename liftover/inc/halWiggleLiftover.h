@@ -13,6 +13,7 @@
 #include <iostream>
 #include "halWiggleScanner.h"
 #include "halWiggleTiles.h"
+#include "halBigWig.h"
 
 namespace hal {
 
@@ -23,6 +24,18 @@ public:
    WiggleLiftover();
    virtual ~WiggleLiftover();
    
+   /** Bound the memory used to store the lifted values: at most maxTiles
+    * tiles are kept uncompressed, and at most maxRunBytes of compressed
+    * tiles are kept in memory before spilling to a temporary file.  0 means
+    * no limit.  Must be called before preloadOutput() and convert() */
+   void setMaxMemory(hal_size_t maxTiles, hal_size_t maxRunBytes);
+
+   /** Write variableStep instead of fixedStep wiggle output */
+   void setVariableStep(bool variableStep);
+
+   /** Write bigWig instead of text wiggle output */
+   void setBigWig(bool bigWig);
+
    void preloadOutput(AlignmentConstPtr alignment,
                       const Genome* tgtGenome,
                       std::istream* inputFile);
@@ -37,6 +50,8 @@ public:
 
    static const double DefaultValue;
    static const hal_size_t DefaultTileSize;
+   static const hal_size_t DefaultMaxTiles;
+   static const hal_size_t DefaultMaxRunBytes;
 
 protected:
 
@@ -46,7 +61,13 @@ protected:
 
    void mapSegment();
    void mapFragments(std::vector<MappedSegmentConstPtr>& fragments);
+   void findSources();
+   void countSourceGroups(std::istream* inputFile);
+   void finishSource(hal_index_t src);
+   void writeSequence(const Sequence* tgtSequence);
    void write();
+   void writeRun(hal_index_t pos, hal_size_t length, double val);
+   void writeBigWigRun(hal_index_t pos, hal_size_t length, double val);
                       
 protected: 
 
@@ -70,6 +91,25 @@ protected:
    ValVec _cvals;
    WiggleTiles<double> _outVals;
    hal_index_t _cvIdx; 
+   hal_size_t _maxTiles;
+   hal_size_t _maxRunBytes;
+   bool _variableStep;
+   bool _bigWig;
+   BigWigWriter _bigWigWriter;
+   const Sequence* _outSequence;
+   hal_index_t _prevPos;
+
+   // each target sequence is written as soon as the input of all the
+   // source sequences that can map to it has been read.  _numSources
+   // counts those not yet finished (NULL_INDEX if there are too many to
+   // keep track of), _srcTargets lists the targets of each source, and
+   // _srcGroups counts the groups of lines of each source still to come
+   // in the input (NULL_INDEX if unknown)
+   std::vector<hal_index_t> _numSources;
+   std::vector<std::vector<hal_index_t> > _srcTargets;
+   std::vector<hal_index_t> _srcGroups;
+   std::vector<bool> _tgtWritten;
+   std::vector<const Sequence*> _tgtSequences;
 
 };
 
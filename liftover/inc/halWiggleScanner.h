@@ -18,7 +18,9 @@
 
 namespace hal {
 
-/** Parse a WIGGLE file line by line */
+/** Parse a WIGGLE file line by line.  bigWig input is also accepted 
+ * (from a seekable stream), in which case each interval is visited as 
+ * a line */
 class WiggleScanner
 {
 public:
@@ -26,6 +28,8 @@ public:
    virtual ~WiggleScanner();
    virtual void scan(const std::string& wigglePath);
    virtual void scan(std::istream* wiggleStream);
+
+   static const hal_size_t BigWigWindow;
    
 protected:
    
@@ -36,6 +40,7 @@ protected:
    
    virtual bool scanHeader(const std::string& lineBuffer);
    virtual void scanLine(const std::string& lineBuffer);
+   virtual void scanBigWig(std::istream* wiggleStream);
    static void skipWhiteSpaces(std::istream* wiggleStream);
 
 protected:
@@ -8,29 +8,55 @@
 #define _HALWIGGLETILES_H
 
 #include <vector>
+#include <list>
+#include <map>
+#include <set>
 #include <string>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <limits>
+#include <unistd.h>
 #include "hal.h"
 
 namespace hal {
 
 /** Memory structure to keep track of wiggle results by tiling the genome
  * into regular intervals.  The idea is that if we are only writing a 
- * subregion, then we don't bother allocating space for the whole genome 
+ * subregion, then we don't bother allocating space for the whole genome.
+ *
+ * Only the most recently used tiles are kept as plain arrays.  The others
+ * are run-length compressed (runs of consecutive set positions with the
+ * same value) and, once the compressed tiles take up too much memory,
+ * spilled to a temporary file.  They are transparently reloaded when 
+ * accessed again.  The file space of released tiles is reused, and given
+ * back once it is at the end of the file.
 */
 template <class T>
 class WiggleTiles
 {
 public:
+
+   /** A run of consecutive set positions, all with the same value.  The
+    * offset is relative to the start of the tile */
+   struct Run
+   {
+      uint32_t _offset;
+      uint32_t _length;
+      T _value;
+   };
    
    WiggleTiles();
    virtual ~WiggleTiles();
 
    /** Initialize the dimensions of the structure and default value.  No
-    * memory is allocated */
+    * memory is allocated.  At most maxTiles tiles are kept uncompressed
+    * and at most maxRunBytes bytes of compressed tiles are kept in memory
+    * before being spilled to disk (0 means no limit for either). */
    void init(hal_size_t genomeSize, T defualtValue, 
-             hal_size_t tileSize);
+             hal_size_t tileSize, hal_size_t maxTiles = 0,
+             hal_size_t maxRunBytes = 0);
    void clear();
 
    /** Get a value.  If the position does not exist in a tile, then we return
@@ -47,43 +73,104 @@ public:
     * where it was not set, or if it was set with the default value */
    bool exists(hal_index_t pos) const;
 
+   /** Get the set positions of a tile as a list of runs in increasing
+    * order, without uncompressing it */
+   void getRuns(hal_size_t tile, std::vector<Run>& runs) const;
+
+   /** Free all memory (and disk) used by a tile.  All of its positions
+    * revert to unset */
+   void releaseTile(hal_size_t tile);
+
+   /** Unset the positions [first, last], releasing the tiles that are
+    * entirely within them */
+   void erase(hal_index_t first, hal_index_t last);
+
    /** Methods to get basic structure info */
    hal_size_t getGenomeSize() const;
    hal_size_t getTileSize() const;
    hal_size_t getNumTiles() const;
    bool isTileEmpty(hal_size_t tile) const;
    T getDefaultValue() const;
+   /** Number of bytes of the spill file in use (or free for reuse) */
+   hal_size_t getSpillSize() const;
    
 protected:
 
-   std::vector<std::vector<T> > _tiles;
-   std::vector<std::vector<bool> > _bits;
+   struct Tile
+   {
+      Tile() : _spillPos(NULL_INDEX), _spillCapacity(0), _spilled(false) {}
+      std::vector<T> _vals;
+      std::vector<bool> _bits;
+      std::vector<Run> _runs;
+      typename std::list<hal_size_t>::iterator _lru;
+      hal_index_t _spillPos;
+      hal_size_t _spillCapacity;
+      bool _spilled;
+   };
+
+   hal_size_t getTileLength(hal_size_t tile) const;
+   void touch(hal_size_t tile) const;
+   void compress(hal_size_t tile) const;
+   void uncompress(hal_size_t tile) const;
+   void makeRuns(const Tile& tile, std::vector<Run>& runs) const;
+   void readRuns(const Tile& tile, std::vector<Run>& runs) const;
+   void spill(hal_size_t tile) const;
+   void freeSlot(Tile& tile) const;
+
+   mutable std::vector<Tile> _tiles;
+   mutable std::list<hal_size_t> _lruList;
+   mutable hal_size_t _runBytes;
+   mutable FILE* _spillFile;
+   mutable hal_index_t _spillEnd;
+   // slots of the spill file that no tile uses, by (capacity in runs,
+   // position), and their positions by end
+   mutable std::set<std::pair<hal_size_t, hal_index_t> > _freeSlots;
+   mutable std::map<hal_index_t, hal_index_t> _freeEnds;
+   mutable hal_size_t _numSlots;
    hal_size_t _tileSize;
    hal_size_t _genomeSize;
    hal_size_t _lastTileSize;
+   hal_size_t _maxTiles;
+   hal_size_t _maxRunBytes;
    T _defaultValue;
+
+private:
+   WiggleTiles(const WiggleTiles&);
+   WiggleTiles& operator=(const WiggleTiles&);
 };
 
 
 // INLINE METHODS
 template <class T>
-inline WiggleTiles<T>::WiggleTiles() : _tileSize(0), _genomeSize(0),
-                                    _lastTileSize(0)
+inline WiggleTiles<T>::WiggleTiles() : _runBytes(0), _spillFile(NULL),
+                                       _spillEnd(0), _numSlots(0),
+                                       _tileSize(0),
+                                       _genomeSize(0), _lastTileSize(0),
+                                       _maxTiles(0), _maxRunBytes(0)
 {
 }
 
 template <class T>
 inline WiggleTiles<T>::~WiggleTiles() 
 {
+  clear();
 }
 
 template <class T>
 inline void WiggleTiles<T>::init(hal_size_t genomeSize, T defaultValue, 
-                         hal_size_t tileSize)
+                                 hal_size_t tileSize, hal_size_t maxTiles,
+                                 hal_size_t maxRunBytes)
 {
+  clear();
   _genomeSize = genomeSize;
   _defaultValue = defaultValue;
   _tileSize = std::min(tileSize, genomeSize);
+  if (_tileSize > (hal_size_t)std::numeric_limits<uint32_t>::max())
+  {
+    throw hal_exception("WiggleTiles tile size too big");
+  }
+  _maxTiles = maxTiles;
+  _maxRunBytes = maxRunBytes;
   _lastTileSize = genomeSize % _tileSize;
   hal_size_t numTiles = genomeSize / _tileSize;
   if (_lastTileSize > 0)
@@ -94,20 +181,24 @@ inline void WiggleTiles<T>::init(hal_size_t genomeSize, T defaultValue,
   {
     _lastTileSize = _tileSize;
   }
-  for (size_t i = 0; i < _tiles.size(); ++i)
-  {
-    _tiles[i].clear();
-    _bits[i].clear();
-  }
   _tiles.resize(numTiles);
-  _bits.resize(numTiles);
 }
 
 template <class T>
 inline void WiggleTiles<T>::clear()
 {
   _tiles.clear();
-  _bits.clear();
+  _lruList.clear();
+  _runBytes = 0;
+  if (_spillFile != NULL)
+  {
+    fclose(_spillFile);
+    _spillFile = NULL;
+  }
+  _spillEnd = 0;
+  _freeSlots.clear();
+  _freeEnds.clear();
+  _numSlots = 0;
   _tileSize = 0;
   _genomeSize = 0;
   _lastTileSize = 0;
@@ -119,14 +210,13 @@ inline T WiggleTiles<T>::get(hal_index_t pos) const
   assert(pos < _genomeSize);
   hal_size_t tile = pos / _tileSize;
   assert(tile < _tiles.size());
-  assert(_tiles[tile].size() == 0 || _tiles[tile].size() == _tileSize ||
-         _tiles[tile].size() == _lastTileSize);
-  if (_tiles[tile].size() == 0)
+  if (isTileEmpty(tile) == true)
   {
     return _defaultValue;
   }
+  touch(tile);
   hal_size_t offset = pos % _tileSize;
-  return _tiles[tile][offset];
+  return _tiles[tile]._vals[offset];
 }
 
 template <class T>
@@ -135,17 +225,10 @@ inline void WiggleTiles<T>::set(hal_index_t pos, T val)
   assert(pos < _genomeSize);
   hal_size_t tile = pos / _tileSize;
   assert(tile < _tiles.size());
-  assert(_tiles[tile].size() == 0 || _tiles[tile].size() == _tileSize ||
-         _tiles[tile].size() == _lastTileSize);
-  if (_tiles[tile].size() == 0)
-  {
-    hal_size_t len = tile == _tiles.size() - 1 ? _lastTileSize : _tileSize;
-    _tiles[tile].assign(len, _defaultValue);
-    _bits[tile].assign(len, false);
-  }
+  touch(tile);
   hal_size_t offset = pos % _tileSize;
-  _tiles[tile][offset] = val;
-  _bits[tile][offset] = true;
+  _tiles[tile]._vals[offset] = val;
+  _tiles[tile]._bits[offset] = true;
 }
 
 template <class T>
@@ -154,14 +237,84 @@ inline bool WiggleTiles<T>::exists(hal_index_t pos) const
   assert(pos < _genomeSize);
   hal_size_t tile = pos / _tileSize;
   assert(tile < _tiles.size());
-  assert(_tiles[tile].size() == 0 || _tiles[tile].size() == _tileSize ||
-         _tiles[tile].size() == _lastTileSize);
-  if (_tiles[tile].size() == 0)
+  if (isTileEmpty(tile) == true)
   {
     return false;
   }
+  touch(tile);
   hal_size_t offset = pos % _tileSize;
-  return _bits[tile][offset];
+  return _tiles[tile]._bits[offset];
+}
+
+template <class T>
+inline void WiggleTiles<T>::getRuns(hal_size_t tile,
+                                    std::vector<Run>& runs) const
+{
+  assert(tile < _tiles.size());
+  const Tile& t = _tiles[tile];
+  runs.clear();
+  if (t._vals.empty() == false)
+  {
+    makeRuns(t, runs);
+  }
+  else if (t._spilled == true)
+  {
+    readRuns(t, runs);
+  }
+  else
+  {
+    runs = t._runs;
+  }
+}
+
+template <class T>
+inline void WiggleTiles<T>::releaseTile(hal_size_t tile)
+{
+  assert(tile < _tiles.size());
+  Tile& t = _tiles[tile];
+  if (t._vals.empty() == false)
+  {
+    _lruList.erase(t._lru);
+  }
+  _runBytes -= t._runs.size() * sizeof(Run);
+  std::vector<T>().swap(t._vals);
+  std::vector<bool>().swap(t._bits);
+  std::vector<Run>().swap(t._runs);
+  t._spilled = false;
+  freeSlot(t);
+}
+
+template <class T>
+inline void WiggleTiles<T>::erase(hal_index_t first, hal_index_t last)
+{
+  assert(first >= 0 && last < (hal_index_t)_genomeSize);
+  if (last < first)
+  {
+    return;
+  }
+  for (hal_size_t tile = first / _tileSize; tile <= last / _tileSize; ++tile)
+  {
+    if (isTileEmpty(tile) == true)
+    {
+      continue;
+    }
+    hal_index_t tileStart = tile * _tileSize;
+    hal_index_t tileLast = tileStart + getTileLength(tile) - 1;
+    if (first <= tileStart && last >= tileLast)
+    {
+      releaseTile(tile);
+    }
+    else
+    {
+      touch(tile);
+      Tile& t = _tiles[tile];
+      hal_size_t start = std::max(first, tileStart) - tileStart;
+      hal_size_t end = std::min(last, tileLast) + 1 - tileStart;
+      std::fill(t._vals.begin() + start, t._vals.begin() + end,
+                _defaultValue);
+      std::fill(t._bits.begin() + start, t._bits.begin() + end, false);
+    }
+  }
 }
 
 template <class T>
@@ -186,7 +339,8 @@ template <class T>
 inline bool WiggleTiles<T>::isTileEmpty(hal_size_t tile) const
 {
   assert(tile < _tiles.size());
-  return _tiles[tile].empty();
+  const Tile& t = _tiles[tile];
+  return t._vals.empty() && t._runs.empty() && !t._spilled;
 }
 
 template <class T>
@@ -195,5 +349,224 @@ inline T WiggleTiles<T>::getDefaultValue() const
   return _defaultValue;
 }
 
+template <class T>
+inline hal_size_t WiggleTiles<T>::getSpillSize() const
+{
+  return _spillEnd;
+}
+
+template <class T>
+inline hal_size_t WiggleTiles<T>::getTileLength(hal_size_t tile) const
+{
+  return tile == _tiles.size() - 1 ? _lastTileSize : _tileSize;
+}
+
+// make sure the tile is uncompressed and at the front of the lru list,
+// compressing the least recently used tile if there are now too many
+template <class T>
+inline void WiggleTiles<T>::touch(hal_size_t tile) const
+{
+  Tile& t = _tiles[tile];
+  if (t._vals.empty() == false)
+  {
+    if (t._lru != _lruList.begin())
+    {
+      _lruList.splice(_lruList.begin(), _lruList, t._lru);
+    }
+    return;
+  }
+  uncompress(tile);
+  _lruList.push_front(tile);
+  t._lru = _lruList.begin();
+  if (_maxTiles > 0 && _lruList.size() > _maxTiles)
+  {
+    compress(_lruList.back());
+  }
+}
+
+template <class T>
+inline void WiggleTiles<T>::compress(hal_size_t tile) const
+{
+  Tile& t = _tiles[tile];
+  assert(t._vals.empty() == false && t._runs.empty());
+  _lruList.erase(t._lru);
+  makeRuns(t, t._runs);
+  std::vector<T>().swap(t._vals);
+  std::vector<bool>().swap(t._bits);
+  _runBytes += t._runs.size() * sizeof(Run);
+  if (_maxRunBytes > 0 && _runBytes > _maxRunBytes)
+  {
+    spill(tile);
+  }
+}
+
+template <class T>
+inline void WiggleTiles<T>::uncompress(hal_size_t tile) const
+{
+  Tile& t = _tiles[tile];
+  assert(t._vals.empty() == true);
+  hal_size_t len = getTileLength(tile);
+  t._vals.assign(len, _defaultValue);
+  t._bits.assign(len, false);
+  if (t._spilled == true)
+  {
+    readRuns(t, t._runs);
+    _runBytes += t._runs.size() * sizeof(Run);
+    t._spilled = false;
+  }
+  for (size_t i = 0; i < t._runs.size(); ++i)
+  {
+    const Run& run = t._runs[i];
+    std::fill(t._vals.begin() + run._offset,
+              t._vals.begin() + run._offset + run._length, run._value);
+    std::fill(t._bits.begin() + run._offset,
+              t._bits.begin() + run._offset + run._length, true);
+  }
+  _runBytes -= t._runs.size() * sizeof(Run);
+  std::vector<Run>().swap(t._runs);
+}
+
+template <class T>
+inline void WiggleTiles<T>::makeRuns(const Tile& tile,
+                                     std::vector<Run>& runs) const
+{
+  runs.clear();
+  for (size_t i = 0; i < tile._vals.size(); ++i)
+  {
+    if (tile._bits[i] == true)
+    {
+      if (runs.empty() == false && 
+          runs.back()._offset + runs.back()._length == i &&
+          runs.back()._value == tile._vals[i])
+      {
+        ++runs.back()._length;
+      }
+      else
+      {
+        Run run = {(uint32_t)i, 1, tile._vals[i]};
+        runs.push_back(run);
+      }
+    }
+  }
+}
+
+template <class T>
+inline void WiggleTiles<T>::readRuns(const Tile& tile,
+                                     std::vector<Run>& runs) const
+{
+  assert(tile._spilled == true && _spillFile != NULL);
+  runs.resize(tile._spillCapacity);
+  if (fseek(_spillFile, tile._spillPos, SEEK_SET) != 0 ||
+      fread(&runs[0], sizeof(Run), runs.size(), _spillFile) != runs.size())
+  {
+    throw hal_exception("Error reading WiggleTiles spill file");
+  }
+  // a slot can be bigger than what's stored in it: unused runs are
+  // written with zero length
+  while (runs.empty() == false && runs.back()._length == 0)
+  {
+    runs.pop_back();
+  }
+}
+
+// write a compressed tile to disk, reusing the tile's previous slot in the
+// file if it is big enough, or else the smallest free one that is
+template <class T>
+inline void WiggleTiles<T>::spill(hal_size_t tile) const
+{
+  Tile& t = _tiles[tile];
+  assert(t._vals.empty() == true && t._spilled == false);
+  if (t._runs.empty() == true)
+  {
+    return;
+  }
+  if (_spillFile == NULL)
+  {
+    _spillFile = tmpfile();
+    if (_spillFile == NULL)
+    {
+      throw hal_exception("Error creating WiggleTiles spill file");
+    }
+  }
+  if (t._spillPos == NULL_INDEX || t._spillCapacity < t._runs.size())
+  {
+    freeSlot(t);
+    typename std::set<std::pair<hal_size_t, hal_index_t> >::iterator i =
+       _freeSlots.lower_bound(std::make_pair(t._runs.size(), 0));
+    if (i != _freeSlots.end())
+    {
+      t._spillCapacity = i->first;
+      t._spillPos = i->second;
+      _freeEnds.erase(t._spillPos + t._spillCapacity * sizeof(Run));
+      _freeSlots.erase(i);
+    }
+    else
+    {
+      t._spillPos = _spillEnd;
+      t._spillCapacity = t._runs.size();
+      _spillEnd += t._spillCapacity * sizeof(Run);
+    }
+    ++_numSlots;
+  }
+  _runBytes -= t._runs.size() * sizeof(Run);
+  Run empty = {0, 0, _defaultValue};
+  t._runs.resize(t._spillCapacity, empty);
+  if (fseek(_spillFile, t._spillPos, SEEK_SET) != 0 ||
+      fwrite(&t._runs[0], sizeof(Run), t._runs.size(), _spillFile) != 
+      t._runs.size())
+  {
+    throw hal_exception("Error writing WiggleTiles spill file");
+  }
+  std::vector<Run>().swap(t._runs);
+  t._spilled = true;
+}
+
+// give back a tile's slot in the spill file.  the file is truncated when
+// the slot is at its end (along with the free slots just before it), or
+// when no tile is left in it
+template <class T>
+inline void WiggleTiles<T>::freeSlot(Tile& tile) const
+{
+  if (tile._spillPos == NULL_INDEX)
+  {
+    return;
+  }
+  assert(_numSlots > 0);
+  --_numSlots;
+  hal_index_t pos = tile._spillPos;
+  hal_index_t end = pos + tile._spillCapacity * sizeof(Run);
+  tile._spillPos = NULL_INDEX;
+  tile._spillCapacity = 0;
+  if (_numSlots == 0)
+  {
+    _freeSlots.clear();
+    _freeEnds.clear();
+    pos = 0;
+  }
+  else if (end != _spillEnd)
+  {
+    _freeSlots.insert(std::make_pair((end - pos) / sizeof(Run), pos));
+    _freeEnds.insert(std::make_pair(end, pos));
+    return;
+  }
+  else
+  {
+    std::map<hal_index_t, hal_index_t>::iterator i;
+    while ((i = _freeEnds.find(pos)) != _freeEnds.end())
+    {
+      _freeSlots.erase(std::make_pair((pos - i->second) / sizeof(Run),
+                                      i->second));
+      pos = i->second;
+      _freeEnds.erase(i);
+    }
+  }
+  _spillEnd = pos;
+  fflush(_spillFile);
+  if (ftruncate(fileno(_spillFile), _spillEnd) != 0)
+  {
+    throw hal_exception("Error truncating WiggleTiles spill file");
+  }
+}
+
 }
 #endif
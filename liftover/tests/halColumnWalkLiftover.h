@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALCOLUMNWALKLIFTOVER_H
+#define _HALCOLUMNWALKLIFTOVER_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include "halLiftover.h"
+
+namespace hal {
+
+/** The original ColumnLiftover, which walks each interval one column at a
+ * time.  Kept in the tests to check the segment-based version against. */
+class ColumnWalkLiftover : public Liftover
+{
+public:
+   
+   ColumnWalkLiftover();
+   virtual ~ColumnWalkLiftover();
+                   
+protected:
+
+   void liftInterval(BedList& mappedBedLines);
+
+   typedef ColumnIterator::DNASet DNASet;
+   typedef ColumnIterator::ColumnMap ColumnMap;
+   typedef PositionCache::IntervalSet IntervalSet;
+   
+   typedef std::pair<const Sequence*, hal_size_t> SeqIndex;
+   typedef std::map<SeqIndex, PositionCache*> PositionMap;
+   
+protected: 
+   
+   ColumnIteratorConstPtr _colIt;
+   std::set<std::string> _missedSet;
+   bool _outParalogy;
+};
+
+}
+#endif
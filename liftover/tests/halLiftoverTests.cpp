@@ -4,8 +4,17 @@
  * Released under the MIT license, see LICENSE.txt
  */
 #include <cstdio>
+#include <map>
 #include "hal.h"
 #include "halBlockLiftover.h"
+#include "halColumnLiftover.h"
+#include "halColumnWalkLiftover.h"
+#include "halWiggleTiles.h"
+#include "halWiggleLiftover.h"
+#include "halWiggleScanner.h"
+#include "halBigWig.h"
+#include "halBigBed.h"
+#include "halTabFacet.h"
 #include "halLiftoverTests.h"
 
 using namespace std;
@@ -352,6 +361,290 @@ void BedLiftoverTest::testMultiBranchLifts(AlignmentConstPtr alignment)
   
 }
 
+// overlapping intervals in sorted input reuse the mappings of the
+// previous lines.  make sure we get the same thing as lifting each line
+// on its own.
+void BedLiftoverTest::testSortedLifts(AlignmentConstPtr alignment)
+{
+  const Genome *root = alignment->openGenome("root");
+  const Genome *child1 = alignment->openGenome("child1");
+  const Genome *leaf2 = alignment->openGenome("leaf2");
+  const Genome *leaf3 = alignment->openGenome("leaf3");
+
+  vector<string> bedLines;
+  bedLines.push_back("Sequence\t0\t30\tA\t0\t+\n");
+  bedLines.push_back("Sequence\t5\t15\tB\t0\t-\n");
+  bedLines.push_back("Sequence\t10\t60\tC\t0\t+\n");
+  bedLines.push_back("Sequence\t12\t13\tD\t0\t+\n");
+  bedLines.push_back("Sequence\t40\t70\tE\t0\t-\n");
+  bedLines.push_back("Sequence\t65\t100\tF\t0\t+\n");
+  bedLines.push_back("Sequence\t20\t45\tUNSORTED\t0\t+\n");
+  bedLines.push_back("Sequence\t90\t100\tG\t0\t+\n");
+
+  const Genome* srcGenomes[] = {child1, root, leaf3};
+  const Genome* tgtGenomes[] = {root, leaf2, leaf2};
+  for (size_t i = 0; i < 3; ++i)
+  {
+    stringstream expected;
+    for (size_t j = 0; j < bedLines.size(); ++j)
+    {
+      BlockLiftover liftover;
+      stringstream bedFile(bedLines[j]);
+      liftover.convert(alignment, srcGenomes[i], &bedFile, tgtGenomes[i],
+                       &expected);
+    }
+    BlockLiftover liftover;
+    stringstream bedFile;
+    for (size_t j = 0; j < bedLines.size(); ++j)
+    {
+      bedFile << bedLines[j];
+    }
+    stringstream outStream;
+    liftover.convert(alignment, srcGenomes[i], &bedFile, tgtGenomes[i],
+                     &outStream);
+    CuAssertTrue(_testCase, outStream.str() == expected.str());
+  }
+}
+
+// the segment-based column liftover must give exactly what we get by
+// walking the interval column by column
+void BedLiftoverTest::testColumnLifts(AlignmentConstPtr alignment)
+{
+  const char* genomeNames[] = {"root", "child1", "leaf1", "leaf2", "leaf3"};
+  string bedLines = "Sequence\t0\t70\tA\t0\t+\n"
+     "Sequence\t3\t47\tB\t0\t-\n"
+     "Sequence\t10\t11\tC\t0\t+\n"
+     "Sequence\t19\t41\tD\t0\t.\n"
+     "Sequence\t55\t70\tE\t0\t-\n";
+
+  for (size_t i = 0; i < 5; ++i)
+  {
+    const Genome* srcGenome = alignment->openGenome(genomeNames[i]);
+    for (size_t j = 0; j < 5; ++j)
+    {
+      const Genome* tgtGenome = alignment->openGenome(genomeNames[j]);
+      for (size_t dupes = 0; dupes < 2; ++dupes)
+      {
+        ColumnWalkLiftover walkLiftover;
+        stringstream walkBedFile(bedLines);
+        stringstream walkStream;
+        walkLiftover.convert(alignment, srcGenome, &walkBedFile, tgtGenome,
+                             &walkStream, -1, -1, false, dupes == 1);
+
+        ColumnLiftover liftover;
+        stringstream bedFile(bedLines);
+        stringstream outStream;
+        liftover.convert(alignment, srcGenome, &bedFile, tgtGenome,
+                         &outStream, -1, -1, false, dupes == 1);
+
+        CuAssertTrue(_testCase, outStream.str() == walkStream.str());
+      }
+    }
+  }
+}
+
+// enough chromosomes and entries to need several levels in both the
+// chromosome tree and the index
+void BedLiftoverTest::testBigBed()
+{
+  hal_size_t numChroms = 300;
+  hal_size_t chromSize = 100000;
+  vector<pair<string, hal_size_t> > chroms;
+  vector<vector<BigBedReader::Entry> > truth(numChroms);
+  for (hal_size_t i = 0; i < numChroms; ++i)
+  {
+    stringstream name;
+    name << "chr" << i;
+    chroms.push_back(pair<string, hal_size_t>(name.str(), chromSize));
+  }
+
+  stringstream buffer;
+  BigBedWriter writer;
+  writer.open(&buffer, chroms);
+  writer.setDefinedFieldCount(4);
+  for (hal_size_t i = 0; i < numChroms * 10; ++i)
+  {
+    hal_size_t chromId = rand() % numChroms;
+    BigBedReader::Entry entry;
+    entry._start = rand() % (chromSize - 100);
+    entry._end = entry._start + 1 + rand() % 100;
+    stringstream rest;
+    rest << "name" << i << "\t" << rand() % 1000;
+    entry._rest = rest.str();
+    truth[chromId].push_back(entry);
+    stringstream line;
+    line << chroms[chromId].first << '\t' << entry._start << '\t'
+         << entry._end << '\t' << entry._rest << '\n';
+    writer.addLine(line.str());
+  }
+  // one chromosome with many blocks
+  for (hal_size_t i = 0; i < 5000; ++i)
+  {
+    BigBedReader::Entry entry;
+    entry._start = i * 10;
+    entry._end = i * 10 + 5;
+    entry._rest = "big\t0";
+    truth[0].push_back(entry);
+    writer.addEntry(chroms[0].first, entry._start, entry._end, entry._rest);
+  }
+  writer.close();
+
+  CuAssertTrue(_testCase, BigBedReader::isBigBed(&buffer));
+  CuAssertTrue(_testCase, BigWigReader::isBigWig(&buffer) == false);
+  BigBedReader reader;
+  reader.open(&buffer);
+  CuAssertTrue(_testCase, reader.getNumChroms() == numChroms);
+  CuAssertTrue(_testCase, reader.getDefinedFieldCount() == 4);
+  CuAssertTrue(_testCase, reader.getFieldCount() == 5);
+  vector<BigBedReader::Entry> entries;
+  for (hal_size_t i = 0; i < numChroms; ++i)
+  {
+    hal_size_t chromId;
+    CuAssertTrue(_testCase, reader.getChromId(chroms[i].first, chromId));
+    CuAssertTrue(_testCase, reader.getChromSize(chromId) == chromSize);
+    reader.getEntries(chromId, 0, chromSize, entries);
+    CuAssertTrue(_testCase, entries.size() == truth[i].size());
+    
+    // same entries, in some sorted order
+    multiset<string> expected;
+    for (size_t j = 0; j < truth[i].size(); ++j)
+    {
+      stringstream ss;
+      ss << truth[i][j]._start << " " << truth[i][j]._end << " " 
+         << truth[i][j]._rest;
+      expected.insert(ss.str());
+    }
+    for (size_t j = 0; j < entries.size(); ++j)
+    {
+      CuAssertTrue(_testCase, j == 0 || 
+                   entries[j]._start >= entries[j - 1]._start);
+      stringstream ss;
+      ss << entries[j]._start << " " << entries[j]._end << " " 
+         << entries[j]._rest;
+      multiset<string>::iterator k = expected.find(ss.str());
+      CuAssertTrue(_testCase, k != expected.end());
+      expected.erase(k);
+    }
+  }
+
+  // a window query only returns overlapping entries
+  hal_size_t chromId;
+  reader.getChromId(chroms[0].first, chromId);
+  reader.getEntries(chromId, 20000, 20100, entries);
+  for (size_t j = 0; j < entries.size(); ++j)
+  {
+    CuAssertTrue(_testCase, entries[j]._start < 20100 &&
+                 entries[j]._end > 20000);
+  }
+  CuAssertTrue(_testCase, entries.size() >= 10);
+}
+
+struct TestBedScanner : public BedScanner
+{
+   TestBedScanner() : _numBegins(0), _numEOFs(0) {}
+   void visitBegin() { ++_numBegins; }
+   void visitLine() { _lines.push_back(_bedLine); }
+   void visitEOF() { ++_numEOFs; }
+   vector<BedLine> _lines;
+   size_t _numBegins;
+   size_t _numEOFs;
+};
+
+// a bigBed is read a window at a time, but scanned as one file, with
+// the entries that straddle windows only visited once
+void BedLiftoverTest::testBigBedScan()
+{
+  vector<pair<string, hal_size_t> > chroms;
+  chroms.push_back(pair<string, hal_size_t>("chrA",
+                                            3 * BedScanner::BigBedWindow));
+  chroms.push_back(pair<string, hal_size_t>("chrB", 1000));
+  stringstream buffer;
+  BigBedWriter writer;
+  writer.open(&buffer, chroms);
+  writer.setDefinedFieldCount(4);
+  hal_size_t numEntries = 0;
+  for (hal_size_t start = 0; start < 3 * BedScanner::BigBedWindow - 300;
+       start += BedScanner::BigBedWindow / 4 - 50)
+  {
+    writer.addEntry("chrA", start, start + 300, "a\t0");
+    ++numEntries;
+  }
+  writer.addEntry("chrB", 10, 20, "b\t0");
+  ++numEntries;
+  writer.close();
+
+  BigBedReader reader;
+  reader.open(&buffer);
+  TestBedScanner scanner;
+  scanner.scanBigBed(reader);
+  CuAssertTrue(_testCase, scanner._numBegins == 1);
+  CuAssertTrue(_testCase, scanner._numEOFs == 1);
+  CuAssertTrue(_testCase, scanner._lines.size() == numEntries);
+  for (size_t i = 1; i + 1 < scanner._lines.size(); ++i)
+  {
+    CuAssertTrue(_testCase, scanner._lines[i]._chrName == "chrA");
+    CuAssertTrue(_testCase, scanner._lines[i]._start >
+                 scanner._lines[i - 1]._start);
+  }
+  CuAssertTrue(_testCase, scanner._lines.back()._chrName == "chrB");
+}
+
+// blank lines, mixed separators and windows line endings, along with
+// a line that's longer than the tokenizer's buffer
+void BedLiftoverTest::testBedScanner()
+{
+  string longName(BedTokenizer::BlockSize + 10, 'x');
+  stringstream bed;
+  bed << "chr1 10\t20 a 5 + 10 20 0 2 3,4, 0,6,\r\n"
+      << "\n   \t\n"
+      << "chr2\t0\t100\t" << longName << "\t0\t-\t0\t0\t1,2,3\t1\t100"
+      << "\t0\textra1 extra2\n"
+      << "chr3 5 6 b 0 . 5 6 0 0";
+
+  stringstream versionStream(bed.str());
+  CuAssertTrue(_testCase, BedScanner::getBedVersion(&versionStream) == 12);
+  CuAssertTrue(_testCase, BedScanner::getNumColumns(
+                 "chr1 1 2 a 0 +  extra") == 7);
+
+  TestBedScanner scanner;
+  scanner.scan(&bed, 12);
+  vector<BedLine>& lines = scanner._lines;
+  CuAssertTrue(_testCase, lines.size() == 3);
+  CuAssertTrue(_testCase, lines[0]._chrName == "chr1");
+  CuAssertTrue(_testCase, lines[0]._start == 10 && lines[0]._end == 20);
+  CuAssertTrue(_testCase, lines[0]._blocks.size() == 2);
+  CuAssertTrue(_testCase, lines[0]._blocks[1]._start == 6);
+  CuAssertTrue(_testCase, lines[0]._blocks[1]._length == 4);
+  CuAssertTrue(_testCase, lines[0]._extra.empty());
+  CuAssertTrue(_testCase, lines[1]._name == longName);
+  CuAssertTrue(_testCase, lines[1]._strand == '-');
+  CuAssertTrue(_testCase, lines[1]._itemR == 1 && lines[1]._itemB == 3);
+  CuAssertTrue(_testCase, lines[1]._extra.size() == 2);
+  CuAssertTrue(_testCase, lines[1]._extra[1] == "extra2");
+  CuAssertTrue(_testCase, lines[2]._strand == '.');
+  CuAssertTrue(_testCase, lines[2]._blocks.empty());
+
+  // tabs only: the space stays in the last column
+  stringstream tabBed("chr1\t1\t2\ta name\n");
+  TestBedScanner tabScanner;
+  locale tabLocale(locale(), new TabSepFacet(locale()));
+  tabScanner.scan(&tabBed, 4, &tabLocale);
+  CuAssertTrue(_testCase, tabScanner._lines.size() == 1);
+  CuAssertTrue(_testCase, tabScanner._lines[0]._name == "a name");
+
+  // numbers must take up their whole column
+  stringstream badBed("chr1 1 2x\n");
+  TestBedScanner badScanner;
+  try
+  {
+    badScanner.scan(&badBed, 3);
+    CuAssertTrue(_testCase, false);
+  }
+  catch (hal_exception&)
+  {
+  }
+}
+
 void BedLiftoverTest::createCallBack(AlignmentPtr alignment)
 {
   setupSharedAlignment(alignment);
@@ -361,6 +654,11 @@ void BedLiftoverTest::checkCallBack(AlignmentConstPtr alignment)
 {
   testOneBranchLifts(alignment);
   testMultiBranchLifts(alignment);
+  testSortedLifts(alignment);
+  testColumnLifts(alignment);
+  testBigBed();
+  testBigBedScan();
+  testBedScanner();
 }
 
 /*
@@ -407,6 +705,139 @@ void WiggleLiftoverTest::testMultiBranchLifts(AlignmentConstPtr alignment)
 {
 }
 
+// compare tiles that are constantly getting compressed and spilled
+// against a plain array
+void WiggleLiftoverTest::testTiles()
+{
+  hal_size_t genomeSize = 1000;
+  WiggleTiles<double> tiles;
+  tiles.init(genomeSize, -1., 30, 2, 200);
+  vector<double> vals(genomeSize, -1.);
+  vector<bool> bits(genomeSize, false);
+  for (size_t i = 0; i < 20000; ++i)
+  {
+    hal_index_t pos = rand() % genomeSize;
+    if (rand() % 2 == 0)
+    {
+      // lots of runs of the same value
+      double val = rand() % 3;
+      tiles.set(pos, val);
+      vals[pos] = val;
+      bits[pos] = true;
+    }
+    else
+    {
+      CuAssertTrue(_testCase, tiles.get(pos) == vals[pos]);
+      CuAssertTrue(_testCase, tiles.exists(pos) == bits[pos]);
+    }
+  }
+
+  // part of a tile on either side of some whole ones
+  tiles.erase(100, 499);
+  for (hal_index_t i = 0; i < (hal_index_t)genomeSize; ++i)
+  {
+    if (i >= 100 && i <= 499)
+    {
+      vals[i] = -1.;
+      bits[i] = false;
+    }
+    CuAssertTrue(_testCase, tiles.get(i) == vals[i]);
+    CuAssertTrue(_testCase, tiles.exists(i) == bits[i]);
+  }
+
+  vector<WiggleTiles<double>::Run> runs;
+  hal_index_t pos = 0;
+  for (hal_size_t i = 0; i < tiles.getNumTiles(); ++i)
+  {
+    tiles.getRuns(i, runs);
+    tiles.releaseTile(i);
+    CuAssertTrue(_testCase, tiles.isTileEmpty(i));
+    hal_index_t tileStart = i * tiles.getTileSize();
+    for (size_t j = 0; j < runs.size(); ++j)
+    {
+      for (; pos < tileStart + (hal_index_t)runs[j]._offset; ++pos)
+      {
+        CuAssertTrue(_testCase, bits[pos] == false);
+      }
+      for (size_t k = 0; k < runs[j]._length; ++k, ++pos)
+      {
+        CuAssertTrue(_testCase, bits[pos] == true);
+        CuAssertTrue(_testCase, vals[pos] == runs[j]._value);
+      }
+    }
+  }
+  for (; pos < (hal_index_t)genomeSize; ++pos)
+  {
+    CuAssertTrue(_testCase, bits[pos] == false);
+  }
+  CuAssertTrue(_testCase, tiles.getSpillSize() == 0);
+}
+
+// write random values over lots of small chromosomes and read them
+// back a base at a time
+void WiggleLiftoverTest::testBigWig()
+{
+  hal_size_t numChroms = 400;
+  hal_size_t chromSize = 3000;
+  vector<pair<string, hal_size_t> > chroms;
+  vector<vector<double> > vals(numChroms);
+  stringstream buffer;
+  for (hal_size_t i = 0; i < numChroms; ++i)
+  {
+    stringstream name;
+    name << "seq" << i;
+    chroms.push_back(pair<string, hal_size_t>(name.str(), chromSize));
+  }
+
+  BigWigWriter writer;
+  writer.open(&buffer, chroms);
+  for (hal_size_t i = 0; i < numChroms; ++i)
+  {
+    vals[i].resize(chromSize, -1.);
+    hal_size_t pos = rand() % 10;
+    while (pos < chromSize)
+    {
+      hal_size_t len = 1 + rand() % 5;
+      len = min(len, chromSize - pos);
+      double val = rand() % 4;
+      writer.addInterval(chroms[i].first, pos, pos + len, val);
+      for (hal_size_t j = pos; j < pos + len; ++j)
+      {
+        vals[i][j] = val;
+      }
+      // every other sequence gets gaps
+      pos += len + (i % 2) * (rand() % 3);
+    }
+  }
+  writer.close();
+
+  CuAssertTrue(_testCase, BigWigReader::isBigWig(&buffer));
+  BigWigReader reader;
+  reader.open(&buffer);
+  CuAssertTrue(_testCase, reader.getNumChroms() == numChroms);
+  vector<BigWigReader::Interval> intervals;
+  for (hal_size_t i = 0; i < numChroms; ++i)
+  {
+    hal_size_t chromId;
+    CuAssertTrue(_testCase, reader.getChromId(chroms[i].first, chromId));
+    CuAssertTrue(_testCase, reader.getChromName(chromId) == chroms[i].first);
+    reader.getIntervals(chromId, 0, chromSize, intervals);
+    vector<double> readVals(chromSize, -1.);
+    for (size_t j = 0; j < intervals.size(); ++j)
+    {
+      CuAssertTrue(_testCase, j == 0 ||
+                   intervals[j]._start >= intervals[j - 1]._end);
+      for (hal_size_t k = intervals[j]._start; k < intervals[j]._end; ++k)
+      {
+        readVals[k] = intervals[j]._value;
+      }
+    }
+    CuAssertTrue(_testCase, readVals == vals[i]);
+  }
+  hal_size_t chromId;
+  CuAssertTrue(_testCase, reader.getChromId("nothere", chromId) == false);
+}
+
 void WiggleLiftoverTest::createCallBack(AlignmentPtr alignment)
 {
   setupSharedAlignment(alignment);
@@ -416,6 +847,106 @@ void WiggleLiftoverTest::checkCallBack(AlignmentConstPtr alignment)
 {
   testOneBranchLifts(alignment);
   testMultiBranchLifts(alignment);
+  testTiles();
+  testBigWig();
+}
+
+// two sequences in each genome, and each sequence of the leaf gets half
+// of its bases from each sequence of the root
+void WiggleRevisitTest::createCallBack(AlignmentPtr alignment)
+{
+  Genome *root = alignment->addRootGenome("root");
+  Genome *leaf = alignment->addLeafGenome("leaf", "root", 1);
+  vector<Sequence::Info> seqVec(2);
+  seqVec[0] = Sequence::Info("chr1", 20, 0, 2);
+  seqVec[1] = Sequence::Info("chr2", 20, 0, 2);
+  root->setDimensions(seqVec);
+  seqVec[0] = Sequence::Info("chr1", 20, 2, 0);
+  seqVec[1] = Sequence::Info("chr2", 20, 2, 0);
+  leaf->setDimensions(seqVec);
+  root->setString("ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT");
+  leaf->setString("ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT");
+  hal_index_t children[] = {0, 3, 2, 1};
+  BottomSegmentIteratorPtr botIt = root->getBottomSegmentIterator();
+  for (hal_index_t i = 0; i < 4; ++i, botIt->toRight())
+  {
+    botIt->setCoordinates(i * 10, 10);
+    botIt->setChildIndex(0, children[i]);
+    botIt->setChildReversed(0, false);
+    botIt->setTopParseIndex(NULL_INDEX);
+  }
+  hal_index_t parents[] = {0, 3, 2, 1};
+  TopSegmentIteratorPtr topIt = leaf->getTopSegmentIterator();
+  for (hal_index_t i = 0; i < 4; ++i, topIt->toRight())
+  {
+    topIt->setCoordinates(i * 10, 10);
+    topIt->setParentIndex(parents[i]);
+    topIt->setParentReversed(false);
+    topIt->setNextParalogyIndex(NULL_INDEX);
+    topIt->setBottomParseIndex(NULL_INDEX);
+  }
+}
+
+struct WiggleCollector : public WiggleScanner
+{
+   void visitLine()
+   {
+     for (hal_index_t i = _first; i <= _last; ++i)
+     {
+       _vals[pair<string, hal_index_t>(_sequenceName, i)] = _value;
+     }
+   }
+   map<pair<string, hal_index_t>, double> _vals;
+};
+
+// a sequence can come back in the input after others.  its targets
+// mustn't be written (or rejected) before its last lines have been read
+void WiggleRevisitTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  const Genome* root = alignment->openGenome("root");
+  const Genome* leaf = alignment->openGenome("leaf");
+  stringstream chr1a;
+  stringstream chr1b;
+  stringstream chr2;
+  chr1a << "fixedStep chrom=chr1 start=1 step=1\n";
+  chr1b << "fixedStep chrom=chr1 start=11 step=1\n";
+  chr2 << "fixedStep chrom=chr2 start=1 step=1\n";
+  for (size_t i = 0; i < 10; ++i)
+  {
+    chr1a << i << "\n";
+    chr1b << 10 + i << "\n";
+  }
+  for (size_t i = 0; i < 20; ++i)
+  {
+    chr2 << 100 + i << "\n";
+  }
+
+  WiggleCollector together;
+  WiggleCollector split;
+  for (size_t i = 0; i < 2; ++i)
+  {
+    stringstream wigFile;
+    if (i == 0)
+    {
+      wigFile << chr1a.str() << chr1b.str() << chr2.str();
+    }
+    else
+    {
+      wigFile << chr1a.str() << chr2.str() << chr1b.str();
+    }
+    stringstream outStream;
+    WiggleLiftover liftover;
+    liftover.convert(alignment, root, &wigFile, leaf, &outStream);
+    (i == 0 ? together : split).scan(&outStream);
+  }
+  CuAssertTrue(_testCase, together._vals.size() == 40);
+  CuAssertTrue(_testCase, split._vals == together._vals);
+  // chr1 of the leaf gets its second half from chr2 of the root, and
+  // chr2 of the leaf from chr1
+  CuAssertTrue(_testCase, split._vals[make_pair(string("chr1"),
+                                                (hal_index_t)15)] == 115);
+  CuAssertTrue(_testCase, split._vals[make_pair(string("chr2"),
+                                                (hal_index_t)15)] == 15);
 }
 
 void halBedLiftoverTest(CuTest *testCase)
@@ -444,11 +975,25 @@ void halWiggleLiftoverTest(CuTest *testCase)
   }
 }
 
+void halWiggleRevisitTest(CuTest *testCase)
+{
+  try
+  {
+    WiggleRevisitTest tester;
+    tester.check(testCase);
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
 CuSuite* halLiftoverTestSuite(void)
 {
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, halBedLiftoverTest);
   SUITE_ADD_TEST(suite, halWiggleLiftoverTest);
+  SUITE_ADD_TEST(suite, halWiggleRevisitTest);
   return suite;
 }
 
@@ -19,6 +19,11 @@ struct BedLiftoverTest : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
    void testOneBranchLifts(hal::AlignmentConstPtr alignment);
    void testMultiBranchLifts(hal::AlignmentConstPtr alignment);
+   void testSortedLifts(hal::AlignmentConstPtr alignment);
+   void testColumnLifts(hal::AlignmentConstPtr alignment);
+   void testBigBed();
+   void testBigBedScan();
+   void testBedScanner();
 };
 
 struct WiggleLiftoverTest : public AlignmentTest
@@ -27,6 +32,14 @@ struct WiggleLiftoverTest : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
    void testOneBranchLifts(hal::AlignmentConstPtr alignment);
    void testMultiBranchLifts(hal::AlignmentConstPtr alignment);
+   void testTiles();
+   void testBigWig();
+};
+
+struct WiggleRevisitTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
 CuSuite *halLiftoverTestSuite();
@@ -31,7 +31,8 @@ MaxLodToken = "max"
 
 # Wrapper for halLodExtract
 def getHalLodExtractCmd(inHalPath, outHalPath, scale, keepSeq, inMemory,
-                     probeFrac, minSeqFrac, chunk, minCovFrac):
+                     probeFrac, minSeqFrac, chunk, minCovFrac, numThreads,
+                     prevHalPath=None):
     cmd = "halLodExtract %s %s %s" % (inHalPath, outHalPath, scale)
     if keepSeq is True:
         cmd += " --keepSequences"
@@ -43,9 +44,23 @@ def getHalLodExtractCmd(inHalPath, outHalPath, scale, keepSeq, inMemory,
         cmd += " --minSeqFrac %f" % minSeqFrac
     if chunk is not None and chunk > 0:
         cmd += " --chunk %d" % chunk
+    if numThreads > 1:
+        cmd += " --numThreads %d" % numThreads
+    if prevHalPath is not None:
+        cmd += " --prevLod %s" % prevHalPath
 
     return cmd
 
+# Move an existing level of detail out of the way so that halLodExtract
+# can copy what hasn't changed from it
+def getPrevHalPath(outHalPath, update):
+    if update is False:
+        return None
+    prevHalPath = outHalPath + ".prev"
+    if os.path.isfile(outHalPath):
+        os.rename(outHalPath, prevHalPath)
+    return prevHalPath
+
 # All created paths get put in the same place using the same logic
 def makePath(inHalPath, outDir, step, name, ext):
     inFileName = os.path.splitext(os.path.basename(inHalPath))[0]
@@ -132,13 +147,18 @@ def formatOutHalPath(outLodPath, outHalPath, absPath):
 # Run halLodExtract for each level of detail.
 def createLods(halPath, outLodPath, outDir, maxBlock, scale, overwrite,
                maxDNA, absPath, trans, inMemory, probeFrac, minSeqFrac,
-               scaleCorFac, numProc, chunk, minLod0, cutOff, minCovFrac):
+               scaleCorFac, numProc, chunk, minLod0, cutOff, minCovFrac,
+               numThreads, onePass, update):
     lodFile = open(outLodPath, "w")
     lodFile.write("0 %s\n" % formatOutHalPath(outLodPath, halPath, absPath))
     steps, lastIsMax = getSteps(halPath, maxBlock, scale, minLod0, cutOff,
                                 minSeqFrac, minCovFrac)
     curStepFactor = scaleCorFac
     lodExtractCmds = []
+    # (outHalPath, stepScale, prevHalPath) of each level, by keepSequences,
+    # for onePass
+    onePassLods = defaultdict(list)
+    prevHalPaths = []
     prevStep = None
     for stepIdx in xrange(1,len(steps)):
         step = int(max(1, steps[stepIdx] * curStepFactor))
@@ -156,10 +176,18 @@ def createLods(halPath, outLodPath, outDir, maxBlock, scale, overwrite,
         isMaxLod = stepIdx == len(steps) - 1 and lastIsMax is True
         if not isMaxLod and (overwrite is True or
                              not os.path.isfile(outHalPath)):
-            lodExtractCmds.append(
-                getHalLodExtractCmd(srcPath, outHalPath, stepScale,
-                                    keepSequences, inMemory, probeFrac,
-                                    minSeqFrac, chunk, minCovFrac))
+            prevHalPath = getPrevHalPath(outHalPath, update)
+            if prevHalPath is not None:
+                prevHalPaths.append(prevHalPath)
+            if onePass is True:
+                onePassLods[keepSequences].append((outHalPath, stepScale,
+                                                   prevHalPath))
+            else:
+                lodExtractCmds.append(
+                    getHalLodExtractCmd(srcPath, outHalPath, stepScale,
+                                        keepSequences, inMemory, probeFrac,
+                                        minSeqFrac, chunk, minCovFrac,
+                                        numThreads, prevHalPath))
         lodPath =  formatOutHalPath(outLodPath, outHalPath, absPath)
         if isMaxLod:
             lodPath = MaxLodToken
@@ -171,7 +199,22 @@ def createLods(halPath, outLodPath, outDir, maxBlock, scale, overwrite,
         prevStep = step
         curStepFactor *= scaleCorFac
     lodFile.close()
+    # all the levels (that keep sequences, or that don't) from one
+    # halLodExtract run, which only reads the input once
+    for keepSequences, lods in onePassLods.items():
+        prevHalPath = None
+        if update is True:
+            prevHalPath = ",".join([x[2] for x in lods])
+        lodExtractCmds.append(
+            getHalLodExtractCmd(halPath, ",".join([x[0] for x in lods]),
+                                ",".join([str(x[1]) for x in lods]),
+                                keepSequences, inMemory, probeFrac,
+                                minSeqFrac, chunk, minCovFrac, numThreads,
+                                prevHalPath))
     runParallelShellCommands(lodExtractCmds, numProc)
+    for prevHalPath in prevHalPaths:
+        if os.path.isfile(prevHalPath):
+            os.remove(prevHalPath)
     
 def main(argv=None):
     if argv is None:
@@ -250,6 +293,25 @@ def main(argv=None):
                         type=float, default=1.0)
     parser.add_argument("--numProc", help="Number of concurrent processes",
                         type=int, default=1)
+    parser.add_argument("--numThreads", help="Number of threads each "
+                        "halLodExtract process builds its graphs with",
+                        type=int, default=1)
+    parser.add_argument("--onePass", help="Generate all levels of detail "
+                        "with a single halLodExtract process (or two, if "
+                        "only some keep their sequences), which reads the "
+                        "input once.  Coarser levels are seeded with the "
+                        "columns sampled for finer ones, so they can differ "
+                        "slightly from those made separately.",
+                        action="store_true", default=False)
+    parser.add_argument("--update", help="Regenerate the levels of detail "
+                        "of an input that was edited since they were made. "
+                        " Only the internal nodes whose genomes changed are "
+                        "rebuilt, the rest are copied from the existing "
+                        "files.  Only halReplaceGenome, halAddToBranch and "
+                        "halAppendSubtree say which genomes they changed: "
+                        "after any other tool opens the input for writing, "
+                        "everything is rebuilt.",
+                        action="store_true", default=False)
     parser.add_argument("--chunk", help="Chunk size of output hal files.  ",
                         type=int, default=None)
     parser.add_argument("--minLod0", help="Override other parameters to "
@@ -281,6 +343,11 @@ def main(argv=None):
     if args.trans is True and args.numProc > 1:
         raise RuntimeError("--numProc > 1 not supported when --trans option is "
                            "set")
+    if args.update is True and (args.trans is True or args.resume is True):
+        raise RuntimeError("--update not supported with --trans or --resume")
+    if args.trans is True and args.onePass is True:
+        raise RuntimeError("--onePass not supported when --trans option is "
+                           "set")
 
     if args.maxDNA < 0:
         args.maxDNA = sys.maxint
@@ -289,7 +356,8 @@ def main(argv=None):
                args.maxBlock, args.scale, not args.resume, args.maxDNA,
                args.absPath, args.trans, args.inMemory, args.probeFrac,
                args.minSeqFrac, args.scaleCorFac, args.numProc, args.chunk,
-               args.minLod0, args.cutOff, args.minCovFrac)
+               args.minLod0, args.cutOff, args.minCovFrac, args.numThreads,
+               args.onePass, args.update)
     
 if __name__ == "__main__":
     sys.exit(main())
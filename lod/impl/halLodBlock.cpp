@@ -30,10 +30,6 @@ void LodBlock::addSegment(LodSegment* segment)
 
 void LodBlock::clear()
 {
-  for (SegmentIterator i = _segments.begin(); i != _segments.end(); ++i)
-  {
-    delete *i;
-  }
   _segments.clear();
 }
 
@@ -126,12 +122,14 @@ void LodBlock::mergeHead(LodBlock* adjBlock)
   }
 }
 
-void LodBlock::insertNeighbours(vector<LodBlock*>& outList)
+void LodBlock::insertNeighbours(vector<LodBlock*>& outList,
+                                LodPool<LodBlock>& blockPool,
+                                LodPool<LodSegment>& segmentPool)
 {
   LodBlock* lodBlock = NULL;
   while (true) 
   {
-    lodBlock = insertNewTailNeighbour();
+    lodBlock = insertNewTailNeighbour(blockPool, segmentPool);
     if (lodBlock != NULL)
     {
       outList.push_back(lodBlock);
@@ -143,7 +141,7 @@ void LodBlock::insertNeighbours(vector<LodBlock*>& outList)
   }
   while (true) 
   {
-    lodBlock = insertNewHeadNeighbour();
+    lodBlock = insertNewHeadNeighbour(blockPool, segmentPool);
     if (lodBlock != NULL)
     {
       outList.push_back(lodBlock);
@@ -157,19 +155,21 @@ void LodBlock::insertNeighbours(vector<LodBlock*>& outList)
   assert(getMaxTailInsertionLen() == 0);
 }
 
-LodBlock* LodBlock::insertNewTailNeighbour()
+LodBlock* LodBlock::insertNewTailNeighbour(LodPool<LodBlock>& blockPool,
+                                           LodPool<LodSegment>& segmentPool)
 {
   LodBlock* newBlock = NULL;
   hal_size_t maxTailInsLen = getMaxTailInsertionLen();
   if (maxTailInsLen > 0)
   {
-    newBlock = new LodBlock();
+    newBlock = blockPool.allocate();
     for (LodBlock::SegmentIterator i = _segments.begin();
          i != _segments.end(); ++i)
     {
       if ((*i)->getTailAdjLen()  >= maxTailInsLen)
       {
-        LodSegment* newSeg = (*i)->insertNewTailAdj(newBlock, maxTailInsLen);
+        LodSegment* newSeg = (*i)->insertNewTailAdj(newBlock, maxTailInsLen,
+                                                    segmentPool);
         newBlock->_segments.push_back(newSeg);
       }
     }
@@ -177,19 +177,21 @@ LodBlock* LodBlock::insertNewTailNeighbour()
   return newBlock;
 }
 
-LodBlock* LodBlock::insertNewHeadNeighbour()
+LodBlock* LodBlock::insertNewHeadNeighbour(LodPool<LodBlock>& blockPool,
+                                           LodPool<LodSegment>& segmentPool)
 {
   LodBlock* newBlock = NULL;
   hal_size_t maxHeadInsLen = getMaxHeadInsertionLen();
   if (maxHeadInsLen > 0)
   {
-    newBlock = new LodBlock();
+    newBlock = blockPool.allocate();
     for (LodBlock::SegmentIterator i = _segments.begin();
          i != _segments.end(); ++i)
     {
       if ((*i)->getHeadAdjLen() >= maxHeadInsLen)
       {
-        LodSegment* newSeg = (*i)->insertNewHeadAdj(newBlock, maxHeadInsLen);
+        LodSegment* newSeg = (*i)->insertNewHeadAdj(newBlock, maxHeadInsLen,
+                                                    segmentPool);
         newBlock->_segments.push_back(newSeg);
       }
     }
@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <deque>
+#include <sys/stat.h>
+#include "halLodCache.h"
+
+using namespace std;
+using namespace hal;
+
+const size_t LodCache::DefaultMaxBytes = (size_t)2 << 30;
+
+LodCache::Entry::Entry() : _numUsers(0), _numBytes(0), _lastUse(0),
+                           _loading(false), _preloaded(false)
+{
+
+}
+
+LodCache* LodCache::getInstance()
+{
+  static LodCache* instance = new LodCache();
+  return instance;
+}
+
+LodCache::LodCache() : _numBytes(0),
+                       _maxBytes(DefaultMaxBytes),
+                       _clock(0),
+                       _threadStarted(false)
+{
+  _defaultCacheBytes =
+     hdf5CLParserInstance(true)->getOption<hal_size_t>("cacheBytes");
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+}
+
+void LodCache::addUser(const string& path, CLParserConstPtr options)
+{
+  pthread_mutex_lock(&_mutex);
+  Entry& entry = _entries[path];
+  if (entry._numUsers == 0 && entry._alignment.get() == NULL &&
+      entry._loading == false)
+  {
+    entry._options = options;
+  }
+  ++entry._numUsers;
+  pthread_mutex_unlock(&_mutex);
+}
+
+void LodCache::removeUser(const string& path)
+{
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator entryIt = _entries.find(path);
+  assert(entryIt != _entries.end() && entryIt->second._numUsers > 0);
+  Entry& entry = entryIt->second;
+  if (--entry._numUsers == 0)
+  {
+    if (entry._loading == true && path != _loadingPath)
+    {
+      cancelJob(path);
+    }
+    // an alignment that's still loading is dropped when it's done, and
+    // one that's still referenced is left for evict()
+    if (entry._loading == false &&
+        (entry._alignment.get() == NULL || entry._alignment.unique()))
+    {
+      _numBytes -= entry._numBytes;
+      _entries.erase(entryIt);
+    }
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+AlignmentConstPtr LodCache::getAlignment(const string& path, bool& opened,
+                                         bool& preloaded)
+{
+  opened = false;
+  preloaded = false;
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator entryIt = _entries.find(path);
+  assert(entryIt != _entries.end() && entryIt->second._numUsers > 0);
+  Entry& entry = entryIt->second;
+  if (entry._loading == true)
+  {
+    if (path == _loadingPath)
+    {
+      opened = true;
+      while (entry._loading == true)
+      {
+        pthread_cond_wait(&_cond, &_mutex);
+      }
+      entry._preloaded = false;
+    }
+    else
+    {
+      // no point waiting for the files queued before it
+      cancelJob(path);
+    }
+  }
+  AlignmentConstPtr alignment = entry._alignment;
+  if (alignment.get() == NULL)
+  {
+    opened = true;
+    alignment = createAlignment(entry);
+    const CLParser* options = entry._options.get();
+    pthread_mutex_unlock(&_mutex);
+    alignment->open(path);
+    size_t numBytes = estimateBytes(path, options, alignment.get());
+    pthread_mutex_lock(&_mutex);
+    insert(path, alignment, numBytes, false);
+  }
+  else if (entry._preloaded == true)
+  {
+    preloaded = true;
+    entry._preloaded = false;
+  }
+  entry._lastUse = ++_clock;
+  evict();
+  pthread_mutex_unlock(&_mutex);
+  return alignment;
+}
+
+void LodCache::preload(const string& path)
+{
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator entryIt = _entries.find(path);
+  if (entryIt == _entries.end() || entryIt->second._numUsers == 0 ||
+      entryIt->second._loading == true ||
+      entryIt->second._alignment.get() != NULL || _numBytes >= _maxBytes)
+  {
+    pthread_mutex_unlock(&_mutex);
+    return;
+  }
+  // the file is opened on another thread
+  AlignmentConstPtr alignment = createAlignment(entryIt->second);
+  if (alignment->isThreadSafe() == false)
+  {
+    pthread_mutex_unlock(&_mutex);
+    return;
+  }
+  if (_threadStarted == false)
+  {
+    if (pthread_create(&_thread, NULL, preloadThread, this) != 0)
+    {
+      pthread_mutex_unlock(&_mutex);
+      return;
+    }
+    pthread_detach(_thread);
+    _threadStarted = true;
+  }
+  entryIt->second._loading = true;
+  _jobs.push_back(pair<string, AlignmentConstPtr>(path, alignment));
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+}
+
+size_t LodCache::getNumBytes() const
+{
+  pthread_mutex_lock(&_mutex);
+  size_t numBytes = _numBytes;
+  pthread_mutex_unlock(&_mutex);
+  return numBytes;
+}
+
+size_t LodCache::getMaxBytes() const
+{
+  pthread_mutex_lock(&_mutex);
+  size_t maxBytes = _maxBytes;
+  pthread_mutex_unlock(&_mutex);
+  return maxBytes;
+}
+
+void LodCache::setMaxBytes(size_t maxBytes)
+{
+  pthread_mutex_lock(&_mutex);
+  _maxBytes = maxBytes;
+  evict();
+  pthread_mutex_unlock(&_mutex);
+}
+
+AlignmentConstPtr LodCache::createAlignment(const Entry& entry) const
+{
+  AlignmentConstPtr alignment = hdf5AlignmentInstanceReadOnly();
+  if (entry._options.get() != NULL)
+  {
+    alignment->setOptionsFromParser(entry._options);
+  }
+  return alignment;
+}
+
+size_t LodCache::estimateBytes(const string& path, const CLParser* options,
+                               const Alignment* alignment) const
+{
+  bool inMemory = options != NULL && options->hasFlag("inMemory") &&
+     options->getFlag("inMemory");
+  hal_size_t cacheBytes = _defaultCacheBytes;
+  if (options != NULL && options->hasOption("cacheBytes"))
+  {
+    cacheBytes = options->getOption<hal_size_t>("cacheBytes");
+  }
+  // each genome's dna, top and bottom arrays get their own chunk cache,
+  // which can't hold more than the whole file.  in memory it's all read.
+  size_t numBytes = alignment->getNumGenomes() * 3 * cacheBytes;
+  struct stat fileStat;
+  if (path.find(":/") == string::npos &&
+      stat(path.c_str(), &fileStat) == 0)
+  {
+    if (inMemory == true || (size_t)fileStat.st_size < numBytes)
+    {
+      numBytes = fileStat.st_size;
+    }
+  }
+  return numBytes;
+}
+
+void LodCache::warmUp(const Alignment* alignment)
+{
+  // the sequence index of every genome is read the first time one of
+  // its sequences is looked up
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (!bfQueue.empty())
+  {
+    const Genome* genome = alignment->openGenome(bfQueue.front());
+    if (genome->getSequenceLength() > 0)
+    {
+      const Sequence* sequence = genome->getSequenceBySite(0);
+      genome->getSequence(sequence->getName());
+    }
+    vector<string> childNames = alignment->getChildNames(bfQueue.front());
+    bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+    bfQueue.pop_front();
+  }
+}
+
+void LodCache::insert(const string& path, AlignmentConstPtr alignment,
+                      size_t numBytes, bool preloaded)
+{
+  EntryMap::iterator entryIt = _entries.find(path);
+  assert(entryIt != _entries.end());
+  Entry& entry = entryIt->second;
+  entry._loading = false;
+  if (entry._numUsers == 0)
+  {
+    _entries.erase(entryIt);
+    return;
+  }
+  entry._alignment = alignment;
+  entry._numBytes = numBytes;
+  entry._lastUse = ++_clock;
+  entry._preloaded = preloaded;
+  _numBytes += numBytes;
+}
+
+void LodCache::cancelJob(const string& path)
+{
+  for (size_t i = 0; i < _jobs.size(); ++i)
+  {
+    if (_jobs[i].first == path)
+    {
+      _jobs.erase(_jobs.begin() + i);
+      break;
+    }
+  }
+  _entries[path]._loading = false;
+}
+
+void LodCache::evict()
+{
+  // alignments referenced outside the cache are in use and can't go
+  while (_numBytes > _maxBytes)
+  {
+    EntryMap::iterator lruIt = _entries.end();
+    for (EntryMap::iterator entryIt = _entries.begin();
+         entryIt != _entries.end(); ++entryIt)
+    {
+      if (entryIt->second._alignment.get() != NULL &&
+          entryIt->second._alignment.unique() &&
+          (lruIt == _entries.end() ||
+           entryIt->second._lastUse < lruIt->second._lastUse))
+      {
+        lruIt = entryIt;
+      }
+    }
+    if (lruIt == _entries.end())
+    {
+      break;
+    }
+    _numBytes -= lruIt->second._numBytes;
+    lruIt->second._numBytes = 0;
+    lruIt->second._alignment = AlignmentConstPtr();
+    lruIt->second._preloaded = false;
+    if (lruIt->second._numUsers == 0)
+    {
+      _entries.erase(lruIt);
+    }
+  }
+}
+
+void LodCache::loadJobs()
+{
+  // the reference counts of the alignments aren't thread-safe, so they
+  // are only ever copied or released with the mutex held
+  pthread_mutex_lock(&_mutex);
+  while (true)
+  {
+    if (_jobs.empty() == true)
+    {
+      pthread_cond_wait(&_cond, &_mutex);
+      continue;
+    }
+    string path = _jobs.front().first;
+    AlignmentConstPtr alignment = _jobs.front().second;
+    _jobs.pop_front();
+    _loadingPath = path;
+    const CLParser* options = _entries[path]._options.get();
+    pthread_mutex_unlock(&_mutex);
+
+    bool loaded = true;
+    size_t numBytes = 0;
+    try
+    {
+      alignment->open(path);
+      warmUp(alignment.get());
+      numBytes = estimateBytes(path, options, alignment.get());
+    }
+    catch(...)
+    {
+      // left for the query to open, and report
+      loaded = false;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    if (loaded == true)
+    {
+      insert(path, alignment, numBytes, true);
+    }
+    else
+    {
+      EntryMap::iterator entryIt = _entries.find(path);
+      entryIt->second._loading = false;
+      if (entryIt->second._numUsers == 0)
+      {
+        _entries.erase(entryIt);
+      }
+    }
+    alignment = AlignmentConstPtr();
+    _loadingPath.clear();
+    pthread_cond_broadcast(&_cond);
+  }
+}
+
+void* LodCache::preloadThread(void* data)
+{
+  ((LodCache*)data)->loadJobs();
+  return NULL;
+}
@@ -5,6 +5,7 @@
  */
 
 #include <cassert>
+#include <sstream>
 #include <deque>
 #include <limits>
 #include <algorithm>
@@ -17,7 +18,7 @@ extern "C" {
 using namespace std;
 using namespace hal;
 
-LodExtract::LodExtract()
+LodExtract::LodExtract() : _graph(NULL)
 {
 
 }
@@ -35,35 +36,101 @@ void LodExtract::createInterpolatedAlignment(AlignmentConstPtr inAlignment,
                                              bool keepSequences,
                                              bool allSequences,
                                              double probeFrac,
-                                             double minSeqFrac)
+                                             double minSeqFrac,
+                                             hal_size_t numThreads,
+                                             const string& inHalPath,
+                                             CLParserConstPtr options)
 {
+  createInterpolatedAlignments(inAlignment,
+                               vector<AlignmentPtr>(1, outAlignment),
+                               vector<double>(1, scale), tree, rootName,
+                               keepSequences, allSequences, probeFrac,
+                               minSeqFrac, numThreads, inHalPath, options);
+}
+
+void LodExtract::createInterpolatedAlignments(
+  AlignmentConstPtr inAlignment,
+  const vector<AlignmentPtr>& outAlignments,
+  const vector<double>& scales,
+  const string& tree,
+  const string& rootName,
+  bool keepSequences,
+  bool allSequences,
+  double probeFrac,
+  double minSeqFrac,
+  hal_size_t numThreads,
+  const string& inHalPath,
+  CLParserConstPtr options)
+{
+  assert(outAlignments.size() == scales.size());
+  if (scales.empty() == true)
+  {
+    throw hal_exception("No scales given");
+  }
+  if (_prevAlignments.empty() == false &&
+      _prevAlignments.size() != outAlignments.size())
+  {
+    throw hal_exception("Need as many previous alignments as output "
+                        "alignments");
+  }
   _inAlignment = inAlignment;
-  _outAlignment = outAlignment;
+  _sourceAlignment = inAlignment;
+  // finest first, so that each level can be seeded by the previous one
+  vector<pair<double, size_t> > order;
+  for (size_t i = 0; i < scales.size(); ++i)
+  {
+    order.push_back(pair<double, size_t>(scales[i], i));
+  }
+  sort(order.begin(), order.end());
+  _scales.clear();
+  _outAlignments.clear();
+  vector<AlignmentConstPtr> prevAlignments;
+  prevAlignments.swap(_prevAlignments);
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    _scales.push_back(order[i].first);
+    _outAlignments.push_back(outAlignments[order[i].second]);
+    _prevAlignments.push_back(prevAlignments.empty() ? AlignmentConstPtr() :
+                              prevAlignments[order[i].second]);
+  }
   _keepSequences = keepSequences;
   _allSequences = allSequences;
   _probeFrac = probeFrac;
   _minSeqFrac = minSeqFrac;
   
   string newTree = tree.empty() ? inAlignment->getNewickTree() : tree;
-  createTree(newTree, rootName);
+  for (size_t i = 0; i < _outAlignments.size(); ++i)
+  {
+    _outAlignment = _outAlignments[i];
+    createTree(newTree, rootName);
+  }
   cout << "tree = " << _outAlignment->getNewickTree() << endl;
   
-  deque<string> bfQueue;
-  bfQueue.push_front(_outAlignment->getRootName());
-  while (!bfQueue.empty())
+  getInternalNodes();
+  findReusableNodes();
+  convertInternalNodes(numThreads, inHalPath, options);
+
+  // record what the levels of detail were made from, so that the next
+  // run can tell what it can take from them
+  stringstream ss;
+  ss << getLastGenomeChange(_sourceAlignment);
+  for (size_t i = 0; i < _outAlignments.size(); ++i)
   {
-    string genomeName = bfQueue.back();
-    bfQueue.pop_back();
-    vector<string> childNames = _outAlignment->getChildNames(genomeName);
-    if (!childNames.empty())
-    {
-      convertInternalNode(genomeName, scale);
-      for (size_t childIdx = 0; childIdx < childNames.size(); childIdx++)
-      {
-        bfQueue.push_back(childNames[childIdx]);
-      } 
-    }
+    MetaData* metaData = _outAlignments[i]->getMetaData();
+    metaData->set("lodSourceId", getChangeLogId(_sourceAlignment));
+    metaData->set("lodSourceChange", ss.str());
+    metaData->set("lodParameters", getParameters(_scales[i]));
   }
+  _outAlignment = AlignmentPtr();
+  _outAlignments.clear();
+  _prevAlignments.clear();
+  _sourceAlignment = AlignmentConstPtr();
+}
+
+void LodExtract::setPreviousAlignments(
+  const vector<AlignmentConstPtr>& prevAlignments)
+{
+  _prevAlignments = prevAlignments;
 }
 
 void LodExtract::createTree(const string& tree, const string& rootName)
@@ -150,27 +217,339 @@ void LodExtract::createTree(const string& tree, const string& rootName)
   stTree_destruct(root);
 }
 
-void LodExtract::convertInternalNode(const string& genomeName, 
-                                     double scale)
+void LodExtract::getInternalNodes()
+{
+  _nodes.clear();
+  deque<string> bfQueue;
+  bfQueue.push_front(_outAlignment->getRootName());
+  while (!bfQueue.empty())
+  {
+    string genomeName = bfQueue.back();
+    bfQueue.pop_back();
+    vector<string> childNames = _outAlignment->getChildNames(genomeName);
+    if (!childNames.empty())
+    {
+      InternalNode node;
+      node._name = genomeName;
+      node._childNames = childNames;
+      node._reuse.assign(_scales.size(), false);
+      node._graph = NULL;
+      node._numWritten = 0;
+      _nodes.push_back(node);
+      for (size_t childIdx = 0; childIdx < childNames.size(); childIdx++)
+      {
+        bfQueue.push_back(childNames[childIdx]);
+      } 
+    }
+  }
+}
+
+string LodExtract::getParameters(double scale) const
+{
+  stringstream ss;
+  ss << "scale=" << scale << " keepSequences=" << _keepSequences
+     << " allSequences=" << _allSequences << " probeFrac=" << _probeFrac
+     << " minSeqFrac=" << _minSeqFrac;
+  return ss.str();
+}
+
+void LodExtract::findReusableNodes()
 {
-  const Genome* parent = _inAlignment->openGenome(genomeName);
+  hal_size_t lastChange = getLastGenomeChange(_sourceAlignment);
+  string sourceId = getChangeLogId(_sourceAlignment);
+  _prevChanges.assign(_scales.size(), 0);
+  for (size_t i = 0; i < _prevAlignments.size(); ++i)
+  {
+    AlignmentConstPtr prevAlignment = _prevAlignments[i];
+    if (prevAlignment.get() == NULL)
+    {
+      continue;
+    }
+    const MetaData* metaData = prevAlignment->getMetaData();
+    stringstream ss(metaData->has("lodSourceChange") ?
+                    metaData->get("lodSourceChange") : "");
+    ss >> _prevChanges[i];
+    // (there's no telling what changed in a file without a change log)
+    if (!ss || _prevChanges[i] > lastChange || sourceId.empty() == true ||
+        metaData->has("lodSourceId") == false ||
+        metaData->get("lodSourceId") != sourceId ||
+        metaData->has("lodParameters") == false ||
+        metaData->get("lodParameters") != getParameters(_scales[i]))
+    {
+      cout << "previous alignment at scale " << _scales[i] << " not made "
+           << "from this input with these options: ignoring it" << endl;
+      continue;
+    }
+
+    // the previous tree, to see which nodes are still there with the
+    // same children
+    map<string, vector<string> > prevTree;
+    deque<string> bfQueue(1, prevAlignment->getRootName());
+    while (!bfQueue.empty())
+    {
+      vector<string>& childNames = prevTree[bfQueue.back()];
+      childNames = prevAlignment->getChildNames(bfQueue.back());
+      bfQueue.pop_back();
+      bfQueue.insert(bfQueue.begin(), childNames.begin(), childNames.end());
+    }
+
+    size_t numReused = 0;
+    for (size_t j = 0; j < _nodes.size(); ++j)
+    {
+      InternalNode& node = _nodes[j];
+      map<string, vector<string> >::const_iterator prevIt =
+         prevTree.find(node._name);
+      if (prevIt != prevTree.end() && prevIt->second == node._childNames &&
+          hasChanged(node, _prevChanges[i]) == false)
+      {
+        node._reuse[i] = true;
+        ++numReused;
+      }
+    }
+    cout << "scale " << _scales[i] << ": reusing " << numReused << " of "
+         << _nodes.size() << " internal nodes" << endl;
+  }
+}
+
+bool LodExtract::hasChanged(const InternalNode& node,
+                            hal_size_t sinceChange) const
+{
+  // the graph depends on the sequences of the node and its children, and
+  // on the segments of the branches between them in the input tree.
+  // those of a branch are logged as a change to the bottom of its parent
+  if (getGenomeChange(_sourceAlignment, node._name, false) > sinceChange)
+  {
+    return true;
+  }
+  set<string> ancestors;
+  for (string name = node._name; name.empty() == false;
+       name = _sourceAlignment->getParentName(name))
+  {
+    ancestors.insert(name);
+  }
+  for (size_t i = 0; i < node._childNames.size(); ++i)
+  {
+    string name = node._childNames[i];
+    if (getGenomeChange(_sourceAlignment, name, false) > sinceChange)
+    {
+      return true;
+    }
+    // up to the common ancestor, then back down to the node
+    for (; ancestors.find(name) == ancestors.end();
+         name = _sourceAlignment->getParentName(name))
+    {
+      if (getGenomeChange(_sourceAlignment,
+                          _sourceAlignment->getParentName(name), true) >
+          sinceChange)
+      {
+        return true;
+      }
+    }
+    for (string ancestor = node._name; ancestor != name;
+         ancestor = _sourceAlignment->getParentName(ancestor))
+    {
+      if (getGenomeChange(_sourceAlignment,
+                          _sourceAlignment->getParentName(ancestor), true) >
+          sinceChange)
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// the threads that build the graphs of the internal nodes.  the one
+// that calls convertInternalNodes() writes them
+struct LodExtract::GraphThreads : public ThreadPool
+{
+   GraphThreads(LodExtract* lodExtract) : _lodExtract(lodExtract),
+                                          _writerStopped(false) {}
+   virtual void work(AlignmentConstPtr alignment)
+   {
+     _lodExtract->buildGraphs(alignment, *this);
+   }
+
+   LodExtract* _lodExtract;
+   bool _writerStopped;
+};
+
+void LodExtract::convertInternalNodes(hal_size_t numThreads,
+                                      const string& inHalPath,
+                                      CLParserConstPtr options)
+{
+  numThreads = std::min(numThreads, (hal_size_t)_nodes.size());
+  if (numThreads <= 1)
+  {
+    AlignmentConstPtr inAlignment = _inAlignment;
+    LodGraph graphs[2];
+    for (size_t i = 0; i < _nodes.size(); ++i)
+    {
+      _nodes[i]._inAlignment = inAlignment;
+      size_t numBuilt = 0;
+      for (size_t j = 0; j < _scales.size(); ++j)
+      {
+        if (_nodes[i]._reuse[j] == true)
+        {
+          copyPrevious(_nodes[i], j);
+          continue;
+        }
+        LodGraph& graph = graphs[numBuilt % 2];
+        LodGraph& seed = graphs[(numBuilt + 1) % 2];
+        buildGraph(inAlignment, _nodes[i], _scales[j],
+                   numBuilt > 0 ? &seed : NULL, graph);
+        seed.erase();
+        ++numBuilt;
+        _nodes[i]._graph = &graph;
+        writeGraph(_nodes[i], j);
+      }
+      graphs[0].erase();
+      graphs[1].erase();
+      closeInputGenomes(inAlignment, _nodes[i]);
+    }
+    return;
+  }
+
+  GraphThreads threads(this);
+  threads.start(numThreads, inHalPath, options);
+
+  // the nodes are handed out in order, so each one's graphs turn up
+  // eventually, one scale at a time.  its thread waits for each graph to
+  // be written before building another, which keeps at most numThreads
+  // graphs (and the seeds of the ones being built) in memory.  the
+  // graphs that are reused are copied here without waiting
+  for (size_t i = 0; i < _nodes.size() * _scales.size(); ++i)
+  {
+    InternalNode& node = _nodes[i / _scales.size()];
+    bool reuse = node._reuse[i % _scales.size()];
+    threads.lock();
+    while (threads.hasError() == false && reuse == false &&
+           node._graph == NULL)
+    {
+      threads.wait();
+    }
+    bool error = threads.hasError();
+    threads.unlock();
+    if (error == true)
+    {
+      break;
+    }
+    try
+    {
+      if (reuse == true)
+      {
+        copyPrevious(node, i % _scales.size());
+      }
+      else
+      {
+        writeGraph(node, node._numWritten);
+      }
+      if (node._numWritten + 1 == _scales.size() &&
+          find(node._reuse.begin(), node._reuse.end(), true) !=
+          node._reuse.end())
+      {
+        closeInputGenomes(_sourceAlignment, node);
+      }
+    }
+    catch(exception& e)
+    {
+      threads.setError(e.what());
+      break;
+    }
+    threads.lock();
+    if (reuse == false)
+    {
+      node._graph = NULL;
+    }
+    ++node._numWritten;
+    threads.broadcast();
+    threads.unlock();
+  }
+  threads.lock();
+  threads._writerStopped = true;
+  threads.broadcast();
+  threads.unlock();
+  threads.join();
+}
+
+void LodExtract::buildGraphs(AlignmentConstPtr inAlignment,
+                             GraphThreads& threads)
+{
+  LodGraph graphs[2];
+  size_t next;
+  while (threads.nextItem(_nodes.size(), next) == true)
+  {
+    InternalNode& node = _nodes[next];
+    bool writerStopped = false;
+    size_t numBuilt = 0;
+    for (size_t j = 0; j < _scales.size() && !writerStopped; ++j)
+    {
+      if (node._reuse[j] == true)
+      {
+        continue;
+      }
+      LodGraph& graph = graphs[numBuilt % 2];
+      LodGraph& seed = graphs[(numBuilt + 1) % 2];
+      buildGraph(inAlignment, node, _scales[j],
+                 numBuilt > 0 ? &seed : NULL, graph);
+      seed.erase();
+      ++numBuilt;
+
+      // the writer uses our alignment and graph until it's done
+      threads.lock();
+      node._inAlignment = inAlignment;
+      node._graph = &graph;
+      threads.broadcast();
+      while (node._numWritten <= j && threads._writerStopped == false)
+      {
+        threads.wait();
+      }
+      writerStopped = node._numWritten <= j;
+      threads.unlock();
+    }
+    graphs[0].erase();
+    graphs[1].erase();
+    if (numBuilt > 0)
+    {
+      closeInputGenomes(inAlignment, node);
+    }
+  }
+}
+
+void LodExtract::buildGraph(AlignmentConstPtr inAlignment,
+                            const InternalNode& node, double scale,
+                            const LodGraph* seed, LodGraph& graph) const
+{
+  const Genome* parent = inAlignment->openGenome(node._name);
   assert(parent != NULL);
-  vector<string> childNames = _outAlignment->getChildNames(genomeName);
   vector<const Genome*> children;
-  for (hal_size_t i = 0; i < childNames.size(); ++i)
+  for (hal_size_t i = 0; i < node._childNames.size(); ++i)
   {
-    children.push_back(_inAlignment->openGenome(childNames[i]));
+    children.push_back(inAlignment->openGenome(node._childNames[i]));
   }
   const Genome* grandParent = NULL; // TEMP HACK  parent->getParent();
   hal_size_t minAvgBlockSize = getMinAvgBlockSize(parent, children, grandParent);
   hal_size_t step = (hal_size_t)(scale * minAvgBlockSize);
-  _graph.build(_inAlignment, parent, children, grandParent, step, _allSequences, 
-               _probeFrac, _minSeqFrac);
+  graph.build(inAlignment, parent, children, grandParent, step, _allSequences, 
+              _probeFrac, _minSeqFrac, seed);
+}
+
+void LodExtract::writeGraph(const InternalNode& node, size_t scaleIdx)
+{
+  _inAlignment = node._inAlignment;
+  _graph = node._graph;
+  _outAlignment = _outAlignments[scaleIdx];
+  const Genome* parent = _inAlignment->openGenome(node._name);
+  vector<const Genome*> children;
+  for (hal_size_t i = 0; i < node._childNames.size(); ++i)
+  {
+    children.push_back(_inAlignment->openGenome(node._childNames[i]));
+  }
 
   map<const Sequence*, hal_size_t> segmentCounts;
   countSegmentsInGraph(segmentCounts);
 
-  writeDimensions(segmentCounts, parent->getName(), childNames);
+  writeDimensions(segmentCounts, parent->getName(), node._childNames);
   if (_keepSequences == true)
   {
     writeSequences(parent, children);
@@ -182,20 +561,156 @@ void LodExtract::convertInternalNode(const string& genomeName,
   // if we're gonna print anything out, do it before this:
   // (not necesssary but by closing genomes we erase their hdf5 caches
   // which can make a difference on huge trees
-  _graph.erase();
   _outAlignment->closeGenome(_outAlignment->openGenome(parent->getName()));
-  _inAlignment->closeGenome(parent);
   for (hal_size_t i = 0; i < children.size(); ++i)
   {
     _outAlignment->closeGenome(
       _outAlignment->openGenome(children[i]->getName()));
-    _inAlignment->closeGenome(children[i]);    
   }
-  if (grandParent != NULL)
+  _graph = NULL;
+}
+
+void LodExtract::copyPrevious(const InternalNode& node, size_t scaleIdx)
+{
+  _inAlignment = _sourceAlignment;
+  _outAlignment = _outAlignments[scaleIdx];
+  AlignmentConstPtr prevAlignment = _prevAlignments[scaleIdx];
+  const Genome* parent = _inAlignment->openGenome(node._name);
+  vector<const Genome*> children;
+  vector<const Genome*> prevGenomes;
+  for (hal_size_t i = 0; i < node._childNames.size(); ++i)
+  {
+    children.push_back(_inAlignment->openGenome(node._childNames[i]));
+    prevGenomes.push_back(prevAlignment->openGenome(node._childNames[i]));
+  }
+  prevGenomes.push_back(prevAlignment->openGenome(node._name));
+  vector<const Genome*> inGenomes = children;
+  inGenomes.push_back(parent);
+
+  // the same dimensions as the graph would have given
+  map<const Sequence*, hal_size_t> segmentCounts;
+  for (size_t i = 0; i < inGenomes.size(); ++i)
+  {
+    SequenceIteratorConstPtr seqIt = inGenomes[i]->getSequenceIterator();
+    SequenceIteratorConstPtr seqEnd = inGenomes[i]->getSequenceEndIterator();
+    for (; seqIt != seqEnd; seqIt->toNext())
+    {
+      const Sequence* inSequence = seqIt->getSequence();
+      const Sequence* prevSequence =
+         prevGenomes[i]->getSequence(inSequence->getName());
+      if (prevSequence != NULL)
+      {
+        if (prevSequence->getSequenceLength() !=
+            inSequence->getSequenceLength())
+        {
+          throw hal_exception("Sequence " + inSequence->getFullName() +
+                              " has a different length in the previous "
+                              "alignment");
+        }
+        segmentCounts.insert(pair<const Sequence*, hal_size_t>(
+                               inSequence, inGenomes[i] == parent ?
+                               prevSequence->getNumBottomSegments() :
+                               prevSequence->getNumTopSegments()));
+      }
+    }
+  }
+
+  writeDimensions(segmentCounts, parent->getName(), node._childNames);
+  if (_keepSequences == true)
+  {
+    writeSequences(parent, children);
+  }
+  for (size_t i = 0; i < inGenomes.size(); ++i)
+  {
+    copySegments(prevGenomes[i],
+                 _outAlignment->openGenome(inGenomes[i]->getName()),
+                 inGenomes[i] != parent);
+  }
+  writeParseInfo(_outAlignment->openGenome(parent->getName()));
+
+  for (size_t i = 0; i < inGenomes.size(); ++i)
   {
     _outAlignment->closeGenome(
-      _outAlignment->openGenome(grandParent->getName()));
-    _inAlignment->closeGenome(grandParent);
+      _outAlignment->openGenome(inGenomes[i]->getName()));
+    prevAlignment->closeGenome(prevGenomes[i]);
+  }
+}
+
+void LodExtract::copySegments(const Genome* prevGenome, Genome* outGenome,
+                              bool top)
+{
+  SequenceIteratorConstPtr seqIt = outGenome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEnd = outGenome->getSequenceEndIterator();
+  for (; seqIt != seqEnd; seqIt->toNext())
+  {
+    // the array indices are copied as they are, which is only right
+    // if the sequences are laid out the same way
+    const Sequence* outSequence = seqIt->getSequence();
+    const Sequence* prevSequence =
+       prevGenome->getSequence(outSequence->getName());
+    assert(prevSequence != NULL);
+    if (prevSequence->getStartPosition() != outSequence->getStartPosition() ||
+        (top == true && prevSequence->getTopSegmentArrayIndex() !=
+         outSequence->getTopSegmentArrayIndex()) ||
+        (top == false && prevSequence->getBottomSegmentArrayIndex() !=
+         outSequence->getBottomSegmentArrayIndex()))
+    {
+      throw hal_exception("Sequence " + outSequence->getFullName() +
+                          " is not where it was in the previous alignment");
+    }
+  }
+
+  if (top == true)
+  {
+    TopSegmentIteratorConstPtr prevTop = prevGenome->getTopSegmentIterator();
+    TopSegmentIteratorPtr outTop = outGenome->getTopSegmentIterator();
+    hal_size_t n = outGenome->getNumTopSegments();
+    assert(n == prevGenome->getNumTopSegments());
+    for (hal_size_t i = 0; i < n; ++i)
+    {
+      outTop->setCoordinates(prevTop->getStartPosition(),
+                             prevTop->getLength());
+      outTop->setParentIndex(prevTop->getParentIndex());
+      outTop->setParentReversed(prevTop->getParentReversed());
+      outTop->setNextParalogyIndex(prevTop->getNextParalogyIndex());
+      outTop->setBottomParseIndex(NULL_INDEX);
+      prevTop->toRight();
+      outTop->toRight();
+    }
+  }
+  else
+  {
+    BottomSegmentIteratorConstPtr prevBottom =
+       prevGenome->getBottomSegmentIterator();
+    BottomSegmentIteratorPtr outBottom = outGenome->getBottomSegmentIterator();
+    hal_size_t n = outGenome->getNumBottomSegments();
+    assert(n == prevGenome->getNumBottomSegments());
+    hal_size_t numChildren = outGenome->getNumChildren();
+    assert(numChildren == prevGenome->getNumChildren());
+    for (hal_size_t i = 0; i < n; ++i)
+    {
+      outBottom->setCoordinates(prevBottom->getStartPosition(),
+                                prevBottom->getLength());
+      for (hal_size_t childNum = 0; childNum < numChildren; ++childNum)
+      {
+        outBottom->setChildIndex(childNum, prevBottom->getChildIndex(childNum));
+        outBottom->setChildReversed(childNum,
+                                    prevBottom->getChildReversed(childNum));
+      }
+      outBottom->setTopParseIndex(NULL_INDEX);
+      prevBottom->toRight();
+      outBottom->toRight();
+    }
+  }
+}
+
+void LodExtract::closeInputGenomes(AlignmentConstPtr inAlignment,
+                                   const InternalNode& node) const
+{
+  inAlignment->closeGenome(inAlignment->openGenome(node._name));
+  for (hal_size_t i = 0; i < node._childNames.size(); ++i)
+  {
+    inAlignment->closeGenome(inAlignment->openGenome(node._childNames[i]));
   }
 }
 
@@ -206,9 +721,9 @@ void LodExtract::countSegmentsInGraph(
   const LodSegment* segment;
   pair<map<const Sequence*, hal_size_t>::iterator, bool> res;
 
-  for (hal_size_t blockIdx = 0; blockIdx < _graph.getNumBlocks(); ++blockIdx)
+  for (hal_size_t blockIdx = 0; blockIdx < _graph->getNumBlocks(); ++blockIdx)
   {
-    block = _graph.getBlock(blockIdx);
+    block = _graph->getBlock(blockIdx);
     for (hal_size_t segIdx = 0; segIdx < block->getNumSegments(); ++segIdx)
     {
       segment = block->getSegment(segIdx);
@@ -221,7 +736,7 @@ void LodExtract::countSegmentsInGraph(
   
   // add unsampled non-zero sequences to dimensions, by looking for
   // sequences who have telomeres but no segments. 
-  const LodBlock* telomeres = _graph.getTelomeres();
+  const LodBlock* telomeres = _graph->getTelomeres();
   for (hal_size_t telIdx = 0; telIdx < telomeres->getNumSegments(); ++telIdx)
   {
     segment = telomeres->getSegment(telIdx);
@@ -387,7 +902,7 @@ void LodExtract::writeSegments(const Genome* inParent,
         bottom = outSequence->getBottomSegmentIterator();
         outSegment = bottom;
       }
-      const LodGraph::SegmentSet* segSet = _graph.getSegmentSet(inSequence);
+      const LodGraph::SegmentSet* segSet = _graph->getSegmentSet(inSequence);
       assert(segSet != NULL);
       LodGraph::SegmentSet::const_iterator segIt = segSet->begin();
       if (segSet->size() > 2)
@@ -461,10 +976,10 @@ void LodExtract::writeHomologies(const Genome* inParent,
   TopSegmentIteratorPtr top = outChild->getTopSegmentIterator();
 
   // FOR EVERY BLOCK
-  for (hal_size_t blockIdx = 0; blockIdx < _graph.getNumBlocks(); ++blockIdx)
+  for (hal_size_t blockIdx = 0; blockIdx < _graph->getNumBlocks(); ++blockIdx)
   {
     SegmentMap segMap;
-    const LodBlock* block = _graph.getBlock(blockIdx);
+    const LodBlock* block = _graph->getBlock(blockIdx);
 
     for (hal_size_t segIdx = 0; segIdx < block->getNumSegments(); ++segIdx)
     {
@@ -656,8 +1171,8 @@ hal_size_t LodExtract::getMinAvgBlockSize(
     if (inChildren[i]->getSequenceLength() > 0)
     {
       assert(inChildren[i]->getNumTopSegments() > 0);
-      assert(inChildren[i]->getNumTopSegments() <
-             inParent->getSequenceLength());
+      assert(inChildren[i]->getNumTopSegments() <=
+             inChildren[i]->getSequenceLength());
       minAvgBlockSize = std::min(minAvgBlockSize, 
                                  inChildren[i]->getSequenceLength() / 
                                  inChildren[i]->getNumTopSegments());
@@ -5,6 +5,8 @@
  */
 
 #include <cassert>
+#include <sstream>
+#include <fstream>
 #include "halLodExtract.h"
 
 using namespace std;
@@ -14,8 +16,10 @@ static CLParserPtr initParser()
 {
   CLParserPtr optionsParser = hdf5CLParserInstance(true);
   optionsParser->addArgument("inHalPath", "Input hal file");
-  optionsParser->addArgument("outHalPath", "output hal file");
-  optionsParser->addArgument("scale", "Scale factor for interpolation");
+  optionsParser->addArgument("outHalPath", "output hal file (or comma-"
+                             "separated list of files, one per scale)");
+  optionsParser->addArgument("scale", "Scale factor for interpolation (or "
+                             "comma-separated list of scale factors)");
   optionsParser->addOption("root", 
                            "Name of root genome of tree to extract (root if "
                            "empty)", "\"\"");
@@ -34,6 +38,23 @@ static CLParserPtr initParser()
                            // Note: needs to be manually synched with 
                            // value in halLodInterpolate.py
                            0.5);
+  optionsParser->addOption("numThreads",
+                           "Number of threads building the graphs of "
+                           "internal nodes.  The output is still written by "
+                           "a single thread.",
+                           1);
+  optionsParser->addOption("prevLod",
+                           "Output of a previous run with the same options "
+                           "(or comma-separated list, one per output file). "
+                           "Internal nodes whose genomes haven't changed "
+                           "since, according to the change log kept in the "
+                           "input file, are copied from it rather than "
+                           "rebuilt.  Opening the input for writing counts "
+                           "as changing every genome, unless the tool "
+                           "logs what it changed (as halReplaceGenome, "
+                           "halAddToBranch and halAppendSubtree do).  Files "
+                           "that don't exist are ignored.",
+                           "\"\"");
   optionsParser->addOptionFlag("keepSequences",
                                "Write the sequence strings to the output "
                                "file.", false);
@@ -47,7 +68,9 @@ static CLParserPtr initParser()
                                 "The scale parameter is used to estimate "
                                 "the interpolation step-size so that the "
                                 "output has \"scale\" fewer blocks than the"
-                                " input.");
+                                " input.  Several levels of detail can be made"
+                                " in a single pass over the input by giving "
+                                "a list of scales and as many output files.");
   return optionsParser;
 }
 
@@ -58,11 +81,13 @@ int main(int argc, char** argv)
   string outHalPath;
   string rootName;
   string outTree;
-  double scale;
+  string scale;
   bool keepSequences;
   bool allSequences;
   double probeFrac;
   double minSeqFrac;
+  hal_size_t numThreads;
+  string prevLod;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -70,11 +95,13 @@ int main(int argc, char** argv)
     outHalPath = optionsParser->getArgument<string>("outHalPath");
     rootName = optionsParser->getOption<string>("root");
     outTree = optionsParser->getOption<string>("outTree");
-    scale = optionsParser->getArgument<double>("scale");
+    scale = optionsParser->getArgument<string>("scale");
     keepSequences = optionsParser->getFlag("keepSequences");
     allSequences = optionsParser->getFlag("allSequences");
     probeFrac = optionsParser->getOption<double>("probeFrac");
     minSeqFrac = optionsParser->getOption<double>("minSeqFrac");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    prevLod = optionsParser->getOption<string>("prevLod");
     if (allSequences == true)
     {
       minSeqFrac = 0.;
@@ -95,13 +122,59 @@ int main(int argc, char** argv)
       throw hal_exception("Input hal alignment is empty");
     }
 
-    AlignmentPtr outAlignment = hdf5AlignmentInstance();
-    outAlignment->setOptionsFromParser(optionsParser);
-    outAlignment->createNew(outHalPath);
-    
-    if (outAlignment->getNumGenomes() != 0)
+    vector<string> outHalPaths = chopString(outHalPath, ",");
+    vector<string> scaleStrings = chopString(scale, ",");
+    if (outHalPaths.size() != scaleStrings.size())
+    {
+      throw hal_exception("Need as many output hal files as scales");
+    }
+    vector<double> scales(scaleStrings.size());
+    for (size_t i = 0; i < scaleStrings.size(); ++i)
+    {
+      stringstream ss(scaleStrings[i]);
+      ss >> scales[i];
+      if (!ss || scales[i] <= 0.)
+      {
+        throw hal_exception("Invalid scale: " + scaleStrings[i]);
+      }
+    }
+
+    // opened before the outputs are created in case they are the same
+    vector<AlignmentConstPtr> prevAlignments;
+    if (prevLod != "\"\"")
     {
-      throw hal_exception("Output hal Alignmnent cannot be initialized");
+      vector<string> prevHalPaths = chopString(prevLod, ",");
+      if (prevHalPaths.size() != outHalPaths.size())
+      {
+        throw hal_exception("Need as many previous hal files as output "
+                            "hal files");
+      }
+      for (size_t i = 0; i < prevHalPaths.size(); ++i)
+      {
+        if (prevHalPaths[i] == outHalPaths[i])
+        {
+          throw hal_exception("Previous hal file can't be overwritten: " +
+                              prevHalPaths[i]);
+        }
+        ifstream prevFile(prevHalPaths[i].c_str());
+        prevAlignments.push_back(
+          prevFile ? openHalAlignmentReadOnly(prevHalPaths[i], optionsParser)
+          : AlignmentConstPtr());
+      }
+    }
+
+    vector<AlignmentPtr> outAlignments;
+    for (size_t i = 0; i < outHalPaths.size(); ++i)
+    {
+      AlignmentPtr outAlignment = hdf5AlignmentInstance();
+      outAlignment->setOptionsFromParser(optionsParser);
+      outAlignment->createNew(outHalPaths[i]);
+    
+      if (outAlignment->getNumGenomes() != 0)
+      {
+        throw hal_exception("Output hal Alignmnent cannot be initialized");
+      }
+      outAlignments.push_back(outAlignment);
     }
     if (rootName != "\"\"" && inAlignment->openGenome(rootName) == NULL)
     {
@@ -117,10 +190,13 @@ int main(int argc, char** argv)
     }
 
     LodExtract lodExtract;
-    lodExtract.createInterpolatedAlignment(inAlignment, outAlignment,
-                                           scale, outTree, rootName,
-                                           keepSequences, allSequences,
-                                           probeFrac, minSeqFrac);
+    lodExtract.setPreviousAlignments(prevAlignments);
+    lodExtract.createInterpolatedAlignments(inAlignment, outAlignments,
+                                            scales, outTree, rootName,
+                                            keepSequences, allSequences,
+                                            probeFrac, minSeqFrac,
+                                            numThreads, inHalPath,
+                                            optionsParser);
   }
   catch(hal_exception& e)
   {
@@ -9,12 +9,13 @@
 #include <cmath>
 #include <cstdlib>
 #include <algorithm>
+#include <sstream>
 #include "halLodGraph.h"
 
 using namespace std;
 using namespace hal;
 
-LodGraph::LodGraph() : _extendFraction(1.0)
+LodGraph::LodGraph() : _extendFraction(1.0), _seed(NULL)
 {
 
 }
@@ -26,27 +27,31 @@ LodGraph::~LodGraph()
 
 void LodGraph::erase()
 {
-  for (SequenceMapIterator smi = _seqMap.begin(); smi != _seqMap.end(); ++smi)
+  for (ScanMapIterator smi = _scanMap.begin(); smi != _scanMap.end(); ++smi)
   {
     delete smi->second;
   }
+  _scanMap.clear();
   _seqMap.clear();
-  for (BlockIterator bi = _blocks.begin(); bi != _blocks.end(); ++bi)
-  {
-    delete *bi;
-  }
   _blocks.clear();
+  _columnSites.clear();
+  _columnStarts.clear();
+  _seed = NULL;
+  _seeds.clear();
   _parent = NULL;
   _grandParent = NULL;
   _genomes.clear();
+  _genomeList.clear();
   _telomeres.clear();
+  _blockPool.clear();
+  _segmentPool.clear();
 }
 
 void LodGraph::build(AlignmentConstPtr alignment, const Genome* parent,
                      const vector<const Genome*>& children, 
                      const Genome* grandParent,
                      hal_size_t step, bool allSequences, double probeFrac,
-                     double minSeqFrac)
+                     double minSeqFrac, const LodGraph* seed)
 {
   erase();
   _alignment = alignment;
@@ -60,20 +65,21 @@ void LodGraph::build(AlignmentConstPtr alignment, const Genome* parent,
   assert(_parent != NULL);
   assert(_alignment->openGenome(_parent->getName()) == _parent);
   
-  _genomes.insert(parent);
-  for (vector<const Genome*>::const_iterator child = children.begin();
-       child != children.end(); ++child)
+  _genomeList.push_back(parent);
+  _genomeList.insert(_genomeList.end(), children.begin(), children.end());
+  if (_grandParent != NULL)
   {
-    _genomes.insert(*child);
+    _genomeList.push_back(_grandParent);
   }
-  assert(_genomes.size() == children.size() + 1);
-  if (_grandParent != NULL)
+  _genomes.insert(_genomeList.begin(), _genomeList.end());
+  assert(_genomes.size() == _genomeList.size());
+  if (seed != NULL)
   {
-    _genomes.insert(_grandParent);
+    addSeeds(seed);
   }
 
-  for (set<const Genome*>::iterator gi = _genomes.begin(); 
-       gi != _genomes.end(); ++gi)
+  for (vector<const Genome*>::iterator gi = _genomeList.begin(); 
+       gi != _genomeList.end(); ++gi)
   {
     scanGenome(*gi);
   }
@@ -85,6 +91,7 @@ void LodGraph::build(AlignmentConstPtr alignment, const Genome* parent,
   optimizeByMerging();
   printDimensions(cout);
   optimizeByInsertion();
+  sortSegmentSets();
   printDimensions(cout);
   assert(checkCoverage() == true);
 }
@@ -131,8 +138,19 @@ void LodGraph::scanGenome(const Genome* genome)
         hal_size_t maxDelta = 0;     
         hal_size_t maxMinSeqLen = 0;
         hal_index_t tryPos = numProbe == 1 ? pos : minTry;
+        if (_seeds.empty() == false &&
+            sampleSeeds(sequence, tryPos, minTry, maxTry, probeStep,
+                        bestPos) == true)
+        {
+          if (bestPos != NULL_INDEX)
+          {
+            lastSampledPos = sequence->getStartPosition() + bestPos;
+          }
+          continue;
+        }
         ColumnIteratorConstPtr colIt = 
            sequence->getColumnIterator(&_genomes, 0, tryPos);
+        Column column;
         do 
         {
           if (colIt->getReferenceSequencePosition() != tryPos)
@@ -145,7 +163,8 @@ void LodGraph::scanGenome(const Genome* genome)
           hal_size_t delta;
           hal_size_t numGenomes;
           hal_size_t minSeqLen;
-          evaluateColumn(colIt, delta, numGenomes, minSeqLen);
+          getColumn(colIt, column);
+          evaluateColumn(column, delta, numGenomes, minSeqLen);
           if (bestColumn(probeStep, delta, numGenomes, minSeqLen,
                          maxDelta, maxNumGenomes, maxMinSeqLen))
           {
@@ -167,7 +186,8 @@ void LodGraph::scanGenome(const Genome* genome)
           }
           assert(colIt->getReferenceSequence() == sequence);
           assert(colIt->getReferenceSequencePosition() == bestPos);
-          createColumn(colIt);
+          getColumn(colIt, column);
+          createColumn(column);
           lastSampledPos = sequence->getStartPosition() + bestPos;
         }
       }
@@ -175,7 +195,144 @@ void LodGraph::scanGenome(const Genome* genome)
   }
 }
 
-void LodGraph::evaluateColumn(ColumnIteratorConstPtr colIt,
+void LodGraph::getColumn(ColumnIteratorConstPtr colIt, 
+                         Column& outColumn) const
+{
+  outColumn.clear();
+  const ColumnIterator::ColumnMap* colMap = colIt->getColumnMap();
+  // the map keeps each genome's sequences together, in order, so we only
+  // need to pick out the genomes in our order (and then any others)
+  for (size_t i = 0; i <= _genomeList.size(); ++i)
+  {
+    ColumnIterator::ColumnMap::const_iterator colMapIt = colMap->begin();
+    for (; colMapIt != colMap->end(); ++colMapIt)
+    {
+      const Genome* genome = colMapIt->first->getGenome();
+      if (i < _genomeList.size() ? genome == _genomeList[i] :
+          _genomes.find(genome) == _genomes.end())
+      {
+        outColumn.push_back(ColumnEntry(colMapIt->first, SiteList()));
+        SiteList& sites = outColumn.back().second;
+        const ColumnIterator::DNASet* dnaSet = colMapIt->second;
+        for (ColumnIterator::DNASet::const_iterator dnaIt = dnaSet->begin();
+             dnaIt != dnaSet->end(); ++dnaIt)
+        {
+          sites.push_back(pair<hal_index_t, bool>(
+                            (*dnaIt)->getArrayIndex(),
+                            (*dnaIt)->getReversed()));
+        }
+        std::sort(sites.begin(), sites.end());
+      }
+    }
+  }
+}
+
+void LodGraph::addSeeds(const LodGraph* seed)
+{
+  assert(seed->_step <= _step);
+  _seed = seed;
+  for (size_t i = 0; i < seed->_columnStarts.size(); ++i)
+  {
+    size_t end = i + 1 < seed->_columnStarts.size() ?
+       seed->_columnStarts[i + 1] : seed->_columnSites.size();
+    for (size_t j = seed->_columnStarts[i]; j < end; ++j)
+    {
+      const ColumnSite& site = seed->_columnSites[j];
+      if (site._pos != NULL_INDEX)
+      {
+        const Sequence* sequence = site._sequence;
+        _seeds[sequence].insert(pair<hal_index_t, size_t>(
+                                  site._pos - sequence->getStartPosition(),
+                                  i));
+      }
+    }
+  }
+}
+
+void LodGraph::getSampledColumn(size_t index, Column& outColumn) const
+{
+  outColumn.clear();
+  size_t end = index + 1 < _columnStarts.size() ?
+     _columnStarts[index + 1] : _columnSites.size();
+  for (size_t j = _columnStarts[index]; j < end; ++j)
+  {
+    const ColumnSite& site = _columnSites[j];
+    if (outColumn.empty() || outColumn.back().first != site._sequence)
+    {
+      outColumn.push_back(ColumnEntry(site._sequence, SiteList()));
+    }
+    if (site._pos != NULL_INDEX)
+    {
+      outColumn.back().second.push_back(
+        pair<hal_index_t, bool>(site._pos, site._reversed));
+    }
+  }
+}
+
+bool LodGraph::sampleSeeds(const Sequence* sequence, hal_index_t tryPos,
+                           hal_index_t minTry, hal_index_t maxTry,
+                           hal_size_t probeStep, hal_index_t& outBestPos)
+{
+  outBestPos = NULL_INDEX;
+  SeedMap::const_iterator smi = _seeds.find(sequence);
+  if (smi == _seeds.end())
+  {
+    return false;
+  }
+  const SeedPositions& positions = smi->second;
+  SeedPositions::const_iterator first = positions.lower_bound(minTry);
+  SeedPositions::const_iterator last = positions.lower_bound(maxTry);
+  if (first == last)
+  {
+    return false;
+  }
+  SeedPositions::const_iterator best = last;
+  Column column;
+  hal_size_t maxNumGenomes = 1;
+  hal_size_t maxDelta = 0;     
+  hal_size_t maxMinSeqLen = 0;
+  // stand in for each probe with the seed closest to it, so that we don't
+  // sample more densely than probing would
+  do
+  {
+    SeedPositions::const_iterator spi = positions.lower_bound(tryPos);
+    if (spi != first)
+    {
+      SeedPositions::const_iterator left = spi;
+      --left;
+      if (spi == last || tryPos - left->first < spi->first - tryPos)
+      {
+        spi = left;
+      }
+    }
+    assert(spi != last);
+    hal_size_t delta;
+    hal_size_t numGenomes;
+    hal_size_t minSeqLen;
+    _seed->getSampledColumn(spi->second, column);
+    evaluateColumn(column, delta, numGenomes, minSeqLen);
+    if (bestColumn(probeStep, delta, numGenomes, minSeqLen,
+                   maxDelta, maxNumGenomes, maxMinSeqLen))
+    {
+      best = spi;
+      maxDelta = delta;
+      maxNumGenomes = numGenomes;
+      maxMinSeqLen = minSeqLen;
+    }
+    tryPos += probeStep;
+  }
+  while (tryPos < maxTry);
+
+  if (best != last)
+  {
+    _seed->getSampledColumn(best->second, column);
+    createColumn(column);
+    outBestPos = best->first;
+  }
+  return true;
+}
+
+void LodGraph::evaluateColumn(const Column& column,
                               hal_size_t& outDeltaMax,
                               hal_size_t& outNumGenomes,
                               hal_size_t& outMinSeqLen)
@@ -184,12 +341,11 @@ void LodGraph::evaluateColumn(ColumnIteratorConstPtr colIt,
   outMinSeqLen = numeric_limits<hal_size_t>::max();
   set<const Genome*> genomeSet;
   // check that block has not already been added.
-  const ColumnIterator::ColumnMap* colMap = colIt->getColumnMap();
-  ColumnIterator::ColumnMap::const_iterator colMapIt = colMap->begin();
+  Column::const_iterator colMapIt = column.begin();
   bool breakOut = false;
-  for (; colMapIt != colMap->end() && !breakOut; ++colMapIt)
+  for (; colMapIt != column.end() && !breakOut; ++colMapIt)
   {
-    const ColumnIterator::DNASet* dnaSet = colMapIt->second;
+    const SiteList* sites = &colMapIt->second;
     const Sequence* sequence = colMapIt->first;
     if (sequence->getSequenceLength() <= _minSeqLen)
     {
@@ -206,21 +362,21 @@ void LodGraph::evaluateColumn(ColumnIteratorConstPtr colIt,
     else
     {
       outMinSeqLen = std::min(outMinSeqLen, sequence->getSequenceLength());
-      ColumnIterator::DNASet::const_iterator dnaIt = dnaSet->begin();
-      if (!dnaSet->empty())
+      SiteList::const_iterator siteIt = sites->begin();
+      if (!sites->empty())
       {
         genomeSet.insert(sequence->getGenome());
       }
-      for (; dnaIt != dnaSet->end() && !breakOut; ++dnaIt)
+      for (; siteIt != sites->end() && !breakOut; ++siteIt)
       {
-        hal_index_t pos = (*dnaIt)->getArrayIndex();
+        hal_index_t pos = siteIt->first;
         LodSegment segment(NULL, sequence, pos, false);
-        SequenceMapIterator smi = _seqMap.find(sequence);
-        if (smi != _seqMap.end())
+        ScanMapIterator smi = _scanMap.find(sequence);
+        if (smi != _scanMap.end())
         {
-          SegmentSet* segmentSet = smi->second;
-          SegmentIterator si = segmentSet->lower_bound(&segment);
-          SegmentSet::value_compare segPLess = segmentSet->key_comp();
+          ScanSet* segmentSet = smi->second;
+          ScanSet::iterator si = segmentSet->lower_bound(&segment);
+          ScanSet::value_compare segPLess = segmentSet->key_comp();
           if (si == segmentSet->end())
           {
             outDeltaMax = numeric_limits<hal_size_t>::max();
@@ -284,58 +440,76 @@ bool LodGraph::bestColumn(hal_size_t probeStep, hal_size_t delta,
 
 void LodGraph::addTelomeres(const Sequence* sequence)
 {
-  SequenceMapIterator smi = _seqMap.find(sequence);
-  SegmentSet* segSet = NULL;
-  if (smi == _seqMap.end())
+  ScanMapIterator smi = _scanMap.find(sequence);
+  ScanSet* segSet = NULL;
+  if (smi == _scanMap.end())
   {
-    segSet = new SegmentSet();
-    _seqMap.insert(pair<const Sequence*, SegmentSet*>(sequence, segSet));
+    segSet = new ScanSet();
+    _scanMap.insert(pair<const Sequence*, ScanSet*>(sequence, segSet));
   }
   else
   {
     segSet = smi->second;
   }
 
-  LodSegment* segment = new LodSegment(&_telomeres, sequence, 
-                                       sequence->getStartPosition() - 1,
-                                       false);
+  LodSegment* segment = _segmentPool.allocate();
+  segment->init(&_telomeres, sequence, sequence->getStartPosition() - 1,
+                false);
   _telomeres.addSegment(segment);
   segSet->insert(segment);  
-  segment = new LodSegment(&_telomeres, sequence, 
-                           sequence->getEndPosition() + 1, false);
+  segment = _segmentPool.allocate();
+  segment->init(&_telomeres, sequence, sequence->getEndPosition() + 1,
+                false);
   _telomeres.addSegment(segment);
   segSet->insert(segment);
 }
 
-void LodGraph::createColumn(ColumnIteratorConstPtr colIt)
+void LodGraph::createColumn(const Column& column)
 {
-  LodBlock* block = new LodBlock();
-  const ColumnIterator::ColumnMap* colMap = colIt->getColumnMap();
-  ColumnIterator::ColumnMap::const_iterator colMapIt = colMap->begin();
-  for (; colMapIt != colMap->end(); ++colMapIt)
+  LodBlock* block = _blockPool.allocate();
+  _columnStarts.push_back(_columnSites.size());
+  ColumnSite colSite;
+  Column::const_iterator colMapIt = column.begin();
+  for (; colMapIt != column.end(); ++colMapIt)
   {
     const Sequence* sequence = colMapIt->first;
+    const SiteList* sites = &colMapIt->second;
+    colSite._sequence = sequence;
+    if (sites->empty())
+    {
+      colSite._pos = NULL_INDEX;
+      colSite._reversed = false;
+      _columnSites.push_back(colSite);
+    }
+    for (SiteList::const_iterator siteIt = sites->begin();
+         siteIt != sites->end(); ++siteIt)
+    {
+      colSite._pos = siteIt->first;
+      colSite._reversed = siteIt->second;
+      _columnSites.push_back(colSite);
+    }
+
     if (sequence->getSequenceLength() > _minSeqLen)
     {
-      SequenceMapIterator smi = _seqMap.find(sequence);
-      SegmentSet* segSet = NULL;
-      if (smi == _seqMap.end())
+      ScanMapIterator smi = _scanMap.find(sequence);
+      ScanSet* segSet = NULL;
+      if (smi == _scanMap.end())
       {
-        segSet = new SegmentSet();;
-        _seqMap.insert(pair<const Sequence*, SegmentSet*>(sequence, segSet));
+        segSet = new ScanSet();
+        _scanMap.insert(pair<const Sequence*, ScanSet*>(sequence, segSet));
       }
       else
       {
         segSet = smi->second;
       }
     
-      const ColumnIterator::DNASet* dnaSet = colMapIt->second;
-      for (ColumnIterator::DNASet::const_iterator dnaIt = dnaSet->begin();
-           dnaIt != dnaSet->end(); ++ dnaIt)
+      for (SiteList::const_iterator siteIt = sites->begin();
+           siteIt != sites->end(); ++siteIt)
       {
-        hal_index_t pos = (*dnaIt)->getArrayIndex();
-        bool reversed = (*dnaIt)->getReversed();
-        LodSegment* segment = new LodSegment(block, sequence, pos, reversed);
+        hal_index_t pos = siteIt->first;
+        bool reversed = siteIt->second;
+        LodSegment* segment = _segmentPool.allocate();
+        segment->init(block, sequence, pos, reversed);
         block->addSegment(segment);
         assert(segSet->find(segment) == segSet->end());
         segSet->insert(segment);
@@ -348,10 +522,10 @@ void LodGraph::createColumn(ColumnIteratorConstPtr colIt)
 
 void LodGraph::computeAdjacencies()
 {
-  for (SequenceMapIterator smi = _seqMap.begin(); smi != _seqMap.end(); ++smi)
+  for (ScanMapIterator smi = _scanMap.begin(); smi != _scanMap.end(); ++smi)
   {
-    SegmentIterator si = smi->second->begin();
-    SegmentIterator siNext;
+    ScanSet::iterator si = smi->second->begin();
+    ScanSet::iterator siNext;
     for (; si != smi->second->end(); ++si)
     {
       siNext = si;
@@ -362,7 +536,13 @@ void LodGraph::computeAdjacencies()
         (*si)->addEdgeFromRightToLeft(*siNext);
       }
     }
+    // the rest of the passes only need to keep track of the segments,
+    // which a vector does much more cheaply than a set
+    SegmentSet& segSet = _seqMap[smi->first];
+    segSet.assign(smi->second->begin(), smi->second->end());
+    delete smi->second;
   }
+  _scanMap.clear();
 }
 
 void LodGraph::optimizeByExtension()
@@ -395,18 +575,8 @@ void LodGraph::optimizeByMerging()
     LodBlock* adjBlock = (*bi)->getHeadMergePartner();
     if (adjBlock != NULL)
     {
-      for (hal_size_t segIdx = 0; segIdx < adjBlock->getNumSegments(); ++segIdx)
-      {
-        // blah - need to clean interface but this is harmless for now
-        LodSegment* seg = const_cast<LodSegment*>(
-          adjBlock->getSegment(segIdx));
-        SequenceMapIterator mapIt = _seqMap.find(seg->getSequence());
-        assert(mapIt != _seqMap.end());
-        SegmentIterator setIt = mapIt->second->find(seg);
-        assert(setIt != mapIt->second->end());
-        assert(*setIt == seg);
-        mapIt->second->erase(setIt);
-      }
+      // the merged segments are left in the SegmentSets, without
+      // adjacencies, until sortSegmentSets()
       (*bi)->mergeHead(adjBlock);
     }
   }
@@ -431,7 +601,7 @@ void LodGraph::optimizeByInsertion()
     newBlocks.clear();
     for (BlockIterator bi = _blocks.begin(); bi != _blocks.end(); ++bi)
     {
-      (*bi)->insertNeighbours(newBlocks);
+      (*bi)->insertNeighbours(newBlocks, _blockPool, _segmentPool);
     }
     startPoint = _blocks.end();
     --startPoint;
@@ -444,13 +614,31 @@ void LodGraph::optimizeByInsertion()
       {
         // blah - need to clean interface but this is harmless for now
         LodSegment* seg = const_cast<LodSegment*>((*bi)->getSegment(i));
-        _seqMap.find(seg->getSequence())->second->insert(seg);
+        _seqMap.find(seg->getSequence())->second.push_back(seg);
       }
     }
     ++startPoint;
   }
 }
 
+void LodGraph::sortSegmentSets()
+{
+  for (SequenceMapIterator smi = _seqMap.begin(); smi != _seqMap.end(); ++smi)
+  {
+    SegmentSet& segSet = smi->second;
+    SegmentSet::iterator last = segSet.begin();
+    for (SegmentSet::iterator si = segSet.begin(); si != segSet.end(); ++si)
+    {
+      if ((*si)->getTailAdj() != NULL || (*si)->getHeadAdj() != NULL)
+      {
+        *last++ = *si;
+      }
+    }
+    segSet.erase(last, segSet.end());
+    std::sort(segSet.begin(), segSet.end(), LodSegmentPLess());
+  }
+}
+
 void LodGraph::printDimensions(ostream& os) const
 {
   hal_size_t totalSegments = 0;
@@ -480,14 +668,18 @@ void LodGraph::printDimensions(ostream& os) const
     minAdjLength = std::min(minAdjLength, (*bi)->getTotalAdjLength());
   }
 
-  os << "Graph: numBlocks=" << _blocks.size()
+  // one write, so that lines from graphs built in different threads
+  // don't get mixed up
+  stringstream ss;
+  ss << "Graph: numBlocks=" << _blocks.size()
      << " numSegs=" << totalSegments << " minSegs=" << minSegments
      << " maxSegs=" << maxSegments
      << " totLen=" << totalLength << " minLen=" << minLength
      << " maxLen=" << maxLength 
      << " totAdjLen=" << totalAdjLength << " minAdjLen=" << minAdjLength
      << " maxAdjLen=" << maxAdjLength 
-     << endl;
+     << '\n';
+  os << ss.str() << flush;
 }
 
 bool LodGraph::checkCoverage() const
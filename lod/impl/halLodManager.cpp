@@ -10,7 +10,9 @@
 #include <limits>
 #include <fstream>
 #include <algorithm>
+#include <sys/time.h>
 #include "halLodManager.h"
+#include "halLodCache.h"
 
 #ifdef ENABLE_UDC
 extern "C" {
@@ -34,27 +36,34 @@ const unsigned long LodManager::MaxAgeSec = 432000;
 // hal/lod/halLodInterpolate.py)
 const string LodManager::MaxLodToken = "max";
 
-LodManager::LodManager()
+static double getTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+LodManager::LevelStats::LevelStats() : _numQueries(0), _numOpens(0),
+                                       _numPreloaded(0), _seconds(0.)
+{
+
+}
+
+LodManager::LodManager() : _preloading(true)
 {
 
 }
 
 LodManager::~LodManager()
 {
-  for (AlignmentMap::iterator mapIt = _map.begin(); mapIt != _map.end();
-       ++mapIt)
-  {
-    if (mapIt->second.second.get() != NULL)
-    {
-      mapIt->second.second->close();
-    }
-  }
+  clearMap();
 }
 
 void LodManager::loadLODFile(const string& lodPath,
                              CLParserConstPtr options)
 {
-  _map.clear();
+  clearMap();
+  _options = options;
 
 #ifdef ENABLE_UDC
   char* cpath = const_cast<char*>(lodPath.c_str());
@@ -121,8 +130,13 @@ void LodManager::loadLODFile(const string& lodPath,
     {
       fullHalPath = resolvePath(lodPath, path);
     }
-    _map.insert(pair<hal_size_t, PathAlign>(
-                  minLen, PathAlign(fullHalPath, AlignmentConstPtr())));
+    Level level;
+    level._path = fullHalPath;
+    if (_map.insert(pair<hal_size_t, Level>(minLen, level)).second == true &&
+        fullHalPath != MaxLodToken)
+    {
+      LodCache::getInstance()->addUser(fullHalPath, _options);
+    }
     ++lineNum;
   }
 
@@ -132,9 +146,12 @@ void LodManager::loadLODFile(const string& lodPath,
 void LodManager::loadSingeHALFile(const string& halPath,
                                   CLParserConstPtr options)
 {
-  _map.clear();
-  _map.insert(pair<hal_size_t, PathAlign>(
-                0, PathAlign(halPath, AlignmentConstPtr())));
+  clearMap();
+  _options = options;
+  Level level;
+  level._path = halPath;
+  _map.insert(pair<hal_size_t, Level>(0, level));
+  LodCache::getInstance()->addUser(halPath, _options);
   _maxLodLowerBound = (hal_size_t)numeric_limits<hal_index_t>::max();
   checkMap(halPath);
 }
@@ -154,7 +171,6 @@ AlignmentConstPtr LodManager::getAlignment(hal_size_t queryLength,
     --mapIt;
   }
   assert(mapIt->first <= queryLength);
-  AlignmentConstPtr& alignment = mapIt->second.second;
   if (mapIt->first == _maxLodLowerBound)
   {
     stringstream ss;
@@ -162,17 +178,26 @@ AlignmentConstPtr LodManager::getAlignment(hal_size_t queryLength,
        << getMaxQueryLength();
     throw hal_exception(ss.str());
   }
-  if (alignment.get() == NULL)
+  LevelStats& stats = mapIt->second._stats;
+  double startTime = getTime();
+  bool opened;
+  bool preloaded;
+  AlignmentConstPtr alignment = LodCache::getInstance()->getAlignment(
+    mapIt->second._path, opened, preloaded);
+  if (opened == true || preloaded == true)
   {
-    alignment = hdf5AlignmentInstanceReadOnly();
-    if (_options.get() != NULL)
-    {
-      alignment->setOptionsFromParser(_options);
-    }
-    alignment->open(mapIt->second.first);
-    checkAlignment(mapIt->first, mapIt->second.first, alignment);
+    checkAlignment(mapIt->first, mapIt->second._path, alignment);
+  }
+  ++stats._numQueries;
+  stats._numOpens += opened == true ? 1 : 0;
+  stats._numPreloaded += preloaded == true ? 1 : 0;
+  stats._seconds += getTime() - startTime;
+  assert(alignment.get() != NULL);
+
+  if (_preloading == true)
+  {
+    preloadNeighbours(mapIt, queryLength);
   }
-  assert(mapIt->second.second.get() != NULL);
   return alignment;
 }
 
@@ -184,6 +209,82 @@ bool LodManager::isLod0(hal_size_t queryLength) const
   return mapIt == _map.begin();
 }
 
+const LodManager::LevelStats&
+LodManager::getLevelStats(hal_size_t queryLength) const
+{
+  assert(_map.size() > 0);
+  AlignmentMap::const_iterator mapIt = _map.upper_bound(queryLength);
+  --mapIt;
+  return mapIt->second._stats;
+}
+
+void LodManager::printLevelStats(ostream& os) const
+{
+  os << "minQueryLength, path, queries, opens, preloaded, seconds" << endl;
+  for (AlignmentMap::const_iterator mapIt = _map.begin();
+       mapIt != _map.end() && mapIt->first != _maxLodLowerBound; ++mapIt)
+  {
+    const LevelStats& stats = mapIt->second._stats;
+    os << mapIt->first << ", " << mapIt->second._path << ", "
+       << stats._numQueries << ", " << stats._numOpens << ", "
+       << stats._numPreloaded << ", " << stats._seconds << endl;
+  }
+}
+
+void LodManager::setPreloading(bool preloading)
+{
+  _preloading = preloading;
+}
+
+void LodManager::preloadNeighbours(AlignmentMap::const_iterator mapIt,
+                                   hal_size_t queryLength)
+{
+  AlignmentMap::const_iterator above = mapIt;
+  ++above;
+  if (above != _map.end() && above->first == _maxLodLowerBound)
+  {
+    above = _map.end();
+  }
+  AlignmentMap::const_iterator below = _map.end();
+  if (mapIt != _map.begin())
+  {
+    below = mapIt;
+    --below;
+  }
+
+  // the query is likelier to move to the level whose bound it's closest
+  // to (on a log scale), so that one goes first
+  bool belowFirst = below != _map.end() && above != _map.end() &&
+     (double)queryLength * (double)queryLength <
+     (double)mapIt->first * (double)above->first;
+  LodCache* cache = LodCache::getInstance();
+  if (belowFirst == true)
+  {
+    cache->preload(below->second._path);
+  }
+  if (above != _map.end())
+  {
+    cache->preload(above->second._path);
+  }
+  if (below != _map.end() && belowFirst == false)
+  {
+    cache->preload(below->second._path);
+  }
+}
+
+void LodManager::clearMap()
+{
+  for (AlignmentMap::iterator mapIt = _map.begin(); mapIt != _map.end();
+       ++mapIt)
+  {
+    if (mapIt->second._path != MaxLodToken)
+    {
+      LodCache::getInstance()->removeUser(mapIt->second._path);
+    }
+  }
+  _map.clear();
+}
+
 string LodManager::resolvePath(const string& lodPath,
                                const string& halPath)
 {
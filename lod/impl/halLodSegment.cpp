@@ -19,26 +19,31 @@ LodSegment::LodSegment() : _sequence(NULL), _tailPos(NULL_INDEX),
 }
 
 LodSegment::LodSegment(LodBlock* block, const Sequence* sequence, 
-                       hal_index_t pos, bool flipped) :
-  _sequence(sequence), 
-  _tailPos(pos),
-  _afterHeadPos(pos),
-  _tailAdj(NULL),
-  _headAdj(NULL),
-  _arrayIndex(NULL_INDEX),
-  _block(block)
+                       hal_index_t pos, bool flipped)
 {
-  _afterHeadPos += flipped ? -1 : 1;
-  assert(_sequence != NULL);
-  assert(getLeftPos() >= getRightPos());
-  assert(getLeftPos() >= _sequence->getStartPosition() - 1);
-  assert(getRightPos() <= _sequence->getEndPosition() + 1);
+  init(block, sequence, pos, flipped);
 }
 
 LodSegment::~LodSegment()
 {
 }
 
+void LodSegment::init(LodBlock* block, const Sequence* sequence,
+                      hal_index_t pos, bool flipped)
+{
+  _sequence = sequence;
+  _tailPos = pos;
+  _afterHeadPos = pos + (flipped ? -1 : 1);
+  _tailAdj = NULL;
+  _headAdj = NULL;
+  _arrayIndex = NULL_INDEX;
+  _block = block;
+  assert(_sequence != NULL);
+  assert(getLeftPos() >= getRightPos());
+  assert(getLeftPos() >= _sequence->getStartPosition() - 1);
+  assert(getRightPos() <= _sequence->getEndPosition() + 1);
+}
+
 void LodSegment::addEdgeFromRightToLeft(LodSegment* tgt)
 {
   assert(tgt != NULL);
@@ -87,13 +92,14 @@ void LodSegment::extendHead(hal_size_t extLen)
   assert(overlaps(*_headAdj) == false);
 }
 
-LodSegment* LodSegment::insertNewHeadAdj(LodBlock* block, hal_size_t newLen)
+LodSegment* LodSegment::insertNewHeadAdj(LodBlock* block, hal_size_t newLen,
+                                         LodPool<LodSegment>& pool)
 {
   assert(newLen > 0);
   hal_index_t newTailPos = getHeadPos();
   newTailPos += getFlipped() ? -1 : 1;
-  LodSegment* newSeg = new LodSegment(block, getSequence(), newTailPos,
-                                      getFlipped());
+  LodSegment* newSeg = pool.allocate();
+  newSeg->init(block, getSequence(), newTailPos, getFlipped());
   bool headToHead = getHeadToHead();
   newSeg->_headAdj = _headAdj;
   if (headToHead)
@@ -116,13 +122,14 @@ LodSegment* LodSegment::insertNewHeadAdj(LodBlock* block, hal_size_t newLen)
   return newSeg;
 }
 
-LodSegment* LodSegment::insertNewTailAdj(LodBlock* block, hal_size_t newLen)
+LodSegment* LodSegment::insertNewTailAdj(LodBlock* block, hal_size_t newLen,
+                                         LodPool<LodSegment>& pool)
 {
   assert(newLen > 0);
   hal_index_t newHeadPos = getTailPos();
   newHeadPos += getFlipped() ? 1 : -1;
-  LodSegment* newSeg = new LodSegment(block, getSequence(), newHeadPos, 
-                                      getFlipped());
+  LodSegment* newSeg = pool.allocate();
+  newSeg->init(block, getSequence(), newHeadPos, getFlipped());
   bool tailToTail = getTailToTail();
   newSeg->_tailAdj = _tailAdj;
   if (tailToTail)
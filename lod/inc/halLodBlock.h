@@ -28,8 +28,8 @@ struct LodBlockPBigger
 };
 
 /* A block is a list of homolgous segments.  All these segments must
- * be the same length.  The block's destructor will free all segments
- * it contains. 
+ * be the same length.  The segments (and blocks) are owned by the
+ * LodPools of the graph, which free them all at once.
  */
 class LodBlock
 {
@@ -72,15 +72,20 @@ public:
    /** Insert new blocks as neighbours until all adjacencies have length
     * 0.  (if there are no self edges, at most 1 head block and 1 tail
     * block are created.  If there are self edges, it can take multiple
-    * blocks to reduce all the edge  lengths */
-   void insertNeighbours(std::vector<LodBlock*>& outList);
+    * blocks to reduce all the edge  lengths.  The new blocks and
+    * segments are allocated from the pools */
+   void insertNeighbours(std::vector<LodBlock*>& outList,
+                         LodPool<LodBlock>& blockPool,
+                         LodPool<LodSegment>& segmentPool);
       
 protected:
 
    /** Create a new block and insert it as a neighbour.  All adjacencies
     * of this block become 0. */
-   LodBlock* insertNewTailNeighbour();
-   LodBlock* insertNewHeadNeighbour();
+   LodBlock* insertNewTailNeighbour(LodPool<LodBlock>& blockPool,
+                                    LodPool<LodSegment>& segmentPool);
+   LodBlock* insertNewHeadNeighbour(LodPool<LodBlock>& blockPool,
+                                    LodPool<LodSegment>& segmentPool);
   
    /** Get the maximum length to extend the block.  This is equivalent
     * to the minimum adjacency length, except that adjacencies between
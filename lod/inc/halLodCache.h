@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALLODCACHE_H
+#define _HALLODCACHE_H
+
+#include <string>
+#include <deque>
+#include <map>
+#include <pthread.h>
+#include "hal.h"
+
+namespace hal {
+
+/** The HAL files opened by all the LodManagers of a process, keyed by
+ * path, so that handles on the same files share the open alignments and
+ * their caches.  Alignments that are no longer in use are closed, least
+ * recently used first, once their estimated memory exceeds the budget.
+ *
+ * Files can also be opened ahead of time by a background thread (if HDF5
+ * is thread-safe).  A query for a file that is still loading waits for
+ * it rather than opening it again.
+ *
+ * The alignments themselves are not thread-safe:  only the thread(s) the
+ * LodManagers are used from (one at a time) may use what getAlignment()
+ * returns.
+ */
+class LodCache
+{
+public:
+
+   /** The instance shared by all LodManagers.  It is never deleted, so
+    * LodManagers can still be destroyed at exit */
+   static LodCache* getInstance();
+
+   /** A LodManager will query path.  Options are applied the first time
+    * it is opened */
+   void addUser(const std::string& path, CLParserConstPtr options);
+   /** A LodManager is done with path.  Closes it if nobody else uses it */
+   void removeUser(const std::string& path);
+
+   /** Open (if necessary) and return the alignment at path, which must
+    * have been added.  opened is set if we opened it now (or waited for
+    * it to finish loading) and preloaded if it had been loaded ahead of
+    * time and not yet used */
+   AlignmentConstPtr getAlignment(const std::string& path, bool& opened,
+                                  bool& preloaded);
+
+   /** Open path in the background, if it isn't already, it is in use and
+    * there is room in the budget.  Does nothing if HDF5 isn't
+    * thread-safe */
+   void preload(const std::string& path);
+
+   /** Estimated bytes of the open alignments */
+   size_t getNumBytes() const;
+   size_t getMaxBytes() const;
+   void setMaxBytes(size_t maxBytes);
+
+   static const size_t DefaultMaxBytes;
+
+protected:
+
+   struct Entry
+   {
+      Entry();
+      AlignmentConstPtr _alignment;
+      CLParserConstPtr _options;
+      size_t _numUsers;
+      size_t _numBytes;
+      size_t _lastUse;
+      bool _loading;
+      bool _preloaded;
+   };
+   typedef std::map<std::string, Entry> EntryMap;
+
+   LodCache();
+
+   AlignmentConstPtr createAlignment(const Entry& entry) const;
+   size_t estimateBytes(const std::string& path, const CLParser* options,
+                        const Alignment* alignment) const;
+   static void warmUp(const Alignment* alignment);
+   void insert(const std::string& path, AlignmentConstPtr alignment,
+               size_t numBytes, bool preloaded);
+   void cancelJob(const std::string& path);
+   void evict();
+   void loadJobs();
+
+   static void* preloadThread(void* data);
+
+   EntryMap _entries;
+   std::deque<std::pair<std::string, AlignmentConstPtr> > _jobs;
+   std::string _loadingPath;
+   size_t _numBytes;
+   size_t _maxBytes;
+   size_t _clock;
+   size_t _defaultCacheBytes;
+   bool _threadStarted;
+   pthread_t _thread;
+   mutable pthread_mutex_t _mutex;
+   pthread_cond_t _cond;
+
+private:
+   LodCache(const LodCache&);
+   const LodCache& operator=(const LodCache&) const;
+};
+
+}
+
+#endif
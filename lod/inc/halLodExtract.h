@@ -26,7 +26,23 @@ namespace hal {
  *
  * The output alignment is created from an arbitrary subset of genomes from
  * the input, linked together in an arbitrary tree.  By default, the 
- * identical tree is used. */
+ * identical tree is used. 
+ *
+ * The graphs of different internal nodes only depend on the input, so
+ * they can be built by several threads, each with its own instance of
+ * the input alignment.  They are still written one at a time, parents
+ * before children, by the calling thread.
+ *
+ * Several levels of detail (one output alignment per scale) can be
+ * made in one pass: the graphs of all the scales are built for each
+ * internal node while its input genomes are open, finest first, and
+ * each graph is seeded with the columns sampled by the previous one,
+ * so that most of the coarser levels don't need new probes.
+ *
+ * Given the output of a previous run, the internal nodes whose genomes
+ * (and the branches between them) haven't changed since, according to
+ * the change log in the input's metadata, are copied from it instead of
+ * being built again. */
 class LodExtract
 {
 public:
@@ -42,18 +58,74 @@ public:
                                     bool keepSequences,
                                     bool allSequences,
                                     double probeFrac,
-                                    double minSeqFrac);
-   
+                                    double minSeqFrac,
+                                    hal_size_t numThreads = 1,
+                                    const std::string& inHalPath = "",
+                                    CLParserConstPtr options = 
+                                    CLParserConstPtr());
+
+   /** Write an interpolation of inAlignment at scales[i] to
+    * outAlignments[i] for every i */
+   void createInterpolatedAlignments(AlignmentConstPtr inAlignment,
+                                     const std::vector<AlignmentPtr>&
+                                     outAlignments,
+                                     const std::vector<double>& scales,
+                                     const std::string& tree,
+                                     const std::string& rootName,
+                                     bool keepSequences,
+                                     bool allSequences,
+                                     double probeFrac,
+                                     double minSeqFrac,
+                                     hal_size_t numThreads = 1,
+                                     const std::string& inHalPath = "",
+                                     CLParserConstPtr options = 
+                                     CLParserConstPtr());
+
+   /** Reuse what can be reused from prevAlignments[i] (if it's not NULL)
+    * when writing outAlignments[i] in the next call to
+    * createInterpolatedAlignments() */
+   void setPreviousAlignments(const std::vector<AlignmentConstPtr>&
+                              prevAlignments);
    
 protected:
 
    typedef std::set<const LodSegment*, LodSegmentPLess> SegmentSet;
    typedef std::map<const Genome*, SegmentSet*> SegmentMap;
 
+   /** An internal node of the output tree, and the graph built for it
+    * at the next scale to be written (NULL until it is ready).  _reuse
+    * says at which scales it is copied from the previous alignment */
+   struct InternalNode
+   {
+      std::string _name;
+      std::vector<std::string> _childNames;
+      std::vector<bool> _reuse;
+      AlignmentConstPtr _inAlignment;
+      const LodGraph* _graph;
+      size_t _numWritten;
+   };
+
 protected:
 
    void createTree(const std::string& tree, const std::string& rootName);
-   void convertInternalNode(const std::string& genomeName, double scale);
+   void getInternalNodes();
+   std::string getParameters(double scale) const;
+   void findReusableNodes();
+   bool hasChanged(const InternalNode& node, hal_size_t sinceChange) const;
+   void convertInternalNodes(hal_size_t numThreads,
+                             const std::string& inHalPath,
+                             CLParserConstPtr options);
+   struct GraphThreads;
+   void buildGraphs(AlignmentConstPtr inAlignment, GraphThreads& threads);
+   void buildGraph(AlignmentConstPtr inAlignment, const InternalNode& node,
+                   double scale, const LodGraph* seed,
+                   LodGraph& graph) const;
+   void writeGraph(const InternalNode& node, size_t scaleIdx);
+   void copyPrevious(const InternalNode& node, size_t scaleIdx);
+   void copySegments(const Genome* prevGenome, Genome* outGenome,
+                     bool top);
+   void closeInputGenomes(AlignmentConstPtr inAlignment,
+                          const InternalNode& node) const;
    void countSegmentsInGraph(
      std::map<const Sequence*, hal_size_t>& segmentCounts);
    void writeDimensions(
@@ -80,14 +152,28 @@ protected:
      const Genome* inGrandParent) const;
 
    
+   // the graph being written, the input alignment it was built from, and
+   // the output alignment of its scale
    AlignmentConstPtr _inAlignment;
+   const LodGraph* _graph;
    AlignmentPtr _outAlignment;
 
-   LodGraph _graph;
+   std::vector<AlignmentPtr> _outAlignments;
+   std::vector<double> _scales;
+
+   // the input alignment passed in (which the threads don't use), the
+   // previous output alignments to copy from, and the last entry of the
+   // input's change log each was made after
+   AlignmentConstPtr _sourceAlignment;
+   std::vector<AlignmentConstPtr> _prevAlignments;
+   std::vector<hal_size_t> _prevChanges;
    bool _keepSequences;
    bool _allSequences;
    double _probeFrac;
    double _minSeqFrac;
+
+   // internal nodes, parents before children
+   std::vector<InternalNode> _nodes;
 };
 
 }
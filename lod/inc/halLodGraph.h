@@ -15,6 +15,7 @@
 #include "hal.h"
 #include "halLodSegment.h"
 #include "halLodBlock.h"
+#include "halLodPool.h"
 
 namespace hal {
 
@@ -22,7 +23,9 @@ class LodGraph
 {
 public:
 
-   typedef std::set<LodSegment*, LodSegmentPLess> SegmentSet;
+   /** The segments of a sequence, sorted by LodSegmentPLess once the
+    * graph is built */
+   typedef std::vector<LodSegment*> SegmentSet;
    typedef SegmentSet::iterator SegmentIterator;
    
    LodGraph();
@@ -38,12 +41,14 @@ public:
    /** Build the LOD graph for a given subtree of the alignment.  The
     * entire graph is stored in memory in a special structure (ie not within
     * HAL).  The step parameter dictates how coarse-grained the interpolation
-    * is:  every step bases are sampled.  */
+    * is:  every step bases are sampled.  If seed is a graph of the
+    * same genomes built with a smaller step, the columns it sampled are
+    * tried before any new ones are probed. */
    void build(AlignmentConstPtr alignment, const Genome* parent,
               const std::vector<const Genome*>& children, 
               const Genome* grandParent,
               hal_size_t step, bool allSequences, double probeFrac,
-              double minSeqFrac);
+              double minSeqFrac, const LodGraph* seed = NULL);
 
    /** Help debuggin and tuning */
    void printDimensions(std::ostream& os) const;
@@ -59,16 +64,59 @@ protected:
    typedef BlockList::iterator BlockIterator;
    typedef BlockList::const_iterator BlockConstIterator;
 
-   typedef std::map<const Sequence*, SegmentSet*> SequenceMap;
+   typedef std::map<const Sequence*, SegmentSet> SequenceMap;
    typedef SequenceMap::iterator SequenceMapIterator;
 
+   // while scanning, the segments need to be searched as they are added
+   typedef std::set<LodSegment*, LodSegmentPLess> ScanSet;
+   typedef std::map<const Sequence*, ScanSet*> ScanMap;
+   typedef ScanMap::iterator ScanMapIterator;
+
+   // a column is stored as the sites (array index and strand) of each
+   // of its sequences
+   typedef std::vector<std::pair<hal_index_t, bool> > SiteList;
+   typedef std::pair<const Sequence*, SiteList> ColumnEntry;
+   typedef std::vector<ColumnEntry> Column;
+   typedef std::map<hal_index_t, size_t> SeedPositions;
+   typedef std::map<const Sequence*, SeedPositions> SeedMap;
+
+   // the columns that were sampled are kept back to back in one array
+   // of sites. a sequence without sites gets one with a NULL_INDEX
+   // position
+   struct ColumnSite
+   {
+      const Sequence* _sequence;
+      hal_index_t _pos;
+      bool _reversed;
+   };
+
    /** Read a HAL genome into sequence graph */
    void scanGenome(const Genome* genome);
 
+   /** Copy the column iterator's column map, ordered by genome (as in
+    * _genomeList) and position instead of by pointer, so that the graph
+    * doesn't depend on where the genomes happen to be allocated */
+   void getColumn(ColumnIteratorConstPtr colIt, Column& outColumn) const;
+
+   /** Index the columns sampled by a graph with a smaller step */
+   void addSeeds(const LodGraph* seed);
+
+   /** Unpack the index'th sampled column */
+   void getSampledColumn(size_t index, Column& outColumn) const;
+
+   /** Add the best seed column with a site of sequence in the range
+    * [minTry, maxTry), as scanGenome() would have if it had probed
+    * the seeds closest to its probes.  outBestPos is set to its position
+    * (NULL_INDEX if none was good enough).  Returns false if there were
+    * no seeds in the range, in which case it needs to be probed */
+   bool sampleSeeds(const Sequence* sequence, hal_index_t tryPos,
+                    hal_index_t minTry, hal_index_t maxTry,
+                    hal_size_t probeStep, hal_index_t& outBestPos);
+
    /** Check maxium distance of this column to any other sampled position.
     * Also count the number of genomes it aligns to.  This information
     * will be used to prioritize probed columns*/
-   void evaluateColumn(ColumnIteratorConstPtr colIt, hal_size_t& outDeltaMax,
+   void evaluateColumn(const Column& column, hal_size_t& outDeltaMax,
                        hal_size_t& outNumGenomes, hal_size_t& outMinSeqLen);
 
    /* Test if this is the best column based on stats collected above */
@@ -81,13 +129,14 @@ protected:
     * position -1 and and endPosition + 1 */
    void addTelomeres(const Sequence* sequence);
 
-   /** Add a single column iterator as  a block */
-   void createColumn(ColumnIteratorConstPtr colIt);
+   /** Add a single column as a block */
+   void createColumn(const Column& column);
 
    /** Add an entire sequence as unaliged segment */
    void createUnaligedSegment(const Sequence* sequence);
 
-   /** compute the adjacencies using the SegmentSets */
+   /** compute the adjacencies using the ScanSets, which are then
+    * replaced by the SegmentSets */
    void computeAdjacencies();
 
    /** First optimization pass: Maximally extend all blocks */
@@ -100,12 +149,17 @@ protected:
     * zero length */
    void optimizeByInsertion();
 
+   /** Drop the segments merged away from the SegmentSets and sort them */
+   void sortSegmentSets();
+
 protected:
    
    // input alignment structure
    AlignmentConstPtr _alignment;
    const Genome* _parent;
    std::set<const Genome*> _genomes;
+   // the same genomes, in the order they are scanned (parent first)
+   std::vector<const Genome*> _genomeList;
    const Genome* _grandParent;
 
    // step size for interpolation
@@ -114,14 +168,23 @@ protected:
    // fraction of edge to greedily extend
    double _extendFraction;
 
-   // the alignment blocks
+   // the alignment blocks, and the storage for all blocks and segments
    BlockList _blocks;
+   LodPool<LodBlock> _blockPool;
+   LodPool<LodSegment> _segmentPool;
+
+   // the columns the blocks were created from (_columnStarts[i] is the
+   // first site of column i), and the sites of the columns of a seed graph
+   std::vector<ColumnSite> _columnSites;
+   std::vector<size_t> _columnStarts;
+   const LodGraph* _seed;
+   SeedMap _seeds;
 
-   // the telomeres all get put in one block.  the block structure
-   // is used only to make sure they get freed.
+   // the telomeres all get put in one block.
    LodBlock _telomeres;
    
    // nodes sorted by sequence
+   ScanMap _scanMap;
    SequenceMap _seqMap;
 
    // sample all sequences no matter how small they are
@@ -151,7 +214,7 @@ inline const LodGraph::SegmentSet* LodGraph::getSegmentSet(
   const Sequence* sequence) const
 {
   assert(_seqMap.find(sequence) != _seqMap.end());
-  return _seqMap.find(sequence)->second;
+  return &_seqMap.find(sequence)->second;
 }
 
 inline const LodBlock* LodGraph::getTelomeres() const
@@ -18,11 +18,30 @@ namespace hal {
 
 /** This is a container that keeps track of LOD alignments as generated
  * by halLodExtract.py
+ *
+ * The HAL files are opened through the LodCache, so they are shared with
+ * the other LodManagers of the process and can be closed when memory
+ * runs short.  When a level is used, the levels on either side of it are
+ * opened in the background (nearest query length first).
  */
 class LodManager
 {
 public:
-   
+
+   /** Counters for the queries answered by one level */
+   struct LevelStats
+   {
+      LevelStats();
+      /** Calls to getAlignment() */
+      hal_size_t _numQueries;
+      /** Calls that opened the file, or waited for it to load */
+      hal_size_t _numOpens;
+      /** Calls that found it preloaded */
+      hal_size_t _numPreloaded;
+      /** Seconds spent in getAlignment() */
+      double _seconds;
+   };
+
    LodManager();
    virtual ~LodManager();
    
@@ -48,6 +67,16 @@ public:
    /** Check if query length corresponds to LOD 0 (ie original HAL) */
    bool isLod0(hal_size_t queryLenth) const;
 
+   /** Counters of the level used for queries of the given length */
+   const LevelStats& getLevelStats(hal_size_t queryLength) const;
+
+   /** One line of counters per level */
+   void printLevelStats(std::ostream& os) const;
+
+   /** Toggle opening the neighbouring levels in getAlignment() (on by
+    * default) */
+   void setPreloading(bool preloading);
+
    /** Any query greater than this is disabled */
    hal_size_t getMaxQueryLength() const;
 
@@ -65,14 +94,22 @@ protected:
    void checkMap(const std::string& lodPath);
    void checkAlignment(hal_size_t minQuery, const std::string& path,
                        AlignmentConstPtr alignment);
-   void preloadAlignments();
+   void clearMap();
+
+   struct Level
+   {
+      std::string _path;
+      LevelStats _stats;
+   };
+   typedef std::map<hal_size_t, Level> AlignmentMap;
 
-   typedef std::pair<std::string, AlignmentConstPtr> PathAlign;
-   typedef std::map<hal_size_t, PathAlign> AlignmentMap;
+   void preloadNeighbours(AlignmentMap::const_iterator mapIt,
+                          hal_size_t queryLength);
 
    CLParserConstPtr _options;
    AlignmentMap _map;
    hal_size_t _maxLodLowerBound;
+   bool _preloading;
 };
 
 inline hal_size_t LodManager::getMaxQueryLength() const 
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALLODPOOL_H
+#define _HALLODPOOL_H
+
+#include <vector>
+#include <cstddef>
+
+namespace hal {
+
+/** Storage for the segments and blocks of a LodGraph.  Objects are
+ * default-constructed in contiguous chunks, handed out one at a time,
+ * and only destroyed all together by clear().  Pointers to them stay
+ * valid until then. */
+template <typename T>
+class LodPool
+{
+public:
+
+   LodPool(size_t chunkSize = 16384);
+   ~LodPool();
+
+   T* allocate();
+   void clear();
+   size_t size() const;
+
+protected:
+
+   std::vector<T*> _chunks;
+   size_t _chunkSize;
+   size_t _used;
+
+private:
+   LodPool(const LodPool&);
+   const LodPool& operator=(const LodPool&) const;
+};
+
+template <typename T>
+inline LodPool<T>::LodPool(size_t chunkSize) : _chunkSize(chunkSize),
+                                               _used(chunkSize)
+{
+
+}
+
+template <typename T>
+inline LodPool<T>::~LodPool()
+{
+  clear();
+}
+
+template <typename T>
+inline T* LodPool<T>::allocate()
+{
+  if (_used == _chunkSize)
+  {
+    _chunks.push_back(new T[_chunkSize]);
+    _used = 0;
+  }
+  return _chunks.back() + _used++;
+}
+
+template <typename T>
+inline void LodPool<T>::clear()
+{
+  for (size_t i = 0; i < _chunks.size(); ++i)
+  {
+    delete [] _chunks[i];
+  }
+  _chunks.clear();
+  _used = _chunkSize;
+}
+
+template <typename T>
+inline size_t LodPool<T>::size() const
+{
+  return _chunks.empty() ? 0 :
+     (_chunks.size() - 1) * _chunkSize + _used;
+}
+
+}
+
+#endif
@@ -16,6 +16,7 @@
 #include <cstdlib>
 #include <cmath>
 #include "hal.h"
+#include "halLodPool.h"
 
 namespace hal {
 
@@ -46,6 +47,11 @@ public:
               hal_index_t pos, bool flipped);
    ~LodSegment();
 
+   /** Set a default-constructed (pooled) segment as the constructor
+    * above would */
+   void init(LodBlock* block, const Sequence* sequence,
+             hal_index_t pos, bool flipped);
+
    // inline get methods
    const Sequence* getSequence() const;
    hal_index_t getTailPos() const;
@@ -85,9 +91,11 @@ public:
     * will connect to whatever this's head connected to. The
     * new segment will have 0 distance from this segment, and
     * it's length is given by the parameter.  The new segment
-    * is then returned */
-   LodSegment* insertNewHeadAdj(LodBlock* block, hal_size_t newLen);
-   LodSegment* insertNewTailAdj(LodBlock* block, hal_size_t newLen);
+    * is allocated from pool then returned */
+   LodSegment* insertNewHeadAdj(LodBlock* block, hal_size_t newLen,
+                                LodPool<LodSegment>& pool);
+   LodSegment* insertNewTailAdj(LodBlock* block, hal_size_t newLen,
+                                LodPool<LodSegment>& pool);
 
    /** Merge the head adjacency segment to this segment.  That segment
     * should then get taken out of consideration */
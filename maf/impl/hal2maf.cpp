@@ -10,6 +10,9 @@
 #include <cstdio>
 #include "halMafExport.h"
 #include "halMafBed.h"
+#include "halMafIndex.h"
+#include "halMafBinaryWriter.h"
+#include "halBgzf.h"
 
 using namespace std;
 using namespace hal;
@@ -32,6 +35,14 @@ static CLParserPtr initParser()
                            "genome to export (or \"stdin\" to pipe from "
                            "standard input)",
                            "\"\"");
+  optionsParser->addOptionFlag("batchTargets",
+                               "read all the --refTargets intervals first and "
+                               "export them sorted by reference position "
+                               "(instead of in file order), reusing one "
+                               "column iterator.  much faster for many small "
+                               "intervals.  with --numThreads, runs of "
+                               "intervals are exported in parallel",
+                               false);
   optionsParser->addOption("start",
                            "coordinate within reference genome (or sequence"
                            " if specified) to start at",
@@ -81,10 +92,45 @@ static CLParserPtr initParser()
   optionsParser->addOptionFlag("global", "output all columns in alignment, "
                                "ignoring refGenome, refSequence, etc. flags",
                                false);
+  optionsParser->addOption("globalMaxMemory", "with --global, stop with "
+                           "an error if the record of which positions "
+                           "have been output takes more than this many "
+                           "bytes (0 for no limit).  It is at most one bit "
+                           "per base of the alignment.  Note that the HDF5 "
+                           "chunk caches (--cacheBytes, --cacheRDC) are per "
+                           "array, and are not counted", 0);
+  optionsParser->addOptionFlag("progress", "with --global, report each leaf "
+                               "genome as it is finished to stderr", false);
   optionsParser->addOptionFlag("printTree", "print a gene tree for every block",
                                false);
   optionsParser->addOptionFlag("onlyOrthologs", "make only orthologs to the "
                                "reference appear in the MAF blocks", false);
+  optionsParser->addOption("numThreads", "number of threads to convert the "
+                           "reference range with.  Each thread works on "
+                           "its own chunks of the reference, and blocks are "
+                           "broken at chunk boundaries.  Output is in "
+                           "reference order.  "
+                           "Not used with --global, or with --refTargets "
+                           "unless --batchTargets is given.  "
+                           "Requires a thread-safe HDF5 library", 1);
+  optionsParser->addOptionFlag("bgzip", "write BGZF-compressed output (as "
+                               "made by bgzip), which can be read by gzip "
+                               "and randomly accessed using --mafIndex.  "
+                               "Not used with --append", false);
+  optionsParser->addOption("compressThreads", "number of threads to compress "
+                           "--bgzip output with", 1);
+  optionsParser->addOptionFlag("binary", "write the blocks in a binary, "
+                               "columnar format (described in "
+                               "halMafBinaryReader.h, which can read it) "
+                               "instead of MAF.  Not used with --append, "
+                               "--bgzip, --mafIndex, --printTree or "
+                               "--numThreads", false);
+  optionsParser->addOption("mafIndex", "write an index of the reference "
+                           "rows of the blocks to this file.  Each line "
+                           "gives a reference range (sequence, start, end) "
+                           "and the (virtual, if --bgzip) offset of its "
+                           "first block.  Not used with --append, and "
+                           "requires --bgzip if writing to stdout", "\"\"");
 
   optionsParser->setDescription("Convert hal database to maf.");
   return optionsParser;
@@ -100,6 +146,7 @@ int main(int argc, char** argv)
   string targetGenomes;
   string refSequenceName;
   string refTargetsPath;
+  bool batchTargets;
   hal_index_t start;
   hal_size_t length;
   hal_size_t maxRefGap;
@@ -109,9 +156,16 @@ int main(int argc, char** argv)
   bool unique;
   bool append;
   bool global;
+  hal_size_t globalMaxMemory;
+  bool progress;
   bool printTree;
   bool onlyOrthologs;
   hal_index_t maxBlockLen;
+  hal_size_t numThreads;
+  bool bgzip;
+  bool binary;
+  hal_size_t compressThreads;
+  string mafIndexPath;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -122,6 +176,7 @@ int main(int argc, char** argv)
     targetGenomes = optionsParser->getOption<string>("targetGenomes");
     refSequenceName = optionsParser->getOption<string>("refSequence");    
     refTargetsPath = optionsParser->getOption<string>("refTargets");
+    batchTargets = optionsParser->getFlag("batchTargets");
     start = optionsParser->getOption<hal_index_t>("start");
     length = optionsParser->getOption<hal_size_t>("length");
     maxRefGap = optionsParser->getOption<hal_size_t>("maxRefGap");
@@ -131,15 +186,39 @@ int main(int argc, char** argv)
     unique = optionsParser->getFlag("unique");
     append = optionsParser->getFlag("append");
     global = optionsParser->getFlag("global");
+    globalMaxMemory = optionsParser->getOption<hal_size_t>("globalMaxMemory");
+    progress = optionsParser->getFlag("progress");
     printTree = optionsParser->getFlag("printTree");
     maxBlockLen = optionsParser->getOption<hal_index_t>("maxBlockLen");
     onlyOrthologs = optionsParser->getFlag("onlyOrthologs");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    bgzip = optionsParser->getFlag("bgzip");
+    binary = optionsParser->getFlag("binary");
+    compressThreads = optionsParser->getOption<hal_size_t>("compressThreads");
+    mafIndexPath = optionsParser->getOption<string>("mafIndex");
 
     if (rootGenomeName != "\"\"" && targetGenomes != "\"\"")
     {
       throw hal_exception("--rootGenome and --targetGenomes options are "
                           "mutually exclusive");
     }
+    if (append == true && (bgzip == true || mafIndexPath != "\"\""))
+    {
+      throw hal_exception("--append cannot be used with --bgzip or "
+                          "--mafIndex");
+    }
+    if (mafPath == "stdout" && mafIndexPath != "\"\"" && bgzip == false)
+    {
+      throw hal_exception("--mafIndex requires --bgzip when writing to "
+                          "stdout");
+    }
+    if (binary == true && (append == true || bgzip == true ||
+                           mafIndexPath != "\"\"" || printTree == true ||
+                           numThreads > 1))
+    {
+      throw hal_exception("--binary cannot be used with --append, --bgzip, "
+                          "--mafIndex, --printTree or --numThreads");
+    }
   }
   catch(exception& e)
   {
@@ -230,6 +309,10 @@ int main(int argc, char** argv)
     {
       openFlags |= ios_base::app;
     }
+    if (bgzip == true || binary == true)
+    {
+      openFlags |= ios_base::binary;
+    }
     ofstream mafFileStream;
     if (mafPath != "stdout")
     {
@@ -239,7 +322,16 @@ int main(int argc, char** argv)
         throw hal_exception("Error opening " + mafPath);
       }
     }
-    ostream& mafStream = mafPath != "stdout" ? mafFileStream : cout;
+    ostream& outStream = mafPath != "stdout" ? mafFileStream : cout;
+    BgzfWriteBuf bgzfBuf;
+    ostream bgzfStream(NULL);
+    if (bgzip == true)
+    {
+      bgzfBuf.open(&outStream, compressThreads);
+      bgzfStream.rdbuf(&bgzfBuf);
+    }
+    ostream& mafStream = bgzip == true ? bgzfStream : outStream;
+    MafIndex mafIndex;
 
     MafExport mafExport;
     mafExport.setMaxRefGap(maxRefGap);
@@ -251,6 +343,16 @@ int main(int argc, char** argv)
     mafExport.setMaxBlockLength(maxBlockLen);
     mafExport.setPrintTree(printTree);
     mafExport.setOnlyOrthologs(onlyOrthologs);
+    if (mafIndexPath != "\"\"")
+    {
+      mafExport.setIndex(&mafIndex);
+    }
+    MafBinaryWriter binaryWriter;
+    if (binary == true)
+    {
+      binaryWriter.open(&mafStream);
+      mafExport.setBinaryWriter(&binaryWriter);
+    }
 
     ifstream refTargetsStream;
     if (refTargetsPath != "\"\"")
@@ -270,12 +372,19 @@ int main(int argc, char** argv)
       }
       istream& bedStream = refTargetsPath != "stdin" ? bedFileStream : cin;
       MafBed mafBed(mafStream, alignment, refGenome, targetSet, mafExport);
+      mafBed.setBatch(batchTargets);
+      if (batchTargets == true)
+      {
+        mafExport.setNumThreads(numThreads, halPath, optionsParser);
+      }
       mafBed.scan(&bedStream);
     }
     else
     {
       if(global)
       {
+        mafExport.setGlobalMaxMemory(globalMaxMemory);
+        mafExport.setProgress(progress);
         mafExport.convertEntireAlignment(mafStream, alignment);
       }
       else if (start == 0 && length == 0 && ref->getSequenceLength() == 0)
@@ -287,17 +396,36 @@ int main(int argc, char** argv)
       }
       else
       {
+        mafExport.setNumThreads(numThreads, halPath, optionsParser);
         mafExport.convertSegmentedSequence(mafStream, alignment, ref, 
                                            start, length, targetSet);
       }
     }
+    if (binary == true)
+    {
+      binaryWriter.close();
+    }
+    streampos mafLength = mafStream.tellp();
+    if (bgzip == true)
+    {
+      bgzfBuf.close();
+    }
+    if (mafIndexPath != "\"\"")
+    {
+      ofstream indexStream(mafIndexPath.c_str());
+      if (!indexStream)
+      {
+        throw hal_exception("Error opening " + mafIndexPath);
+      }
+      mafIndex.write(indexStream, bgzip == true ? &bgzfBuf : NULL);
+    }
     if (mafPath != "stdout")
     {
       // dont want to leave a size 0 file when there's not ouput because
       // it can make some scripts (ie that process a maf for each contig)
       // obnoxious (presently the case for halPhlyoPTrain which uses 
       // hal2mafMP --splitBySequence). 
-      if (mafFileStream.tellp() == (streampos)0)
+      if (mafLength == (streampos)0)
       {
         std::remove(mafPath.c_str());
       }
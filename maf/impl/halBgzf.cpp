@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include <cstring>
+#include <pthread.h>
+#include <zlib.h>
+#include "halBgzf.h"
+
+using namespace std;
+using namespace hal;
+
+// same as bgzip, so that compressed blocks always fit in 64k
+const size_t BgzfWriteBuf::BlockSize = 0xff00;
+const size_t BgzfWriteBuf::BatchSize = 16;
+
+static const size_t BgzfHeaderSize = 18;
+static const size_t BgzfFooterSize = 8;
+static const size_t BgzfMaxBlockSize = 0x10000;
+
+static const unsigned char BgzfHeader[BgzfHeaderSize] =
+{
+  0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0, 0
+};
+
+static const unsigned char BgzfEOF[28] =
+{
+  0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0x1b, 0,
+  3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static void putLittle32(char* buf, uint32_t val)
+{
+  for (size_t i = 0; i < 4; ++i)
+  {
+    buf[i] = (char)((val >> (8 * i)) & 0xff);
+  }
+}
+
+static uint32_t getLittle32(const char* buf)
+{
+  uint32_t val = 0;
+  for (size_t i = 0; i < 4; ++i)
+  {
+    val |= (uint32_t)(unsigned char)buf[i] << (8 * i);
+  }
+  return val;
+}
+
+BgzfWriteBuf::BgzfWriteBuf() : _outStream(NULL), _numThreads(1), _offset(0),
+                               _compressedOffset(0)
+{
+
+}
+
+BgzfWriteBuf::~BgzfWriteBuf()
+{
+  if (_outStream != NULL)
+  {
+    try
+    {
+      close();
+    }
+    catch(...)
+    {
+    }
+  }
+}
+
+void BgzfWriteBuf::open(ostream* outStream, hal_size_t numThreads)
+{
+  _outStream = outStream;
+  _numThreads = numThreads > 0 ? numThreads : 1;
+  _buffer.resize(BlockSize);
+  _pending.clear();
+  _offset = 0;
+  _compressedOffset = 0;
+  _blockOffsets.clear();
+  setp(&_buffer[0], &_buffer[0] + BlockSize);
+}
+
+void BgzfWriteBuf::close()
+{
+  if (_outStream == NULL)
+  {
+    return;
+  }
+  if (pptr() > pbase())
+  {
+    queueBlock();
+  }
+  writeBlocks();
+  _outStream->write((const char*)BgzfEOF, sizeof(BgzfEOF));
+  _outStream->flush();
+  if (!*_outStream)
+  {
+    throw hal_exception("Error writing compressed output");
+  }
+  _outStream = NULL;
+  setp(NULL, NULL);
+}
+
+uint64_t BgzfWriteBuf::getVirtualOffset(uint64_t offset) const
+{
+  uint64_t block = offset / BlockSize;
+  uint64_t inBlock = offset % BlockSize;
+  if (block >= _blockOffsets.size())
+  {
+    // the very end of the file, when it is a multiple of the block size
+    assert(inBlock == 0 && offset == _offset);
+    return _compressedOffset << 16;
+  }
+  return (_blockOffsets[block] << 16) | inBlock;
+}
+
+BgzfWriteBuf::int_type BgzfWriteBuf::overflow(int_type c)
+{
+  if (_outStream == NULL)
+  {
+    return traits_type::eof();
+  }
+  queueBlock();
+  if (_pending.size() >= BatchSize * _numThreads)
+  {
+    writeBlocks();
+  }
+  if (traits_type::eq_int_type(c, traits_type::eof()) == false)
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+// blocks are only cut when they're full (or at close()) since the
+// virtual offsets depend on it
+int BgzfWriteBuf::sync()
+{
+  return 0;
+}
+
+BgzfWriteBuf::pos_type BgzfWriteBuf::seekoff(off_type off,
+                                             ios_base::seekdir dir,
+                                             ios_base::openmode which)
+{
+  if (off != 0 || dir != ios_base::cur || (which & ios_base::out) == 0)
+  {
+    return pos_type(off_type(-1));
+  }
+  return pos_type(off_type(_offset + (pptr() - pbase())));
+}
+
+void BgzfWriteBuf::queueBlock()
+{
+  _pending.push_back(string(pbase(), pptr() - pbase()));
+  _offset += pptr() - pbase();
+  setp(&_buffer[0], &_buffer[0] + BlockSize);
+}
+
+struct BgzfCompressJob
+{
+   const vector<string>* _input;
+   vector<string>* _output;
+   size_t _first;
+   size_t _step;
+};
+
+void* BgzfWriteBuf::compressThread(void* data)
+{
+  BgzfCompressJob* job = (BgzfCompressJob*)data;
+  for (size_t i = job->_first; i < job->_input->size(); i += job->_step)
+  {
+    compressBlock(job->_input->at(i), job->_output->at(i));
+  }
+  return NULL;
+}
+
+void BgzfWriteBuf::writeBlocks()
+{
+  _compressed.resize(_pending.size());
+  size_t numThreads = min((size_t)_numThreads, _pending.size());
+  if (numThreads > 1)
+  {
+    vector<pthread_t> threads(numThreads);
+    vector<BgzfCompressJob> jobs(numThreads);
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+      jobs[i]._input = &_pending;
+      jobs[i]._output = &_compressed;
+      jobs[i]._first = i;
+      jobs[i]._step = numThreads;
+      if (pthread_create(&threads[i], NULL, compressThread, &jobs[i]) != 0)
+      {
+        throw hal_exception("Error creating compression thread");
+      }
+    }
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+      pthread_join(threads[i], NULL);
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < _pending.size(); ++i)
+    {
+      compressBlock(_pending[i], _compressed[i]);
+    }
+  }
+  for (size_t i = 0; i < _compressed.size(); ++i)
+  {
+    _blockOffsets.push_back(_compressedOffset);
+    _outStream->write(_compressed[i].data(), _compressed[i].length());
+    _compressedOffset += _compressed[i].length();
+  }
+  if (!*_outStream)
+  {
+    throw hal_exception("Error writing compressed output");
+  }
+  _pending.clear();
+}
+
+void BgzfWriteBuf::compressBlock(const string& data, string& block)
+{
+  assert(data.length() <= BlockSize);
+  block.resize(BgzfMaxBlockSize);
+  memcpy(&block[0], BgzfHeader, BgzfHeaderSize);
+  size_t maxCompressed = BgzfMaxBlockSize - BgzfHeaderSize - BgzfFooterSize;
+  size_t compressedSize = 0;
+  // store the block uncompressed if it doesn't shrink enough to fit
+  int levels[2] = {Z_DEFAULT_COMPRESSION, Z_NO_COMPRESSION};
+  for (size_t i = 0; i < 2 && compressedSize == 0; ++i)
+  {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, levels[i], Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      throw hal_exception("Error initializing zlib");
+    }
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = data.length();
+    zs.next_out = (Bytef*)&block[BgzfHeaderSize];
+    zs.avail_out = maxCompressed;
+    int ret = deflate(&zs, Z_FINISH);
+    if (ret == Z_STREAM_END)
+    {
+      compressedSize = zs.total_out;
+    }
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END && ret != Z_OK && ret != Z_BUF_ERROR)
+    {
+      throw hal_exception("Error compressing block");
+    }
+  }
+  if (compressedSize == 0)
+  {
+    throw hal_exception("Error compressing block");
+  }
+  size_t blockSize = BgzfHeaderSize + compressedSize + BgzfFooterSize;
+  block[16] = (char)((blockSize - 1) & 0xff);
+  block[17] = (char)((blockSize - 1) >> 8);
+  uint32_t crc = crc32(crc32(0, NULL, 0), (const Bytef*)data.data(),
+                       data.length());
+  putLittle32(&block[BgzfHeaderSize + compressedSize], crc);
+  putLittle32(&block[BgzfHeaderSize + compressedSize + 4], data.length());
+  block.resize(blockSize);
+}
+
+BgzfReadBuf::BgzfReadBuf() : _inStream(NULL)
+{
+
+}
+
+BgzfReadBuf::~BgzfReadBuf()
+{
+
+}
+
+void BgzfReadBuf::open(istream* inStream)
+{
+  _inStream = inStream;
+  _compressed.resize(BgzfMaxBlockSize);
+  _buffer.resize(BgzfMaxBlockSize);
+  setg(&_buffer[0], &_buffer[0], &_buffer[0]);
+}
+
+void BgzfReadBuf::seekVirtual(uint64_t offset)
+{
+  assert(_inStream != NULL);
+  _inStream->clear();
+  _inStream->seekg(offset >> 16);
+  setg(&_buffer[0], &_buffer[0], &_buffer[0]);
+  size_t inBlock = offset & 0xffff;
+  if (readBlock() == false)
+  {
+    if (inBlock > 0)
+    {
+      throw hal_exception("Invalid BGZF virtual offset");
+    }
+    return;
+  }
+  if (inBlock > (size_t)(egptr() - eback()))
+  {
+    throw hal_exception("Invalid BGZF virtual offset");
+  }
+  setg(eback(), eback() + inBlock, egptr());
+}
+
+BgzfReadBuf::int_type BgzfReadBuf::underflow()
+{
+  while (gptr() == egptr())
+  {
+    if (readBlock() == false)
+    {
+      return traits_type::eof();
+    }
+  }
+  return traits_type::to_int_type(*gptr());
+}
+
+// read and inflate the next block into _buffer.  returns false at the
+// end of the stream
+bool BgzfReadBuf::readBlock()
+{
+  if (_inStream == NULL || _inStream->peek() == EOF)
+  {
+    return false;
+  }
+  char* header = &_compressed[0];
+  _inStream->read(header, BgzfHeaderSize);
+  if (_inStream->gcount() != (streamsize)BgzfHeaderSize ||
+      (unsigned char)header[0] != 0x1f || (unsigned char)header[1] != 0x8b ||
+      header[2] != 8 || (header[3] & 4) == 0 ||
+      header[12] != 'B' || header[13] != 'C')
+  {
+    throw hal_exception("Invalid BGZF block header");
+  }
+  size_t blockSize = ((unsigned char)header[16] |
+                      ((unsigned char)header[17] << 8)) + 1;
+  if (blockSize < BgzfHeaderSize + BgzfFooterSize)
+  {
+    throw hal_exception("Invalid BGZF block size");
+  }
+  _inStream->read(header + BgzfHeaderSize, blockSize - BgzfHeaderSize);
+  if (_inStream->gcount() != (streamsize)(blockSize - BgzfHeaderSize))
+  {
+    throw hal_exception("Truncated BGZF block");
+  }
+  size_t length = getLittle32(header + blockSize - 4);
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit2(&zs, -15) != Z_OK)
+  {
+    throw hal_exception("Error initializing zlib");
+  }
+  zs.next_in = (Bytef*)header + BgzfHeaderSize;
+  zs.avail_in = blockSize - BgzfHeaderSize - BgzfFooterSize;
+  zs.next_out = (Bytef*)&_buffer[0];
+  zs.avail_out = _buffer.size();
+  int ret = inflate(&zs, Z_FINISH);
+  inflateEnd(&zs);
+  if (ret != Z_STREAM_END || zs.total_out != length)
+  {
+    throw hal_exception("Error uncompressing BGZF block");
+  }
+  setg(&_buffer[0], &_buffer[0], &_buffer[0] + length);
+  return true;
+}
@@ -6,6 +6,7 @@
 
 #include <deque>
 #include <cassert>
+#include <algorithm>
 #include "halMafBed.h"
 
 using namespace std;
@@ -19,7 +20,8 @@ MafBed::MafBed(std::ostream& mafStream, AlignmentConstPtr alignment,
   _alignment(alignment),
   _refGenome(refGenome),
   _targetSet(targetSet),
-  _mafExport(mafExport)
+  _mafExport(mafExport),
+  _batch(false)
 {
 }
    
@@ -28,6 +30,11 @@ MafBed::~MafBed()
 
 }
 
+void MafBed::setBatch(bool batch)
+{
+  _batch = batch;
+}
+
 void MafBed::visitLine()
 {
   const Sequence* refSequence = _refGenome->getSequence(_bedLine._chrName);
@@ -46,11 +53,7 @@ void MafBed::visitLine()
     }
     else
     {
-      hal_index_t start = _bedLine._start;
-      hal_index_t end = _bedLine._end;
-      _mafExport.convertSegmentedSequence(_mafStream, _alignment, 
-                                          refSequence, start, end - start,
-                                          _targetSet);
+      convertRange(refSequence, _bedLine._start, _bedLine._end);
     }
   }
   else
@@ -69,10 +72,37 @@ void MafBed::visitLine()
       {
         hal_index_t start = _bedLine._start +_bedLine._blocks[i]._start;
         hal_index_t end = _bedLine._start + _bedLine._blocks[i]._start + _bedLine._blocks[i]._length;
-        _mafExport.convertSegmentedSequence(_mafStream, _alignment, 
-                                            refSequence, start, end - start,
-                                            _targetSet);
+        convertRange(refSequence, start, end);
       }
     }
   }
 }
+
+void MafBed::visitEOF()
+{
+  if (_batch == true)
+  {
+    sort(_ranges.begin(), _ranges.end());
+    _mafExport.convertRanges(_mafStream, _alignment, _refGenome, _ranges,
+                             _targetSet);
+    _ranges.clear();
+  }
+}
+
+// convert [start, end) of the sequence now, or save it (in genome
+// coordinates) for the end of the batch
+void MafBed::convertRange(const Sequence* refSequence, hal_index_t start,
+                          hal_index_t end)
+{
+  if (_batch == true)
+  {
+    hal_index_t offset = refSequence->getStartPosition();
+    _ranges.push_back(MafExport::Range(offset + start, offset + end - 1));
+  }
+  else
+  {
+    _mafExport.convertSegmentedSequence(_mafStream, _alignment, 
+                                        refSequence, start, end - start,
+                                        _targetSet);
+  }
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstring>
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "halMafBinaryReader.h"
+
+using namespace std;
+using namespace hal;
+
+const char hal::MafBinaryMagic[8] = {'H', 'A', 'L', 'B', 'L', 'O', 'C', 'K'};
+const uint32_t hal::MafBinaryVersion = 1;
+const uint32_t hal::MafBinaryByteOrder = 0x01020304;
+
+static const size_t HeaderSize = 16;
+static const size_t TrailerSize = 48;
+
+void MafBinaryBlock::getRow(uint32_t row, string& dna) const
+{
+  assert(row < _numRows);
+  dna.resize(_numColumns);
+  const uint8_t* packed = _dna + row * getRowBytes();
+  for (uint32_t i = 0; i < _numColumns; ++i)
+  {
+    dna[i] = decode(i % 2 == 0 ? packed[i / 2] & 0xf : packed[i / 2] >> 4);
+  }
+}
+
+MafBinaryReader::MafBinaryReader() : _data(NULL), _size(0), _map(NULL)
+{
+  close();
+}
+
+MafBinaryReader::~MafBinaryReader()
+{
+  close();
+}
+
+void MafBinaryReader::open(const string& path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw hal_exception("Error opening " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    throw hal_exception("Error reading size of " + path);
+  }
+  _size = (size_t)st.st_size;
+  if (_size > 0)
+  {
+    _map = mmap(NULL, _size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (_map == MAP_FAILED || _map == NULL)
+  {
+    _map = NULL;
+    _size = 0;
+    throw hal_exception("Error memory mapping " + path);
+  }
+  _data = (const char*)_map;
+  try
+  {
+    load();
+  }
+  catch(...)
+  {
+    close();
+    throw;
+  }
+}
+
+void MafBinaryReader::open(const char* data, size_t size)
+{
+  close();
+  _data = data;
+  _size = size;
+  try
+  {
+    load();
+  }
+  catch(...)
+  {
+    close();
+    throw;
+  }
+}
+
+void MafBinaryReader::close()
+{
+  if (_map != NULL)
+  {
+    munmap(_map, _size);
+    _map = NULL;
+  }
+  _data = NULL;
+  _size = 0;
+  _numBlocks = 0;
+  _numSequences = 0;
+  _nameOffsets = NULL;
+  _sequenceLengths = NULL;
+  _names = NULL;
+  _blockOffsets = NULL;
+}
+
+void MafBinaryReader::load()
+{
+  if (_size < HeaderSize + TrailerSize || (size_t)_data % 8 != 0 ||
+      memcmp(_data, MafBinaryMagic, 8) != 0 ||
+      memcmp(_data + _size - 8, MafBinaryMagic, 8) != 0)
+  {
+    throw hal_exception("Not a (complete) binary block file");
+  }
+  const char* trailer = _data + _size - TrailerSize;
+  const uint64_t* counts = (const uint64_t*)trailer;
+  const uint32_t* version = (const uint32_t*)(trailer + 32);
+  if (version[1] != MafBinaryByteOrder)
+  {
+    throw hal_exception("Binary block file was written with a different "
+                        "byte order");
+  }
+  if (version[0] != MafBinaryVersion)
+  {
+    throw hal_exception("Unsupported binary block file version");
+  }
+  _numBlocks = counts[0];
+  _numSequences = counts[1];
+  uint64_t sequencesOffset = counts[2];
+  uint64_t indexOffset = counts[3];
+  if (sequencesOffset % 8 != 0 || indexOffset % 8 != 0 ||
+      sequencesOffset > indexOffset ||
+      indexOffset + _numBlocks * 8 > _size - TrailerSize ||
+      sequencesOffset + (2 * _numSequences + 1) * 8 > indexOffset)
+  {
+    throw hal_exception("Corrupt binary block file trailer");
+  }
+  _nameOffsets = (const uint64_t*)(_data + sequencesOffset);
+  _sequenceLengths = (const int64_t*)(_nameOffsets + _numSequences + 1);
+  _names = (const char*)(_sequenceLengths + _numSequences);
+  if (_names + _nameOffsets[_numSequences] > _data + indexOffset)
+  {
+    throw hal_exception("Corrupt binary block file sequence table");
+  }
+  _blockOffsets = (const uint64_t*)(_data + indexOffset);
+}
+
+hal_size_t MafBinaryReader::getNumBlocks() const
+{
+  return _numBlocks;
+}
+
+hal_size_t MafBinaryReader::getNumSequences() const
+{
+  return _numSequences;
+}
+
+string MafBinaryReader::getSequenceName(hal_size_t i) const
+{
+  assert(i < _numSequences);
+  return string(_names + _nameOffsets[i],
+                _nameOffsets[i + 1] - _nameOffsets[i]);
+}
+
+hal_size_t MafBinaryReader::getSequenceLength(hal_size_t i) const
+{
+  assert(i < _numSequences);
+  return (hal_size_t)_sequenceLengths[i];
+}
+
+MafBinaryBlock MafBinaryReader::getBlock(hal_size_t i) const
+{
+  assert(i < _numBlocks);
+  uint64_t offset = _blockOffsets[i];
+  if (offset % 8 != 0 || offset + 8 > _size)
+  {
+    throw hal_exception("Corrupt binary block file index");
+  }
+  MafBinaryBlock block;
+  const uint32_t* dims = (const uint32_t*)(_data + offset);
+  block._numRows = dims[0];
+  block._numColumns = dims[1];
+  const char* pos = _data + offset + 8;
+  block._starts = (const int64_t*)pos;
+  pos += block._numRows * 8;
+  block._lengths = (const int64_t*)pos;
+  pos += block._numRows * 8;
+  block._sequences = (const uint32_t*)pos;
+  pos += block._numRows * 4;
+  block._strands = pos;
+  pos += block._numRows;
+  pos += (8 - (pos - _data) % 8) % 8;
+  block._dna = (const uint8_t*)pos;
+  pos += block._numRows * block.getRowBytes();
+  if (pos > _data + _size)
+  {
+    throw hal_exception("Corrupt binary block file block");
+  }
+  return block;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include <cctype>
+#include "halMafBinaryWriter.h"
+
+using namespace std;
+using namespace hal;
+
+MafBinaryWriter::MafBinaryWriter() : _os(NULL), _offset(0)
+{
+
+}
+
+MafBinaryWriter::~MafBinaryWriter()
+{
+
+}
+
+void MafBinaryWriter::open(ostream* os)
+{
+  _os = os;
+  _offset = 0;
+  _blockOffsets.clear();
+  _sequenceIds.clear();
+  _sequenceNames.clear();
+  _sequenceLengths.clear();
+  write(MafBinaryMagic, 8);
+  write(&MafBinaryVersion, 4);
+  write(&MafBinaryByteOrder, 4);
+}
+
+void MafBinaryWriter::close()
+{
+  if (_os == NULL)
+  {
+    return;
+  }
+  assert(_offset % 8 == 0);
+  uint64_t sequencesOffset = _offset;
+  uint64_t nameOffset = 0;
+  for (size_t i = 0; i < _sequenceNames.size(); ++i)
+  {
+    write(&nameOffset, 8);
+    nameOffset += _sequenceNames[i].length();
+  }
+  write(&nameOffset, 8);
+  if (_sequenceLengths.empty() == false)
+  {
+    write(&_sequenceLengths[0], _sequenceLengths.size() * 8);
+  }
+  for (size_t i = 0; i < _sequenceNames.size(); ++i)
+  {
+    write(_sequenceNames[i].data(), _sequenceNames[i].length());
+  }
+  pad();
+
+  uint64_t indexOffset = _offset;
+  if (_blockOffsets.empty() == false)
+  {
+    write(&_blockOffsets[0], _blockOffsets.size() * 8);
+  }
+
+  uint64_t trailer[4] = {_blockOffsets.size(), _sequenceNames.size(),
+                         sequencesOffset, indexOffset};
+  write(trailer, sizeof(trailer));
+  write(&MafBinaryVersion, 4);
+  write(&MafBinaryByteOrder, 4);
+  write(MafBinaryMagic, 8);
+  _os->flush();
+  if (!*_os)
+  {
+    throw hal_exception("Error writing binary block file");
+  }
+  _os = NULL;
+}
+
+// the rows are the same, and in the same order, as in
+// MafBlock::printBlock()
+void MafBinaryWriter::writeBlock(const MafBlock& block)
+{
+  assert(_os != NULL);
+  MafBlock::Entries::const_iterator ref = block._reference;
+  assert(ref != block._entries.end());
+  for (MafBlock::Entries::const_iterator e = block._entries.begin();
+       e != block._entries.end(); ++e)
+  {
+    if (e->second->_start != NULL_INDEX || e == ref)
+    {
+      block.fillEntry(e->second);
+    }
+  }
+
+  hal_index_t refStart = ref->second->_start;
+  if (refStart == NULL_INDEX)
+  {
+    refStart = block._refIndex;
+  }
+  block.getRows(_rows);
+
+  assert(_offset % 8 == 0);
+  _blockOffsets.push_back(_offset);
+  uint32_t dims[2] = {(uint32_t)_rows.size(), (uint32_t)block._numColumns};
+  write(dims, sizeof(dims));
+
+  size_t numRows = _rows.size();
+  if (numRows == 0)
+  {
+    return;
+  }
+  _buffer.resize(numRows * 2);
+  for (size_t i = 0; i < numRows; ++i)
+  {
+    _buffer[i] = _rows[i]->_start;
+    _buffer[numRows + i] = _rows[i]->_length;
+  }
+  if (_rows[0] == ref->second)
+  {
+    _buffer[0] = refStart;
+  }
+  write(&_buffer[0], numRows * 16);
+
+  vector<uint32_t> sequenceIds(numRows);
+  string strands(numRows, '+');
+  for (size_t i = 0; i < numRows; ++i)
+  {
+    sequenceIds[i] = getSequenceId(_rows[i]);
+    strands[i] = _rows[i]->_strand;
+  }
+  write(&sequenceIds[0], numRows * 4);
+  write(strands.data(), numRows);
+  pad();
+
+  size_t rowBytes = ((size_t)block._numColumns + 1) / 2;
+  _dna.assign(numRows * rowBytes, 0);
+  for (size_t i = 0; i < numRows; ++i)
+  {
+    const MafBlockString* buffer = _rows[i]->_sequence;
+    assert(buffer->_len >= (size_t)block._numColumns);
+    uint8_t* packed = &_dna[i * rowBytes];
+    for (hal_index_t j = 0; j < block._numColumns; ++j)
+    {
+      uint8_t code = encode(buffer->_buf[j]);
+      packed[j / 2] |= j % 2 == 0 ? code : code << 4;
+    }
+  }
+  write(&_dna[0], _dna.size());
+  pad();
+}
+
+uint8_t MafBinaryWriter::encode(char c)
+{
+  switch (c)
+  {
+  case '-': return 0;
+  case 'A': return 1;
+  case 'C': return 2;
+  case 'G': return 3;
+  case 'T': return 4;
+  case 'a': return 9;
+  case 'c': return 10;
+  case 'g': return 11;
+  case 't': return 12;
+  default:
+    break;
+  }
+  return islower(c) ? 13 : 5;
+}
+
+void MafBinaryWriter::write(const void* data, size_t size)
+{
+  if (size > 0)
+  {
+    _os->write((const char*)data, size);
+    _offset += size;
+  }
+}
+
+void MafBinaryWriter::pad()
+{
+  static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  write(zeros, (8 - _offset % 8) % 8);
+}
+
+uint32_t MafBinaryWriter::getSequenceId(const MafBlockEntry* entry)
+{
+  map<string, uint32_t>::iterator i = _sequenceIds.find(entry->_name);
+  if (i == _sequenceIds.end())
+  {
+    i = _sequenceIds.insert(pair<string, uint32_t>(
+                              entry->_name,
+                              (uint32_t)_sequenceNames.size())).first;
+    _sequenceNames.push_back(entry->_name);
+    _sequenceLengths.push_back(entry->_srcLength);
+  }
+  return i->second;
+}
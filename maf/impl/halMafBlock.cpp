@@ -15,6 +15,7 @@ using namespace hal;
 const hal_index_t MafBlock::defaultMaxLength = 1000;
 
 MafBlock::MafBlock(hal_index_t maxLength) : _maxLength(maxLength),
+                                            _numColumns(0),
                                             _fullNames(false),
                                             _tree(NULL)
 {
@@ -26,9 +27,10 @@ MafBlock::MafBlock(hal_index_t maxLength) : _maxLength(maxLength),
 
 MafBlock::~MafBlock()
 {
-  for (Entries::iterator i = _entries.begin(); i != _entries.end(); ++i)
+  clearEntries();
+  for (size_t i = 0; i < _entryPool.size(); ++i)
   {
-    delete i->second;
+    delete _entryPool[i];
   }
   for (size_t j = 0; j < _stringBuffers.size(); ++j)
   {
@@ -41,18 +43,12 @@ MafBlock::~MafBlock()
 
 void MafBlock::resetEntries()
 {
-  _reference = _entries.end();
   _refIndex = NULL_INDEX;
-  Entries::iterator i = _entries.begin();
-  Entries::iterator next;
+  size_t j = 0;
   MafBlockEntry* e;
-  bool deleted;
-  while (i != _entries.end())
+  for (size_t i = 0; i < _entries.size(); ++i)
   {
-    next = i;
-    ++next;
-    e = i->second;
-    deleted = false;
+    e = _entries[i].second;
 
     //every time we reset an entry, we check if was empty.
     //if it was, then we increase lastUsed, otherwise we reset it to
@@ -65,9 +61,8 @@ void MafBlock::resetEntries()
     {
       if (e->_lastUsed > 10)
       {
-        delete i->second;
-        _entries.erase(i);
-        deleted = true;
+        _entryPool.push_back(e);
+        continue;
       }
       else
       {
@@ -78,32 +73,54 @@ void MafBlock::resetEntries()
     {
       e->_lastUsed = 0;
     }
-    if (deleted == false)
-    {
-      assert (e->_start == NULL_INDEX || e->_length > 0);
-      assert (e->_name == getName(i->first));
-      // Rest block information but leave sequence information so we
-      // can reuse it. 
-      e->_start = NULL_INDEX;
-      e->_strand = '+';
-      e->_length = 0;
-      e->_sequence->clear();
-    }
-    i = next;
+    assert (e->_start == NULL_INDEX || e->_length > 0);
+    assert (e->_dnaSequence == _entries[i].first);
+    // Rest block information but leave sequence information so we
+    // can reuse it. 
+    e->_start = NULL_INDEX;
+    e->_strand = '+';
+    e->_length = 0;
+    e->_sequence->clear();
+    _entries[j++] = _entries[i];
   }  
+  _entries.resize(j);
+  _reference = _entries.end();
+}
+
+void MafBlock::clearEntries()
+{
+  for (size_t i = 0; i < _entries.size(); ++i)
+  {
+    _entryPool.push_back(_entries[i].second);
+  }
+  _entries.clear();
+  _reference = _entries.end();
+}
+
+MafBlockEntry* MafBlock::newEntry()
+{
+  if (_entryPool.empty() == true)
+  {
+    return new MafBlockEntry(_stringBuffers);
+  }
+  MafBlockEntry* entry = _entryPool.back();
+  _entryPool.pop_back();
+  entry->_dnaSequence = NULL;
+  entry->_lastUsed = 0;
+  entry->_sequence->clear();
+  return entry;
 }
 
 void MafBlock::initEntry(MafBlockEntry* entry, const Sequence* sequence, 
                          DNAIteratorConstPtr dna, bool clearSequence)
 {
-  string sequenceName = getName(sequence);
-  if (entry->_name != sequenceName || 
-      sequence->getGenome() != entry->_genome)
+  if (entry->_dnaSequence != sequence)
   {
     // replace genearl sequence information
-    entry->_name = sequenceName;
+    entry->_name = getName(sequence);
     entry->_genome = sequence->getGenome();
     entry->_srcLength = (hal_index_t)sequence->getSequenceLength();
+    entry->_dnaSequence = sequence;
   }
   if (dna.get())
   {
@@ -130,38 +147,76 @@ void MafBlock::initEntry(MafBlockEntry* entry, const Sequence* sequence,
   entry->_tree = NULL;
 }
 
+// entries are only updated for the columns they have a base in.  the
+// gaps for the other columns are filled in when the next base arrives (or
+// the block is written).  bases are marked with a placeholder since the
+// block's dna is contiguous in every entry (see canAppendColumn) and is
+// read in one go by fillEntry().
 inline void MafBlock::updateEntry(MafBlockEntry* entry, 
                                   const Sequence* sequence,
                                   DNAIteratorConstPtr dna)
 {
-  if (dna.get() != NULL)
+  assert(dna.get() != NULL);
+  if (entry->_start == NULL_INDEX)
   {
-    if (entry->_start == NULL_INDEX)
-    {
-      initEntry(entry, sequence, dna, false);
-    }
-    assert(entry->_name == getName(sequence));
-    assert(entry->_strand == dna->getReversed() ? '-' : '+');
-    assert(entry->_srcLength == (hal_index_t)sequence->getSequenceLength());
+    initEntry(entry, sequence, dna, false);
+  }
+  assert(entry->_dnaSequence == sequence);
+  assert(entry->_strand == dna->getReversed() ? '-' : '+');
+  assert(entry->_srcLength == (hal_index_t)sequence->getSequenceLength());
 
-    ++entry->_length;
+  ++entry->_length;
     
-    assert(dna->getReversed() == true || (hal_index_t)
-           (dna->getArrayIndex() - sequence->getStartPosition()) == 
-           (hal_index_t)
-           (entry->_start + entry->_length - 1));
+  assert(dna->getReversed() == true || (hal_index_t)
+         (dna->getArrayIndex() - sequence->getStartPosition()) == 
+         (hal_index_t)
+         (entry->_start + entry->_length - 1));
     
-    assert(dna->getReversed() == false || (hal_index_t)
-           (entry->_srcLength - 1 - 
-            (dna->getArrayIndex() - sequence->getStartPosition()))  == 
-           (hal_index_t)
-           (entry->_start + entry->_length - 1)); 
+  assert(dna->getReversed() == false || (hal_index_t)
+         (entry->_srcLength - 1 - 
+          (dna->getArrayIndex() - sequence->getStartPosition()))  == 
+         (hal_index_t)
+         (entry->_start + entry->_length - 1)); 
+
+  MafBlockString* buffer = entry->_sequence;
+  assert(buffer->_len <= (size_t)_numColumns);
+  if (buffer->_len < (size_t)_numColumns)
+  {
+    buffer->append('-', _numColumns - buffer->_len);
+  }
+  buffer->append('N');
+}
 
-    entry->_sequence->append(dna->getChar());
+void MafBlock::fillEntry(MafBlockEntry* entry) const
+{
+  MafBlockString* buffer = entry->_sequence;
+  if (buffer->_len < (size_t)_numColumns)
+  {
+    buffer->append('-', _numColumns - buffer->_len);
   }
-  else
+  if (entry->_start != NULL_INDEX && entry->_length > 0)
   {
-    entry->_sequence->append('-');
+    hal_index_t start = entry->_start;
+    if (entry->_strand == '-')
+    {
+      start = entry->_srcLength - entry->_start - entry->_length;
+    }
+    string dna;
+    entry->_dnaSequence->getSubString(dna, start, entry->_length);
+    if (entry->_strand == '-')
+    {
+      reverseComplement(dna);
+    }
+    string::const_iterator base = dna.begin();
+    for (size_t i = 0; i < buffer->_len; ++i)
+    {
+      if (buffer->_buf[i] != '-')
+      {
+        assert(base != dna.end());
+        buffer->_buf[i] = *base++;
+      }
+    }
+    assert(base == dna.end());
   }
 }
 
@@ -199,7 +254,9 @@ stTree *MafBlock::getTreeNode(SegmentIteratorConstPtr segIt, bool modifyEntries)
   stTree *ret = stTree_construct();
   const Genome *genome = segIt->getGenome();
   const Sequence *seq = genome->getSequenceBySite(segIt->getStartPosition());
-  Entries::const_iterator entryIt = _entries.lower_bound(seq);
+  Entries::const_iterator entryIt = lower_bound(_entries.begin(), 
+                                                _entries.end(), seq, 
+                                                EntryLess());
   if (entryIt != _entries.end() && entryIt->first == seq) {
     MafBlockEntry *entry = NULL;
     for (; entryIt != _entries.end() && entryIt->first == seq; entryIt++) {
@@ -334,7 +391,13 @@ void MafBlock::initBlock(ColumnIteratorConstPtr col, bool fullNames, bool printT
   if (printTree && _tree != NULL) {
     stTree_destruct(_tree);
   }
+  if (fullNames != _fullNames)
+  {
+    // the names cached in the entries are no good
+    clearEntries();
+  }
   resetEntries();
+  _numColumns = 0;
   _fullNames = fullNames;
   _printTree = printTree;
   const ColumnMap* colMap = col->getColumnMap();
@@ -351,17 +414,18 @@ void MafBlock::initBlock(ColumnIteratorConstPtr col, bool fullNames, bool printT
     // entry
     if (c->second->empty())
     {
-      e = _entries.lower_bound(sequence);
+      e = lower_bound(_entries.begin(), _entries.end(), sequence, 
+                      EntryLess());
       if (e == _entries.end() || e->first != sequence)
       {
-        MafBlockEntry* entry = new MafBlockEntry(_stringBuffers);
+        MafBlockEntry* entry = newEntry();
         initEntry(entry, sequence, DNAIteratorConstPtr());      
-        e = _entries.insert(Entries::value_type(sequence, entry));  
+        e = _entries.insert(e, Entry(sequence, entry));  
       }
       else
       {
         assert (e->first == sequence);
-        assert (e->second->_name == getName(sequence));
+        assert (e->second->_dnaSequence == sequence);
         initEntry(e->second, sequence, DNAIteratorConstPtr());
       }
     }
@@ -372,10 +436,11 @@ void MafBlock::initBlock(ColumnIteratorConstPtr col, bool fullNames, bool printT
       {
         // search for c's sequence in _entries.  
         // we conly call find() once.  afterwards we just move forward
-        // in the map since they are both sorted by the same key. 
+        // in the array since they are both sorted by the same key. 
         if (e == _entries.begin())
         {
-          e = _entries.lower_bound(sequence);
+          e = lower_bound(_entries.begin(), _entries.end(), sequence, 
+                          EntryLess());
           if (e == _entries.end() || e->first != sequence)
           {
             e = _entries.end();
@@ -383,17 +448,19 @@ void MafBlock::initBlock(ColumnIteratorConstPtr col, bool fullNames, bool printT
         }
         else
         {
-          while (e->first != c->first && e != _entries.end())
+          while (e != _entries.end() && e->first != sequence)
           {
             ++e;
           }
         }
         if (e == _entries.end())
         {
-          MafBlockEntry* entry = new MafBlockEntry(_stringBuffers);
+          MafBlockEntry* entry = newEntry();
           initEntry(entry, sequence, *d);
-          assert(entry->_name == getName(sequence));
-          e = _entries.insert(Entries::value_type(sequence, entry));
+          // after any other entries of the same sequence
+          e = upper_bound(_entries.begin(), _entries.end(), sequence,
+                          EntryLess());
+          e = _entries.insert(e, Entry(sequence, entry));
         }
         else
         {
@@ -404,19 +471,17 @@ void MafBlock::initBlock(ColumnIteratorConstPtr col, bool fullNames, bool printT
     }
   }
 
-  if (_reference == _entries.end())
+  const Sequence* referenceSequence = col->getReferenceSequence();
+  e = lower_bound(_entries.begin(), _entries.end(), referenceSequence,
+                  EntryLess());
+  if (e == _entries.end() || e->first != referenceSequence)
   {
-    const Sequence* referenceSequence = col->getReferenceSequence();
-    e = _entries.lower_bound(referenceSequence);
-    if (e == _entries.end() || e->first != referenceSequence)
-    {
-      e = _entries.begin();
-    }
-    _reference = e;
-    if (e->first == referenceSequence)
-    {
-      _refIndex = col->getReferenceSequencePosition();
-    }
+    e = _entries.begin();
+  }
+  _reference = e;
+  if (e->first == referenceSequence)
+  {
+    _refIndex = col->getReferenceSequencePosition();
   }
 
   if (_printTree) {
@@ -437,23 +502,17 @@ void MafBlock::appendColumn(ColumnIteratorConstPtr col)
     sequence = c->first;
     for (d = c->second->begin(); d != c->second->end(); ++d)
     {
-      while (e->first != sequence && e != _entries.end())
+      while (e != _entries.end() && e->first != sequence)
       {
-        updateEntry(e->second, NULL, DNAIteratorConstPtr());
         ++e;
       }
       assert(e != _entries.end());
       assert(e->first == sequence);
-      assert(e->second->_name == getName(sequence));
       updateEntry(e->second, sequence, *d);
       ++e;
     }
   }
-  
-  for (; e != _entries.end(); ++e)
-  {
-    updateEntry(e->second, NULL, DNAIteratorConstPtr());
-  }
+  ++_numColumns;
 }
 
 
@@ -479,7 +538,7 @@ bool MafBlock::canAppendColumn(ColumnIteratorConstPtr col)
 
     for (d = c->second->begin(); d != c->second->end(); ++d)
     {
-      while (e->first != sequence && e != _entries.end())
+      while (e != _entries.end() && e->first != sequence)
       {
         ++e;
       }
@@ -491,7 +550,7 @@ bool MafBlock::canAppendColumn(ColumnIteratorConstPtr col)
       {
         entry = e->second;
         assert(e->first == sequence);
-        assert(entry->_name == getName(sequence) &&
+        assert(entry->_dnaSequence == sequence &&
                entry->_genome == sequence->getGenome());
         if (entry->_start != NULL_INDEX)
         {
@@ -564,6 +623,24 @@ static void printTreeEntries(stTree *tree, ostream& os)
   }
 }
 
+bool MafBlock::getReferenceRow(string& name, hal_index_t& start,
+                               hal_index_t& length) const
+{
+  if (_reference == _entries.end())
+  {
+    return false;
+  }
+  const MafBlockEntry* ref = _reference->second;
+  start = ref->_start != NULL_INDEX ? ref->_start : _refIndex;
+  if (start == NULL_INDEX)
+  {
+    return false;
+  }
+  name = ref->_name;
+  length = ref->_length;
+  return true;
+}
+
 ostream& MafBlock::printBlockWithTree(ostream& os) const
 {
   //Sort tree so that the reference comes first.
@@ -580,33 +657,79 @@ ostream& MafBlock::printBlockWithTree(ostream& os) const
   return os;
 }
 
-// todo: fast way of reference first. 
-ostream& MafBlock::printBlock(ostream& os) const
+size_t MafBlock::getGenomeRank(const Genome* genome) const
 {
-  os << "a\n";
+  map<const Genome*, size_t>::const_iterator i = _genomeRanks.find(genome);
+  if (i != _genomeRanks.end())
+  {
+    return i->second;
+  }
+  // only the names are looked at, so no other genomes get opened
+  const Alignment* alignment = genome->getAlignment();
+  size_t rank = 0;
+  deque<string> bfQueue(1, alignment->getRootName());
+  while (!bfQueue.empty() && bfQueue.front() != genome->getName())
+  {
+    vector<string> childNames = alignment->getChildNames(bfQueue.front());
+    bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+    bfQueue.pop_front();
+    ++rank;
+  }
+  _genomeRanks.insert(pair<const Genome*, size_t>(genome, rank));
+  return rank;
+}
+
+bool MafBlock::RowLess::operator()(const MafBlockEntry* e1,
+                                   const MafBlockEntry* e2) const
+{
+  if (e1->_genome != e2->_genome)
+  {
+    return _block->getGenomeRank(e1->_genome) <
+       _block->getGenomeRank(e2->_genome);
+  }
+  int cmp = e1->_name.compare(e2->_name);
+  return cmp < 0 || (cmp == 0 && e1->_start < e2->_start);
+}
 
-  Entries::const_iterator ref = _reference;
+// the rows that get written, in the order they are written in.  the
+// reference row is always first (if it's written at all)
+void MafBlock::getRows(vector<MafBlockEntry*>& rows) const
+{
   assert(_reference != _entries.end());
-  if (ref->second->_start == NULL_INDEX)
+  rows.clear();
+  if (_reference->second->_start != NULL_INDEX || _refIndex != NULL_INDEX)
   {
-    if (_refIndex != NULL_INDEX)
-    {
-      ref->second->_start = _refIndex;
-      os << *ref->second;
-      ref->second->_start = NULL_INDEX;
-    }    
+    rows.push_back(_reference->second);
   }
-  else
+  size_t numRef = rows.size();
+  for (Entries::const_iterator e = _entries.begin(); e != _entries.end();
+       ++e)
   {
-    os << *ref->second;
+    if (e->second->_start != NULL_INDEX && e != _reference)
+    {
+      rows.push_back(e->second);
+    }
   }
+  stable_sort(rows.begin() + numRef, rows.end(), RowLess(this));
+}
+
+ostream& MafBlock::printBlock(ostream& os) const
+{
+  os << "a\n";
 
-  for (Entries::const_iterator e = _entries.begin();
-       e != _entries.end(); ++e)
+  getRows(_rows);
+  for (size_t i = 0; i < _rows.size(); ++i)
   {
-    if (e->second->_start != NULL_INDEX && e != ref)
+    if (_rows[i]->_start == NULL_INDEX)
+    {
+      assert(i == 0 && _refIndex != NULL_INDEX);
+      _rows[i]->_start = _refIndex;
+      os << *_rows[i];
+      _rows[i]->_start = NULL_INDEX;
+    }
+    else
     {
-      os << *e->second;
+      os << *_rows[i];
     }
   }
   return os;
@@ -614,6 +737,14 @@ ostream& MafBlock::printBlock(ostream& os) const
 
 ostream& hal::operator<<(ostream& os, const MafBlock& mafBlock)
 {
+  for (MafBlock::Entries::const_iterator e = mafBlock._entries.begin();
+       e != mafBlock._entries.end(); ++e)
+  {
+    if (e->second->_start != NULL_INDEX || e == mafBlock._reference)
+    {
+      mafBlock.fillEntry(e->second);
+    }
+  }
   if (mafBlock._printTree) {
     return mafBlock.printBlockWithTree(os);
   } else {
@@ -5,13 +5,47 @@
  */
 
 #include <deque>
+#include <map>
+#include <sstream>
 #include <cassert>
 #include "halMafExport.h"
+#include "halMafBinaryWriter.h"
 
 using namespace std;
 using namespace hal;
 
-MafExport::MafExport() : _maxRefGap(0), _noDupes(false), _printTree(false)
+const hal_size_t MafExport::ThreadChunkLength = 1000000;
+
+// work shared by the threads of convertParallel().  each chunk is a list
+// of ranges converted with convertRanges().  chunks are handed out in
+// order, and their output is held in _output until all the chunks
+// before them have been written.  threads stop taking new chunks while
+// the writer is more than _maxPending chunks behind.  if _splitRange is
+// set, the chunks are consecutive pieces of one range.
+struct MafExport::ThreadState : public ThreadPool
+{
+   virtual void work(AlignmentConstPtr alignment)
+   {
+     convertChunks(alignment, *this);
+   }
+
+   const MafExport* _parent;
+   string _genomeName;
+   bool _splitRange;
+   vector<string> _targetNames;
+   vector<vector<Range> > _chunks;
+   size_t _nextChunk;
+   size_t _nextWrite;
+   size_t _maxPending;
+   map<size_t, string> _output;
+   map<size_t, MafIndex> _indexes;
+};
+
+MafExport::MafExport() : _maxRefGap(0), _noDupes(false), _printTree(false),
+                         _numThreads(1), _index(NULL),
+                         _globalMaxMemory(0), _progress(false),
+                         _binaryWriter(NULL), _skipFirst(0),
+                         _skipLast(NULL_INDEX)
 {
 
 }
@@ -66,16 +100,77 @@ void MafExport::setOnlyOrthologs(bool onlyOrthologs)
   _onlyOrthologs = onlyOrthologs;
 }
 
+void MafExport::setNumThreads(hal_size_t numThreads, const string& halPath,
+                              CLParserConstPtr options)
+{
+  _numThreads = numThreads > 0 ? numThreads : 1;
+  _halPath = halPath;
+  _options = options;
+}
+
+void MafExport::setIndex(MafIndex* index)
+{
+  _index = index;
+}
+
+void MafExport::setGlobalMaxMemory(hal_size_t maxMemory)
+{
+  _globalMaxMemory = maxMemory;
+}
+
+void MafExport::setProgress(bool progress)
+{
+  _progress = progress;
+}
+
+void MafExport::setBinaryWriter(MafBinaryWriter* writer)
+{
+  _binaryWriter = writer;
+}
+
 void MafExport::writeHeader()
 {
   assert(_mafStream != NULL);
-  if (_mafStream->tellp() == streampos(0))
+  if (_binaryWriter == NULL && _mafStream->tellp() == streampos(0))
   {
     *_mafStream << "##maf version=1 scoring=N/A\n"
                 << "# hal " << _alignment->getNewickTree() << endl << endl;
   }
 }
 
+void MafExport::writeBlock(bool flush)
+{
+  if (_binaryWriter != NULL)
+  {
+    _binaryWriter->writeBlock(_mafBlock);
+    return;
+  }
+  indexBlock();
+  *_mafStream << _mafBlock << '\n';
+  if (flush == true)
+  {
+    _mafStream->flush();
+  }
+}
+
+void MafExport::indexBlock()
+{
+  assert(_mafStream != NULL);
+  string name;
+  hal_index_t start;
+  hal_index_t length;
+  if (_index != NULL && _mafBlock.getReferenceRow(name, start, length))
+  {
+    streampos offset = _mafStream->tellp();
+    if (offset == streampos(-1))
+    {
+      throw hal_exception("Cannot index MAF output that doesn't support "
+                          "tellp()");
+    }
+    _index->addBlock(name, start, length, (uint64_t)offset);
+  }
+}
+
 void MafExport::convertSegmentedSequence(ostream& mafStream,
                                          AlignmentConstPtr alignment,
                                          const SegmentedSequence* seq,
@@ -106,6 +201,32 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
     writeHeader();
   }
 
+  if (_numThreads > 1)
+  {
+    // the chunks are in genome coordinates
+    const Sequence* sequence = dynamic_cast<const Sequence*>(seq);
+    const Genome* genome = dynamic_cast<const Genome*>(seq);
+    hal_index_t offset = 0;
+    if (sequence != NULL)
+    {
+      genome = sequence->getGenome();
+      offset = sequence->getStartPosition();
+    }
+    assert(genome != NULL);
+    hal_size_t chunkLength = min(ThreadChunkLength,
+                                 (length + _numThreads - 1) / _numThreads);
+    vector<vector<Range> > chunks;
+    for (hal_index_t pos = startPosition; pos <= lastPosition;
+         pos += chunkLength)
+    {
+      hal_index_t last = min(lastPosition, 
+                             pos + (hal_index_t)chunkLength - 1);
+      chunks.push_back(vector<Range>(1, Range(offset + pos, offset + last)));
+    }
+    convertParallel(mafStream, genome, chunks, targets, true);
+    return;
+  }
+
   ColumnIteratorConstPtr colIt = seq->getColumnIterator(&targets,
                                                         _maxRefGap, 
                                                         startPosition,
@@ -115,10 +236,82 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
                                                         false, // reverseStrand,
                                                         true,  // unique
                                                         _onlyOrthologs);
+  convertColumns(colIt);
+}
 
+void MafExport::convertRanges(ostream& mafStream,
+                              AlignmentConstPtr alignment,
+                              const Genome* genome,
+                              const vector<Range>& ranges,
+                              const set<const Genome*>& targets)
+{
+  assert(genome != NULL);
+  if (ranges.empty() == true)
+  {
+    return;
+  }
+  _mafStream = &mafStream;
+  _alignment = alignment;
+  if (!_append)
+  {
+    writeHeader();
+  }
 
+  if (_numThreads > 1)
+  {
+    hal_size_t totalLength = 0;
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+      totalLength += ranges[i].second - ranges[i].first + 1;
+    }
+    hal_size_t maxChunkLength = min(ThreadChunkLength, 
+                                    (totalLength + _numThreads - 1) /
+                                    _numThreads);
+    vector<vector<Range> > chunks;
+    const Sequence* prevSequence = NULL;
+    hal_size_t chunkLength = 0;
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+      const Sequence* sequence = genome->getSequenceBySite(ranges[i].first);
+      if (chunks.empty() || sequence != prevSequence ||
+          chunkLength >= maxChunkLength)
+      {
+        chunks.push_back(vector<Range>());
+        chunkLength = 0;
+      }
+      chunks.back().push_back(ranges[i]);
+      chunkLength += ranges[i].second - ranges[i].first + 1;
+      prevSequence = sequence;
+    }
+    convertParallel(mafStream, genome, chunks, targets, false);
+    return;
+  }
+
+  ColumnIteratorConstPtr colIt = genome->getColumnIterator(&targets,
+                                                           _maxRefGap,
+                                                           ranges[0].first,
+                                                           ranges[0].second,
+                                                           _noDupes,
+                                                           _noAncestors,
+                                                           false,
+                                                           true,
+                                                           _onlyOrthologs);
+  convertColumns(colIt);
+  for (size_t i = 1; i < ranges.size(); ++i)
+  {
+    // clearing the visit cache gives the same columns as a new iterator
+    // would (ranges can overlap)
+    colIt->toSite(ranges[i].first, ranges[i].second, true);
+    convertColumns(colIt);
+  }
+}
+
+// write the blocks of every column from the iterator's current one to its
+// last one
+void MafExport::convertColumns(ColumnIteratorConstPtr colIt)
+{
   hal_size_t appendCount = 0;
-  if (_unique == false || colIt->isCanonicalOnRef() == true)
+  if (isOwnColumn(colIt) == true)
   {
     _mafBlock.initBlock(colIt, _ucscNames, _printTree);
     assert(_mafBlock.canAppendColumn(colIt) == true);
@@ -129,7 +322,7 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
   while (colIt->lastColumn() == false)
   {
     colIt->toRight();
-    if (_unique == false || colIt->isCanonicalOnRef() == true)
+    if (isOwnColumn(colIt) == true)
     {
       if (appendCount == 0)
       {
@@ -146,7 +339,7 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
         }
         if (appendCount > 0)
         {
-          mafStream << _mafBlock << '\n';
+          writeBlock();
         }
         _mafBlock.initBlock(colIt, _ucscNames, _printTree);
         assert(_mafBlock.canAppendColumn(colIt) == true);
@@ -160,7 +353,181 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
   // so we do following check
   if (appendCount > 0)
   {
-    mafStream << _mafBlock << endl;
+    writeBlock(true);
+  }
+}
+
+// a column is written from its left-most reference base in the
+// iterator's range if unique is set, and otherwise from the first one
+// the iterator visits (the left-most one it can reach).  a chunk of a
+// split range leaves the columns that reach back into the chunks before
+// it to them.
+bool MafExport::isOwnColumn(ColumnIteratorConstPtr colIt) const
+{
+  if (_unique == true)
+  {
+    return colIt->isCanonicalOnRef();
+  }
+  if (_skipFirst > _skipLast)
+  {
+    return true;
+  }
+  const Genome* refGenome = colIt->getReferenceGenome();
+  const ColumnIterator::ColumnMap* colMap = colIt->getColumnMap();
+  for (ColumnIterator::ColumnMap::const_iterator c = colMap->begin();
+       c != colMap->end(); ++c)
+  {
+    if (c->first->getGenome() == refGenome)
+    {
+      for (size_t i = 0; i < c->second->size(); ++i)
+      {
+        hal_index_t pos = c->second->at(i)->getArrayIndex();
+        if (pos >= _skipFirst && pos <= _skipLast)
+        {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void MafExport::convertParallel(ostream& mafStream,
+                                const Genome* genome,
+                                const vector<vector<Range> >& chunks,
+                                const set<const Genome*>& targets,
+                                bool splitRange)
+{
+  if (_binaryWriter != NULL)
+  {
+    throw hal_exception("Binary blocks can only be written by one thread");
+  }
+  ThreadState state;
+  state._parent = this;
+  state._genomeName = genome->getName();
+  state._splitRange = splitRange;
+  state._chunks = chunks;
+  for (set<const Genome*>::const_iterator i = targets.begin();
+       i != targets.end(); ++i)
+  {
+    state._targetNames.push_back((*i)->getName());
+  }
+
+  size_t numThreads = min((size_t)_numThreads, state._chunks.size());
+  state._nextChunk = 0;
+  state._nextWrite = 0;
+  state._maxPending = 4 * numThreads;
+  state.start(numThreads, _halPath, _options);
+
+  for (size_t i = 0; i < state._chunks.size(); ++i)
+  {
+    string buffer;
+    MafIndex index;
+    state.lock();
+    while (state.hasError() == false && state._output.find(i) == 
+           state._output.end())
+    {
+      state.wait();
+    }
+    bool error = state.hasError();
+    if (error == false)
+    {
+      buffer.swap(state._output[i]);
+      state._output.erase(i);
+      if (_index != NULL)
+      {
+        index = state._indexes[i];
+        state._indexes.erase(i);
+      }
+      state._nextWrite = i + 1;
+      state.broadcast();
+    }
+    state.unlock();
+    if (error == true)
+    {
+      break;
+    }
+    try
+    {
+      if (_index != NULL)
+      {
+        _index->addIndex(index, (uint64_t)mafStream.tellp());
+      }
+      mafStream << buffer;
+    }
+    catch(exception& e)
+    {
+      state.setError(e.what());
+      break;
+    }
+  }
+  mafStream.flush();
+  state.join();
+}
+
+void MafExport::convertChunks(AlignmentConstPtr alignment,
+                              ThreadState& state)
+{
+  const MafExport* parent = state._parent;
+  set<const Genome*> targets;
+  for (size_t i = 0; i < state._targetNames.size(); ++i)
+  {
+    targets.insert(alignment->openGenome(state._targetNames[i]));
+  }
+  const Genome* genome = alignment->openGenome(state._genomeName);
+
+  MafExport mafExport;
+  mafExport.setMaxRefGap(parent->_maxRefGap);
+  mafExport.setNoDupes(parent->_noDupes);
+  mafExport.setNoAncestors(parent->_noAncestors);
+  mafExport.setUcscNames(parent->_ucscNames);
+  mafExport.setUnique(parent->_unique);
+  mafExport.setAppend(true);
+  mafExport.setMaxBlockLength(parent->_mafBlock.getMaxLength());
+  mafExport.setPrintTree(parent->_printTree);
+  mafExport.setOnlyOrthologs(parent->_onlyOrthologs);
+  MafIndex index;
+  if (parent->_index != NULL)
+  {
+    mafExport.setIndex(&index);
+  }
+
+  while (true)
+  {
+    state.lock();
+    while (state.hasError() == false && 
+           state._nextChunk < state._chunks.size() &&
+           state._nextChunk >= state._nextWrite + state._maxPending)
+    {
+      state.wait();
+    }
+    if (state.hasError() == true || 
+        state._nextChunk == state._chunks.size())
+    {
+      state.unlock();
+      break;
+    }
+    size_t chunk = state._nextChunk++;
+    state.unlock();
+
+    if (state._splitRange == true)
+    {
+      mafExport._skipFirst = state._chunks[0].front().first;
+      mafExport._skipLast = state._chunks[chunk].front().first - 1;
+    }
+    stringstream buffer;
+    index.clear();
+    mafExport.convertRanges(buffer, alignment, genome,
+                            state._chunks[chunk], targets);
+
+    state.lock();
+    state._output[chunk] = buffer.str();
+    if (parent->_index != NULL)
+    {
+      state._indexes[chunk] = index;
+    }
+    state.broadcast();
+    state.unlock();
   }
 }
 
@@ -183,7 +550,24 @@ void MafExport::convertEntireAlignment(ostream& mafStream,
         assert(genome != NULL);
         leafGenomes.push_back(genome);
     }
+    // Make a visit cache for every genome (ancestors get visited too)
+    // up front, so that they can all switch to bitmaps once their
+    // visited positions get too scattered to store as intervals.
     ColumnIterator::VisitCache visitCache;
+    deque<string> genomeNames(1, alignment->getRootName());
+    while (genomeNames.empty() == false)
+    {
+        const Genome *genome = alignment->openGenome(genomeNames.front());
+        vector<string> childNames = 
+           alignment->getChildNames(genomeNames.front());
+        genomeNames.pop_front();
+        genomeNames.insert(genomeNames.end(), childNames.begin(), 
+                           childNames.end());
+        PositionCache *posCache = new PositionCache();
+        posCache->allowBitmap(genome->getSequenceLength());
+        visitCache.insert(pair<const Genome*, PositionCache*>(genome, 
+                                                              posCache));
+    }
     // Go through all the genomes one by one, and spit out any columns
     // they participate in that we haven't seen.
     for (hal_size_t i = 0; i < leafGenomes.size(); i++) {
@@ -197,7 +581,10 @@ void MafExport::convertEntireAlignment(ostream& mafStream,
                                                                  false, // reverseStrand
                                                                  true,  // unique
                                                                  _onlyOrthologs);
+        // The iterator takes over the caches, and we take them back
+        // when it's done.
         colIt->setVisitCache(&visitCache);
+        visitCache.clear();
         // So that we don't accidentally visit the first column if it's
         // already been visited.
         colIt->toSite(0, genome->getSequenceLength() - 1);
@@ -213,10 +600,11 @@ void MafExport::convertEntireAlignment(ostream& mafStream,
                 if (numBlocks++ % 1000 == 0)
                 {
                     colIt->defragment();
+                    checkVisitCache(colIt->getVisitCache());
                 }
                 if (appendCount > 0)
                 {
-                    mafStream << _mafBlock << '\n';
+                    writeBlock();
                 }
                 _mafBlock.initBlock(colIt, _ucscNames, _printTree);
                 assert(_mafBlock.canAppendColumn(colIt) == true);
@@ -231,14 +619,21 @@ void MafExport::convertEntireAlignment(ostream& mafStream,
             }
             colIt->toRight();
         }
-        // Copy over the updated visit cache information. This is a
-        // deep copy, so it's slow, but necessary to preserve the
-        // column iterator ownership of the visit cache
-        visitCache.clear();
-        ColumnIterator::VisitCache *newVisitCache = colIt->getVisitCache();
-        for(ColumnIterator::VisitCache::iterator it = newVisitCache->begin();
-            it != newVisitCache->end(); it++) {
-            visitCache[it->first] = new PositionCache(*it->second);
+        visitCache.swap(*colIt->getVisitCache());
+        // The genome we just went through is now (almost) entirely
+        // visited, so a bitmap is overkill for it.
+        ColumnIterator::VisitCache::iterator cacheIt = visitCache.find(genome);
+        if (cacheIt != visitCache.end())
+        {
+            cacheIt->second->compact();
+        }
+        hal_size_t memory = checkVisitCache(&visitCache);
+        if (_progress == true)
+        {
+            cerr << genome->getName() << " done (" << i + 1
+                 << " of " << leafGenomes.size() << " leaves), " 
+                 << numBlocks << " blocks so far, visited positions use " 
+                 << memory << " bytes" << endl;
         }
     }
 
@@ -247,6 +642,30 @@ void MafExport::convertEntireAlignment(ostream& mafStream,
     // so we do following check
     if (appendCount > 0)
     {
-        mafStream << _mafBlock << endl;
+        writeBlock(true);
     }
+    for (ColumnIterator::VisitCache::iterator it = visitCache.begin();
+         it != visitCache.end(); ++it)
+    {
+        delete it->second;
+    }
+}
+
+hal_size_t MafExport::checkVisitCache(
+  const ColumnIterator::VisitCache* visitCache) const
+{
+  hal_size_t memory = 0;
+  for (ColumnIterator::VisitCache::const_iterator i = visitCache->begin();
+       i != visitCache->end(); ++i)
+  {
+    memory += i->second->getMemoryUsage();
+  }
+  if (_globalMaxMemory > 0 && memory > _globalMaxMemory)
+  {
+    stringstream ss;
+    ss << "Visited positions use " << memory << " bytes, which is more "
+       << "than the limit of " << _globalMaxMemory << " bytes";
+    throw hal_exception(ss.str());
+  }
+  return memory;
 }
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <cassert>
+#include "halMafIndex.h"
+#include "halBgzf.h"
+
+using namespace std;
+using namespace hal;
+
+const uint64_t MafIndex::ChunkSize = 0xff00;
+
+static const string MafIndexHeader = "##maf-index version=1 offsets=";
+
+bool MafIndex::Chunk::operator<(const Chunk& other) const
+{
+  if (_sequence != other._sequence)
+  {
+    return _sequence < other._sequence;
+  }
+  if (_start != other._start)
+  {
+    return _start < other._start;
+  }
+  return _offset < other._offset;
+}
+
+MafIndex::MafIndex() : _compressed(false)
+{
+
+}
+
+MafIndex::~MafIndex()
+{
+
+}
+
+void MafIndex::clear()
+{
+  _chunks.clear();
+  _compressed = false;
+}
+
+void MafIndex::addBlock(const string& sequence, hal_index_t start,
+                        hal_size_t length, uint64_t offset)
+{
+  hal_index_t end = start + (hal_index_t)length;
+  if (_chunks.empty() == false)
+  {
+    Chunk& last = _chunks.back();
+    if (last._sequence == sequence && start >= last._end &&
+        offset - last._offset < ChunkSize)
+    {
+      last._end = end;
+      return;
+    }
+  }
+  Chunk chunk;
+  chunk._sequence = sequence;
+  chunk._start = start;
+  chunk._end = end;
+  chunk._offset = offset;
+  _chunks.push_back(chunk);
+}
+
+void MafIndex::addIndex(const MafIndex& other, uint64_t offset)
+{
+  for (size_t i = 0; i < other._chunks.size(); ++i)
+  {
+    _chunks.push_back(other._chunks[i]);
+    _chunks.back()._offset += offset;
+  }
+}
+
+void MafIndex::write(ostream& os, const BgzfWriteBuf* bgzf) const
+{
+  vector<Chunk> chunks(_chunks);
+  sort(chunks.begin(), chunks.end());
+  os << MafIndexHeader << (bgzf != NULL ? "virtual" : "byte") << '\n';
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    uint64_t offset = chunks[i]._offset;
+    if (bgzf != NULL)
+    {
+      offset = bgzf->getVirtualOffset(offset);
+    }
+    os << chunks[i]._sequence << '\t' << chunks[i]._start << '\t'
+       << chunks[i]._end << '\t' << offset << '\n';
+  }
+  if (!os)
+  {
+    throw hal_exception("Error writing MAF index");
+  }
+}
+
+void MafIndex::read(istream& is)
+{
+  clear();
+  string line;
+  if (!getline(is, line) || line.compare(0, MafIndexHeader.length(),
+                                         MafIndexHeader) != 0)
+  {
+    throw hal_exception("Invalid MAF index header");
+  }
+  string offsets = line.substr(MafIndexHeader.length());
+  if (offsets != "virtual" && offsets != "byte")
+  {
+    throw hal_exception("Invalid MAF index header: " + line);
+  }
+  _compressed = offsets == "virtual";
+  while (getline(is, line))
+  {
+    if (line.empty() == true)
+    {
+      continue;
+    }
+    stringstream ss(line);
+    Chunk chunk;
+    ss >> chunk._sequence >> chunk._start >> chunk._end >> chunk._offset;
+    if (!ss || chunk._end < chunk._start)
+    {
+      throw hal_exception("Invalid MAF index line: " + line);
+    }
+    _chunks.push_back(chunk);
+  }
+  sort(_chunks.begin(), _chunks.end());
+}
+
+bool MafIndex::isCompressed() const
+{
+  return _compressed;
+}
+
+void MafIndex::getChunks(const string& sequence, hal_index_t start,
+                         hal_index_t end, vector<Chunk>& chunks) const
+{
+  chunks.clear();
+  Chunk first;
+  first._sequence = sequence;
+  first._start = numeric_limits<hal_index_t>::min();
+  first._offset = 0;
+  vector<Chunk>::const_iterator i = lower_bound(_chunks.begin(),
+                                                _chunks.end(), first);
+  // chunks are sorted by start, so we can stop at the first one that
+  // starts past the range
+  for (; i != _chunks.end() && i->_sequence == sequence && i->_start < end;
+       ++i)
+  {
+    if (i->_end > start || (i->_start == i->_end && i->_start >= start))
+    {
+      chunks.push_back(*i);
+    }
+  }
+}
@@ -34,6 +34,7 @@ void MafScanDimensions::scan(const string& mafPath, const set<string>& targets)
     delete i->second;
   }
   _dimMap.clear();
+  _records.clear();
 
   MafScanner::scan(mafPath, targets);
 
@@ -59,12 +60,11 @@ void MafScanDimensions::sLine()
   Row& row = _block[_rows - 1];
 
   // this is the first pass.  so we do a quick sanity check
-  size_t dotPos = row._sequenceName.find('.');
-  if (dotPos == string::npos || dotPos == 0 || 
-      dotPos == row._sequenceName.length() - 1)
+  if (row._name->_genomeName.empty() == true)
   {
     stringstream ss;
-    ss << "illegal sequence name found: " << row._sequenceName << ".  Sequence "
+    ss << "illegal sequence name found: " << row._name->_fullName 
+       << ".  Sequence "
        "names must be in genomeName.sequenceName format.";
     throw hal_exception(ss.str());
   }
@@ -81,7 +81,8 @@ void MafScanDimensions::sLine()
       if (!isNucleotide(row._line[i]))
       {
         stringstream ss;
-        ss << "problem reading line for sequence " << row._sequenceName << ": "
+        ss << "problem reading line for sequence " << row._name->_fullName 
+       << ": "
            " non-gap non-nucleotide character " << row._line[i] << " found at "
            << i << "th position";
         throw hal_exception(ss.str());
@@ -92,7 +93,8 @@ void MafScanDimensions::sLine()
   if (row._line.length() - numGaps != row._length)
   {
     stringstream ss;
-    ss << "problem reading line for sequence " << row._sequenceName << ": "
+    ss << "problem reading line for sequence " << row._name->_fullName 
+       << ": "
            " length field was " << row._length << " but line contains "
            << row._line.length() - numGaps << " bases";
     throw hal_exception(ss.str());
@@ -101,7 +103,8 @@ void MafScanDimensions::sLine()
   if (row._startPosition + row._length > row._srcLength)
   {
     stringstream ss;
-    ss << "problem reading line for sequence " << row._sequenceName << ": "
+    ss << "problem reading line for sequence " << row._name->_fullName 
+       << ": "
            " sequence length is" << row._srcLength << " but line starts at "
        << row._startPosition << " and contains " << row._length << " bases";
     throw hal_exception(ss.str());
@@ -120,31 +123,37 @@ void MafScanDimensions::end()
 void MafScanDimensions::updateDimensionsFromBlock()
 {
   assert(_rows > 0 && !_block.empty());
-  size_t length = _block[0]._line.length();
   for (size_t i = 0; i < _rows; ++i)
   {
     Row& row = _block[i];
-    pair<string, Record*> newRec(row._sequenceName, NULL);
-    pair<DimMap::iterator, bool> result = _dimMap.insert(newRec);
-    Record*& rec = result.first->second;
+    if (row._name->_id >= _records.size())
+    {
+      _records.resize(_names->getNumNames(), NULL);
+    }
+    Record*& rec = _records[row._name->_id];
+    bool newRecord = rec == NULL;
+    if (newRecord == true)
+    {
+      pair<string, Record*> newRec(row._name->_fullName, NULL);
+      rec = _dimMap.insert(newRec).first->second = new Record();
+    }
     pair<hal_size_t, ArrayInfo> startIndex;
     startIndex.first = 0;
     startIndex.second._index = 0; 
     startIndex.second._count = 1;
     startIndex.second._written = 0;
     startIndex.second._empty = 0;
-    if (result.second == false && row._srcLength != rec->_length)
+    if (newRecord == false && row._srcLength != rec->_length)
     {
-      assert(rec != NULL);
       stringstream ss;
-      ss << "conflicting length for sequence " << row._sequenceName << ": "
+      ss << "conflicting length for sequence " << row._name->_fullName 
+         << ": "
          << "was scanned once as " << row._srcLength << " then again as "
          << rec->_length;
       throw hal_exception(ss.str());
     }
-    else if (result.second == true)
+    else if (newRecord == true)
     {
-      rec = new Record(); 
       startIndex.first = 0;
       startIndex.second._empty = 1;
       rec->_startMap.insert(startIndex);
@@ -165,8 +174,18 @@ void MafScanDimensions::updateDimensionsFromBlock()
         end = row._srcLength - row._startPosition;
       }
       startIndex.first = start;
-      pair<StartMap::iterator, bool> smResult = 
-         rec->_startMap.insert(startIndex);
+      pair<StartMap::iterator, bool> smResult;
+      // rows of a sequence usually come in order, so try the end first
+      if (start > rec->_startMap.rbegin()->first)
+      {
+        smResult.first = rec->_startMap.insert(rec->_startMap.end(), 
+                                               startIndex);
+        smResult.second = true;
+      }
+      else
+      {
+        smResult = rec->_startMap.insert(startIndex);
+      }
       StartMap::iterator smIt = smResult.first;
       bool bad = false;
 
@@ -231,7 +250,7 @@ void MafScanDimensions::updateDimensionsFromBlock()
         {
           rec->_startMap.erase(smIt);
         }
-        rec->_badPosSet.insert(FilePosition(_mafFile.tellg(), i));
+        rec->_badPosSet.insert(FilePosition(getFilePosition(), i));
       }
       else
       {
@@ -242,25 +261,24 @@ void MafScanDimensions::updateDimensionsFromBlock()
           startIndex.first = end;
           startIndex.second._empty = 1;
           startIndex.second._count = 1;
-          pair<StartMap::iterator, bool> endResult = 
-             rec->_startMap.insert(startIndex);              
+          StartMap::iterator hint = smIt;
+          rec->_startMap.insert(++hint, startIndex);
         }
 
         size_t numGaps = 0;
-        hal_size_t interiorStart;
-
-        for (size_t j = 0; j < length; ++j)
+        size_t prev = 0;
+        const char* line = row._line.data();
+        for (size_t k = 0; k < _cuts.size(); ++k)
         {
-          if (row._line[j] == '-')
-          {
-            ++numGaps;
-          }
+          size_t j = _cuts[k];
+          numGaps += count(line + prev, line + j, '-');
+          prev = j;
           // valid segmentation between j-1 and j:
           // we add the start coordinate of the segment beginning at 
           // j in forward segment coordinates.  
-          else if (_mask[j] == true && (row._line[j] != '-'))
+          if (line[j] != '-')
           {
-            interiorStart = start + j - numGaps;
+            hal_size_t interiorStart = start + j - numGaps;
             if (interiorStart > start)
             {
               ++smIt->second._count;
@@ -36,17 +36,17 @@ void MafScanReference::sLine()
 {
   Row& row = _block[_rows - 1];
   // this is the first pass.  so we do a quick sanity check
-  if (row._sequenceName.find('.') == string::npos || 
-      row._sequenceName.find('.') == 0)
+  if (row._name->_genomeName.empty() == true)
   {
     stringstream ss;
-    ss << "illegal sequence name found: " << row._sequenceName << ".  Sequence "
+    ss << "illegal sequence name found: " << row._name->_fullName 
+       << ".  Sequence "
        "names must be in genomeName.sequenceName format.";
     throw hal_exception(ss.str());
   }
   
-  _name = genomeName(row._sequenceName);
-  _mafFile.seekg(0, ios_base::end);
+  _name = row._name->_genomeName;
+  stopScan();
 }
 
 void MafScanReference::end()
@@ -15,7 +15,83 @@ using namespace std;
 using namespace hal;
 
 
-MafScanner::MafScanner()
+MafNameTable::MafNameTable()
+{
+
+}
+
+MafNameTable::~MafNameTable()
+{
+  clear();
+}
+
+const MafNameTable::Name* MafNameTable::getName(const char* fullName,
+                                                size_t length)
+{
+  _key.assign(fullName, length);
+  NameMap::iterator i = _nameMap.lower_bound(_key);
+  if (i != _nameMap.end() && i->first == _key)
+  {
+    return i->second;
+  }
+  Name* name = new Name();
+  name->_id = _nameMap.size();
+  name->_fullName = _key;
+  size_t dotPos = _key.find('.');
+  if (dotPos != string::npos && dotPos > 0 && dotPos < _key.length() - 1)
+  {
+    name->_genomeName = _key.substr(0, dotPos);
+    name->_sequenceName = _key.substr(dotPos + 1);
+  }
+  _nameMap.insert(i, NameMap::value_type(_key, name));
+  _names.push_back(name);
+  return name;
+}
+
+const MafNameTable::Name* MafNameTable::getName(size_t id) const
+{
+  return id < _names.size() ? _names[id] : NULL;
+}
+
+size_t MafNameTable::getNumNames() const
+{
+  return _nameMap.size();
+}
+
+void MafNameTable::clear()
+{
+  for (NameMap::iterator i = _nameMap.begin(); i != _nameMap.end(); ++i)
+  {
+    delete i->second;
+  }
+  _nameMap.clear();
+  _names.clear();
+}
+
+// spill file records: a row, the end of a block, and the end of the file
+static const char SpillRow = 'r';
+static const char SpillBlock = 'a';
+static const char SpillEnd = 'e';
+
+template <typename T>
+static void writeSpill(ostream& os, const T& val)
+{
+  os.write((const char*)&val, sizeof(T));
+}
+
+template <typename T>
+static void readSpill(istream& is, T& val)
+{
+  is.read((char*)&val, sizeof(T));
+  if (!is)
+  {
+    throw hal_exception("error reading MAF spill file");
+  }
+}
+
+MafScanner::MafScanner() : _names(&_ownNames), _stop(false), 
+                           _spillStream(NULL), _spilled(false), 
+                           _spillPosition(0)
 {
 
 }
@@ -25,36 +101,89 @@ MafScanner::~MafScanner()
 
 }
 
+void MafScanner::setNameTable(MafNameTable* names)
+{
+  _names = names != NULL ? names : &_ownNames;
+}
+
+MafNameTable* MafScanner::getNameTable()
+{
+  return _names;
+}
+
+void MafScanner::setSpillStream(ostream* spillStream)
+{
+  _spillStream = spillStream;
+}
+
 void MafScanner::scan(const string& mafFilePath, const set<string>& targets)
 {
   _targets = targets;
-  _mafFile.open(mafFilePath.c_str());
+  _targetCache.clear();
+  _mafFile.open(mafFilePath.c_str(), ios_base::in | ios_base::binary);
   _numBlocks = 0;
+  _stop = false;
+  _spilled = false;
 
   if (!_mafFile)
   {
     throw runtime_error("error opening path: " + mafFilePath);
   }
+  _tokenizer.open(&_mafFile);
   
   _rows = 0;
   _block.clear();
-  string buffer;
-  while (!_mafFile.eof() && _mafFile.good())
+  while (_stop == false && _tokenizer.nextLine())
   {
-    buffer.clear();
-    _mafFile >> buffer;
-    if (buffer == "a")
+    const char* first = _tokenizer.getField(0);
+    if (first[0] == 'a' && first[1] == '\0')
     {
       if (_rows > 0)
       {
+        spillMarker(SpillBlock);
         updateMask();
         aLine();
         ++_numBlocks;
-        nextLine();
       }
       _rows = 0;
     }
-    else if (buffer == "s")
+    else if (first[0] == 's' && first[1] == '\0')
+    {
+      readRow(_tokenizer.getNumFields());
+    }
+  }
+  spillMarker(SpillEnd);
+  if (_rows > 0)
+  {
+    updateMask();
+    ++_numBlocks;
+  }
+  end();  
+  _mafFile.close();
+  if (_spillStream != NULL)
+  {
+    _spillStream->flush();
+    if (!*_spillStream)
+    {
+      throw hal_exception("error writing MAF spill file");
+    }
+  }
+}
+
+void MafScanner::scanSpill(istream& spillStream)
+{
+  _targets.clear();
+  _targetCache.clear();
+  _numBlocks = 0;
+  _stop = false;
+  _spilled = true;
+  _rows = 0;
+  _block.clear();
+  char type = SpillEnd;
+  do
+  {
+    readSpill(spillStream, type);
+    if (type == SpillRow)
     {
       ++_rows;
       if (_rows > _block.size())
@@ -62,53 +191,159 @@ void MafScanner::scan(const string& mafFilePath, const set<string>& targets)
         _block.resize(_rows);
       }
       Row& row = _block[_rows - 1];
-      _mafFile >> row._sequenceName >> row._startPosition >> row._length 
-               >> row._strand >> row._srcLength >> row._line;
-      if (_mafFile.bad() || _mafFile.fail())
-      {
-        throw hal_exception("error parsing sequence " + row._sequenceName);
-      }
-      if (_rows > 1 && row._line.length() != _block[_rows - 2]._line.length())
+      size_t id;
+      hal_size_t lineLength;
+      readSpill(spillStream, id);
+      readSpill(spillStream, row._startPosition);
+      readSpill(spillStream, row._length);
+      readSpill(spillStream, row._srcLength);
+      readSpill(spillStream, row._strand);
+      readSpill(spillStream, lineLength);
+      row._name = _names->getName(id);
+      if (row._name == NULL)
       {
-        stringstream ss;
-        ss << "two lines in same block have different lengths: " 
-           << row._sequenceName << " " << row._startPosition << " and "
-           << _block[_rows - 2]._sequenceName << " " 
-           << _block[_rows - 2]._startPosition;
-        throw hal_exception(ss.str());
+        throw hal_exception("MAF spill file doesn't match name table");
       }
-
-      if (_targets.size() > 1 && // (will always include reference) 
-          _targets.find(genomeName(row._sequenceName)) == _targets.end())
+      row._line.resize(lineLength);
+      if (lineLength > 0)
       {
-        // genome not in targets, pretend like it never happened. 
-        --_rows;
+        spillStream.read(&row._line[0], lineLength);
       }
-      else
+      sLine();
+    }
+    else if (type == SpillBlock || type == SpillEnd)
+    {
+      readSpill(spillStream, _spillPosition);
+      if (type == SpillBlock)
       {
-        sLine();
+        updateMask();
+        aLine();
+        ++_numBlocks;
+        _rows = 0;
       }
     }
     else
     {
-      nextLine();
+      throw hal_exception("error reading MAF spill file");
     }
-  }
+  } while (type != SpillEnd);
   if (_rows > 0)
   {
     updateMask();
     ++_numBlocks;
   }
-  end();  
-  _mafFile.close();
+  end();
+  _spilled = false;
+}
+
+void MafScanner::spillRow(const Row& row)
+{
+  if (_spillStream != NULL)
+  {
+    writeSpill(*_spillStream, SpillRow);
+    writeSpill(*_spillStream, row._name->_id);
+    writeSpill(*_spillStream, row._startPosition);
+    writeSpill(*_spillStream, row._length);
+    writeSpill(*_spillStream, row._srcLength);
+    writeSpill(*_spillStream, row._strand);
+    writeSpill(*_spillStream, (hal_size_t)row._line.length());
+    _spillStream->write(row._line.data(), row._line.length());
+  }
+}
+
+void MafScanner::spillMarker(char type)
+{
+  if (_spillStream != NULL)
+  {
+    writeSpill(*_spillStream, type);
+    writeSpill(*_spillStream, getFilePosition());
+  }
+}
+
+void MafScanner::readRow(size_t numFields)
+{
+  ++_rows;
+  if (_rows > _block.size())
+  {
+    _block.resize(_rows);
+  }
+  Row& row = _block[_rows - 1];
+  if (numFields < 2)
+  {
+    throw hal_exception("error parsing sequence line with no name");
+  }
+  row._name = _names->getName(_tokenizer.getField(1),
+                              _tokenizer.getFieldLength(1));
+  hal_index_t startPosition, length, srcLength;
+  if (numFields < 7 ||
+      !BedTokenizer::parseInt(_tokenizer.getField(2),
+                              _tokenizer.getFieldLength(2), startPosition) ||
+      !BedTokenizer::parseInt(_tokenizer.getField(3),
+                              _tokenizer.getFieldLength(3), length) ||
+      _tokenizer.getFieldLength(4) != 1 ||
+      !BedTokenizer::parseInt(_tokenizer.getField(5),
+                              _tokenizer.getFieldLength(5), srcLength) ||
+      startPosition < 0 || length < 0 || srcLength < 0)
+  {
+    throw hal_exception("error parsing sequence " + row._name->_fullName);
+  }
+  row._startPosition = startPosition;
+  row._length = length;
+  row._strand = _tokenizer.getField(4)[0];
+  row._srcLength = srcLength;
+  row._line.assign(_tokenizer.getField(6), _tokenizer.getFieldLength(6));
+
+  if (_rows > 1 && row._line.length() != _block[_rows - 2]._line.length())
+  {
+    stringstream ss;
+    ss << "two lines in same block have different lengths: " 
+       << row._name->_fullName << " " << row._startPosition << " and "
+       << _block[_rows - 2]._name->_fullName << " " 
+       << _block[_rows - 2]._startPosition;
+    throw hal_exception(ss.str());
+  }
+
+  if (_targets.size() > 1 && // (will always include reference) 
+      isTarget(row._name) == false)
+  {
+    // genome not in targets, pretend like it never happened. 
+    --_rows;
+  }
+  else
+  {
+    spillRow(row);
+    sLine();
+  }
 }
 
-void MafScanner::nextLine()
+bool MafScanner::isTarget(const Name* name)
 {
-  while (!_mafFile.eof() && !_mafFile.bad() && _mafFile.peek() != '\n')
+  if (name->_id >= _targetCache.size())
   {
-    _mafFile.get();
+    _targetCache.resize(_names->getNumNames(), 0);
   }
+  char& cached = _targetCache[name->_id];
+  if (cached == 0)
+  {
+    if (name->_genomeName.empty() == true)
+    {
+      throw hal_exception("illegal sequence name found: " + 
+                          name->_fullName + ".  Sequence names must be in "
+                          "genomeName.sequenceName format.");
+    }
+    cached = _targets.find(name->_genomeName) != _targets.end() ? 1 : 2;
+  }
+  return cached == 1;
+}
+
+void MafScanner::stopScan()
+{
+  _stop = true;
+}
+
+hal_size_t MafScanner::getFilePosition() const
+{
+  return _spilled ? _spillPosition : _tokenizer.getLinePosition();
 }
 
 // the mask stores a bit for every column where a gap begins in any row
@@ -119,25 +354,26 @@ void MafScanner::updateMask()
   if (_rows > 0)
   {
     size_t length = _block[0]._line.length();
-    _mask.resize(length);
-    fill(_mask.begin(), _mask.end(), false);
+    _mask.assign(length, 0);
+
+    // scan each row left to right, marking where gap runs begin (position
+    // of first gap) or end (position of first non gap)
+    for (size_t j = 0; j < _rows; ++j)
+    {
+      const char* line = _block[j]._line.data();
+      char* mask = &_mask[0];
+      for (size_t i = 1; i < length; ++i)
+      {
+        mask[i] |= (line[i] == '-') != (line[i - 1] == '-');
+      }
+    }
 
-    // scan left to right
+    _cuts.clear();
     for (size_t i = 1; i < length; ++i)
     {
-      // scan up to down
-      for (size_t j = 0; j < _rows && _mask[i] == false; ++j)
+      if (_mask[i] != 0)
       {
-        // beginning of gap run. add position of first gap to mask
-        if (_block[j]._line[i] == '-' && _block[j]._line[i-1] != '-')
-        {
-          _mask[i] = true;
-        }
-        // end of gap run. add position of first non gap to mask
-        else if (_block[j]._line[i] != '-' && _block[j]._line[i-1] == '-')
-        {
-          _mask[i] = true;
-        }
+        _cuts.push_back(i);
       }
     }
   }
@@ -29,7 +29,8 @@ void MafWriteGenomes::convert(const string& mafPath,
                               const string& refGenomeName,
                               const set<string>& targets,
                               const DimMap& dimMap,
-                              AlignmentPtr alignment)
+                              AlignmentPtr alignment,
+                              istream* spillStream)
 {
   _refName = refGenomeName;
   _dimMap = &dimMap;
@@ -39,8 +40,16 @@ void MafWriteGenomes::convert(const string& mafPath,
   _bottomSegment = BottomSegmentIteratorPtr();
   _refBottom = BottomSegmentIteratorPtr();
   _childIdxMap.clear();
+  _nameInfo.clear();
   createGenomes();  
-  MafScanner::scan(mafPath, targets);
+  if (spillStream != NULL)
+  {
+    MafScanner::scanSpill(*spillStream);
+  }
+  else
+  {
+    MafScanner::scan(mafPath, targets);
+  }
   initEmptySegments();
   updateRefParseInfo();
 }
@@ -223,11 +232,9 @@ void MafWriteGenomes::initBlockInfo(size_t col)
       _blockInfo[i]._gaps = 0;
       _blockInfo[i]._start = NULL_INDEX;
       _blockInfo[i]._length = 0;
-      assert(_dimMap->find(_block[i]._sequenceName) != _dimMap->end());
-      _blockInfo[i]._record = _dimMap->find(_block[i]._sequenceName)->second;
-      _blockInfo[i]._genome = 
-         _alignment->openGenome(genomeName(_block[i]._sequenceName));
-      assert(_blockInfo[i]._genome != NULL);
+      const NameInfo& nameInfo = getNameInfo(_block[i]._name);
+      _blockInfo[i]._record = nameInfo._record;
+      _blockInfo[i]._genome = nameInfo._genome;
       _blockInfo[i]._skip = false;
       // correction for - strand: need to iterate index right to left
       // so keep a correctly flipped maf line here (rather than doing it
@@ -285,7 +292,7 @@ void MafWriteGenomes::initBlockInfo(size_t col)
         if (mapIt != startMap.end() &&
             mapIt->second._written == 0 &&
             mapIt->second._empty == 0 && 
-            posSet.find(FilePosition(_mafFile.tellg(), i)) == posSet.end())
+            posSet.find(FilePosition(getFilePosition(), i)) == posSet.end())
         {
           rowInfo._arrayIndex = mapIt->second._index;
 
@@ -341,10 +348,9 @@ void MafWriteGenomes::initParaMap()
   for (size_t i = 0; i < _rows; ++i)
   {
     Row& row = _block[i];
-    Genome* genome = _alignment->openGenome(genomeName(row._sequenceName));
-    assert(genome != NULL);
-    Sequence* sequence = genome->getSequence(sequenceName(row._sequenceName));
-    assert(sequence != NULL);
+    const NameInfo& nameInfo = getNameInfo(row._name);
+    Genome* genome = nameInfo._genome;
+    Sequence* sequence = nameInfo._sequence;
     Paralogy para = {sequence->getStartPosition() + row._startPosition, i};
     pair<ParaMap::iterator, bool> res = _paraMap.insert(
       pair<Genome*, ParaSet>(genome, ParaSet()));
@@ -362,8 +368,8 @@ void MafWriteGenomes::convertSegments(size_t col)
     RowInfo& rowInfo = _blockInfo[_refRow];
     Row& row = _block[_refRow];
     _refBottom->setArrayIndex(_refGenome, rowInfo._arrayIndex);
-    seq =  _refGenome->getSequence(sequenceName(row._sequenceName));
-    assert(seq != NULL);
+    seq = getNameInfo(row._name)._sequence;
+    assert(seq->getGenome() == _refGenome);
     _refBottom->setCoordinates(seq->getStartPosition() + rowInfo._start, 
                                rowInfo._length);
     _refBottom->setTopParseIndex(NULL_INDEX);
@@ -392,8 +398,7 @@ void MafWriteGenomes::convertSegments(size_t col)
       hal_index_t rowSeqOffset = col;
       const string& rowLine = row._strand == '-' ? rowInfo._gapComp : row._line;
 
-      seq = genome->getSequence(sequenceName(row._sequenceName));
-      assert(seq != NULL);
+      seq = getNameInfo(row._name)._sequence;
       if (genome == _refGenome)
       {
         _bottomSegment->setArrayIndex(rowInfo._genome, rowInfo._arrayIndex);
@@ -464,9 +469,7 @@ void MafWriteGenomes::updateParalogy(size_t i)
   ParaSet& paraSet = pIt->second;
   if (paraSet.size() > 1)
   {
-    Sequence* sequence = rowInfo._genome->getSequence(
-      sequenceName(row._sequenceName));
-    assert(sequence != NULL);
+    Sequence* sequence = getNameInfo(row._name)._sequence;
     Paralogy query = {sequence->getStartPosition() + row._startPosition, 0};
     ParaSet::iterator sIt = paraSet.find(query);
     assert(sIt != paraSet.end());
@@ -598,6 +601,28 @@ void MafWriteGenomes::end()
   }
 }
 
+const MafWriteGenomes::NameInfo& 
+MafWriteGenomes::getNameInfo(const Name* name)
+{
+  if (name->_id >= _nameInfo.size())
+  {
+    NameInfo empty = {NULL, NULL, NULL};
+    _nameInfo.resize(getNameTable()->getNumNames(), empty);
+  }
+  NameInfo& nameInfo = _nameInfo[name->_id];
+  if (nameInfo._record == NULL)
+  {
+    DimMap::const_iterator i = _dimMap->find(name->_fullName);
+    assert(i != _dimMap->end());
+    nameInfo._record = i->second;
+    nameInfo._genome = _alignment->openGenome(name->_genomeName);
+    assert(nameInfo._genome != NULL);
+    nameInfo._sequence = nameInfo._genome->getSequence(name->_sequenceName);
+    assert(nameInfo._sequence != NULL);
+  }
+  return nameInfo;
+}
+
 MafWriteGenomes::ParaSet::iterator 
 MafWriteGenomes::circularNext(size_t row, ParaSet& paraSet, ParaSet::iterator i)
 {
@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
 #include "halMafScanDimensions.h"
 #include "halMafWriteGenomes.h"
 #include "halMafScanReference.h"
@@ -31,6 +32,13 @@ static CLParserPtr initParser()
                                " reference must alaready be present in hal"
                                " dabase as a leaf.",
                                false);
+  optionsParser->addOption("spillFile",
+                           "parse the maf only once, saving its rows to this "
+                           "(temporary, binary) file while the dimensions "
+                           "are computed, then building the hal from it. "
+                           "The file is removed when done.  It takes about "
+                           "as much space as the maf.",
+                           "\"\"");
                            
   optionsParser->setDescription("import maf into hal database.");
   return optionsParser;
@@ -44,6 +52,7 @@ int main(int argc, char** argv)
   string refGenomeName;
   string targetGenomes;
   bool append;
+  string spillPath;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -52,6 +61,7 @@ int main(int argc, char** argv)
     refGenomeName = optionsParser->getOption<string>("refGenome");
     targetGenomes = optionsParser->getOption<string>("targetGenomes");
     append = optionsParser->getFlag("append");
+    spillPath = optionsParser->getOption<string>("spillFile");
   }
   catch(exception& e)
   {
@@ -110,44 +120,89 @@ int main(int argc, char** argv)
     set<string> targetSet(targetNames.begin(), targetNames.end());
     targetSet.insert(refGenomeName);
 
+    // the names are interned once, by the first pass, and shared with
+    // the second
+    MafNameTable names;
     MafScanDimensions dScan;
-    dScan.scan(mafPath, targetSet);
-
-    string prevGenome, curGenome;
-    hal_size_t segmentCount = 0;
-    hal_size_t setCount = 0;
-    hal_size_t sequenceCount = 0;
-    hal_size_t skipCount = 0;
-    const MafScanDimensions::DimMap& dimMap = dScan.getDimensions();
-    for (MafScanDimensions::DimMap::const_iterator i = dimMap.begin();
-         i != dimMap.end(); ++i)
+    dScan.setNameTable(&names);
+    fstream spillStream;
+    if (spillPath != "\"\"")
     {
-      curGenome = MafScanner::genomeName(i->first);
-      MafScanDimensions::DimMap::const_iterator next = i;
-      ++next;
-      if (prevGenome.empty() == false && (curGenome != prevGenome ||
-                                          next == dimMap.end()))
+      spillStream.open(spillPath.c_str(), ios_base::in | ios_base::out | 
+                       ios_base::trunc | ios_base::binary);
+      if (!spillStream)
       {
-        cout << prevGenome << ":  " <<  segmentCount << " segments, "
-             << setCount << " set entries, " << skipCount << " dupe rows, "
-             << sequenceCount << " sequences"
-             << endl;
-        segmentCount = 0;
-        setCount = 0;
-        skipCount = 0;
-        sequenceCount = 0;
+        throw hal_exception("Error opening spill file: " + spillPath);
       }
-      segmentCount += i->second->_numSegments;
-      setCount += i->second->_startMap.size();
-      sequenceCount++;
-      skipCount += i->second->_badPosSet.size();
-      prevGenome = curGenome;
+      dScan.setSpillStream(&spillStream);
     }
-    cout << "Total Number of blocks in maf: " << dScan.getNumBlocks() << "\n";
+    // the spill file goes, whatever happens
+    try
+    {
+      dScan.scan(mafPath, targetSet);
 
-    MafWriteGenomes writer;
-    writer.convert(mafPath, refGenomeName, targetSet, dScan.getDimensions(),
-                   alignment);
+      string prevGenome, curGenome;
+      hal_size_t segmentCount = 0;
+      hal_size_t setCount = 0;
+      hal_size_t sequenceCount = 0;
+      hal_size_t skipCount = 0;
+      const MafScanDimensions::DimMap& dimMap = dScan.getDimensions();
+      for (MafScanDimensions::DimMap::const_iterator i = dimMap.begin();
+           i != dimMap.end(); ++i)
+      {
+        curGenome = MafScanner::genomeName(i->first);
+        MafScanDimensions::DimMap::const_iterator next = i;
+        ++next;
+        if (prevGenome.empty() == false && (curGenome != prevGenome ||
+                                            next == dimMap.end()))
+        {
+          cout << prevGenome << ":  " <<  segmentCount << " segments, "
+               << setCount << " set entries, " << skipCount << " dupe rows, "
+               << sequenceCount << " sequences"
+               << endl;
+          segmentCount = 0;
+          setCount = 0;
+          skipCount = 0;
+          sequenceCount = 0;
+        }
+        segmentCount += i->second->_numSegments;
+        setCount += i->second->_startMap.size();
+        sequenceCount++;
+        skipCount += i->second->_badPosSet.size();
+        prevGenome = curGenome;
+      }
+      cout << "Total Number of blocks in maf: " << dScan.getNumBlocks()
+           << "\n";
+
+      MafWriteGenomes writer;
+      writer.setNameTable(&names);
+      if (spillPath != "\"\"")
+      {
+        spillStream.seekg(0);
+        writer.convert(mafPath, refGenomeName, targetSet,
+                       dScan.getDimensions(), alignment, &spillStream);
+      }
+      else
+      {
+        writer.convert(mafPath, refGenomeName, targetSet,
+                       dScan.getDimensions(), alignment);
+      }
+    }
+    catch(...)
+    {
+      if (spillPath != "\"\"")
+      {
+        spillStream.close();
+        std::remove(spillPath.c_str());
+      }
+      throw;
+    }
+    if (spillPath != "\"\"")
+    {
+      spillStream.close();
+      std::remove(spillPath.c_str());
+    }
+    alignment->close();
 
 
   }try{}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALBGZF_H
+#define _HALBGZF_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "hal.h"
+
+namespace hal {
+
+/** Stream buffer that writes BGZF (the blocked gzip of bgzip and tabix).
+ * Every block but the last holds exactly BlockSize bytes of input, so
+ * the virtual offset (compressed block offset << 16 | offset in block)
+ * of any position can be looked up once the blocks are written.  Blocks
+ * are compressed in batches across numThreads threads.  tellp() on a
+ * stream using this buffer gives the uncompressed position. */
+class BgzfWriteBuf : public std::streambuf
+{
+public:
+
+   BgzfWriteBuf();
+   virtual ~BgzfWriteBuf();
+
+   void open(std::ostream* outStream, hal_size_t numThreads = 1);
+
+   /** Write out everything, followed by the empty end-of-file block */
+   void close();
+
+   /** Virtual offset of an uncompressed position.  Only valid for
+    * positions in blocks that have been written (ie. after close()) */
+   uint64_t getVirtualOffset(uint64_t offset) const;
+
+   static const size_t BlockSize;
+   static const size_t BatchSize;
+
+protected:
+
+   virtual int_type overflow(int_type c);
+   virtual int sync();
+   virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                            std::ios_base::openmode which);
+
+   void queueBlock();
+   void writeBlocks();
+   static void compressBlock(const std::string& data, std::string& block);
+   static void* compressThread(void* data);
+
+   std::ostream* _outStream;
+   hal_size_t _numThreads;
+   std::vector<char> _buffer;
+   std::vector<std::string> _pending;
+   std::vector<std::string> _compressed;
+   uint64_t _offset;
+   uint64_t _compressedOffset;
+   std::vector<uint64_t> _blockOffsets;
+
+private:
+   BgzfWriteBuf(const BgzfWriteBuf&);
+   BgzfWriteBuf& operator=(const BgzfWriteBuf&);
+};
+
+/** Stream buffer that reads BGZF from a seekable stream, block by
+ * block, and can jump to a virtual offset. */
+class BgzfReadBuf : public std::streambuf
+{
+public:
+
+   BgzfReadBuf();
+   virtual ~BgzfReadBuf();
+
+   void open(std::istream* inStream);
+   void seekVirtual(uint64_t offset);
+
+protected:
+
+   virtual int_type underflow();
+   bool readBlock();
+
+   std::istream* _inStream;
+   std::vector<char> _compressed;
+   std::vector<char> _buffer;
+
+private:
+   BgzfReadBuf(const BgzfReadBuf&);
+   BgzfReadBuf& operator=(const BgzfReadBuf&);
+};
+
+}
+
+#endif
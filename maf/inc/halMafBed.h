@@ -30,9 +30,18 @@ public:
 
    void run(std::istream* bedStream, int bedVersion = -1);
 
+   /** Collect all the intervals, and convert them in reference order
+    * (rather than file order) at the end of the scan, using one column
+    * iterator for all of them (see MafExport::convertRanges) */
+   void setBatch(bool batch);
+
 protected: 
 
    virtual void visitLine();
+   virtual void visitEOF();
+
+   void convertRange(const Sequence* refSequence, hal_index_t start,
+                     hal_index_t end);
 
 protected:
 
@@ -44,6 +53,8 @@ protected:
    hal_size_t _refLength;
    std::set<const Genome*>& _targetSet;
    MafExport& _mafExport;
+   bool _batch;
+   std::vector<MafExport::Range> _ranges;
 };
 
 }
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALMAFBINARYREADER_H
+#define _HALMAFBINARYREADER_H
+
+#include <string>
+#include "halDefs.h"
+
+namespace hal {
+
+/** Binary, columnar version of the blocks hal2maf writes (--binary),
+ * laid out so it can be used straight from a memory map.  Everything
+ * is in the writer's byte order (checked against MafBinaryByteOrder)
+ * and every section starts on an 8-byte boundary:
+ *
+ * header:   char magic[8] ("HALBLOCK"), uint32 version, uint32 byteOrder
+ * blocks:   uint32 numRows, uint32 numColumns,
+ *           int64 start[numRows], int64 length[numRows],
+ *           uint32 sequence[numRows], char strand[numRows] ('+' or '-'),
+ *           then the dna of each row, two columns per byte (low nibble
+ *           first, see MafBinaryBlock::decode()).  The rows are in the
+ *           same order, with the same coordinates, as in the MAF.
+ * sequences: uint64 nameOffset[numSequences + 1] into the names,
+ *           int64 length[numSequences], then the names (not terminated)
+ * index:    uint64 blockOffset[numBlocks]
+ * trailer:  uint64 numBlocks, uint64 numSequences, uint64 sequencesOffset,
+ *           uint64 indexOffset, uint32 version, uint32 byteOrder,
+ *           char magic[8]
+ *
+ * This header and halMafBinaryReader.cpp only depend on halDefs.h, so
+ * they can be copied into other tools. */
+
+extern const char MafBinaryMagic[8];
+extern const uint32_t MafBinaryVersion;
+extern const uint32_t MafBinaryByteOrder;
+
+/** One block of a MafBinaryReader, pointing into its data */
+struct MafBinaryBlock
+{
+   uint32_t _numRows;
+   uint32_t _numColumns;
+   const int64_t* _starts;
+   const int64_t* _lengths;
+   const uint32_t* _sequences;
+   const char* _strands;
+   const uint8_t* _dna;
+
+   /** Bytes of packed dna per row */
+   size_t getRowBytes() const;
+
+   /** Base (or '-') of a row in a column */
+   char getBase(uint32_t row, uint32_t column) const;
+
+   /** The row as it appears in the MAF */
+   void getRow(uint32_t row, std::string& dna) const;
+
+   /** Character for a 4-bit code: 0 is a gap, 1-5 are ACGTN, and bit 3
+    * marks lower case */
+   static char decode(uint8_t code);
+};
+
+class MafBinaryReader
+{
+public:
+
+   MafBinaryReader();
+   virtual ~MafBinaryReader();
+
+   /** Memory map a file written by MafBinaryWriter */
+   void open(const std::string& path);
+
+   /** Read from a buffer holding a whole file (which must stay around,
+    * and be 8-byte aligned, until close()) */
+   void open(const char* data, size_t size);
+
+   void close();
+
+   hal_size_t getNumBlocks() const;
+   hal_size_t getNumSequences() const;
+   std::string getSequenceName(hal_size_t i) const;
+   hal_size_t getSequenceLength(hal_size_t i) const;
+   MafBinaryBlock getBlock(hal_size_t i) const;
+
+protected:
+
+   void load();
+
+   const char* _data;
+   size_t _size;
+   void* _map;
+   hal_size_t _numBlocks;
+   hal_size_t _numSequences;
+   const uint64_t* _nameOffsets;
+   const int64_t* _sequenceLengths;
+   const char* _names;
+   const uint64_t* _blockOffsets;
+
+private:
+   MafBinaryReader(const MafBinaryReader&);
+   MafBinaryReader& operator=(const MafBinaryReader&);
+};
+
+inline size_t MafBinaryBlock::getRowBytes() const
+{
+  return (_numColumns + 1) / 2;
+}
+
+inline char MafBinaryBlock::decode(uint8_t code)
+{
+  static const char table[16] = {'-', 'A', 'C', 'G', 'T', 'N', 'N', 'N',
+                                 '-', 'a', 'c', 'g', 't', 'n', 'n', 'n'};
+  return table[code & 0xf];
+}
+
+inline char MafBinaryBlock::getBase(uint32_t row, uint32_t column) const
+{
+  uint8_t byte = _dna[row * getRowBytes() + column / 2];
+  return decode(column % 2 == 0 ? byte & 0xf : byte >> 4);
+}
+
+}
+
+#endif
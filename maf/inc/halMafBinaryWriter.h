@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALMAFBINARYWRITER_H
+#define _HALMAFBINARYWRITER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include "halMafBlock.h"
+#include "halMafBinaryReader.h"
+
+namespace hal {
+
+/** Write MafBlocks in the binary format described in
+ * halMafBinaryReader.h.  The stream is only ever appended to (the
+ * sequence table and index go at the end), so it needn't be seekable */
+class MafBinaryWriter
+{
+public:
+
+   MafBinaryWriter();
+   virtual ~MafBinaryWriter();
+
+   void open(std::ostream* os);
+
+   /** Write the sequence table, index and trailer.  Nothing can be
+    * written after */
+   void close();
+
+   void writeBlock(const MafBlock& block);
+
+   hal_size_t getNumBlocks() const;
+
+   /** 4-bit code of a base (see MafBinaryBlock::decode()) */
+   static uint8_t encode(char c);
+
+protected:
+
+   void write(const void* data, size_t size);
+   void pad();
+   uint32_t getSequenceId(const MafBlockEntry* entry);
+
+   std::ostream* _os;
+   uint64_t _offset;
+   std::vector<uint64_t> _blockOffsets;
+   std::map<std::string, uint32_t> _sequenceIds;
+   std::vector<std::string> _sequenceNames;
+   std::vector<int64_t> _sequenceLengths;
+   std::vector<MafBlockEntry*> _rows;
+   std::vector<int64_t> _buffer;
+   std::vector<uint8_t> _dna;
+};
+
+inline hal_size_t MafBinaryWriter::getNumBlocks() const
+{
+  return _blockOffsets.size();
+}
+
+}
+
+#endif
@@ -11,8 +11,10 @@
 #include <string>
 #include <deque>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <map>
-#include <string>
+#include <vector>
 #include "hal.h"
 #include "sonLib.h"
 
@@ -26,6 +28,7 @@ struct MafBlockString
    MafBlockString();
    ~MafBlockString();
    void append(char c);
+   void append(char c, size_t count);
    void clear();
    char* str();
    char* _buf;
@@ -41,13 +44,17 @@ struct MafBlockEntry
    ~MafBlockEntry();
    
    std::vector<MafBlockString*>& _buffers;
+   // only set when the entry is given a new sequence (_dnaSequence)
    std::string _name;
    hal_index_t _start;
    hal_index_t _length;
    char _strand;
    short _lastUsed;
    hal_index_t _srcLength;
+   // bases are only marked in here as the columns are appended.  the
+   // actual dna is read in one go when the block is written.
    MafBlockString* _sequence;
+   const Sequence* _dnaSequence;
    // add this because _sequence is no longer assumed to 
    // be unique
    const Genome* _genome;
@@ -67,10 +74,18 @@ public:
    void appendColumn(ColumnIteratorConstPtr col);
    bool canAppendColumn(hal::ColumnIteratorConstPtr col);
    void setMaxLength(hal_index_t maxLen);
+   hal_index_t getMaxLength() const;
+
+   /** Get the name, start and length of the row that will be printed
+    * first.  Returns false if there isn't one. */
+   bool getReferenceRow(std::string& name, hal_index_t& start,
+                        hal_index_t& length) const;
    
 protected:
    
    void resetEntries();
+   void clearEntries();
+   MafBlockEntry* newEntry();
    void initEntry(MafBlockEntry* entry, const Sequence* sequence,
                   DNAIteratorConstPtr dna, bool clearSequence = true);
    void updateEntry(MafBlockEntry* entry, const Sequence* sequence,
@@ -80,16 +95,45 @@ protected:
    void buildTreeR(BottomSegmentIteratorConstPtr botIt, stTree *tree, bool modifyEntries);
    stTree *getTreeNode(SegmentIteratorConstPtr segIt, bool modifyEntries);
 
+   void fillEntry(MafBlockEntry* entry) const;
+   size_t getGenomeRank(const Genome* genome) const;
+   void getRows(std::vector<MafBlockEntry*>& rows) const;
    std::ostream& printBlock(std::ostream& os) const;
    std::ostream& printBlockWithTree(std::ostream& os) const;
 
-   typedef std::multimap<const Sequence*, MafBlockEntry*, 
-                         ColumnIterator::SequenceLess> Entries;
+   // the entries are kept sorted by sequence (in the same order as the
+   // column map), with the entries of a sequence that appears more than
+   // once in a block in the order they were added.  entries that go
+   // unused are kept in _entryPool for reuse.
+   typedef std::pair<const Sequence*, MafBlockEntry*> Entry;
+   typedef std::vector<Entry> Entries;
+   struct EntryLess
+   {
+      bool operator()(const Entry& e, const Sequence* s) const {
+        return ColumnIterator::SequenceLess()(e.first, s); }
+      bool operator()(const Sequence* s, const Entry& e) const {
+        return ColumnIterator::SequenceLess()(s, e.first); }
+   };
+   // rows are written with the reference first, and then the genomes in
+   // breadth-first order of the tree, and the rows of each genome by
+   // sequence name and start.  (unlike _entries, this doesn't depend on
+   // where the genomes are in memory, so it's the same for every thread)
+   struct RowLess
+   {
+      RowLess(const MafBlock* block) : _block(block) {}
+      bool operator()(const MafBlockEntry* e1,
+                      const MafBlockEntry* e2) const;
+      const MafBlock* _block;
+   };
    Entries _entries;
    Entries::const_iterator _reference;
+   mutable std::vector<MafBlockEntry*> _rows;
+   mutable std::map<const Genome*, size_t> _genomeRanks;
+   std::vector<MafBlockEntry*> _entryPool;
    std::vector<MafBlockString*> _stringBuffers;
    hal_index_t _maxLength;
    hal_index_t _refIndex;
+   hal_index_t _numColumns;
    bool _fullNames;
    bool _printTree;
    stTree *_tree;
@@ -99,6 +143,7 @@ protected:
    friend std::ostream& operator<<(std::ostream& os, 
                                    const hal::MafBlock& mafBlock);
    friend std::istream& operator>>(std::istream& is, hal::MafBlock& mafBlock);
+   friend class MafBinaryWriter;
 };
 
 std::ostream& operator<<(std::ostream& os, 
@@ -135,6 +180,18 @@ inline void MafBlockString::append(char c)
   _buf[_len++] = c;
 }
 
+inline void MafBlockString::append(char c, size_t count)
+{
+  assert(_cap >= _len);
+  if (_len + count > _cap)
+  {
+    _cap = std::max((_cap + 1) * 2 - 1, _len + count);
+    _buf = (char*)realloc(_buf, _cap + 1); 
+  }
+  memset(_buf + _len, c, count);
+  _len += count;
+}
+
 inline void MafBlockString::clear()
 {
   if (_cap > 0)
@@ -151,7 +208,7 @@ inline char* MafBlockString::str()
 }
 
 inline MafBlockEntry::MafBlockEntry(std::vector<MafBlockString*>& buffers) : 
-  _buffers(buffers), _lastUsed(0), _genome(NULL)
+  _buffers(buffers), _lastUsed(0), _dnaSequence(NULL), _genome(NULL)
 {
   if (_buffers.empty() == false) 
   {
@@ -187,6 +244,11 @@ inline void MafBlock::setMaxLength(hal_index_t maxLen)
   _maxLength = maxLen;
 }
 
+inline hal_index_t MafBlock::getMaxLength() const
+{
+  return _maxLength;
+}
+
 }
 
 
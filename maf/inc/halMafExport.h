@@ -12,9 +12,12 @@
 #include <set>
 #include <vector>
 #include "halMafBlock.h"
+#include "halMafIndex.h"
 
 namespace hal {
 
+class MafBinaryWriter;
+
 class MafExport
 {
 public:
@@ -23,6 +26,9 @@ public:
 
    virtual ~MafExport();
 
+   /** Inclusive range of genome (not sequence) coordinates */
+   typedef std::pair<hal_index_t, hal_index_t> Range;
+
    void convertSegmentedSequence(std::ostream& mafStream,
                                  AlignmentConstPtr alignment,
                                  const SegmentedSequence* seq,
@@ -30,10 +36,24 @@ public:
                                  hal_size_t length,
                                  const std::set<const Genome*>& targets);
 
+   /** Convert a list of ranges of the reference genome, in the order
+    * given, with one column iterator that is moved from range to range
+    * with toSite() instead of being recreated for each.  The output is
+    * the same as convertSegmentedSequence() on each range in turn.
+    * With setNumThreads(), consecutive ranges are grouped into chunks
+    * (broken between sequences) that are converted in parallel */
+   void convertRanges(std::ostream& mafStream,
+                      AlignmentConstPtr alignment,
+                      const Genome* genome,
+                      const std::vector<Range>& ranges,
+                      const std::set<const Genome*>& targets);
+
    // Convert all columns in the leaf genomes to MAF. Each column is
    // reported exactly once regardless of the unique setting, although
    // this may change in the future. Likewise, maxRefGap has no
-   // effect, although noDupes will work.
+   // effect, although noDupes will work.  The visited positions of
+   // each genome are kept as intervals, or as a bitmap (one bit per
+   // base) when that is smaller.
    void convertEntireAlignment(std::ostream& mafStream,
                                AlignmentConstPtr alignment);
 
@@ -47,9 +67,54 @@ public:
    void setPrintTree(bool printTree);
    void setOnlyOrthologs(bool onlyOrthologs);
 
+   /** Split convertSegmentedSequence() into chunks of the reference
+    * that are converted by numThreads threads, each with its own
+    * (read-only) copy of the alignment, opened from halPath.  The blocks
+    * are written in reference order, and are the same as with one thread
+    * except that they are broken at chunk boundaries.  convertRanges()
+    * is split the same way, between ranges. */
+   void setNumThreads(hal_size_t numThreads, const std::string& halPath,
+                      CLParserConstPtr options);
+
+   /** Add every block that is written to an index (which must outlive
+    * the conversion).  Offsets are taken from tellp() of the output
+    * stream, so it must support it. */
+   void setIndex(MafIndex* index);
+
+   /** Make convertEntireAlignment() throw if the sets of visited
+    * positions grow beyond maxMemory bytes (0 for no limit) */
+   void setGlobalMaxMemory(hal_size_t maxMemory);
+
+   /** Make convertEntireAlignment() report each genome it finishes,
+    * along with the memory used by the visited positions, to stderr */
+   void setProgress(bool progress);
+
+   /** Write the blocks to a binary writer (already opened, and closed
+    * by the caller when done) instead of as MAF text.  The MAF stream
+    * is then ignored, and so is the index.  Can't be used with
+    * setNumThreads() */
+   void setBinaryWriter(MafBinaryWriter* writer);
+
+   static const hal_size_t ThreadChunkLength;
+
 protected:
 
    void writeHeader();
+   void writeBlock(bool flush = false);
+   void indexBlock();
+   void convertColumns(ColumnIteratorConstPtr colIt);
+   bool isOwnColumn(ColumnIteratorConstPtr colIt) const;
+   hal_size_t checkVisitCache(const ColumnIterator::VisitCache* visitCache)
+     const;
+   void convertParallel(std::ostream& mafStream,
+                        const Genome* genome,
+                        const std::vector<std::vector<Range> >& chunks,
+                        const std::set<const Genome*>& targets,
+                        bool splitRange);
+
+   struct ThreadState;
+   static void convertChunks(AlignmentConstPtr alignment,
+                             ThreadState& state);
 
 protected:
 
@@ -64,6 +129,17 @@ protected:
    bool _append;
    bool _printTree;
    bool _onlyOrthologs;
+   hal_size_t _numThreads;
+   std::string _halPath;
+   CLParserConstPtr _options;
+   MafIndex* _index;
+   hal_size_t _globalMaxMemory;
+   bool _progress;
+   MafBinaryWriter* _binaryWriter;
+   // columns with a reference base in this range were written by an
+   // earlier chunk (see convertParallel())
+   hal_index_t _skipFirst;
+   hal_index_t _skipLast;
 };
 
 }
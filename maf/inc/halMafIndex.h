@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALMAFINDEX_H
+#define _HALMAFINDEX_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "hal.h"
+
+namespace hal {
+
+class BgzfWriteBuf;
+
+/** Index of the reference rows of the blocks in a MAF.  Consecutive
+ * blocks on the same reference sequence, in order, are grouped into
+ * chunks of about ChunkSize bytes of MAF.  Each chunk records the
+ * reference range it covers and the offset of its first block (a virtual
+ * offset if the MAF is BGZF compressed).  To find the blocks overlapping
+ * a range, read each overlapping chunk from its offset until a block
+ * starts past the range (or the chunk ends).
+ *
+ * The text format is a header line followed by one line per chunk:
+ * sequence (as named in the MAF), start, end, offset. */
+class MafIndex
+{
+public:
+
+   struct Chunk
+   {
+      std::string _sequence;
+      hal_index_t _start;
+      hal_index_t _end;
+      uint64_t _offset;
+      bool operator<(const Chunk& other) const;
+   };
+
+   MafIndex();
+   virtual ~MafIndex();
+
+   void clear();
+
+   /** Add a block, whose reference row is sequence:[start, start+length),
+    * beginning at the given (uncompressed) offset in the MAF. */
+   void addBlock(const std::string& sequence, hal_index_t start,
+                 hal_size_t length, uint64_t offset);
+
+   /** Add all the chunks of another index for a MAF that was written at
+    * the given offset of this one */
+   void addIndex(const MafIndex& other, uint64_t offset);
+
+   /** Write the index.  If the MAF was compressed, its buffer is needed
+    * to convert offsets to virtual offsets */
+   void write(std::ostream& os, const BgzfWriteBuf* bgzf = NULL) const;
+   void read(std::istream& is);
+
+   /** True if the offsets are BGZF virtual offsets */
+   bool isCompressed() const;
+
+   /** Get the chunks overlapping sequence:[start, end) */
+   void getChunks(const std::string& sequence, hal_index_t start,
+                  hal_index_t end, std::vector<Chunk>& chunks) const;
+
+   static const uint64_t ChunkSize;
+
+protected:
+
+   std::vector<Chunk> _chunks;
+   bool _compressed;
+};
+
+}
+
+#endif
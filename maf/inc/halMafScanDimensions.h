@@ -32,7 +32,8 @@ public:
    };
    typedef std::map<hal_size_t, ArrayInfo> StartMap;
 
-   typedef std::pair<std::streampos, size_t> FilePosition;
+   // position of the block (see MafScanner::getFilePosition) and row
+   typedef std::pair<hal_size_t, size_t> FilePosition;
    typedef std::set<FilePosition> PosSet;
 
    struct Record 
@@ -62,6 +63,8 @@ protected:
 protected:
       
    DimMap _dimMap;
+   // _dimMap entries by name id
+   std::vector<Record*> _records;
 };
 
 }
@@ -13,13 +13,55 @@
 #include <cstdlib>
 #include <vector>
 #include <string>
+#include <map>
 #include "hal.h"
+#include "halBedTokenizer.h"
 
 namespace hal {
 
+/** The sequence names found in a MAF.  Each distinct name is stored once,
+ * already split into its genome and sequence names, and given a small id
+ * that scanners can use to cache whatever they look up by name.  A table
+ * can be shared between several passes over the same MAF. */
+class MafNameTable
+{
+public:
+   struct Name
+   {
+      size_t _id;
+      std::string _fullName;
+      // both empty if the name isn't in genomeName.sequenceName format
+      std::string _genomeName;
+      std::string _sequenceName;
+   };
+
+   MafNameTable();
+   virtual ~MafNameTable();
+
+   const Name* getName(const char* fullName, size_t length);
+   /** NULL if there is no name with the id */
+   const Name* getName(size_t id) const;
+   size_t getNumNames() const;
+   void clear();
+
+protected:
+
+   typedef std::map<std::string, Name*> NameMap;
+   NameMap _nameMap;
+   std::vector<Name*> _names;
+   std::string _key;
+
+private:
+   MafNameTable(const MafNameTable&);
+   MafNameTable& operator=(const MafNameTable&);
+};
+
 /** Parse a MAF file line by line 
  * written independently from the maf export, and it's too much of a 
- * bother to reuse any of that code. */
+ * bother to reuse any of that code. 
+ * Lines are split in place (with a BedTokenizer) rather than read with
+ * the stream operators, and sequence names are interned in a name table,
+ * which can be shared with other scanners (see setNameTable). */
 class MafScanner
 {
 public:
@@ -27,12 +69,28 @@ public:
    virtual ~MafScanner();
    virtual void scan(const std::string& mafPath, 
                      const std::set<std::string>& targetSet);
+
+   /** Scan the blocks saved in a spill file (see setSpillStream), exactly
+    * as the MAF they came from was scanned, but without parsing it.  The
+    * names are stored by id, so the scanner must use the same name table
+    * as the one that wrote the file. */
+   virtual void scanSpill(std::istream& spillStream);
+
+   /** While scanning, write the rows that are kept (after filtering the 
+    * targets) to a binary spill file that can be read by scanSpill */
+   void setSpillStream(std::ostream* spillStream);
    hal_size_t getNumBlocks() const { return _numBlocks; }
    static std::string genomeName(const std::string& fullName);
    static std::string sequenceName(const std::string& fullName);
 
+   /** Use (and add to) the given names instead of the scanner's own */
+   void setNameTable(MafNameTable* names);
+   MafNameTable* getNameTable();
+
+   typedef MafNameTable::Name Name;
+
    struct Row {
-      std::string _sequenceName;
+      const Name* _name;
       hal_size_t _startPosition;
       hal_size_t _length;
       char _strand;
@@ -40,22 +98,41 @@ public:
       std::string _line;
    };
    typedef std::vector<Row> Block;
-   typedef std::vector<bool> Mask;
+   typedef std::vector<char> Mask;
 
 protected:
    virtual void aLine() = 0;
    virtual void sLine() = 0;
    virtual void end() = 0;
-   void nextLine();
+   void readRow(size_t numFields);
+   void spillRow(const Row& row);
+   void spillMarker(char type);
+   bool isTarget(const Name* name);
    void updateMask();
+   void stopScan();
 
+   /** Position of the line being scanned.  When aLine() is called, this
+    * is the start of the next block; when end() is, the end of the file */
+   hal_size_t getFilePosition() const;
 
    std::ifstream _mafFile;
+   BedTokenizer _tokenizer;
    std::set<std::string> _targets;
+   MafNameTable _ownNames;
+   MafNameTable* _names;
+   // for each name id, 0 if not yet looked up, 1 if in targets, 2 if not
+   std::vector<char> _targetCache;
+   bool _stop;
+   std::ostream* _spillStream;
+   // position of the line being scanned when reading a spill file
+   bool _spilled;
+   hal_size_t _spillPosition;
    
    Block _block;
    size_t _rows;
    Mask _mask;
+   // the columns (> 0) set in _mask, in order
+   std::vector<size_t> _cuts;
    hal_size_t _numBlocks;
 };
 
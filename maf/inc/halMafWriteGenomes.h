@@ -36,11 +36,16 @@ public:
    typedef MafScanDimensions::PosSet PosSet;
    typedef std::pair<DimMap::const_iterator, DimMap::const_iterator> MapRange;
 
+   /** If spillStream is given, the blocks are read from it (see
+    * MafScanner::setSpillStream) instead of from the MAF */
    void convert(const std::string& mafPath,
                 const std::string& refGenomeName,
                 const std::set<std::string>& targets,
                 const DimMap& dimMap,
-                AlignmentPtr alignment);
+                AlignmentPtr alignment,
+                std::istream* spillStream = NULL);
+
+   using MafScanner::setNameTable;
                          
 private:
    
@@ -81,11 +86,20 @@ private:
       size_t _row;
       bool operator<(const Paralogy& p) const { return _start < p._start; }
    };
+   // what we look up for each sequence name, cached by name id
+   struct NameInfo
+   {
+      const Record* _record;
+      Genome* _genome;
+      Sequence* _sequence;
+   };
+
    typedef std::set<Paralogy> ParaSet;
    typedef std::map<Genome*, ParaSet> ParaMap;
 
 private:
 
+   const NameInfo& getNameInfo(const Name* name);
    ParaSet::iterator circularNext(size_t row, ParaSet& paraSet, 
                                   ParaSet::iterator i);
    ParaSet::iterator circularPrev(size_t row, ParaSet& paraSet,
@@ -103,6 +117,7 @@ private:
    BottomSegmentIteratorPtr _bottomSegment, _refBottom;
    std::map<Genome*, hal_size_t> _childIdxMap;
    ParaMap _paraMap;
+   std::vector<NameInfo> _nameInfo;
 };
 
 }
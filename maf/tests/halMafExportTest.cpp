@@ -4,14 +4,397 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
+#include <sstream>
+#include <deque>
+#include <cstring>
+#include <algorithm>
 #include "halMafTests.h"
 #include "halMafExport.h"
+#include "halMafIndex.h"
+#include "halMafBinaryWriter.h"
+#include "halBgzf.h"
+#include "halRandomData.h"
 
 using namespace std;
 using namespace hal;
 
+// write fake blocks through the compressor, indexing each one, and
+// check that every block can be found again through the index
+static void halMafBgzfIndexTest(CuTest *testCase)
+{
+  try
+  {
+    stringstream compressed;
+    BgzfWriteBuf writeBuf;
+    writeBuf.open(&compressed, 3);
+    ostream mafStream(&writeBuf);
+    MafIndex index;
+    string text;
+    hal_index_t numBlocks = 20000;
+    for (hal_index_t i = 0; i < numBlocks; ++i)
+    {
+      string seqName = i < numBlocks / 2 ? "a.chr1" : "a.chr2";
+      hal_index_t start = (i % (numBlocks / 2)) * 10;
+      index.addBlock(seqName, start, 10, (uint64_t)mafStream.tellp());
+      stringstream block;
+      block << "a\ns\t" << seqName << '\t' << start << "\t10\t+\t100000\t"
+            << "ACGTACGTAC\n\n";
+      mafStream << block.str();
+      text += block.str();
+    }
+    CuAssertTrue(testCase, (size_t)mafStream.tellp() == text.length());
+    writeBuf.close();
+    CuAssertTrue(testCase, compressed.str().length() < text.length());
+
+    stringstream indexText;
+    index.write(indexText, &writeBuf);
+    MafIndex readIndex;
+    readIndex.read(indexText);
+    CuAssertTrue(testCase, readIndex.isCompressed() == true);
+
+    compressed.seekg(0);
+    BgzfReadBuf readBuf;
+    readBuf.open(&compressed);
+    istream readStream(&readBuf);
+    stringstream uncompressed;
+    uncompressed << readStream.rdbuf();
+    CuAssertTrue(testCase, uncompressed.str() == text);
+
+    vector<MafIndex::Chunk> chunks;
+    readIndex.getChunks("a.chr2", 50005, 50006, chunks);
+    CuAssertTrue(testCase, chunks.size() == 1);
+    CuAssertTrue(testCase, chunks[0]._start <= 50000 &&
+                 chunks[0]._end > 50000);
+    readBuf.seekVirtual(chunks[0]._offset);
+    readStream.clear();
+    string line, name;
+    hal_index_t start = NULL_INDEX;
+    while (getline(readStream, line) && start < 50000)
+    {
+      if (line.length() > 0 && line[0] == 's')
+      {
+        stringstream ss(line.substr(1));
+        ss >> name >> start;
+        CuAssertTrue(testCase, name == "a.chr2");
+        CuAssertTrue(testCase, start >= chunks[0]._start);
+      }
+    }
+    CuAssertTrue(testCase, start == 50000);
+
+    readIndex.getChunks("a.chr1", 0, 100000, chunks);
+    CuAssertTrue(testCase, chunks.size() > 1);
+    readIndex.getChunks("a.chr3", 0, 100000, chunks);
+    CuAssertTrue(testCase, chunks.empty());
+  }
+  catch(exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+}
+
+// converting a list of ranges with one iterator has to give the same
+// blocks as converting each range on its own
+struct MafExportRangesTest : public AlignmentTest
+{
+   void createCallBack(AlignmentPtr alignment)
+   {
+     createRandomAlignment(alignment, 2, 0.1, 6, 10, 1000, 5, 10, 1101);
+   }
+   void checkCallBack(AlignmentConstPtr alignment)
+   {
+     const Genome* genome = alignment->openGenome(alignment->getRootName());
+     hal_index_t length = genome->getSequenceLength();
+     vector<MafExport::Range> ranges;
+     for (hal_index_t i = 0; i < 100; ++i)
+     {
+       hal_index_t start = (i * 7919) % length;
+       hal_index_t last = min(length - 1, start + i % 40);
+       ranges.push_back(MafExport::Range(start, last));
+     }
+     sort(ranges.begin(), ranges.end());
+     set<const Genome*> targets;
+     
+     MafExport mafExport;
+     mafExport.setNoDupes(false);
+     mafExport.setNoAncestors(false);
+     mafExport.setUcscNames(true);
+     mafExport.setUnique(false);
+     mafExport.setAppend(false);
+     mafExport.setOnlyOrthologs(false);
+     stringstream expected;
+     for (size_t i = 0; i < ranges.size(); ++i)
+     {
+       const Sequence* sequence = genome->getSequenceBySite(ranges[i].first);
+       hal_index_t start = ranges[i].first - sequence->getStartPosition();
+       hal_index_t last = min(ranges[i].second, sequence->getEndPosition());
+       ranges[i].second = last;
+       mafExport.convertSegmentedSequence(expected, alignment, sequence, 
+                                          start, last - ranges[i].first + 1,
+                                          targets);
+     }
+     stringstream batched;
+     mafExport.convertRanges(batched, alignment, genome, ranges, targets);
+     CuAssertTrue(_testCase, expected.str().empty() == false);
+     CuAssertTrue(_testCase, batched.str() == expected.str());
+   }
+};
+
+static void halMafExportRangesTest(CuTest *testCase)
+{
+  try
+  {
+    MafExportRangesTest tester;
+    tester.check(testCase);
+  }
+  catch (exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+}
+
+// export the same blocks as MAF and in binary, and check that the MAF
+// can be rebuilt from what the reader gets out of the binary
+struct MafExportBinaryTest : public AlignmentTest
+{
+   void createCallBack(AlignmentPtr alignment)
+   {
+     createRandomAlignment(alignment, 2, 0.1, 6, 10, 1000, 5, 10, 1103);
+   }
+   void checkCallBack(AlignmentConstPtr alignment)
+   {
+     const Genome* genome = alignment->openGenome(alignment->getRootName());
+     set<const Genome*> targets;
+     MafExport mafExport;
+     mafExport.setNoDupes(false);
+     mafExport.setNoAncestors(false);
+     mafExport.setUcscNames(true);
+     mafExport.setUnique(false);
+     mafExport.setAppend(false);
+     mafExport.setOnlyOrthologs(false);
+     stringstream maf;
+     mafExport.convertSegmentedSequence(maf, alignment, genome, 0, 0,
+                                        targets);
+
+     stringstream binary;
+     MafBinaryWriter writer;
+     writer.open(&binary);
+     mafExport.setBinaryWriter(&writer);
+     stringstream ignored;
+     mafExport.convertSegmentedSequence(ignored, alignment, genome, 0, 0,
+                                        targets);
+     writer.close();
+     CuAssertTrue(_testCase, ignored.str().empty() == true);
+     CuAssertTrue(_testCase, writer.getNumBlocks() > 0);
+
+     // the reader wants 8-byte aligned data
+     string data = binary.str();
+     vector<uint64_t> aligned((data.length() + 7) / 8);
+     memcpy(&aligned[0], data.data(), data.length());
+     MafBinaryReader reader;
+     reader.open((const char*)&aligned[0], data.length());
+     CuAssertTrue(_testCase, reader.getNumBlocks() == writer.getNumBlocks());
+     
+     stringstream rebuilt;
+     rebuilt << "##maf version=1 scoring=N/A\n"
+             << "# hal " << alignment->getNewickTree() << "\n\n";
+     string dna;
+     for (hal_size_t i = 0; i < reader.getNumBlocks(); ++i)
+     {
+       MafBinaryBlock block = reader.getBlock(i);
+       rebuilt << "a\n";
+       for (uint32_t j = 0; j < block._numRows; ++j)
+       {
+         block.getRow(j, dna);
+         CuAssertTrue(_testCase, block.getBase(j, block._numColumns - 1) ==
+                      dna[dna.length() - 1]);
+         hal_size_t seq = block._sequences[j];
+         rebuilt << "s\t" << reader.getSequenceName(seq) << '\t' 
+                 << block._starts[j] << '\t' << block._lengths[j] << '\t'
+                 << block._strands[j] << '\t' 
+                 << reader.getSequenceLength(seq) << '\t' << dna << '\n';
+       }
+       rebuilt << '\n';
+     }
+     CuAssertTrue(_testCase, rebuilt.str() == maf.str());
+   }
+};
+
+static void halMafExportBinaryTest(CuTest *testCase)
+{
+  try
+  {
+    MafExportBinaryTest tester;
+    tester.check(testCase);
+  }
+  catch (exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+}
+
+// the columns of a MAF, each as its sorted list of bases (with their
+// sequences and positions), in the order they appear in.  blocks that are
+// only split in two give the same columns.
+static void getMafColumns(const string& maf, vector<string>& columns)
+{
+  stringstream mafStream(maf);
+  string line;
+  vector<vector<string> > rows;
+  while (true)
+  {
+    bool more = !getline(mafStream, line).fail();
+    if (more == true && line.length() > 1 && line[0] == 's')
+    {
+      stringstream lineStream(line);
+      rows.push_back(vector<string>(7));
+      for (size_t i = 0; i < 7; ++i)
+      {
+        lineStream >> rows.back()[i];
+      }
+      continue;
+    }
+    if (rows.empty() == false)
+    {
+      vector<hal_index_t> positions(rows.size());
+      for (size_t i = 0; i < rows.size(); ++i)
+      {
+        positions[i] = atol(rows[i][2].c_str());
+      }
+      for (size_t j = 0; j < rows[0][6].length(); ++j)
+      {
+        vector<string> bases;
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+          char base = rows[i][6][j];
+          if (base != '-')
+          {
+            stringstream baseStream;
+            baseStream << rows[i][1] << rows[i][4] << positions[i]++
+                       << base;
+            bases.push_back(baseStream.str());
+          }
+        }
+        sort(bases.begin(), bases.end());
+        string column;
+        for (size_t i = 0; i < bases.size(); ++i)
+        {
+          column += bases[i] + " ";
+        }
+        columns.push_back(column);
+      }
+      rows.clear();
+    }
+    if (more == false)
+    {
+      break;
+    }
+  }
+}
+
+// converting the reference with several threads has to give the same
+// columns as with one, and its blocks the same rows in the same order
+// (blocks are only broken at chunk boundaries)
+struct MafExportThreadsTest : public AlignmentTest
+{
+   void createCallBack(AlignmentPtr alignment)
+   {
+     createRandomAlignment(alignment, 2, 0.1, 6, 10, 1000, 5, 10, 1105);
+   }
+   void checkCallBack(AlignmentConstPtr alignment)
+   {
+     if (alignment->isThreadSafe() == false)
+     {
+       return;
+     }
+     // the longest genome has the most blocks (and duplications)
+     const Genome* genome = NULL;
+     deque<string> queue(1, alignment->getRootName());
+     while (queue.empty() == false)
+     {
+       const Genome* next = alignment->openGenome(queue.front());
+       if (genome == NULL ||
+           next->getSequenceLength() > genome->getSequenceLength())
+       {
+         genome = next;
+       }
+       vector<string> childNames = alignment->getChildNames(queue.front());
+       queue.insert(queue.end(), childNames.begin(), childNames.end());
+       queue.pop_front();
+     }
+     set<const Genome*> targets;
+     for (size_t unique = 0; unique < 2; ++unique)
+     {
+       MafExport mafExport;
+       mafExport.setNoDupes(false);
+       mafExport.setNoAncestors(false);
+       mafExport.setUcscNames(true);
+       mafExport.setUnique(unique == 1);
+       mafExport.setAppend(false);
+       mafExport.setOnlyOrthologs(false);
+       // columns reaching outside the range are only written without
+       // unique
+       hal_index_t start = genome->getSequenceLength() / 4;
+       hal_size_t length = genome->getSequenceLength() / 2;
+       stringstream serial;
+       mafExport.convertSegmentedSequence(serial, alignment, genome, start,
+                                          length, targets);
+       mafExport.setNumThreads(4, _checkPath, CLParserConstPtr());
+       stringstream parallel;
+       mafExport.convertSegmentedSequence(parallel, alignment, genome, start,
+                                          length, targets);
+       vector<string> serialColumns;
+       getMafColumns(serial.str(), serialColumns);
+       vector<string> parallelColumns;
+       getMafColumns(parallel.str(), parallelColumns);
+       CuAssertTrue(_testCase, serialColumns.empty() == false);
+       CuAssertTrue(_testCase, parallelColumns == serialColumns);
+
+       // the blocks that don't straddle a chunk boundary are written
+       // exactly the same
+       set<string> parallelBlocks;
+       string text = parallel.str();
+       for (size_t i = 0, j; (j = text.find("\n\n", i)) != string::npos;
+            i = j + 2)
+       {
+         parallelBlocks.insert(text.substr(i, j - i));
+       }
+       size_t numBlocks = 0;
+       size_t numFound = 0;
+       text = serial.str();
+       for (size_t i = 0, j; (j = text.find("\n\n", i)) != string::npos;
+            i = j + 2)
+       {
+         ++numBlocks;
+         numFound += parallelBlocks.count(text.substr(i, j - i));
+       }
+       CuAssertTrue(_testCase, numFound + 3 >= numBlocks);
+     }
+   }
+};
+
+static void halMafExportThreadsTest(CuTest *testCase)
+{
+  try
+  {
+    MafExportThreadsTest tester;
+    tester.check(testCase);
+  }
+  catch (exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+}
+
 CuSuite *halMafExportTestSuite(void)
 {
   CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halMafBgzfIndexTest);
+  SUITE_ADD_TEST(suite, halMafExportRangesTest);
+  SUITE_ADD_TEST(suite, halMafExportBinaryTest);
+  SUITE_ADD_TEST(suite, halMafExportThreadsTest);
   return suite;
 }
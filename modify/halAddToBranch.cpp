@@ -104,6 +104,17 @@ int main(int argc, char *argv[])
   if (!noMarkAncestors) {
     markAncestorsForUpdate(mainAlignment, insertName);
   }
+
+  // Log the changes so that files derived from the alignment (like
+  // levels of detail) can be updated without starting from scratch.
+  vector<string> sequenceChanged;
+  sequenceChanged.push_back(insertName);
+  sequenceChanged.push_back(leafName);
+  vector<string> bottomChanged;
+  bottomChanged.push_back(parentName);
+  bottomChanged.push_back(insertName);
+  logGenomeChanges(mainAlignment, sequenceChanged, bottomChanged);
+
   mainAlignment->close();
   botAlignment->close();
   topAlignment->close();
@@ -26,7 +26,7 @@ static CLParserPtr initParser()
 }
 
 void addSubtree(AlignmentPtr mainAlignment, AlignmentConstPtr appendAlignment, 
-                string currNode)
+                string currNode, vector<string>& appended)
 {
   Genome *outGenome = mainAlignment->openGenome(currNode);
   const Genome *inGenome = appendAlignment->openGenome(currNode);
@@ -40,7 +40,8 @@ void addSubtree(AlignmentPtr mainAlignment, AlignmentConstPtr appendAlignment,
     Genome *mainChildGenome = mainAlignment->addLeafGenome(children[i], currNode, appendAlignment->getBranchLength(currNode, children[i]));
     const Genome *appendChildGenome = appendAlignment->openGenome(children[i]);
     appendChildGenome->copy(mainChildGenome);
-    addSubtree(mainAlignment, appendAlignment, children[i]);
+    appended.push_back(children[i]);
+    addSubtree(mainAlignment, appendAlignment, children[i], appended);
   }
   inGenome->copyBottomDimensions(outGenome);
   inGenome->copyBottomSegments(outGenome);
@@ -71,6 +72,7 @@ int main(int argc, char *argv[])
   AlignmentPtr mainAlignment = openHalAlignment(mainPath, optParser);
   AlignmentConstPtr appendAlignment = openHalAlignment(appendPath, optParser);
   AlignmentConstPtr bridgeAlignment;
+  vector<string> appended;
 
   if (!merge) {
     if (bridgePath == "") {
@@ -82,6 +84,7 @@ int main(int argc, char *argv[])
                                                             branchLength);
     const Genome *appendAppendedRoot = appendAlignment->openGenome(rootName);
     appendAppendedRoot->copy(mainAppendedRoot);
+    appended.push_back(rootName);
   } else {
     // the bridge alignment is equivalent to the append alignment in this case
     // (the append alignment will contain at least all the information that
@@ -93,7 +96,7 @@ int main(int argc, char *argv[])
     }
     assert(branchLength == 0.0);
   }
-  addSubtree(mainAlignment, appendAlignment, rootName);
+  addSubtree(mainAlignment, appendAlignment, rootName, appended);
 
   // Need proper bottom segments for parent genome
   Genome *mainParentGenome = mainAlignment->openGenome(parentName);
@@ -115,6 +118,13 @@ int main(int argc, char *argv[])
   if (!noMarkAncestors) {
     markAncestorsForUpdate(mainAlignment, rootName);
   }
+
+  // Log the changes so that files derived from the alignment (like
+  // levels of detail) can be updated without starting from scratch.
+  vector<string> bottomChanged = appended;
+  bottomChanged.push_back(parentName);
+  logGenomeChanges(mainAlignment, appended, bottomChanged);
+
   mainAlignment->close();
   appendAlignment->close();
   if (!merge) {
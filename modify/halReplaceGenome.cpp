@@ -140,6 +140,19 @@ int main(int argc, char *argv[])
   if (!noMarkAncestors) {
     markAncestorsForUpdate(mainAlignment, genomeName);
   }
+
+  // Log the changes so that files derived from the alignment (like
+  // levels of detail) can be updated without starting from scratch.
+  vector<string> bottomChanged;
+  if (useBottomAlignment) {
+    bottomChanged.push_back(genomeName);
+  }
+  if (useTopAlignment) {
+    bottomChanged.push_back(mainAlignment->getParentName(genomeName));
+  }
+  logGenomeChanges(mainAlignment, vector<string>(1, genomeName),
+                   bottomChanged);
+
   if (useTopAlignment) {
     topAlignment->close();
   }
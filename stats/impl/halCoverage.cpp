@@ -0,0 +1,374 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <set>
+#include <map>
+#include <algorithm>
+#include <cassert>
+#include "halCoverage.h"
+
+using namespace std;
+using namespace hal;
+
+static const hal_size_t CoverageBatchSegments = 65536;
+
+// a count for every position of a genome, as runs of equal counts.  run
+// i starts at _starts[i] and ends where the next one starts (or at
+// _length)
+struct CoverageRuns
+{
+   vector<hal_index_t> _starts;
+   vector<hal_size_t> _values;
+   hal_size_t _length;
+};
+
+// a change in the number of target sites, at a position of a parent
+typedef pair<hal_index_t, hal_index_t> CoverageEvent;
+
+static void initRuns(CoverageRuns& runs, hal_size_t length)
+{
+  runs._starts.clear();
+  runs._values.clear();
+  runs._length = length;
+}
+
+// runs must be appended in order.  one starting where the last did
+// replaces it
+static void appendRun(CoverageRuns& runs, hal_index_t start, 
+                      hal_size_t value)
+{
+  if (start >= (hal_index_t)runs._length)
+  {
+    return;
+  }
+  if (runs._starts.empty() == false && runs._starts.back() == start)
+  {
+    runs._starts.pop_back();
+    runs._values.pop_back();
+  }
+  if (runs._values.empty() == true || runs._values.back() != value)
+  {
+    runs._starts.push_back(start);
+    runs._values.push_back(value);
+  }
+}
+
+static hal_index_t getRunEnd(const CoverageRuns& runs, size_t i)
+{
+  return i + 1 < runs._starts.size() ? runs._starts[i + 1] : 
+     (hal_index_t)runs._length;
+}
+
+static size_t getRunAt(const CoverageRuns& runs, hal_index_t pos)
+{
+  assert(runs._starts.empty() == false && runs._starts[0] == 0);
+  return upper_bound(runs._starts.begin(), runs._starts.end(), pos) - 
+     runs._starts.begin() - 1;
+}
+
+// append src over [srcStart, srcStart + length) to dest at destStart,
+// back to front if reversed
+static void copyRuns(const CoverageRuns& src, hal_index_t srcStart,
+                     hal_size_t length, bool reversed, CoverageRuns& dest,
+                     hal_index_t destStart)
+{
+  if (length == 0)
+  {
+    return;
+  }
+  hal_index_t srcEnd = srcStart + (hal_index_t)length;
+  if (reversed == false)
+  {
+    for (size_t i = getRunAt(src, srcStart); 
+         i < src._starts.size() && src._starts[i] < srcEnd; ++i)
+    {
+      hal_index_t start = max(src._starts[i], srcStart);
+      appendRun(dest, destStart + start - srcStart, src._values[i]);
+    }
+  }
+  else
+  {
+    for (size_t i = getRunAt(src, srcEnd - 1); ; --i)
+    {
+      hal_index_t end = min(getRunEnd(src, i), srcEnd);
+      appendRun(dest, destStart + srcEnd - end, src._values[i]);
+      if (src._starts[i] <= srcStart)
+      {
+        break;
+      }
+    }
+  }
+}
+
+static void readBottomStarts(const Genome* genome, 
+                             vector<hal_index_t>& bottomStarts)
+{
+  hal_size_t numBottom = genome->getNumBottomSegments();
+  bottomStarts.clear();
+  bottomStarts.reserve(numBottom);
+  vector<BottomSegmentRecord> records;
+  vector<hal_index_t> childIndexes;
+  vector<bool> childReversed;
+  for (hal_size_t start = 0; start < numBottom; 
+       start += CoverageBatchSegments)
+  {
+    genome->readBottomSegments(start, 
+                               min(CoverageBatchSegments, numBottom - start),
+                               records, childIndexes, childReversed);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+      bottomStarts.push_back(records[i]._startPosition);
+    }
+  }
+}
+
+// number of target sites below each site of the parent, from those
+// below each site of the child (which is on the path to the target).
+// paralogous child segments share a parent segment, and add up there
+static void countInParent(const Genome* child, const CoverageRuns& childRuns,
+                          const Genome* parent, CoverageRuns& parentRuns)
+{
+  vector<hal_index_t> bottomStarts;
+  readBottomStarts(parent, bottomStarts);
+  vector<CoverageEvent> events;
+  vector<TopSegmentRecord> records;
+  hal_size_t numTop = child->getNumTopSegments();
+  for (hal_size_t start = 0; start < numTop; start += CoverageBatchSegments)
+  {
+    child->readTopSegments(start, min(CoverageBatchSegments, numTop - start),
+                           records);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+      const TopSegmentRecord& top = records[i];
+      if (top._parentIndex == NULL_INDEX || top._length == 0)
+      {
+        continue;
+      }
+      hal_index_t parentStart = bottomStarts[top._parentIndex];
+      hal_index_t topEnd = top._startPosition + (hal_index_t)top._length;
+      for (size_t j = getRunAt(childRuns, top._startPosition);
+           j < childRuns._starts.size() && childRuns._starts[j] < topEnd; ++j)
+      {
+        hal_index_t value = (hal_index_t)childRuns._values[j];
+        if (value > 0)
+        {
+          hal_index_t runStart = max(childRuns._starts[j], 
+                                     top._startPosition);
+          hal_index_t runEnd = min(getRunEnd(childRuns, j), topEnd);
+          hal_index_t pos = parentStart + (top._parentReversed == true ? 
+                                           topEnd - runEnd :
+                                           runStart - top._startPosition);
+          events.push_back(CoverageEvent(pos, value));
+          events.push_back(CoverageEvent(pos + runEnd - runStart, -value));
+        }
+      }
+    }
+  }
+  sort(events.begin(), events.end());
+
+  initRuns(parentRuns, parent->getSequenceLength());
+  appendRun(parentRuns, 0, 0);
+  hal_index_t depth = 0;
+  for (size_t i = 0; i < events.size(); ++i)
+  {
+    depth += events[i].second;
+    if (i + 1 == events.size() || events[i + 1].first != events[i].first)
+    {
+      appendRun(parentRuns, events[i].first, (hal_size_t)depth);
+    }
+  }
+}
+
+// number of target sites in the column of each site of the genome, from
+// those of its parent.  sites without a parent are the tops of their
+// columns, whose counts are ownRuns (NULL if the genome isn't on the
+// path to the target, when they're zero)
+static void pullFromParent(const Genome* genome, 
+                           const vector<hal_index_t>& parentBottomStarts,
+                           const CoverageRuns& parentRuns,
+                           const CoverageRuns* ownRuns, CoverageRuns& runs)
+{
+  initRuns(runs, genome->getSequenceLength());
+  vector<TopSegmentRecord> records;
+  hal_size_t numTop = genome->getNumTopSegments();
+  for (hal_size_t start = 0; start < numTop; start += CoverageBatchSegments)
+  {
+    genome->readTopSegments(start, min(CoverageBatchSegments, numTop - start),
+                            records);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+      const TopSegmentRecord& top = records[i];
+      if (top._parentIndex != NULL_INDEX)
+      {
+        copyRuns(parentRuns, parentBottomStarts[top._parentIndex], 
+                 top._length, top._parentReversed, runs, top._startPosition);
+      }
+      else if (ownRuns != NULL)
+      {
+        copyRuns(*ownRuns, top._startPosition, top._length, false, runs,
+                 top._startPosition);
+      }
+      else
+      {
+        appendRun(runs, top._startPosition, 0);
+      }
+    }
+  }
+}
+
+static void makeHistogram(const CoverageRuns& runs, 
+                          CoverageHistogram& histogram)
+{
+  // depthCounts[d] is the number of sites covered d times
+  vector<hal_size_t> depthCounts;
+  for (size_t i = 0; i < runs._starts.size(); ++i)
+  {
+    hal_size_t depth = runs._values[i];
+    if (depth > 0)
+    {
+      if (depthCounts.size() <= depth)
+      {
+        depthCounts.resize(depth + 1, 0);
+      }
+      depthCounts[depth] += getRunEnd(runs, i) - runs._starts[i];
+    }
+  }
+  histogram.clear();
+  if (depthCounts.size() > 1)
+  {
+    histogram.resize(depthCounts.size() - 1);
+    hal_size_t covered = 0;
+    for (size_t i = histogram.size(); i > 0; --i)
+    {
+      covered += depthCounts[i];
+      histogram[i - 1] = covered;
+    }
+  }
+}
+
+static void pullDown(const Genome* genome, const CoverageRuns& runs,
+                     const map<const Genome*, CoverageRuns>& below,
+                     const set<const Genome*>& onPath,
+                     const vector<const Genome*>& refGenomes,
+                     vector<CoverageHistogram>& histograms)
+{
+  for (size_t i = 0; i < refGenomes.size(); ++i)
+  {
+    if (refGenomes[i] == genome)
+    {
+      makeHistogram(runs, histograms[i]);
+    }
+  }
+  vector<hal_index_t> bottomStarts;
+  for (hal_size_t i = 0; i < genome->getNumChildren(); ++i)
+  {
+    const Genome* child = genome->getChild(i);
+    if (onPath.find(child) != onPath.end())
+    {
+      if (bottomStarts.empty() == true)
+      {
+        readBottomStarts(genome, bottomStarts);
+      }
+      map<const Genome*, CoverageRuns>::const_iterator own = 
+         below.find(child);
+      CoverageRuns childRuns;
+      pullFromParent(child, bottomStarts, runs, 
+                     own == below.end() ? NULL : &own->second, childRuns);
+      pullDown(child, childRuns, below, onPath, refGenomes, histograms);
+    }
+  }
+}
+
+void hal::computeCoverage(const vector<const Genome*>& refGenomes,
+                          const Genome* tgtGenome,
+                          vector<CoverageHistogram>& histograms)
+{
+  histograms.assign(refGenomes.size(), CoverageHistogram());
+
+  // number of target sites below each site of the target's ancestors
+  map<const Genome*, CoverageRuns> below;
+  CoverageRuns& tgtRuns = below[tgtGenome];
+  initRuns(tgtRuns, tgtGenome->getSequenceLength());
+  appendRun(tgtRuns, 0, 1);
+  const Genome* root = tgtGenome;
+  for (; root->getParent() != NULL; root = root->getParent())
+  {
+    countInParent(root, below[root], root->getParent(),
+                  below[root->getParent()]);
+  }
+
+  set<const Genome*> onPath;
+  for (size_t i = 0; i < refGenomes.size(); ++i)
+  {
+    for (const Genome* genome = refGenomes[i]; genome != NULL;
+         genome = genome->getParent())
+    {
+      onPath.insert(genome);
+    }
+  }
+  pullDown(root, below[root], below, onPath, refGenomes, histograms);
+}
+
+// the target genomes are handed out one at a time to the threads of
+// computeCoverage() below.  each fills in its own columns of _histograms,
+// so the result is the same whatever the order
+struct CoverageThreads : public ThreadPool
+{
+   virtual void work(AlignmentConstPtr alignment);
+
+   vector<string> _refNames;
+   vector<string> _tgtNames;
+   vector<vector<CoverageHistogram> >* _histograms;
+};
+
+void CoverageThreads::work(AlignmentConstPtr alignment)
+{
+  vector<const Genome*> refGenomes;
+  for (size_t i = 0; i < _refNames.size(); ++i)
+  {
+    refGenomes.push_back(alignment->openGenome(_refNames[i]));
+    if (refGenomes.back() == NULL)
+    {
+      throw hal_exception("Genome " + _refNames[i] + " does not exist.");
+    }
+  }
+  vector<CoverageHistogram> histograms;
+  size_t tgt;
+  while (nextItem(_tgtNames.size(), tgt) == true)
+  {
+    const Genome* tgtGenome = alignment->openGenome(_tgtNames[tgt]);
+    if (tgtGenome == NULL)
+    {
+      throw hal_exception("Genome " + _tgtNames[tgt] + " does not exist.");
+    }
+    computeCoverage(refGenomes, tgtGenome, histograms);
+    // nobody else touches this column
+    for (size_t i = 0; i < refGenomes.size(); ++i)
+    {
+      (*_histograms)[i][tgt].swap(histograms[i]);
+    }
+  }
+}
+
+void hal::computeCoverage(AlignmentConstPtr alignment,
+                          const vector<string>& refNames,
+                          const vector<string>& tgtNames,
+                          vector<vector<CoverageHistogram> >& histograms,
+                          hal_size_t numThreads, const string& halPath,
+                          CLParserConstPtr options)
+{
+  ThreadPool::checkThreadSafe(alignment, numThreads);
+  histograms.assign(refNames.size(),
+                    vector<CoverageHistogram>(tgtNames.size()));
+  CoverageThreads state;
+  state._refNames = refNames;
+  state._tgtNames = tgtNames;
+  state._histograms = &histograms;
+
+  numThreads = max((hal_size_t)1, min(numThreads,
+                                      (hal_size_t)tgtNames.size()));
+  state.run(numThreads, alignment, halPath, options);
+}
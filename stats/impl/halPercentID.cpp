@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cassert>
+#include "halPercentID.h"
+
+using namespace std;
+using namespace hal;
+
+static const hal_size_t PercentIDBatchSegments = 65536;
+static const hal_size_t PercentIDDNAWindow = 1000000;
+
+// the target sites of a column, as seen from a site of some genome, are
+// kept in one byte: NoSite, ManySites or else the upper case base of
+// the only one (complemented if it is on the other strand).  the
+// reverseComplement() of NoSite and ManySites is themselves
+static const char NoSite = '\0';
+static const char ManySites = '\1';
+
+static char addSites(char sites, char other)
+{
+  return sites == NoSite ? other : other == NoSite ? sites : ManySites;
+}
+
+static bool isOneSite(char sites)
+{
+  return sites != NoSite && sites != ManySites;
+}
+
+static void readOwnSites(const Genome* genome, string& sites)
+{
+  hal_size_t length = genome->getSequenceLength();
+  if (genome->containsDNAArray() == false)
+  {
+    sites.assign(length, NoSite);
+    return;
+  }
+  sites.resize(length);
+  string dna;
+  for (hal_size_t start = 0; start < length; start += PercentIDDNAWindow)
+  {
+    genome->getSubString(dna, start, min(PercentIDDNAWindow, length - start));
+    for (size_t i = 0; i < dna.length(); ++i)
+    {
+      char c = toupper(dna[i]);
+      sites[start + i] = c == 'N' ? NoSite : c;
+    }
+  }
+}
+
+static void readBottomStarts(const Genome* genome,
+                             vector<hal_index_t>& bottomStarts)
+{
+  hal_size_t numBottom = genome->getNumBottomSegments();
+  bottomStarts.clear();
+  bottomStarts.reserve(numBottom);
+  vector<BottomSegmentRecord> records;
+  vector<hal_index_t> childIndexes;
+  vector<bool> childReversed;
+  for (hal_size_t start = 0; start < numBottom;
+       start += PercentIDBatchSegments)
+  {
+    genome->readBottomSegments(start, min(PercentIDBatchSegments,
+                                          numBottom - start),
+                               records, childIndexes, childReversed);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+      bottomStarts.push_back(records[i]._startPosition);
+    }
+  }
+}
+
+// target sites in the column of each site of the parent, from those
+// below each site of the child (which is on the path to the target).
+// the sites of the child's segments without a parent are appended to
+// orphanSites, if it is given, in the order of the segments
+static void addToParent(const Genome* child, const string& childSites,
+                        const Genome* parent,
+                        const vector<hal_index_t>& bottomStarts,
+                        string& parentSites, string* orphanSites)
+{
+  parentSites.assign(parent->getSequenceLength(), NoSite);
+  hal_size_t numTop = child->getNumTopSegments();
+  vector<TopSegmentRecord> tops;
+  for (hal_size_t start = 0; start < numTop; start += PercentIDBatchSegments)
+  {
+    child->readTopSegments(start, min(PercentIDBatchSegments, numTop - start),
+                           tops);
+    for (size_t i = 0; i < tops.size(); ++i)
+    {
+      const TopSegmentRecord& top = tops[i];
+      const char* src = childSites.data() + top._startPosition;
+      if (top._parentIndex == NULL_INDEX)
+      {
+        if (orphanSites != NULL)
+        {
+          orphanSites->append(src, top._length);
+        }
+        continue;
+      }
+      hal_index_t dest = bottomStarts[top._parentIndex];
+      if (top._parentReversed == false)
+      {
+        for (hal_size_t j = 0; j < top._length; ++j)
+        {
+          parentSites[dest + j] = addSites(parentSites[dest + j], src[j]);
+        }
+      }
+      else
+      {
+        dest += top._length - 1;
+        for (hal_size_t j = 0; j < top._length; ++j)
+        {
+          parentSites[dest - j] = addSites(parentSites[dest - j],
+                                           reverseComplement(src[j]));
+        }
+      }
+    }
+  }
+}
+
+// the genomes from the root down to the reference, by name so that each
+// thread can open them in its own instance of the alignment, and the
+// starts of their bottom segments.  read once and shared by the threads
+struct ReferencePath
+{
+   vector<string> _names;
+   vector<vector<hal_index_t> > _bottomStarts;
+};
+
+static void readReferencePath(const Genome* refGenome, ReferencePath& path)
+{
+  vector<const Genome*> genomes;
+  for (const Genome* genome = refGenome; genome != NULL;
+       genome = genome->getParent())
+  {
+    genomes.push_back(genome);
+  }
+  reverse(genomes.begin(), genomes.end());
+  path._names.clear();
+  path._bottomStarts.assign(genomes.size(), vector<hal_index_t>());
+  for (size_t i = 0; i < genomes.size(); ++i)
+  {
+    path._names.push_back(genomes[i]->getName());
+    if (i + 1 < genomes.size())
+    {
+      readBottomStarts(genomes[i], path._bottomStarts[i]);
+    }
+  }
+}
+
+static void openReferencePath(AlignmentConstPtr alignment,
+                              const ReferencePath& path,
+                              vector<const Genome*>& pathGenomes)
+{
+  pathGenomes.clear();
+  for (size_t i = 0; i < path._names.size(); ++i)
+  {
+    pathGenomes.push_back(alignment->openGenome(path._names[i]));
+  }
+}
+
+// target sites in the column of each site of the reference.  they are
+// counted up to the root from the target, then copied down the path to
+// the reference, holding the sites of two genomes at a time.  sites
+// without a parent start their own columns, which only hold target
+// sites if the genome is an ancestor of the target: those are set aside
+// while counting up, for the ancestors on the path
+static void getTargetSites(const ReferencePath& path,
+                           const vector<const Genome*>& pathGenomes,
+                           const Genome* tgtGenome, string& refSites)
+{
+  size_t pathLength = pathGenomes.size();
+  vector<string> orphanSites(pathLength);
+  vector<bool> isAncestor(pathLength, false);
+  string& sites = refSites;
+  string nextSites;
+  readOwnSites(tgtGenome, sites);
+  const Genome* child = tgtGenome;
+  for (const Genome* parent = child->getParent(); parent != NULL;
+       parent = parent->getParent())
+  {
+    size_t childIdx = find(pathGenomes.begin(), pathGenomes.end(), child) -
+       pathGenomes.begin();
+    size_t parentIdx = find(pathGenomes.begin(), pathGenomes.end(), parent) -
+       pathGenomes.begin();
+    // the reference's own bottom starts aren't in the path
+    vector<hal_index_t> bottomStarts;
+    if (parentIdx + 1 >= pathLength)
+    {
+      readBottomStarts(parent, bottomStarts);
+    }
+    string* childOrphanSites = NULL;
+    if (childIdx < pathLength)
+    {
+      isAncestor[childIdx] = true;
+      childOrphanSites = &orphanSites[childIdx];
+    }
+    addToParent(child, sites, parent, parentIdx + 1 < pathLength ?
+                path._bottomStarts[parentIdx] : bottomStarts,
+                nextSites, childOrphanSites);
+    sites.swap(nextSites);
+    child = parent;
+  }
+  assert(child == pathGenomes[0]);
+
+  vector<TopSegmentRecord> tops;
+  for (size_t i = 1; i < pathLength; ++i)
+  {
+    const Genome* genome = pathGenomes[i];
+    const vector<hal_index_t>& bottomStarts = path._bottomStarts[i - 1];
+    const char* orphan = isAncestor[i] == true ? orphanSites[i].data() : NULL;
+    nextSites.assign(genome->getSequenceLength(), NoSite);
+    hal_size_t numTop = genome->getNumTopSegments();
+    for (hal_size_t start = 0; start < numTop;
+         start += PercentIDBatchSegments)
+    {
+      genome->readTopSegments(start, min(PercentIDBatchSegments,
+                                         numTop - start), tops);
+      for (size_t j = 0; j < tops.size(); ++j)
+      {
+        const TopSegmentRecord& top = tops[j];
+        string::iterator dest = nextSites.begin() + top._startPosition;
+        if (top._parentIndex != NULL_INDEX)
+        {
+          string::const_iterator src =
+             sites.begin() + bottomStarts[top._parentIndex];
+          if (top._parentReversed == false)
+          {
+            copy(src, src + top._length, dest);
+          }
+          else
+          {
+            transform(string::const_reverse_iterator(src + top._length),
+                      string::const_reverse_iterator(src), dest,
+                      (char (*)(char))reverseComplement);
+          }
+        }
+        else if (orphan != NULL)
+        {
+          copy(orphan, orphan + top._length, dest);
+          orphan += top._length;
+        }
+      }
+    }
+    sites.swap(nextSites);
+    string().swap(orphanSites[i]);
+  }
+}
+
+// refSites holds the base of each reference site counted (NoSite for
+// the rest)
+static void comparePercentID(const string& refSites, const string& tgtSites,
+                             PercentID& percentID)
+{
+  hal_size_t numAligned = 0;
+  hal_size_t numSites = 0;
+  hal_size_t numID = 0;
+  const char* ref = refSites.data();
+  const char* tgt = tgtSites.data();
+  for (size_t i = 0; i < refSites.length(); ++i)
+  {
+    bool counted = ref[i] != NoSite;
+    numAligned += counted && tgt[i] != NoSite;
+    numSites += counted && isOneSite(tgt[i]);
+    numID += counted && tgt[i] == ref[i];
+  }
+  percentID._numAligned = numAligned;
+  percentID._numSites = numSites;
+  percentID._numID = numID;
+}
+
+// the target genomes are handed out one at a time to the threads of
+// computePercentID() below.  each fills in its own elements of
+// _percentIDs, so the result is the same whatever the order
+struct PercentIDThreads : public ThreadPool
+{
+   virtual void work(AlignmentConstPtr alignment);
+
+   ReferencePath _path;
+   string _refSites;
+   vector<string> _tgtNames;
+   vector<PercentID>* _percentIDs;
+};
+
+void PercentIDThreads::work(AlignmentConstPtr alignment)
+{
+  vector<const Genome*> pathGenomes;
+  openReferencePath(alignment, _path, pathGenomes);
+  string tgtSites;
+  size_t tgt;
+  while (nextItem(_tgtNames.size(), tgt) == true)
+  {
+    const Genome* tgtGenome = alignment->openGenome(_tgtNames[tgt]);
+    if (tgtGenome == NULL)
+    {
+      throw hal_exception("Genome " + _tgtNames[tgt] + " does not exist.");
+    }
+    getTargetSites(_path, pathGenomes, tgtGenome, tgtSites);
+    // nobody else touches this element
+    comparePercentID(_refSites, tgtSites, (*_percentIDs)[tgt]);
+  }
+}
+
+void hal::computePercentID(AlignmentConstPtr alignment,
+                           const string& refName,
+                           const vector<string>& tgtNames,
+                           vector<PercentID>& percentIDs,
+                           hal_size_t numThreads, const string& halPath,
+                           CLParserConstPtr options)
+{
+  ThreadPool::checkThreadSafe(alignment, numThreads);
+  const Genome* refGenome = alignment->openGenome(refName);
+  if (refGenome == NULL)
+  {
+    throw hal_exception("Genome " + refName + " does not exist.");
+  }
+  PercentID empty = {0, 0, 0};
+  percentIDs.assign(tgtNames.size(), empty);
+  PercentIDThreads state;
+  state._tgtNames = tgtNames;
+  state._percentIDs = &percentIDs;
+
+  // only reference sites that are the one reference site (and not an N)
+  // in their column are counted
+  readReferencePath(refGenome, state._path);
+  vector<const Genome*> pathGenomes;
+  openReferencePath(alignment, state._path, pathGenomes);
+  getTargetSites(state._path, pathGenomes, refGenome, state._refSites);
+  string ownSites;
+  readOwnSites(refGenome, ownSites);
+  for (size_t i = 0; i < ownSites.length(); ++i)
+  {
+    if (ownSites[i] == NoSite || state._refSites[i] == ManySites)
+    {
+      state._refSites[i] = NoSite;
+    }
+  }
+  string().swap(ownSites);
+
+  numThreads = max((hal_size_t)1, min(numThreads,
+                                      (hal_size_t)tgtNames.size()));
+  state.run(numThreads, alignment, halPath, options);
+}
@@ -7,6 +7,7 @@
 #include <deque>
 #include <cassert>
 #include "halStats.h"
+#include "halStatsCache.h"
 
 using namespace std;
 using namespace hal;
@@ -16,9 +17,9 @@ HalStats::HalStats()
 
 }
 
-HalStats::HalStats(AlignmentConstPtr alignment)
+HalStats::HalStats(AlignmentConstPtr alignment, const StatsCache* cache)
 {
-  readAlignment(alignment);
+  readAlignment(alignment, cache);
 }
 
 HalStats::~HalStats()
@@ -43,7 +44,8 @@ void HalStats::printCsv(ostream& outStream) const
   outStream << endl;
 }
 
-void HalStats::readAlignment(AlignmentConstPtr alignment)
+void HalStats::readAlignment(AlignmentConstPtr alignment,
+                             const StatsCache* cache)
 {
   _tree.clear();
   _genomeStatsVec.clear();
@@ -52,8 +54,15 @@ void HalStats::readAlignment(AlignmentConstPtr alignment)
   {
     _tree = alignment->getNewickTree();
     _genomeStatsVec.reserve(alignment->getNumGenomes());
-    const Genome* root = alignment->openGenome(alignment->getRootName());
-    readGenomeRecursive(alignment, root);
+    if (cache != NULL)
+    {
+      readCacheRecursive(alignment, cache, alignment->getRootName());
+    }
+    else
+    {
+      const Genome* root = alignment->openGenome(alignment->getRootName());
+      readGenomeRecursive(alignment, root);
+    }
   }
 }
 
@@ -78,3 +87,21 @@ void HalStats::readGenomeRecursive(AlignmentConstPtr alignment,
     readGenomeRecursive(alignment, child);
   }
 }
+
+void HalStats::readCacheRecursive(AlignmentConstPtr alignment,
+                                  const StatsCache* cache,
+                                  const string& genomeName)
+{
+  const CachedGenomeStats* genomeStats = cache->getGenomeStats(genomeName);
+  if (genomeStats == NULL)
+  {
+    throw hal_exception("Genome " + genomeName + " not in stats cache");
+  }
+  _genomeStatsVec.push_back(*genomeStats);
+
+  vector<string> children = alignment->getChildNames(genomeName);
+  for (hal_size_t i = 0; i < children.size(); ++i)
+  {
+    readCacheRecursive(alignment, cache, children[i]);
+  }
+}
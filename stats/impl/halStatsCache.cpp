@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <sstream>
+#include <deque>
+#include <algorithm>
+#include <cassert>
+#include "halStatsCache.h"
+
+using namespace std;
+using namespace hal;
+
+/** bump whenever the format of the cached values changes */
+const string StatsCache::Version = "1";
+
+static const string VersionKey = "Version";
+static const string GenomeKeyPrefix = "Genome:";
+static const hal_size_t BaseCountWindow = 1000000;
+
+/** names of all genomes in the tree, parents before children */
+static vector<string> getGenomeNames(AlignmentConstPtr alignment)
+{
+  vector<string> names;
+  if (alignment->getNumGenomes() == 0)
+  {
+    return names;
+  }
+  deque<string> queue;
+  queue.push_back(alignment->getRootName());
+  while (queue.empty() == false)
+  {
+    names.push_back(queue.front());
+    vector<string> children = alignment->getChildNames(queue.front());
+    queue.pop_front();
+    queue.insert(queue.end(), children.begin(), children.end());
+  }
+  return names;
+}
+
+StatsCache::StatsCache()
+{
+
+}
+
+StatsCache::~StatsCache()
+{
+
+}
+
+bool StatsCache::load(AlignmentConstPtr alignment)
+{
+  _genomes.clear();
+  const MetaData* meta = alignment->getStatsCache();
+  if (meta == NULL || meta->has(VersionKey) == false ||
+      meta->get(VersionKey) != Version)
+  {
+    return false;
+  }
+  vector<string> names = getGenomeNames(alignment);
+  if (meta->getMap().size() != names.size() + 1)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    string key = GenomeKeyPrefix + names[i];
+    CachedGenomeStats& stats = _genomes[names[i]];
+    stats._name = names[i];
+    if (meta->has(key) == false ||
+        parseGenome(meta->get(key), stats) == false)
+    {
+      _genomes.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void StatsCache::compute(AlignmentConstPtr alignment)
+{
+  _genomes.clear();
+  vector<string> names = getGenomeNames(alignment);
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    const Genome* genome = alignment->openGenome(names[i]);
+    if (genome == NULL)
+    {
+      throw hal_exception("Genome " + names[i] + " not found.");
+    }
+    computeGenome(genome, _genomes[names[i]]);
+    alignment->closeGenome(genome);
+  }
+}
+
+void StatsCache::store(AlignmentPtr alignment) const
+{
+  MetaData* meta = alignment->createStatsCache();
+  for (map<string, CachedGenomeStats>::const_iterator i = _genomes.begin();
+       i != _genomes.end(); ++i)
+  {
+    meta->set(GenomeKeyPrefix + i->first, formatGenome(i->second));
+  }
+  meta->set(VersionKey, Version);
+}
+
+const CachedGenomeStats* StatsCache::getGenomeStats(const string& name) const
+{
+  map<string, CachedGenomeStats>::const_iterator i = _genomes.find(name);
+  return i == _genomes.end() ? NULL : &i->second;
+}
+
+void StatsCache::computeGenome(const Genome* genome, CachedGenomeStats& stats)
+{
+  stats._name = genome->getName();
+  stats._numChildren = genome->getNumChildren();
+  stats._length = genome->getSequenceLength();
+  stats._numSequences = genome->getNumSequences();
+  stats._numTopSegments = genome->getNumTopSegments();
+  stats._numBottomSegments = genome->getNumBottomSegments();
+
+  stats._sequences.clear();
+  stats._sequences.reserve(stats._numSequences);
+  if (stats._numSequences > 0)
+  {
+    SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+    SequenceIteratorConstPtr seqEnd = genome->getSequenceEndIterator();
+    for (; !seqIt->equals(seqEnd); seqIt->toNext())
+    {
+      const Sequence* sequence = seqIt->getSequence();
+      stats._sequences.push_back(
+        Sequence::Info(sequence->getName(), sequence->getSequenceLength(),
+                       sequence->getNumTopSegments(),
+                       sequence->getNumBottomSegments()));
+    }
+  }
+
+  fill(stats._baseCounts, stats._baseCounts + 5, 0);
+  if (genome->containsDNAArray() == false)
+  {
+    return;
+  }
+  string dna;
+  for (hal_size_t pos = 0; pos < stats._length; pos += BaseCountWindow)
+  {
+    genome->getSubString(dna, pos, min(BaseCountWindow, stats._length - pos));
+    for (string::const_iterator c = dna.begin(); c != dna.end(); ++c)
+    {
+      switch (*c)
+      {
+      case 'a':
+      case 'A':
+        ++stats._baseCounts[0];
+        break;
+      case 'c':
+      case 'C':
+        ++stats._baseCounts[1];
+        break;
+      case 'g':
+      case 'G':
+        ++stats._baseCounts[2];
+        break;
+      case 't':
+      case 'T':
+        ++stats._baseCounts[3];
+        break;
+      default:
+        ++stats._baseCounts[4];
+        break;
+      }
+    }
+  }
+}
+
+// first line: genome dimensions then base counts, followed by one line
+// per sequence with the name last so that it can contain spaces
+string StatsCache::formatGenome(const CachedGenomeStats& stats)
+{
+  stringstream ss;
+  ss << stats._numChildren << ' ' << stats._length << ' '
+     << stats._numSequences << ' ' << stats._numTopSegments << ' '
+     << stats._numBottomSegments;
+  for (size_t i = 0; i < 5; ++i)
+  {
+    ss << ' ' << stats._baseCounts[i];
+  }
+  ss << '\n';
+  for (size_t i = 0; i < stats._sequences.size(); ++i)
+  {
+    const Sequence::Info& info = stats._sequences[i];
+    ss << info._length << ' ' << info._numTopSegments << ' '
+       << info._numBottomSegments << ' ' << info._name << '\n';
+  }
+  return ss.str();
+}
+
+bool StatsCache::parseGenome(const string& value, CachedGenomeStats& stats)
+{
+  stringstream ss(value);
+  ss >> stats._numChildren >> stats._length >> stats._numSequences
+     >> stats._numTopSegments >> stats._numBottomSegments;
+  for (size_t i = 0; i < 5; ++i)
+  {
+    ss >> stats._baseCounts[i];
+  }
+  if (!ss)
+  {
+    return false;
+  }
+  stats._sequences.resize(stats._numSequences);
+  for (size_t i = 0; i < stats._numSequences; ++i)
+  {
+    Sequence::Info& info = stats._sequences[i];
+    ss >> info._length >> info._numTopSegments >> info._numBottomSegments;
+    ss.get();
+    getline(ss, info._name);
+    if (!ss)
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -6,18 +6,24 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <deque>
 #include "halStats.h"
+#include "halStatsCache.h"
+#include "halCoverage.h"
+#include "halPercentID.h"
 
 using namespace std;
 using namespace hal;
 
 static void printGenomes(ostream& os, AlignmentConstPtr alignment);
 static void printSequences(ostream& os, AlignmentConstPtr alignment, 
-                          const string& genomeName);
+                          const string& genomeName, const StatsCache* cache);
 static void printSequenceStats(ostream& os, AlignmentConstPtr alignment, 
-                               const string& genomeName);
+                               const string& genomeName,
+                               const StatsCache* cache);
 static void printBedSequenceStats(ostream& os, AlignmentConstPtr alignment, 
-                                  const string& genomeName);
+                                  const string& genomeName,
+                                  const StatsCache* cache);
 static void printBranchPath(ostream& os, AlignmentConstPtr alignment, 
                             const vector<string>& genomeNames, bool keepRoot);
 static void printBranches(ostream& os, AlignmentConstPtr alignment);
@@ -30,20 +36,29 @@ static void printBranchLength(ostream& os, AlignmentConstPtr alignment,
                               const string& genomeName);
 static void printBranches(ostream& os, AlignmentConstPtr alignment); 
 static void printNumSegments(ostream& os, AlignmentConstPtr alignment,
-                             const string& genomeName); 
+                             const string& genomeName,
+                             const StatsCache* cache); 
 static void printBaseComp(ostream& os, AlignmentConstPtr alignment, 
-                          const string& baseCompPair);
+                          const string& baseCompPair,
+                          const StatsCache* cache);
 static void printGenomeMetaData(ostream &os, AlignmentConstPtr alignment,
                           const string &genomeName);
 static void printChromSizes(ostream& os, AlignmentConstPtr alignment, 
-                            const string& genomeName);
+                            const string& genomeName,
+                            const StatsCache* cache);
+static const CachedGenomeStats* getCachedGenome(const StatsCache* cache,
+                                                const string& genomeName);
+static void writeStatsCache(const string& path, CLParserConstPtr options);
 static void printPercentID(ostream& os, AlignmentConstPtr alignment,
-                           const string& genomeName);
+                           const string& genomeName, hal_size_t numThreads,
+                           const string& halPath, CLParserConstPtr options);
 static void printCoverage(ostream& os, AlignmentConstPtr alignment,
                                  const string& genomeName);
 static void printSegments(ostream& os, AlignmentConstPtr alignment,
                           const string& genomeName, bool top);
-static void printAllCoverage(ostream& os, AlignmentConstPtr alignment);
+static void printAllCoverage(ostream& os, AlignmentConstPtr alignment,
+                             hal_size_t numThreads, const string& halPath,
+                             CLParserConstPtr options);
 
 int main(int argc, char** argv)
 {
@@ -115,6 +130,21 @@ int main(int argc, char** argv)
   optionsParser->addOptionFlag("allCoverage",
                                "print histogram of coverage from all genomes to"
                                " all genomes", false);
+  optionsParser->addOption("numThreads",
+                           "number of threads to compute --allCoverage "
+                           "and --percentID with.  Each thread maps its own "
+                           "genomes",
+                           1);
+  optionsParser->addOptionFlag("writeCache",
+                               "compute the length, sequence table, segment "
+                               "counts and base composition of every genome "
+                               "and store them in the hal file, so that later "
+                               "queries for them needn't read the genomes.  "
+                               "The file is opened for writing, and any tool "
+                               "that later does so discards the cache", false);
+  optionsParser->addOptionFlag("noCache",
+                               "ignore any stats stored with --writeCache",
+                               false);
 
 
   string path;
@@ -139,6 +169,9 @@ int main(int argc, char** argv)
   string topSegments;
   string bottomSegments;
   bool allCoverage;
+  bool writeCache;
+  bool noCache;
+  hal_size_t numThreads;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -164,6 +197,9 @@ int main(int argc, char** argv)
     topSegments = optionsParser->getOption<string>("topSegments");
     bottomSegments = optionsParser->getOption<string>("bottomSegments");
     allCoverage = optionsParser->getFlag("allCoverage");
+    writeCache = optionsParser->getFlag("writeCache");
+    noCache = optionsParser->getFlag("noCache");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
 
     size_t optCount = listGenomes == true ? 1 : 0;
     if (sequencesFromGenome != "\"\"") ++optCount;
@@ -186,6 +222,7 @@ int main(int argc, char** argv)
     if (topSegments != "\"\"") ++optCount;
     if (bottomSegments != "\"\"") ++optCount;
     if (allCoverage) ++optCount;
+    if (writeCache) ++optCount;
     if (optCount > 1)
     {
       throw hal_exception("--genomes, --sequences, --tree, --span, --spanRoot, "
@@ -193,7 +230,7 @@ int main(int argc, char** argv)
                           "--bedSequences, --root, --numSegments, --baseComp, "
                           "--genomeMetaData, --chromSizes, --percentID, "
                           "--coverage,  --topSegments, --bottomSegments, "
-                          "--allCoverage "
+                          "--allCoverage, --writeCache "
                           "and --branchLength options are exclusive");
     }
   }
@@ -205,7 +242,18 @@ int main(int argc, char** argv)
   }
   try
   {
+    if (writeCache == true)
+    {
+      writeStatsCache(path, optionsParser);
+      return 0;
+    }
     AlignmentConstPtr alignment = openHalAlignmentReadOnly(path, optionsParser);
+    StatsCache statsCache;
+    const StatsCache* cache = NULL;
+    if (noCache == false && statsCache.load(alignment) == true)
+    {
+      cache = &statsCache;
+    }
 
     if (listGenomes == true && alignment->getNumGenomes() > 0)
     {
@@ -213,7 +261,7 @@ int main(int argc, char** argv)
     }
     else if (sequencesFromGenome != "\"\"")
     {
-      printSequences(cout, alignment, sequencesFromGenome);
+      printSequences(cout, alignment, sequencesFromGenome, cache);
     }
     else if (tree == true)
     {
@@ -221,11 +269,12 @@ int main(int argc, char** argv)
     }
     else if (sequenceStatsFromGenome != "\"\"")
     {
-      printSequenceStats(cout, alignment, sequenceStatsFromGenome);
+      printSequenceStats(cout, alignment, sequenceStatsFromGenome, cache);
     }
     else if (bedSequencesFromGenome != "\"\"")
     {
-      printBedSequenceStats(cout, alignment, bedSequencesFromGenome);
+      printBedSequenceStats(cout, alignment, bedSequencesFromGenome,
+                            cache);
     }
     else if (spanGenomes !=  "\"\"")
     {
@@ -257,11 +306,11 @@ int main(int argc, char** argv)
     }
     else if (numSegmentsGenome != "\"\"")
     {
-      printNumSegments(cout, alignment, numSegmentsGenome);
+      printNumSegments(cout, alignment, numSegmentsGenome, cache);
     }
     else if (baseCompPair != "\"\"")
     {
-      printBaseComp(cout, alignment, baseCompPair);
+      printBaseComp(cout, alignment, baseCompPair, cache);
     }
     else if (genomeMetaData != "\"\"")
     {
@@ -269,11 +318,12 @@ int main(int argc, char** argv)
     }
     else if (chromSizesFromGenome != "\"\"")
     {
-      printChromSizes(cout, alignment, chromSizesFromGenome);
+      printChromSizes(cout, alignment, chromSizesFromGenome, cache);
     }
     else if (percentID != "\"\"")
     {
-      printPercentID(cout, alignment, percentID);
+      printPercentID(cout, alignment, percentID, numThreads, path,
+                     optionsParser);
     }
     else if (coverage != "\"\"") {
       printCoverage(cout, alignment, coverage);
@@ -284,11 +334,11 @@ int main(int argc, char** argv)
     else if (bottomSegments != "\"\"") {
       printSegments(cout, alignment, bottomSegments, false);
     } else if (allCoverage) {
-      printAllCoverage(cout, alignment);
+      printAllCoverage(cout, alignment, numThreads, path, optionsParser);
     }
     else
     {
-      HalStats halStats(alignment);
+      HalStats halStats(alignment, cache);
       cout << endl << "hal v" << alignment->getVersion() << "\n" << halStats;
     }
   }
@@ -327,8 +377,18 @@ void printGenomes(ostream& os, AlignmentConstPtr alignment)
 }
 
 void printSequences(ostream& os, AlignmentConstPtr alignment, 
-                   const string& genomeName)
+                   const string& genomeName, const StatsCache* cache)
 {
+  if (cache != NULL)
+  {
+    const CachedGenomeStats* stats = getCachedGenome(cache, genomeName);
+    for (size_t i = 0; i < stats->_sequences.size(); ++i)
+    {
+      os << (i > 0 ? "," : "") << stats->_sequences[i]._name;
+    }
+    os << endl;
+    return;
+  }
   const Genome* genome = alignment->openGenome(genomeName);
   if (genome == NULL)
   {
@@ -351,8 +411,24 @@ void printSequences(ostream& os, AlignmentConstPtr alignment,
 }
 
 void printSequenceStats(ostream& os, AlignmentConstPtr alignment, 
-                        const string& genomeName)
+                        const string& genomeName, const StatsCache* cache)
 {
+  if (cache != NULL)
+  {
+    const CachedGenomeStats* stats = getCachedGenome(cache, genomeName);
+    if (stats->_sequences.empty() == false)
+    {
+      os << "SequenceName, Length, NumTopSegments, NumBottomSegments" << endl;
+    }
+    for (size_t i = 0; i < stats->_sequences.size(); ++i)
+    {
+      const Sequence::Info& info = stats->_sequences[i];
+      os << info._name << ", " << info._length << ", "
+         << info._numTopSegments << ", " << info._numBottomSegments << "\n";
+    }
+    os << endl;
+    return;
+  }
   const Genome* genome = alignment->openGenome(genomeName);
   if (genome == NULL)
   {
@@ -376,8 +452,19 @@ void printSequenceStats(ostream& os, AlignmentConstPtr alignment,
 }
 
 void printBedSequenceStats(ostream& os, AlignmentConstPtr alignment, 
-                           const string& genomeName)
+                           const string& genomeName, const StatsCache* cache)
 {
+  if (cache != NULL)
+  {
+    const CachedGenomeStats* stats = getCachedGenome(cache, genomeName);
+    for (size_t i = 0; i < stats->_sequences.size(); ++i)
+    {
+      os << stats->_sequences[i]._name << "\t" << 0 << "\t"
+         << stats->_sequences[i]._length << "\n";
+    }
+    os << endl;
+    return;
+  }
   const Genome* genome = alignment->openGenome(genomeName);
   if (genome == NULL)
   {
@@ -536,8 +623,14 @@ void printBranchLength(ostream& os, AlignmentConstPtr alignment,
 }
 
 void printNumSegments(ostream& os, AlignmentConstPtr alignment, 
-                      const string& genomeName)
+                      const string& genomeName, const StatsCache* cache)
 {
+  if (cache != NULL)
+  {
+    const CachedGenomeStats* stats = getCachedGenome(cache, genomeName);
+    os << stats->_numTopSegments << " " << stats->_numBottomSegments << endl;
+    return;
+  }
   const Genome* genome = alignment->openGenome(genomeName);
   if (genome == NULL)
   {
@@ -548,7 +641,7 @@ void printNumSegments(ostream& os, AlignmentConstPtr alignment,
 }
 
 void printBaseComp(ostream& os, AlignmentConstPtr alignment, 
-                   const string& baseCompPair)
+                   const string& baseCompPair, const StatsCache* cache)
 {
   string genomeName;
   hal_size_t step = 0;
@@ -566,16 +659,32 @@ void printBaseComp(ostream& os, AlignmentConstPtr alignment,
        << " format genomeName,step";
     throw hal_exception(ss.str());
   }
+
+  hal_size_t numA = 0;
+  hal_size_t numC = 0;
+  hal_size_t numG = 0;
+  hal_size_t numT = 0;
+  // the cache has exact counts, which we use whatever the step
+  if (cache != NULL)
+  {
+    const CachedGenomeStats* stats = getCachedGenome(cache, genomeName);
+    numA = stats->_baseCounts[0];
+    numC = stats->_baseCounts[1];
+    numG = stats->_baseCounts[2];
+    numT = stats->_baseCounts[3];
+    double total = numA + numC + numG + numT;
+    os << (double)numA / total << '\t'
+       << (double)numC / total << '\t'
+       << (double)numG / total << '\t'
+       << (double)numT / total << '\n';
+    return;
+  }
       
   const Genome* genome = alignment->openGenome(genomeName);
   if (genome == NULL)
   {
     throw hal_exception(string("Genome ") + genomeName + " not found.");
   }
-  hal_size_t numA = 0;
-  hal_size_t numC = 0;
-  hal_size_t numG = 0;
-  hal_size_t numT = 0;
 
   hal_size_t len = genome->getSequenceLength();
   if (step >= len)
@@ -634,8 +743,18 @@ void printGenomeMetaData(ostream &os, AlignmentConstPtr alignment,
 }
 
 void printChromSizes(ostream& os, AlignmentConstPtr alignment, 
-                     const string& genomeName)
+                     const string& genomeName, const StatsCache* cache)
 {
+  if (cache != NULL)
+  {
+    const CachedGenomeStats* stats = getCachedGenome(cache, genomeName);
+    for (size_t i = 0; i < stats->_sequences.size(); ++i)
+    {
+      os << stats->_sequences[i]._name << '\t'
+         << stats->_sequences[i]._length << '\n';
+    }
+    return;
+  }
   const Genome* genome = alignment->openGenome(genomeName);
   if (genome == NULL)
   {
@@ -653,197 +772,99 @@ void printChromSizes(ostream& os, AlignmentConstPtr alignment,
   }
 }
 
+// Identity of every genome with the given one, in tree order (parents
+// before children).  Genomes that share no column with it are left out.
 void printPercentID(ostream& os, AlignmentConstPtr alignment,
-                    const string& genomeName)
+                    const string& genomeName, hal_size_t numThreads,
+                    const string& halPath, CLParserConstPtr options)
 {
-  const Genome *refGenome = alignment->openGenome(genomeName);
-  if (!refGenome) {
-    throw hal_exception("Genome " + genomeName + " does not exist.");
+  vector<string> tgtNames;
+  deque<string> queue(1, alignment->getRootName());
+  while (queue.empty() == false)
+  {
+    tgtNames.push_back(queue.front());
+    vector<string> children = alignment->getChildNames(queue.front());
+    queue.pop_front();
+    queue.insert(queue.end(), children.begin(), children.end());
   }
+  vector<PercentID> percentIDs;
+  computePercentID(alignment, genomeName, tgtNames, percentIDs, numThreads,
+                   halPath, options);
 
-  ColumnIteratorPtr colIt = refGenome->getColumnIterator();
-  // A bit sloppy, but a mapping from genome to (# identical bases, # aligned sites)
-  // The # of aligned sites is necessary since a) not all sites are aligned and
-  // b) we don't consider anything containing N's to be aligned.
-  map<const Genome *, pair<hal_size_t *, hal_size_t *> > genomeStats;
-  while(1) {
-    // Get DNA for this site in reference
-    DNAIteratorConstPtr refDnaIt = refGenome->getDNAIterator(colIt->getReferenceSequencePosition() + colIt->getReferenceSequence()->getStartPosition());
-    char refDna = toupper(refDnaIt->getChar());
-    
-    const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
-    map <const Genome *, pair<hal_size_t *, hal_size_t *> > tempGenomeStats;
-    for (ColumnIterator::ColumnMap::const_iterator colMapIt = cmap->begin();
-         colMapIt != cmap->end(); colMapIt++) {
-      if (colMapIt->second->empty()) {
-        // There are empty entries in the column map.
-        continue;
-      }
-      const Genome *genome = colMapIt->first->getGenome();
-      const ColumnIterator::DNASet *dnaSet = colMapIt->second;
-      assert(dnaSet->size() == 1);
-      for (hal_size_t i = 0; i < dnaSet->size(); i++) {
-        DNAIteratorConstPtr dnaIt = dnaSet->at(i);
-        char otherDna = toupper(dnaIt->getChar());
-        if (refDna != 'N' && otherDna != 'N') {
-          if (!tempGenomeStats.count(genome)) {
-            // initialize the map for this genome if necessary.
-            tempGenomeStats[genome] = make_pair(new hal_size_t, new hal_size_t);
-            *tempGenomeStats[genome].first = 0;
-            *tempGenomeStats[genome].second = 0;
-          }
-          hal_size_t *tempNumID = tempGenomeStats[genome].first;
-          hal_size_t *tempNumSites = tempGenomeStats[genome].second;
-          if (refDna == otherDna) {
-            (*tempNumID)++;
-          }
-          (*tempNumSites)++;
-        }
-      }
+  os << "Genome, % ID, numID, numSites" << endl;
+  for (size_t i = 0; i < tgtNames.size(); ++i)
+  {
+    const PercentID& percentID = percentIDs[i];
+    if (percentID._numAligned > 0)
+    {
+      os << tgtNames[i] << ", " 
+         << ((double) percentID._numID) / percentID._numSites << ", "
+         << percentID._numID << ", " << percentID._numSites << endl;
     }
-    if (refDna != 'N' && *tempGenomeStats[refGenome].second == 1) {
-      // If there isn't a duplication in the reference then we count
-      // this column.
-      for (map<const Genome *, pair<hal_size_t *, hal_size_t *> >::iterator it = tempGenomeStats.begin();
-           it != tempGenomeStats.end(); it++) {
-        const Genome *genome = it->first;
-        if (!genomeStats.count(genome)) {
-          // initialize the map for this genome if necessary.
-          genomeStats[genome] = make_pair(new hal_size_t, new hal_size_t);
-          *genomeStats[genome].first = 0;
-          *genomeStats[genome].second = 0;
+  }
+}
+
+// one row per non-empty histogram, padded with zeroes to the length of
+// the longest
+static void printHistograms(ostream& os, const string& header,
+                            const vector<string>& rowNames,
+                            const vector<CoverageHistogram>& histograms)
+{
+  size_t maxHistLength = 0;
+  for (size_t i = 0; i < histograms.size(); ++i)
+  {
+    maxHistLength = max(maxHistLength, histograms[i].size());
+  }
+  os << header;
+  for (size_t i = 0; i < maxHistLength; ++i)
+  {
+    os << ", sitesCovered" << i + 1 << "Times";
+  }
+  os << endl;
+  for (size_t i = 0; i < histograms.size(); ++i)
+  {
+    if (histograms[i].empty() == false)
+    {
+      os << rowNames[i];
+      for (size_t j = 0; j < maxHistLength; ++j)
+      {
+        if (j < histograms[i].size())
+        {
+          os << ", " << (double)histograms[i][j];
         }
-        hal_size_t *tempNumID = it->second.first;
-        hal_size_t *tempNumSites = it->second.second;
-        if (*tempNumSites == 1) {
-          // only count for the ID ratio if there's only 1 site for
-          // this genome in the column.
-          hal_size_t *numID = genomeStats[genome].first;
-          hal_size_t *numSites = genomeStats[genome].second;
-          assert(*tempNumID == 1 || *tempNumID == 0);
-          assert(*tempNumSites == 1);
-          if (*tempNumID == 1) {
-            (*numID)++;
-          }
-          (*numSites)++;
+        else
+        {
+          os << ", " << 0;
         }
       }
+      os << endl;
     }
-    // clean up temporary counts.
-    for (map<const Genome *, pair<hal_size_t *, hal_size_t *> >::iterator it = tempGenomeStats.begin();
-         it != tempGenomeStats.end(); it++) {
-      delete it->second.first;
-      delete it->second.second;
-    }
-    if (colIt->getReferenceSequencePosition() % 1000 == 0) {
-      colIt->defragment();
-    }
-    if (colIt->lastColumn()) {
-      // Break here--the column iterator will crash if we try to go further.
-      break;
-    }
-    colIt->toRight();
-  }
-  os << "Genome, % ID, numID, numSites" << endl;
-  for (map<const Genome *, pair<hal_size_t *, hal_size_t *> >::iterator statsIt = genomeStats.begin();
-       statsIt != genomeStats.end(); statsIt++) {
-    string name = statsIt->first->getName();
-    hal_size_t numID = *statsIt->second.first;
-    hal_size_t numSites = *statsIt->second.second;
-    os << name << ", " << ((double) numID)/numSites << ", " << numID <<
-      ", " << numSites << endl;
-    delete statsIt->second.first;
-    delete statsIt->second.second;
   }
 }
 
+// Coverage of a genome by itself and by the leaves (the rows are the
+// genome followed by the other leaves in tree order)
 void printCoverage(ostream& os, AlignmentConstPtr alignment,
-                          const string& genomeName)
+                   const string& genomeName)
 {
   const Genome *refGenome = alignment->openGenome(genomeName);
   if (!refGenome) {
     throw hal_exception("Genome " + genomeName + " does not exist.");
   }
-
-  ColumnIteratorPtr colIt = refGenome->getColumnIterator(NULL, 0, 0,
-                                                         NULL_INDEX, false,
-                                                         false, false, true);
-  map<const Genome *, vector<hal_size_t> *> histograms;
-  while(1) {
-    const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
-    // Temporary collecting of per-genome sites mapped, since it's
-    // organized in the column map by sequence, not genome.
-    map<const Genome *, hal_size_t> numSitesMapped;
-    for (ColumnIterator::ColumnMap::const_iterator colMapIt = cmap->begin();
-         colMapIt != cmap->end(); colMapIt++) {
-      if (colMapIt->second->empty()) {
-        // There are empty entries in the column map.
-        continue;
-      }
-      const Genome *genome = colMapIt->first->getGenome();
-      if (genome->getNumChildren() == 0 || genome == refGenome) {
-          // We only care about coverage from leaf genomes, but if
-          // the reference is an ancestor we need to keep track of its
-          // coverage too.
-          if (!numSitesMapped.count(genome)) {
-              // Initialize map entry
-              numSitesMapped[genome] = 0;
-          }
-          const ColumnIterator::DNASet *dnaSet = colMapIt->second;
-          numSitesMapped[genome] = numSitesMapped[genome] + dnaSet->size();
-      }
-    }
-    for (map<const Genome *, hal_size_t>::const_iterator it = numSitesMapped.begin();
-         it != numSitesMapped.end(); it++) {
-      if (!histograms.count(it->first)) {
-        // Initialize map
-        histograms[it->first] = new vector<hal_size_t>;
-      }
-      vector<hal_size_t> *histogram = histograms[it->first];
-      if (histogram->size() < it->second) {
-        histogram->resize(it->second, 0);
-      }
-      for (hal_size_t i = 0; i < it->second; i++) {
-        (*histogram)[i] = histogram->at(i) + numSitesMapped[refGenome];
-      }
-    }
-    if (colIt->getReferenceSequencePosition() % 1000 == 0) {
-      colIt->defragment();
-    }
-    if (colIt->lastColumn()) {
-      // Break here--the column iterator will crash if we try to go further.
-      break;
-    }
-    colIt->toRight();
-  }
-  hal_size_t maxHistLength = 0;
-  for (map<const Genome *, vector<hal_size_t> *>::iterator histIt = histograms.begin();
-       histIt != histograms.end(); histIt++) {
-    vector <hal_size_t> *histogram = histIt->second;
-    if (histogram->size() > maxHistLength) {
-      maxHistLength = histogram->size();
-    }
-  }
-
-  os << "Genome";
-  for (hal_size_t i = 0; i < maxHistLength; i++) {
-    os << ", sitesCovered" << i + 1 << "Times";
-  }
-  os << endl;
-  for (map<const Genome *, vector<hal_size_t> *>::iterator histIt = histograms.begin();
-       histIt != histograms.end(); histIt++) {
-    string name = histIt->first->getName();
-    os << name;
-    vector <hal_size_t> *histogram = histIt->second;
-    for(hal_size_t i = 0; i < maxHistLength; i++) {
-      if (i < histogram->size()) {
-        os << ", " << (double) histogram->at(i);
-      } else {
-        os << ", " << 0;
-      }
+  vector<string> tgtNames(1, genomeName);
+  vector<string> leafNames = 
+     alignment->getLeafNamesBelow(alignment->getRootName());
+  for (size_t i = 0; i < leafNames.size(); ++i)
+  {
+    if (leafNames[i] != genomeName)
+    {
+      tgtNames.push_back(leafNames[i]);
     }
-    os << endl;
   }
+  vector<vector<CoverageHistogram> > histograms;
+  computeCoverage(alignment, vector<string>(1, genomeName), tgtNames,
+                  histograms);
+  printHistograms(os, "Genome", tgtNames, histograms[0]);
 }
 
 static void printSegments(ostream& os, AlignmentConstPtr alignment,
@@ -882,114 +903,51 @@ static void printSegments(ostream& os, AlignmentConstPtr alignment,
   }
 }
 
-// Print coverage for all leaves vs. all leaves efficiently.
-static void printAllCoverage(ostream& os, AlignmentConstPtr alignment)
+// Print coverage for all leaves vs. all leaves.  Each row is the
+// coverage of ToGenome by FromGenome, grouped by ToGenome and both in
+// tree order.  The FromGenomes are divided among the threads.
+static void printAllCoverage(ostream& os, AlignmentConstPtr alignment,
+                             hal_size_t numThreads, const string& halPath,
+                             CLParserConstPtr options)
 {
-  vector<string> leafNames = alignment->getLeafNamesBelow(alignment->getRootName());
-  vector<const Genome *> leafGenomes;
-  for (hal_size_t i = 0; i < leafNames.size(); i++) {
-    const Genome *genome = alignment->openGenome(leafNames[i]);
-    assert(genome != NULL);
-    leafGenomes.push_back(genome);
-  }
-  ColumnIterator::VisitCache visitCache;
-  map<pair<const Genome *, const Genome *>, vector<hal_size_t> *> histograms;
-  for (hal_size_t i = 0; i < leafGenomes.size(); i++) {
-    const Genome *genome = leafGenomes[i];
-    // Follow paralogies, but ignore ancestors.
-    ColumnIteratorPtr colIt = genome->getColumnIterator(NULL, 0, 0,
-                                                        NULL_INDEX, false,
-                                                        true, false, true);
-    colIt->setVisitCache(&visitCache);
-    // So that we don't accidentally visit the first column if it's
-    // already been visited.
-    colIt->toSite(0, genome->getSequenceLength() - 1);
-    while(1) {
-      const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
-      // Temporary collecting of per-genome sites mapped, since it's
-      // organized in the column map by sequence, not genome.
-      map<const Genome *, hal_size_t> numSitesMapped;
-      for (ColumnIterator::ColumnMap::const_iterator colMapIt = cmap->begin();
-           colMapIt != cmap->end(); colMapIt++) {
-        if (colMapIt->second->empty()) {
-          // There are empty entries in the column map.
-          continue;
-        }
-        const Genome *genome = colMapIt->first->getGenome();
-        if (!numSitesMapped.count(genome)) {
-          // Initialize map entry
-          numSitesMapped[genome] = 0;
-        }
-        const ColumnIterator::DNASet *dnaSet = colMapIt->second;
-        numSitesMapped[genome] = numSitesMapped[genome] + dnaSet->size();
-      }
-      // O(n^2) in the number of genomes in the column -- doesn't seem
-      // like there is a better way, since coverage isn't quite
-      // symmetric.
-      for (map<const Genome *, hal_size_t>::const_iterator it = numSitesMapped.begin();
-           it != numSitesMapped.end(); it++) {
-        for(map<const Genome *, hal_size_t>::const_iterator it2 = numSitesMapped.begin();
-           it2 != numSitesMapped.end(); it2++) {
-          pair<const Genome *, const Genome *> key = make_pair(it->first, it2->first);
-          if (!histograms.count(key)) {
-            // Initialize map
-            histograms[key] = new vector<hal_size_t>;
-          }
-          vector<hal_size_t> *histogram = histograms[key];
-          if (histogram->size() < it2->second) {
-            histogram->resize(it2->second, 0);
-          }
-          for (hal_size_t i = 0; i < it2->second; i++) {
-            (*histogram)[i] = histogram->at(i) + numSitesMapped[it->first];
-          }
-        }
-      }
-      if (colIt->getReferenceSequencePosition() % 1000 == 0) {
-        colIt->defragment();
-      }
-      if (colIt->lastColumn()) {
-        // Break here--the column iterator will crash if we try to go further.
-        break;
-      }
-      colIt->toRight();
-    }
-    // Copy over the updated visit cache information so we can supply it to the next genome.
-    visitCache.clear();
-    ColumnIterator::VisitCache *newVisitCache = colIt->getVisitCache();
-    for(ColumnIterator::VisitCache::iterator it = newVisitCache->begin();
-        it != newVisitCache->end(); it++) {
-      visitCache[it->first] = new PositionCache(*it->second);
-    }
-  }
+  vector<string> leafNames = 
+     alignment->getLeafNamesBelow(alignment->getRootName());
+  vector<vector<CoverageHistogram> > histograms;
+  computeCoverage(alignment, leafNames, leafNames, histograms, numThreads,
+                  halPath, options);
 
-  hal_size_t maxHistLength = 0;
-  for (map<pair<const Genome *, const Genome *>, vector<hal_size_t> *>::iterator histIt = histograms.begin();
-       histIt != histograms.end(); histIt++) {
-    vector <hal_size_t> *histogram = histIt->second;
-    if (histogram->size() > maxHistLength) {
-      maxHistLength = histogram->size();
+  vector<string> rowNames;
+  vector<CoverageHistogram> rows;
+  for (size_t i = 0; i < leafNames.size(); ++i)
+  {
+    for (size_t j = 0; j < leafNames.size(); ++j)
+    {
+      rowNames.push_back(leafNames[j] + ", " + leafNames[i]);
+      rows.push_back(histograms[i][j]);
     }
   }
+  printHistograms(os, "FromGenome, ToGenome", rowNames, rows);
+}
 
-  os << "FromGenome, ToGenome";
-  for (hal_size_t i = 0; i < maxHistLength; i++) {
-    os << ", sitesCovered" << i + 1 << "Times";
-  }
-  os << endl;
-  for (map<pair<const Genome *, const Genome *>, vector<hal_size_t> *>::iterator histIt = histograms.begin();
-       histIt != histograms.end(); histIt++) {
-    string fromName = histIt->first.second->getName();
-    string toName = histIt->first.first->getName();
-    os << fromName;
-    os << ", " << toName;
-    vector <hal_size_t> *histogram = histIt->second;
-    for(hal_size_t i = 0; i < maxHistLength; i++) {
-      if (i < histogram->size()) {
-        os << ", " << (double) histogram->at(i);
-      } else {
-        os << ", " << 0;
-      }
-    }
-    os << endl;
+const CachedGenomeStats* getCachedGenome(const StatsCache* cache,
+                                         const string& genomeName)
+{
+  const CachedGenomeStats* stats = cache->getGenomeStats(genomeName);
+  if (stats == NULL)
+  {
+    throw hal_exception(string("Genome ") + genomeName + " not found.");
   }
+  return stats;
+}
+
+void writeStatsCache(const string& path, CLParserConstPtr options)
+{
+  AlignmentPtr alignment = openHalAlignment(path, options);
+  StatsCache cache;
+  cache.compute(alignment);
+  cache.store(alignment);
+  // only the cache was written: don't leave the open in the change log
+  // as a change to every genome
+  logGenomeChanges(alignment, vector<string>(), vector<string>());
+  alignment->close();
 }
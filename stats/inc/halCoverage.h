@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALCOVERAGE_H
+#define _HALCOVERAGE_H
+
+#include <string>
+#include <vector>
+#include "hal.h"
+
+namespace hal {
+
+/** Element i is the number of reference sites covered more than i
+ * times.  Empty if no site is covered */
+typedef std::vector<hal_size_t> CoverageHistogram;
+
+/** Coverage of the sites of each of refGenomes by the sites of tgtGenome
+ * in their columns (as given by a column iterator that follows
+ * paralogies: every site descended from the same ancestral site).
+ * histograms[i] is for refGenomes[i].  Rather than walking columns,
+ * the number of target sites below each ancestral site is counted up
+ * the segment arrays and pulled back down to the references, as runs
+ * of equal counts */
+void computeCoverage(const std::vector<const Genome*>& refGenomes,
+                     const Genome* tgtGenome,
+                     std::vector<CoverageHistogram>& histograms);
+
+/** Coverage of every genome in refNames by every genome in tgtNames.
+ * histograms[i][j] is the coverage of refNames[i] by tgtNames[j].
+ * The targets are divided among numThreads threads, each with its own
+ * instance of the alignment opened from halPath */
+void computeCoverage(AlignmentConstPtr alignment,
+                     const std::vector<std::string>& refNames,
+                     const std::vector<std::string>& tgtNames,
+                     std::vector<std::vector<CoverageHistogram> >& histograms,
+                     hal_size_t numThreads = 1,
+                     const std::string& halPath = "",
+                     CLParserConstPtr options = CLParserConstPtr());
+
+}
+
+#endif
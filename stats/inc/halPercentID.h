@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALPERCENTID_H
+#define _HALPERCENTID_H
+
+#include <string>
+#include <vector>
+#include "hal.h"
+
+namespace hal {
+
+/** Identity of a genome with the reference, over the columns (every site
+ * descended from the same ancestral site) that contain exactly one
+ * reference site.  Ns aren't counted as sites. */
+struct PercentID
+{
+   /** Columns containing at least one site of the genome */
+   hal_size_t _numAligned;
+   /** Columns containing exactly one site of the genome */
+   hal_size_t _numSites;
+   /** Those of _numSites where the genome's base is the reference's */
+   hal_size_t _numID;
+};
+
+/** Identity of each genome in tgtNames with refName.  Bases are compared
+ * over whole segments rather than column by column.  The targets are
+ * divided among numThreads threads, each with its own instance of the
+ * alignment opened from halPath */
+void computePercentID(AlignmentConstPtr alignment,
+                      const std::string& refName,
+                      const std::vector<std::string>& tgtNames,
+                      std::vector<PercentID>& percentIDs,
+                      hal_size_t numThreads = 1,
+                      const std::string& halPath = "",
+                      CLParserConstPtr options = CLParserConstPtr());
+
+}
+
+#endif
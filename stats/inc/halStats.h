@@ -14,6 +14,8 @@
 
 namespace hal {
 
+class StatsCache;
+
 struct GenomeStats : public hal::Sequence::Info 
 {
    size_t _numChildren;
@@ -25,16 +27,23 @@ class HalStats
 public:
 
    HalStats();
-   HalStats(hal::AlignmentConstPtr alignment); 
+   HalStats(hal::AlignmentConstPtr alignment,
+            const StatsCache* cache = NULL); 
    virtual ~HalStats();
 
    void printCsv(std::ostream& outStream) const;
-   void readAlignment(hal::AlignmentConstPtr alignment);
+
+   /** Read the genome stats, from the cache if one is given */
+   void readAlignment(hal::AlignmentConstPtr alignment,
+                      const StatsCache* cache = NULL);
 
 protected:
 
    void readGenomeRecursive(hal::AlignmentConstPtr alignment,
                             const hal::Genome* genome);
+   void readCacheRecursive(hal::AlignmentConstPtr alignment,
+                           const StatsCache* cache,
+                           const std::string& genomeName);
 
    std::string _tree;
    std::vector<GenomeStats> _genomeStatsVec;
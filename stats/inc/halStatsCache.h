@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALSTATSCACHE_H
+#define _HALSTATSCACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "hal.h"
+#include "halStats.h"
+
+namespace hal {
+
+/** What halStats reports about a genome's arrays */
+struct CachedGenomeStats : public GenomeStats
+{
+   /** A, C, G, T (either case) and anything else */
+   hal_size_t _baseCounts[5];
+   std::vector<hal::Sequence::Info> _sequences;
+};
+
+/** The genome stats kept in the alignment's stats cache (see
+ * Alignment::getStatsCache()), so that halStats can answer queries
+ * without opening genomes */
+class StatsCache
+{
+public:
+
+   StatsCache();
+   virtual ~StatsCache();
+
+   /** Read the stats from the alignment's cache.  Returns false, leaving
+    * this empty, if there is no cache or it was written by another
+    * version or for another tree */
+   bool load(hal::AlignmentConstPtr alignment);
+
+   /** Compute the stats by reading every genome in the alignment */
+   void compute(hal::AlignmentConstPtr alignment);
+
+   /** Replace the alignment's cache with these stats */
+   void store(hal::AlignmentPtr alignment) const;
+
+   /** Stats of a genome (NULL if it isn't in the cache) */
+   const CachedGenomeStats* getGenomeStats(const std::string& name) const;
+
+   static const std::string Version;
+
+protected:
+
+   void computeGenome(const hal::Genome* genome, CachedGenomeStats& stats);
+   static bool parseGenome(const std::string& value, CachedGenomeStats& stats);
+   static std::string formatGenome(const CachedGenomeStats& stats);
+
+   std::map<std::string, CachedGenomeStats> _genomes;
+};
+
+}
+
+#endif
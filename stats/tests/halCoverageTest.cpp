@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <map>
+#include <deque>
+#include "halStatsTests.h"
+#include "halCoverage.h"
+#include "halRandomData.h"
+
+using namespace std;
+using namespace hal;
+
+// the coverage of refGenome by every genome, counted in the column of
+// each of its sites in turn
+static void getColumnCoverage(AlignmentConstPtr alignment,
+                              const Genome* refGenome,
+                              map<const Genome*, CoverageHistogram>& 
+                              histograms)
+{
+  histograms.clear();
+  hal_index_t length = (hal_index_t)refGenome->getSequenceLength();
+  if (length == 0)
+  {
+    return;
+  }
+  ColumnIteratorConstPtr colIt = refGenome->getColumnIterator(NULL, 0, 0,
+                                                              0);
+  for (hal_index_t pos = 0; pos < length; ++pos)
+  {
+    colIt->toSite(pos, pos, true);
+    map<const Genome*, hal_size_t> numSites;
+    const ColumnIterator::ColumnMap* colMap = colIt->getColumnMap();
+    for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin();
+         i != colMap->end(); ++i)
+    {
+      numSites[i->first->getGenome()] += i->second->size();
+    }
+    for (map<const Genome*, hal_size_t>::const_iterator i = 
+            numSites.begin(); i != numSites.end(); ++i)
+    {
+      CoverageHistogram& histogram = histograms[i->first];
+      if (histogram.size() < i->second)
+      {
+        histogram.resize(i->second, 0);
+      }
+      for (hal_size_t j = 0; j < i->second; ++j)
+      {
+        ++histogram[j];
+      }
+    }
+  }
+}
+
+// the coverage computed from the segment arrays must match a count of
+// the column of every site
+struct CoverageTest : public AlignmentTest
+{
+   void createCallBack(AlignmentPtr alignment)
+   {
+     createRandomAlignment(alignment, 2, 0.1, 6, 10, 100, 5, 20, 1107);
+   }
+   void checkCallBack(AlignmentConstPtr alignment)
+   {
+     vector<string> names;
+     deque<string> queue(1, alignment->getRootName());
+     while (queue.empty() == false)
+     {
+       names.push_back(queue.front());
+       vector<string> childNames = alignment->getChildNames(queue.front());
+       queue.insert(queue.end(), childNames.begin(), childNames.end());
+       queue.pop_front();
+     }
+     vector<vector<CoverageHistogram> > histograms;
+     computeCoverage(alignment, names, names, histograms);
+     CuAssertTrue(_testCase, histograms.size() == names.size());
+
+     for (size_t i = 0; i < names.size(); ++i)
+     {
+       const Genome* refGenome = alignment->openGenome(names[i]);
+       map<const Genome*, CoverageHistogram> columnHistograms;
+       getColumnCoverage(alignment, refGenome, columnHistograms);
+       for (size_t j = 0; j < names.size(); ++j)
+       {
+         const Genome* tgtGenome = alignment->openGenome(names[j]);
+         CuAssertTrue(_testCase, 
+                      histograms[i][j] == columnHistograms[tgtGenome]);
+         CuAssertTrue(_testCase, histograms[i][j].empty() == false ||
+                      tgtGenome != refGenome);
+         if (histograms[i][j].empty() == false)
+         {
+           CuAssertTrue(_testCase, histograms[i][j][0] <= 
+                        refGenome->getSequenceLength());
+         }
+       }
+     }
+
+     if (alignment->isThreadSafe() == true)
+     {
+       vector<vector<CoverageHistogram> > threadHistograms;
+       computeCoverage(alignment, names, names, threadHistograms, 3,
+                       _checkPath, CLParserPtr());
+       CuAssertTrue(_testCase, threadHistograms == histograms);
+     }
+   }
+};
+
+static void halCoverageTest(CuTest *testCase)
+{
+  try
+  {
+    CoverageTest tester;
+    tester.check(testCase);
+  }
+  catch (exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+}
+
+CuSuite *halCoverageTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halCoverageTest);
+  return suite;
+}
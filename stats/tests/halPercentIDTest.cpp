@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <map>
+#include <deque>
+#include <cctype>
+#include "halStatsTests.h"
+#include "halPercentID.h"
+#include "halRandomData.h"
+
+using namespace std;
+using namespace hal;
+
+// the identity of every genome with refGenome, counted in the column of
+// each of its sites in turn
+static void getColumnPercentID(AlignmentConstPtr alignment,
+                               const Genome* refGenome,
+                               map<const Genome*, PercentID>& percentIDs)
+{
+  percentIDs.clear();
+  hal_index_t length = (hal_index_t)refGenome->getSequenceLength();
+  if (length == 0)
+  {
+    return;
+  }
+  ColumnIteratorConstPtr colIt = refGenome->getColumnIterator(NULL, 0, 0,
+                                                              0);
+  DNAIteratorConstPtr refDnaIt = refGenome->getDNAIterator(0);
+  for (hal_index_t pos = 0; pos < length; ++pos)
+  {
+    colIt->toSite(pos, pos, true);
+    refDnaIt->jumpTo(pos);
+    char refDna = toupper(refDnaIt->getChar());
+    map<const Genome*, pair<hal_size_t, hal_size_t> > numSites;
+    const ColumnIterator::ColumnMap* colMap = colIt->getColumnMap();
+    for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin();
+         i != colMap->end(); ++i)
+    {
+      for (size_t j = 0; j < i->second->size(); ++j)
+      {
+        char dna = toupper(i->second->at(j)->getChar());
+        if (dna != 'N')
+        {
+          pair<hal_size_t, hal_size_t>& counts =
+             numSites[i->first->getGenome()];
+          ++counts.first;
+          counts.second += dna == refDna;
+        }
+      }
+    }
+    if (refDna == 'N' || numSites[refGenome].first != 1)
+    {
+      continue;
+    }
+    for (map<const Genome*, pair<hal_size_t, hal_size_t> >::const_iterator
+            i = numSites.begin(); i != numSites.end(); ++i)
+    {
+      if (i->second.first > 0)
+      {
+        PercentID& percentID = percentIDs[i->first];
+        ++percentID._numAligned;
+        if (i->second.first == 1)
+        {
+          ++percentID._numSites;
+          percentID._numID += i->second.second;
+        }
+      }
+    }
+  }
+}
+
+// the identities computed from the segment arrays must match a count of
+// the column of every reference site
+struct PercentIDTest : public AlignmentTest
+{
+   void createCallBack(AlignmentPtr alignment)
+   {
+     createRandomAlignment(alignment, 2, 0.1, 6, 10, 100, 5, 20, 2311);
+   }
+   void checkCallBack(AlignmentConstPtr alignment)
+   {
+     vector<string> names;
+     deque<string> queue(1, alignment->getRootName());
+     while (queue.empty() == false)
+     {
+       names.push_back(queue.front());
+       vector<string> childNames = alignment->getChildNames(queue.front());
+       queue.insert(queue.end(), childNames.begin(), childNames.end());
+       queue.pop_front();
+     }
+     for (size_t i = 0; i < names.size(); ++i)
+     {
+       vector<PercentID> percentIDs;
+       computePercentID(alignment, names[i], names, percentIDs);
+       CuAssertTrue(_testCase, percentIDs.size() == names.size());
+
+       const Genome* refGenome = alignment->openGenome(names[i]);
+       map<const Genome*, PercentID> columnPercentIDs;
+       getColumnPercentID(alignment, refGenome, columnPercentIDs);
+       for (size_t j = 0; j < names.size(); ++j)
+       {
+         const Genome* tgtGenome = alignment->openGenome(names[j]);
+         PercentID& columnPercentID = columnPercentIDs[tgtGenome];
+         CuAssertTrue(_testCase, percentIDs[j]._numAligned ==
+                      columnPercentID._numAligned);
+         CuAssertTrue(_testCase, percentIDs[j]._numSites ==
+                      columnPercentID._numSites);
+         CuAssertTrue(_testCase, percentIDs[j]._numID ==
+                      columnPercentID._numID);
+       }
+       CuAssertTrue(_testCase, percentIDs[i]._numID == 
+                    percentIDs[i]._numSites);
+
+       if (alignment->isThreadSafe() == true)
+       {
+         vector<PercentID> threadPercentIDs;
+         computePercentID(alignment, names[i], names, threadPercentIDs, 3,
+                          _checkPath, CLParserPtr());
+         for (size_t j = 0; j < names.size(); ++j)
+         {
+           CuAssertTrue(_testCase, threadPercentIDs[j]._numID ==
+                        percentIDs[j]._numID);
+         }
+       }
+     }
+   }
+};
+
+static void halPercentIDTest(CuTest *testCase)
+{
+  try
+  {
+    PercentIDTest tester;
+    tester.check(testCase);
+  }
+  catch (exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+}
+
+CuSuite *halPercentIDTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halPercentIDTest);
+  return suite;
+}
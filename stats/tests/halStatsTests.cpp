@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdio>
+#include "halStatsTests.h"
+
+int halStatsRunAllTests(void) {
+  CuString *output = CuStringNew();
+  CuSuite* suite = CuSuiteNew();
+  CuSuiteAddSuite(suite, halCoverageTestSuite());
+  CuSuiteAddSuite(suite, halPercentIDTestSuite());
+  CuSuiteRun(suite);
+  CuSuiteSummary(suite, output);
+  CuSuiteDetails(suite, output);
+  printf("%s\n", output->buffer);
+  return suite->failCount > 0;
+}
+
+int main(int argc, char *argv[]) {
+   
+  return halStatsRunAllTests();
+}
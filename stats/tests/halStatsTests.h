@@ -0,0 +1,19 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALSTATSTESTS_H
+#define _HALSTATSTESTS_H
+
+#include "halAlignmentTest.h"
+
+extern "C" {
+#include "CuTest.h"
+}
+
+CuSuite *halCoverageTestSuite();
+CuSuite *halPercentIDTestSuite();
+
+#endif
@@ -15,12 +15,38 @@ int main(int argc, char** argv)
 {
   CLParserPtr optionsParser = hdf5CLParserInstance();
   optionsParser->addArgument("halFile", "path to hal file to validate");
+  optionsParser->addOption("numThreads", "number of threads to validate "
+                           "with.  Genomes, and chunks of large genomes, "
+                           "are checked concurrently, each thread with its "
+                           "own handle on the file.  Requires a "
+                           "thread-safe HDF5 library", 1);
+  optionsParser->addOption("sample", "only check this fraction (evenly "
+                           "spread) of the segments and DNA of each genome. "
+                           " The genome-wide checks are always done", 1.);
+  optionsParser->addOptionFlag("progress", "report the number of chunks "
+                               "checked to stderr", false);
+  optionsParser->addOptionFlag("deep", "check every segment through the "
+                               "segment iterators instead of reading the "
+                               "segment arrays in batches (much slower)",
+                               false);
   optionsParser->setDescription("Check if hal database is valid");
   string path;
+  hal_size_t numThreads;
+  double sample;
+  bool progress;
+  bool deep;
   try
   {
     optionsParser->parseOptions(argc, argv);
     path = optionsParser->getArgument<string>("halFile");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    sample = optionsParser->getOption<double>("sample");
+    progress = optionsParser->getFlag("progress");
+    deep = optionsParser->getFlag("deep");
+    if (sample <= 0. || sample > 1.)
+    {
+      throw hal_exception("--sample must be greater than 0 and at most 1");
+    }
   }
   catch(exception& e)
   {
@@ -31,7 +57,8 @@ int main(int argc, char** argv)
   try
   {
     AlignmentConstPtr alignment = openHalAlignmentReadOnly(path, optionsParser);
-    validateAlignment(alignment);
+    validateAlignment(alignment, numThreads, path, optionsParser, sample,
+                      progress, deep);
   }
   catch(hal_exception& e)
   {